@@ -854,6 +854,9 @@ then
 			AC_MSG_CHECKING(if PostgreSQL has PQdescribePrepared)
 			FW_TRY_LINK([#include <libpq-fe.h>
 #include <stdlib.h>],[PQdescribePrepared(0,0);],[$POSTGRESQLINCLUDES],[$POSTGRESQLLIBS $SOCKETLIBS],[$LD_LIBRARY_PATH:$POSTGRESQLLIBSPATH],[AC_MSG_RESULT(yes); AC_DEFINE(HAVE_POSTGRESQL_PQDESCRIBEPREPARED,1,Some versions of postgresql have PQdescribePrepared)],[AC_MSG_RESULT(no)])
+			AC_MSG_CHECKING(if PostgreSQL has PQenterPipelineMode)
+			FW_TRY_LINK([#include <libpq-fe.h>
+#include <stdlib.h>],[PQenterPipelineMode(0);],[$POSTGRESQLINCLUDES],[$POSTGRESQLLIBS $SOCKETLIBS],[$LD_LIBRARY_PATH:$POSTGRESQLLIBSPATH],[AC_MSG_RESULT(yes); AC_DEFINE(HAVE_POSTGRESQL_PQENTERPIPELINEMODE,1,Some versions of postgresql have PQenterPipelineMode)],[AC_MSG_RESULT(no)])
 		fi
 		AC_MSG_CHECKING(if PostgreSQL has PQserverVersion)
 		FW_TRY_LINK([#include <libpq-fe.h>
@@ -1002,6 +1005,10 @@ then
 		FW_TRY_LINK([#include <sqlite3.h>
 #include <stdlib.h>],[sqlite3_prepare_v2(0,0,0,0,0);],[$SQLITESTATIC $SQLITEINCLUDES $PTHREADINCLUDES],[$SQLITELIBS $PTHREADLIB],[$LD_LIBRARY_PATH],[AC_MSG_RESULT(yes); AC_DEFINE(HAVE_SQLITE3_PREPARE_V2,1,SQLite supports sqlite3_prepare_v2)],[AC_MSG_RESULT(no)])
 
+		AC_MSG_CHECKING(for sqlite3_open_v2)
+		FW_TRY_LINK([#include <sqlite3.h>
+#include <stdlib.h>],[sqlite3_open_v2(0,0,SQLITE_OPEN_READONLY|SQLITE_OPEN_SHAREDCACHE,0);],[$SQLITESTATIC $SQLITEINCLUDES $PTHREADINCLUDES],[$SQLITELIBS $PTHREADLIB],[$LD_LIBRARY_PATH],[AC_MSG_RESULT(yes); AC_DEFINE(HAVE_SQLITE3_OPEN_V2,1,SQLite supports sqlite3_open_v2)],[AC_MSG_RESULT(no)])
+
 		AC_MSG_CHECKING(for sqlite3_malloc)
 		FW_TRY_LINK([#include <sqlite3.h>
 #include <stdlib.h>],[sqlite3_malloc(0);],[$SQLITESTATIC $SQLITEINCLUDES $PTHREADINCLUDES],[$SQLITELIBS $PTHREADLIB],[$LD_LIBRARY_PATH],[AC_MSG_RESULT(yes); AC_DEFINE(HAVE_SQLITE3_MALLOC,1,SQLite supports sqlite3_malloc)],[AC_MSG_RESULT(no)])
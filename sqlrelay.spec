@@ -457,6 +457,7 @@ cp -r %{buildroot}%{_docdir}/%{name}/api/java %{buildroot}%{_javadocdir}/%{name}
 %{_bindir}/sqlr-start
 %{_bindir}/sqlr-stop
 %{_bindir}/sqlr-status
+%{_bindir}/sqlr-trace
 %{_bindir}/sqlr-pwdenc
 %{_libdir}/libsqlrserver.so.12
 %{_libdir}/libsqlrserver.so.12.*
@@ -483,6 +484,7 @@ cp -r %{buildroot}%{_docdir}/%{name}/api/java %{buildroot}%{_javadocdir}/%{name}
 %{_mandir}/*/sqlr-start.*
 %{_mandir}/*/sqlr-stop.*
 %{_mandir}/*/sqlr-status.*
+%{_mandir}/*/sqlr-trace.*
 %{_mandir}/*/sqlr-pwdenc.*
 %doc AUTHORS ChangeLog
 %attr(755, sqlrelay, sqlrelay) %dir %{_localstatedir}/log/%{name}
@@ -21,6 +21,20 @@
         #define MAXPATHLEN 256
 #endif
 
+// maximum number of commands that can be
+// queued before the pipeline is synced
+#define MAXPIPELINEDEPTH 256
+
+// maximum number of bytes of commands that can be queued before the
+// pipeline is synced (well under the combined size of the client's send
+// and server's receive socket buffers)
+#define MAXPIPELINEBYTES 32768
+
+struct sqlrpipelineentry {
+	sqlrcursor	*cursor;
+	uint16_t	command;
+};
+
 class sqlrconnectionprivate {
 	friend class sqlrconnection;
 	private:
@@ -130,6 +144,16 @@ class sqlrconnectionprivate {
 		// cursor list
 		sqlrcursor	*_firstcursor;
 		sqlrcursor	*_lastcursor;
+
+		// pipeline
+		bool			_pipelining;
+		bool			_pipelinebegun;
+		bool			_pipelinefailed;
+		uint16_t		_pipelinedepth;
+		sqlrpipelineentry	_pipeline[MAXPIPELINEDEPTH];
+		uint16_t		_pipelinehead;
+		uint16_t		_pipelinecount;
+		uint64_t		_pipelinebytes;
 };
 
 sqlrconnection::sqlrconnection(const char *server, uint16_t port,
@@ -270,6 +294,15 @@ void sqlrconnection::init(const char *server, uint16_t port,
 	// cursor list
 	pvt->_firstcursor=NULL;
 	pvt->_lastcursor=NULL;
+
+	// pipeline
+	pvt->_pipelining=false;
+	pvt->_pipelinebegun=false;
+	pvt->_pipelinefailed=false;
+	pvt->_pipelinedepth=32;
+	pvt->_pipelinehead=0;
+	pvt->_pipelinecount=0;
+	pvt->_pipelinebytes=0;
 }
 
 void sqlrconnection::clearSessionFlags() {
@@ -514,6 +547,9 @@ void sqlrconnection::endSession() {
 		debugPreEnd();
 	}
 
+	// commands still waiting in the pipeline will never get a response
+	abandonPipeline();
+
 	// abort each cursor's result set
 	sqlrcursor	*currentcursor=pvt->_firstcursor;
 	while (currentcursor) {
@@ -541,6 +577,7 @@ void sqlrconnection::flushWriteBuffer() {
 void sqlrconnection::closeConnection() {
 	pvt->_cs->close();
 	pvt->_connected=false;
+	pvt->_pipelinebegun=false;
 }
 
 bool sqlrconnection::suspendSession() {
@@ -577,6 +614,37 @@ bool sqlrconnection::suspendSession() {
 
 bool sqlrconnection::openSession() {
 
+	// Commands that aren't pipelined need their response right away,
+	// so read the responses to anything that's been pipelined first.
+	syncPipeline();
+
+	return openSessionInternal();
+}
+
+bool sqlrconnection::openPipelinedSession() {
+
+	if (!openSessionInternal()) {
+		return false;
+	}
+
+	// tell the server to buffer its responses
+	// until the end of the pipeline
+	if (!pvt->_pipelinebegun) {
+
+		if (pvt->_debug) {
+			debugPreStart();
+			debugPrint("Beginning Pipeline\n");
+			debugPreEnd();
+		}
+
+		pvt->_cs->write((uint16_t)BEGIN_PIPELINE);
+		pvt->_pipelinebegun=true;
+	}
+	return true;
+}
+
+bool sqlrconnection::openSessionInternal() {
+
 	if (pvt->_connected) {
 		return true;
 	}
@@ -1734,7 +1802,7 @@ bool sqlrconnection::autoCommitOff() {
 
 bool sqlrconnection::autoCommit(bool on) {
 
-	if (!openSession()) {
+	if (!((pvt->_pipelining)?openPipelinedSession():openSession())) {
 		return false;
 	}
 
@@ -1749,6 +1817,12 @@ bool sqlrconnection::autoCommit(bool on) {
 
 	pvt->_cs->write((uint16_t)AUTOCOMMIT);
 	pvt->_cs->write(on);
+
+	if (pvt->_pipelining) {
+		queuePipelinedCommand(NULL,AUTOCOMMIT);
+		return true;
+	}
+
 	flushWriteBuffer();
 
 	return !gotError();
@@ -1756,7 +1830,7 @@ bool sqlrconnection::autoCommit(bool on) {
 
 bool sqlrconnection::begin() {
 
-	if (!openSession()) {
+	if (!((pvt->_pipelining)?openPipelinedSession():openSession())) {
 		return false;
 	}
 
@@ -1769,6 +1843,12 @@ bool sqlrconnection::begin() {
 	}
 
 	pvt->_cs->write((uint16_t)BEGIN);
+
+	if (pvt->_pipelining) {
+		queuePipelinedCommand(NULL,BEGIN);
+		return true;
+	}
+
 	flushWriteBuffer();
 
 	return !gotError();
@@ -1776,7 +1856,7 @@ bool sqlrconnection::begin() {
 
 bool sqlrconnection::commit() {
 
-	if (!openSession()) {
+	if (!((pvt->_pipelining)?openPipelinedSession():openSession())) {
 		return false;
 	}
 
@@ -1789,6 +1869,12 @@ bool sqlrconnection::commit() {
 	}
 
 	pvt->_cs->write((uint16_t)COMMIT);
+
+	if (pvt->_pipelining) {
+		queuePipelinedCommand(NULL,COMMIT);
+		return true;
+	}
+
 	flushWriteBuffer();
 
 	return !gotError();
@@ -1796,7 +1882,7 @@ bool sqlrconnection::commit() {
 
 bool sqlrconnection::rollback() {
 
-	if (!openSession()) {
+	if (!((pvt->_pipelining)?openPipelinedSession():openSession())) {
 		return false;
 	}
 
@@ -1809,11 +1895,160 @@ bool sqlrconnection::rollback() {
 	}
 
 	pvt->_cs->write((uint16_t)ROLLBACK);
+
+	if (pvt->_pipelining) {
+		queuePipelinedCommand(NULL,ROLLBACK);
+		return true;
+	}
+
 	flushWriteBuffer();
 
 	return !gotError();
 }
 
+void sqlrconnection::beginPipeline() {
+
+	if (pvt->_debug) {
+		debugPreStart();
+		debugPrint("Pipelining commands\n");
+		debugPreEnd();
+	}
+
+	clearError();
+	pvt->_pipelining=true;
+}
+
+bool sqlrconnection::endPipeline() {
+
+	if (pvt->_debug) {
+		debugPreStart();
+		debugPrint("Ending Pipeline\n");
+		debugPreEnd();
+	}
+
+	syncPipeline();
+	pvt->_pipelining=false;
+
+	bool	success=!pvt->_pipelinefailed;
+	pvt->_pipelinefailed=false;
+	return success;
+}
+
+void sqlrconnection::setPipelineDepth(uint16_t depth) {
+	if (!depth) {
+		depth=1;
+	} else if (depth>MAXPIPELINEDEPTH) {
+		depth=MAXPIPELINEDEPTH;
+	}
+	pvt->_pipelinedepth=depth;
+}
+
+bool sqlrconnection::pipelining() {
+	return pvt->_pipelining;
+}
+
+void sqlrconnection::queuePipelinedCommand(sqlrcursor *cur,
+						uint16_t command) {
+
+	sqlrpipelineentry	*entry=&pvt->_pipeline[pvt->_pipelinecount];
+	entry->cursor=cur;
+	entry->command=command;
+	pvt->_pipelinecount++;
+
+	// Cap the number of queued commands.  (Their size is capped by
+	// reservePipelineSpace().)
+	if (pvt->_pipelinecount-pvt->_pipelinehead>=pvt->_pipelinedepth ||
+			pvt->_pipelinecount==MAXPIPELINEDEPTH) {
+		syncPipeline();
+	}
+}
+
+void sqlrconnection::reservePipelineSpace(uint64_t bytes) {
+
+	// The server doesn't read the next command until it has written the
+	// response to the current one, and responses can be arbitrarily
+	// large (eg. all rows of a result set, if the result set buffer size
+	// is 0).  So, once the server blocks writing a response that the
+	// client isn't reading yet, whatever the client writes next has to
+	// fit in the socket buffers, or both sides end up blocked on each
+	// other.  If the command that's about to be written would put more
+	// than MAXPIPELINEBYTES in flight, then read the pending responses
+	// before writing it.
+	if (pvt->_pipelinecount>pvt->_pipelinehead &&
+			pvt->_pipelinebytes+bytes>MAXPIPELINEBYTES) {
+		syncPipeline();
+	}
+	pvt->_pipelinebytes+=bytes;
+}
+
+void sqlrconnection::syncPipeline() {
+
+	// tell the server to send everything that it's buffered
+	if (pvt->_pipelinebegun) {
+
+		if (pvt->_debug) {
+			debugPreStart();
+			debugPrint("Syncing Pipeline\n");
+			debugPreEnd();
+		}
+
+		pvt->_cs->write((uint16_t)END_PIPELINE);
+		flushWriteBuffer();
+		pvt->_pipelinebegun=false;
+	}
+
+	// Read the responses in the same order that the commands were sent.
+	// Entries are removed before they're processed so that if processing
+	// one of them ends the session, abandonPipeline() only has to deal
+	// with the ones that are left.
+	while (pvt->_pipelinehead<pvt->_pipelinecount) {
+
+		sqlrpipelineentry	*entry=
+				&pvt->_pipeline[pvt->_pipelinehead];
+		pvt->_pipelinehead++;
+
+		if (entry->cursor) {
+			if (!entry->cursor->processPipelinedResultSet()) {
+				pvt->_pipelinefailed=true;
+			}
+			continue;
+		}
+
+		// getError() clears the previous error, but if more than one
+		// connection-level command failed, the first error is the one
+		// that the app will want to see
+		char	*firsterror=pvt->_error;
+		int64_t	firsterrorno=pvt->_errorno;
+		pvt->_error=NULL;
+		if (gotError()) {
+			pvt->_pipelinefailed=true;
+		}
+		if (firsterror) {
+			delete[] pvt->_error;
+			pvt->_error=firsterror;
+			pvt->_errorno=firsterrorno;
+		}
+	}
+
+	pvt->_pipelinehead=0;
+	pvt->_pipelinecount=0;
+	pvt->_pipelinebytes=0;
+}
+
+void sqlrconnection::abandonPipeline() {
+
+	for (uint16_t i=pvt->_pipelinehead; i<pvt->_pipelinecount; i++) {
+		if (pvt->_pipeline[i].cursor) {
+			pvt->_pipeline[i].cursor->abandonPipelinedResultSet();
+		}
+		pvt->_pipelinefailed=true;
+	}
+
+	pvt->_pipelinehead=0;
+	pvt->_pipelinecount=0;
+	pvt->_pipelinebytes=0;
+}
+
 const char *sqlrconnection::errorMessage() {
 	return pvt->_error;
 }
@@ -5,6 +5,7 @@
 #include <sqlrelay/sqlrclient.h>
 #include <rudiments/memorypool.h>
 #include <rudiments/file.h>
+#include <rudiments/memorymap.h>
 #include <rudiments/charstring.h>
 #include <rudiments/permissions.h>
 #include <rudiments/datetime.h>
@@ -232,12 +233,20 @@ class sqlrcursorprivate {
 		// result set
 		bool		_lazyfetch;
 		uint64_t	_rsbuffersize;
+		uint64_t	_rsbufferbytes;
+		uint64_t	_rsblocksize;
 		uint16_t	_sendcolumninfo;
 		uint16_t	_sentcolumninfo;
 
 		uint16_t	_suspendresultsetsent;
 		bool		_endofresultset;
 
+		// lob streaming
+		sqlrlobfieldcallback	_lobfieldcallback;
+		void			*_lobfieldcallbackdata;
+		char			*_lobsegment;
+		uint32_t		_lobsegmentsize;
+
 		uint16_t	_columntypeformat;
 		uint32_t	_colcount;
 		uint32_t	_previouscolcount;
@@ -276,6 +285,19 @@ class sqlrcursorprivate {
 		file		*_cachesource;
 		file		*_cachesourceind;
 
+		// mapped cache file
+		bool		_cachemapped;
+		memorymap	_cachemap;
+		memorymap	_cacheindmap;
+		const unsigned char	*_cachedata;
+		uint64_t	_cachedatasize;
+		const unsigned char	*_cacheindex;
+		uint64_t	_cacherowcount;
+		uint64_t	_cachesummaryoffset;
+		uint64_t	_cachecurrentrow;
+		char		**_cachefields;
+		uint32_t	*_cachefieldlengths;
+
 		// error
 		int64_t		_errorno;
 		char		*_error;
@@ -294,6 +316,9 @@ class sqlrcursorprivate {
 		uint16_t	_cursorid;
 		bool		_havecursorid;
 
+		// pipeline
+		bool		_pipelined;
+
 		// query translation
 		char		*_querytree;
 		char		*_translatedquery;
@@ -357,6 +382,8 @@ void sqlrcursor::init(sqlrconnection *sqlrc, bool copyreferences) {
 	// result set
 	pvt->_lazyfetch=false;
 	pvt->_rsbuffersize=0;
+	pvt->_rsbufferbytes=0;
+	pvt->_rsblocksize=0;
 
 	pvt->_firstrowindex=0;
 	pvt->_resumedlastrowindex=0;
@@ -388,6 +415,12 @@ void sqlrcursor::init(sqlrconnection *sqlrc, bool copyreferences) {
 
 	pvt->_returnnulls=false;
 
+	// lob streaming
+	pvt->_lobfieldcallback=NULL;
+	pvt->_lobfieldcallbackdata=NULL;
+	pvt->_lobsegment=NULL;
+	pvt->_lobsegmentsize=0;
+
 	// cache file
 	pvt->_cachesource=NULL;
 	pvt->_cachesourceind=NULL;
@@ -396,6 +429,15 @@ void sqlrcursor::init(sqlrconnection *sqlrc, bool copyreferences) {
 	pvt->_cachedest=NULL;
 	pvt->_cachedestind=NULL;
 	pvt->_cacheon=false;
+	pvt->_cachemapped=false;
+	pvt->_cachedata=NULL;
+	pvt->_cachedatasize=0;
+	pvt->_cacheindex=NULL;
+	pvt->_cacherowcount=0;
+	pvt->_cachesummaryoffset=0;
+	pvt->_cachecurrentrow=0;
+	pvt->_cachefields=NULL;
+	pvt->_cachefieldlengths=NULL;
 
 	// options...
 	pvt->_sendcolumninfo=SEND_COLUMN_INFO;
@@ -407,6 +449,9 @@ void sqlrcursor::init(sqlrconnection *sqlrc, bool copyreferences) {
 	pvt->_cursorid=0;
 	pvt->_havecursorid=false;
 
+	// pipeline
+	pvt->_pipelined=false;
+
 	// query translation
 	pvt->_querytree=NULL;
 	pvt->_translatedquery=NULL;
@@ -430,6 +475,9 @@ void sqlrcursor::init(sqlrconnection *sqlrc, bool copyreferences) {
 
 sqlrcursor::~sqlrcursor() {
 
+	// the connection can't be left holding a pointer to this cursor
+	syncPipeline();
+
 	// abort result set if necessary
 	if (pvt->_sqlrc && !pvt->_sqlrc->endsessionsent() &&
 				!pvt->_sqlrc->suspendsessionsent()) {
@@ -499,11 +547,15 @@ sqlrcursor::~sqlrcursor() {
 	delete[] pvt->_querytree;
 	delete[] pvt->_translatedquery;
 
+	// lob streaming
+	delete[] pvt->_lobsegment;
+
 	delete pvt;
 }
 
 void sqlrcursor::setResultSetBufferSize(uint64_t rows) {
 	pvt->_rsbuffersize=rows;
+	pvt->_rsblocksize=rows;
 	if (pvt->_sqlrc->debug()) {
 		pvt->_sqlrc->debugPreStart();
 		pvt->_sqlrc->debugPrint("Result Set Buffer Size: ");
@@ -513,10 +565,31 @@ void sqlrcursor::setResultSetBufferSize(uint64_t rows) {
 	}
 }
 
+void sqlrcursor::setLobFieldCallback(sqlrlobfieldcallback callback,
+								void *data) {
+	pvt->_lobfieldcallback=callback;
+	pvt->_lobfieldcallbackdata=data;
+}
+
 uint64_t sqlrcursor::getResultSetBufferSize() {
 	return pvt->_rsbuffersize;
 }
 
+void sqlrcursor::setResultSetBufferBytes(uint64_t bytes) {
+	pvt->_rsbufferbytes=bytes;
+	if (pvt->_sqlrc->debug()) {
+		pvt->_sqlrc->debugPreStart();
+		pvt->_sqlrc->debugPrint("Result Set Buffer Bytes: ");
+		pvt->_sqlrc->debugPrint((int64_t)bytes);
+		pvt->_sqlrc->debugPrint("\n");
+		pvt->_sqlrc->debugPreEnd();
+	}
+}
+
+uint64_t sqlrcursor::getResultSetBufferBytes() {
+	return pvt->_rsbufferbytes;
+}
+
 void sqlrcursor::lazyFetch() {
 	pvt->_lazyfetch=true;
 }
@@ -633,9 +706,11 @@ void sqlrcursor::startCaching() {
 
 		if (!pvt->_resumed) {
 
-			// write "magic" identifier to head of files
-			pvt->_cachedest->write("SQLRELAYCACHE",13);
-			pvt->_cachedestind->write("SQLRELAYCACHE",13);
+			// write "magic" identifier and version to head of files
+			pvt->_cachedest->write(CACHE_MAGIC,CACHE_MAGIC_LENGTH);
+			pvt->_cachedestind->write(CACHE_MAGIC,CACHE_MAGIC_LENGTH);
+			pvt->_cachedest->write((uint16_t)CACHE_VERSION);
+			pvt->_cachedestind->write((uint16_t)CACHE_VERSION);
 			
 			// write ttl to files
 			datetime	dt;
@@ -644,6 +719,14 @@ void sqlrcursor::startCaching() {
 			pvt->_cachedest->write(expiration);
 			pvt->_cachedestind->write(expiration);
 
+			// the row count and the offset of the column summary
+			// aren't known until the whole result set is cached
+			pvt->_cachedest->write((int64_t)-1);
+			pvt->_cachedest->write((int64_t)0);
+
+			// let the cache manager know about the file
+			indexCacheFile(expiration);
+
 		} else {
 
 			// go to the end
@@ -847,30 +930,22 @@ void sqlrcursor::cacheData() {
 		// seek to the right place in the index file and write the
 		// destination file offset
 		pvt->_cachedestind->setPositionRelativeToBeginning(
-				// magicid
-				13+
-				// ttl
-				sizeof(int64_t)+
-				// row
+				CACHE_INDEX_HEADER_SIZE+
 				(pvt->_firstrowindex+i)*sizeof(int64_t));
 		pvt->_cachedestind->write(position);
 
-		// write the row to the cache file
+		// write the row to the cache file, NULL-terminating each
+		// field so it can be returned straight from the file later
 		for (uint32_t j=0; j<pvt->_colcount; j++) {
-			uint16_t	type;
-			int32_t		len;
-			char		*field=getFieldInternal(i,j);
+			char	*field=getFieldInternal(i,j);
 			if (field) {
-				type=STRING_DATA;
-				len=charstring::length(field);
-				pvt->_cachedest->write(type);
+				int32_t	len=getFieldLengthInternal(i,j);
 				pvt->_cachedest->write(len);
-				if (len>0) {
-					pvt->_cachedest->write(field);
-				}
+				pvt->_cachedest->write(field,len);
+				pvt->_cachedest->write('\0');
 			} else {
-				type=NULL_DATA;
-				pvt->_cachedest->write(type);
+				pvt->_cachedest->write(
+					(int32_t)CACHE_NULL_FIELD);
 			}
 		}
 	}
@@ -892,13 +967,56 @@ void sqlrcursor::finishCaching() {
 		pvt->_sqlrc->debugPreEnd();
 	}
 
-	// terminate the result set
-	pvt->_cachedest->write((uint16_t)END_RESULT_SET);
+	// write a summary of the columns, so the result set
+	// can be used without looking at each row first
+	int64_t	summaryoffset=pvt->_cachedest->getCurrentPosition();
+	for (uint32_t i=0; i<pvt->_colcount; i++) {
+		sqlrclientcolumn	*whichcol=getColumnInternal(i);
+		pvt->_cachedest->write(whichcol->longest);
+		pvt->_cachedest->write((uint16_t)whichcol->longdatatype);
+	}
+
+	// fill in the row count and summary offset
+	pvt->_cachedest->flushWriteBuffer(-1,-1);
+	pvt->_cachedest->setPositionRelativeToBeginning(CACHE_ROWCOUNT_OFFSET);
+	pvt->_cachedest->write((int64_t)pvt->_rowcount);
+	pvt->_cachedest->write(summaryoffset);
 
 	// close the cache file
 	clearCacheDest();
 }
 
+void sqlrcursor::indexCacheFile(int64_t expiration) {
+
+	// the index is kept in the same directory as the cache file
+	const char	*slash=charstring::findLast(pvt->_cachedestname,'/');
+	stringbuffer	indexname;
+	if (slash) {
+		indexname.append(pvt->_cachedestname,
+					slash-pvt->_cachedestname+1);
+	}
+	indexname.append(CACHE_INDEX_FILE);
+
+	// add the expiration and file name in a single write, under
+	// a lock, so the cache manager never sees a partial entry
+	stringbuffer	entry;
+	entry.append(expiration)->append('\t');
+	entry.append((slash)?slash+1:pvt->_cachedestname)->append('\n');
+
+	// The index is only writable by its owner, like the cache files.  If
+	// another user's application created it, then the entry isn't added,
+	// and the cache manager finds the file during its next full scan.
+	file	index;
+	if (index.open(indexname.getString(),O_WRONLY|O_APPEND|O_CREAT,
+					permissions::ownerReadWrite())) {
+		if (index.lockFile(F_WRLCK)) {
+			index.write(entry.getString(),entry.getSize());
+			index.unlockFile();
+		}
+		index.close();
+	}
+}
+
 void sqlrcursor::flushToCache() {
 	if (pvt->_cachedest) {
 		pvt->_cachedest->flushWriteBuffer(-1,-1);
@@ -2739,6 +2857,14 @@ void sqlrcursor::performSubstitution(stringbuffer *buffer, uint16_t which) {
 
 bool sqlrcursor::runQuery() {
 
+	// a cursor can only have one pipelined query outstanding
+	syncPipeline();
+
+	// make sure that the query won't overrun the pipeline
+	if (pvt->_sqlrc->pipelining()) {
+		pvt->_sqlrc->reservePipelineSpace(pipelinedQuerySize());
+	}
+
 	// send the query
 	if (sendQueryInternal()) {
 
@@ -2747,6 +2873,16 @@ bool sqlrcursor::runQuery() {
 		sendInputOutputBinds();
 		sendGetColumnInfo();
 
+		// if we're pipelining, then send the initial skip/fetch along
+		// with the query and read the response later
+		if (pvt->_sqlrc->pipelining()) {
+			skipRows(true,0);
+			fetchRows();
+			pvt->_pipelined=true;
+			pvt->_sqlrc->queuePipelinedCommand(this,NEW_QUERY);
+			return true;
+		}
+
 		pvt->_sqlrc->flushWriteBuffer();
 
 		if (processInitialResultSet()) {
@@ -2756,6 +2892,38 @@ bool sqlrcursor::runQuery() {
 	return false;
 }
 
+uint64_t sqlrcursor::pipelinedQuerySize() {
+
+	// Estimate the number of bytes that sending the query will write.
+	// This doesn't have to be exact, just not much less than the actual
+	// size.  128 bytes covers the command, flags, counts and skip/fetch,
+	// and 32 bytes covers each variable's type, sizes and non-string
+	// value.
+	uint64_t	size=128+pvt->_querylen;
+	dynamicarray<sqlrclientbindvar>	*vars[4]={
+		pvt->_subvars,
+		pvt->_inbindvars,
+		pvt->_outbindvars,
+		pvt->_inoutbindvars
+	};
+	for (uint16_t i=0; i<4; i++) {
+		for (uint64_t j=0; j<vars[i]->getLength(); j++) {
+			sqlrclientbindvar	*var=&((*vars[i])[j]);
+			size+=32+charstring::length(var->variable);
+			if (i==2) {
+				continue;
+			}
+			if (var->type==SQLRCLIENTBINDVARTYPE_STRING) {
+				size+=charstring::length(var->value.stringval);
+			} else if (var->type==SQLRCLIENTBINDVARTYPE_BLOB ||
+					var->type==SQLRCLIENTBINDVARTYPE_CLOB) {
+				size+=var->valuesize;
+			}
+		}
+	}
+	return size;
+}
+
 bool sqlrcursor::sendQueryInternal() {
 
 	// if the first 8 characters of the query are "-- debug" followed
@@ -2769,7 +2937,9 @@ bool sqlrcursor::sendQueryInternal() {
 	}
 	clearResultSet();
 
-	if (!pvt->_sqlrc->openSession()) {
+	if (!((pvt->_sqlrc->pipelining())?
+				pvt->_sqlrc->openPipelinedSession():
+				pvt->_sqlrc->openSession())) {
 		return false;
 	}
 
@@ -3488,10 +3658,12 @@ bool sqlrcursor::processInitialResultSet() {
 	bool	success=true;
 
 	// Skip and fetch here if we're not reading from a cached result set.
-	// This way, everything gets done in 1 round trip.
-	if (!pvt->_cachesource) {
+	// This way, everything gets done in 1 round trip.  (If the query was
+	// pipelined then this was already sent along with the query.)
+	if (!pvt->_cachesource && !pvt->_pipelined) {
 		success=skipAndFetch(true,0);
 	}
+	pvt->_pipelined=false;
 
 	// check for an error
 	if (success) {
@@ -3540,7 +3712,13 @@ bool sqlrcursor::processInitialResultSet() {
 		// parse the data
 		if (success) {
 
-			if (!pvt->_lazyfetch) {
+			if (pvt->_cachemapped) {
+
+				// rows of mapped cache files
+				// are read in place, on demand
+				success=useCacheMap();
+
+			} else if (!pvt->_lazyfetch) {
 
 				success=parseResults();
 
@@ -3569,6 +3747,32 @@ bool sqlrcursor::processInitialResultSet() {
 	return success;
 }
 
+bool sqlrcursor::processPipelinedResultSet() {
+
+	if (pvt->_sqlrc->debug()) {
+		pvt->_sqlrc->debugPreStart();
+		pvt->_sqlrc->debugPrint("Processing pipelined result set...\n");
+		pvt->_sqlrc->debugPreEnd();
+	}
+
+	// refresh socket client
+	pvt->_cs=pvt->_sqlrc->cs();
+
+	return processInitialResultSet();
+}
+
+void sqlrcursor::abandonPipelinedResultSet() {
+	pvt->_pipelined=false;
+	setError("The session ended before the response "
+			"to the pipelined query was received.");
+}
+
+void sqlrcursor::syncPipeline() {
+	if (pvt->_pipelined) {
+		pvt->_sqlrc->syncPipeline();
+	}
+}
+
 bool sqlrcursor::skipAndFetch(bool initial, uint64_t rowstoskip) {
 
 	if (!skipRows(initial,rowstoskip)) {
@@ -3591,6 +3795,11 @@ bool sqlrcursor::skipRows(bool initial, uint64_t rowstoskip) {
 		pvt->_sqlrc->debugPreEnd();
 	}
 
+	// each result set starts out with full blocks of rows
+	if (initial) {
+		pvt->_rsblocksize=pvt->_rsbuffersize;
+	}
+
 	// bump the rowcount
 	pvt->_rowcount+=rowstoskip;
 
@@ -3660,7 +3869,7 @@ void sqlrcursor::fetchRows() {
 	if (pvt->_sqlrc->debug()) {
 		pvt->_sqlrc->debugPreStart();
 		pvt->_sqlrc->debugPrint("Fetching ");
-		pvt->_sqlrc->debugPrint((int64_t)pvt->_rsbuffersize);
+		pvt->_sqlrc->debugPrint((int64_t)pvt->_rsblocksize);
 		pvt->_sqlrc->debugPrint(" rows\n");
 		pvt->_sqlrc->debugPreEnd();
 	}
@@ -3671,7 +3880,7 @@ void sqlrcursor::fetchRows() {
 	}
 
 	// otherwise send the server the number of rows to fetch
-	pvt->_cs->write(pvt->_rsbuffersize);
+	pvt->_cs->write(pvt->_rsblocksize);
 }
 
 uint16_t sqlrcursor::getErrorStatus() {
@@ -5265,7 +5474,9 @@ bool sqlrcursor::parseResults() {
 
 	// in the block of rows, keep track of
 	// how many rows are actually populated
+	// and how many bytes they contain
 	uint64_t	rowblockcount=0;
+	uint64_t	rowblockbytes=0;
 
 	// get rows
 	for (;;) {
@@ -5390,6 +5601,19 @@ bool sqlrcursor::parseResults() {
 			}
 			buffer[length]='\0';
 
+		} else if (type==START_LONG_DATA && pvt->_lobfieldcallback) {
+
+			// if a lob field callback was provided, then hand
+			// the data to it, segment by segment, rather than
+			// buffering the entire lob, and store an empty field
+			if (!streamLobField(pvt->_rowcount-1,colindex)) {
+				return false;
+			}
+			buffer=(char *)pvt->_rowstorage->allocate(1);
+			buffer[0]='\0';
+			length=0;
+			type=END_LONG_DATA;
+
 		} else if (type==START_LONG_DATA) {
 
 			uint64_t	totallength;
@@ -5477,6 +5701,7 @@ bool sqlrcursor::parseResults() {
 
 		// add the buffer to the current row
 		currentrow->addField(colindex,buffer,length);
+		rowblockbytes+=length;
 	
 		if (pvt->_sqlrc->debug()) {
 			pvt->_sqlrc->debugPreStart();
@@ -5528,8 +5753,8 @@ bool sqlrcursor::parseResults() {
 			}
 
 			// check to see if we've gotten enough rows
-			if (pvt->_rsbuffersize &&
-				rowblockcount==pvt->_rsbuffersize) {
+			if (pvt->_rsblocksize &&
+				rowblockcount==pvt->_rsblocksize) {
 				break;
 			}
 
@@ -5537,6 +5762,20 @@ bool sqlrcursor::parseResults() {
 		}
 	}
 
+	// size the next block of rows to fit the buffer, given how
+	// wide the rows in this block were, but never make it larger
+	// than the result set buffer size
+	if (pvt->_rsbufferbytes && pvt->_rsbuffersize && rowblockcount) {
+		uint64_t	rowbytes=rowblockbytes/rowblockcount;
+		uint64_t	blocksize=(rowbytes)?
+					pvt->_rsbufferbytes/rowbytes:
+					pvt->_rsbuffersize;
+		if (blocksize>pvt->_rsbuffersize) {
+			blocksize=pvt->_rsbuffersize;
+		}
+		pvt->_rsblocksize=(blocksize)?blocksize:1;
+	}
+
 	// terminate the row list
 	if (rowblockcount>=OPTIMISTIC_ROW_COUNT && currentrow) {
 		currentrow->next=NULL;
@@ -5549,6 +5788,85 @@ bool sqlrcursor::parseResults() {
 	return true;
 }
 
+bool sqlrcursor::streamLobField(uint64_t row, uint32_t col) {
+
+	uint64_t	totallength;
+	if (getLongLong(&totallength)!=sizeof(uint64_t)) {
+		setError("Failed to get total length.\n"
+			"A network error may have occurred");
+		return false;
+	}
+
+	if (pvt->_sqlrc->debug()) {
+		pvt->_sqlrc->debugPreStart();
+		pvt->_sqlrc->debugPrint("streaming LOB data: length=");
+		pvt->_sqlrc->debugPrint((int64_t)totallength);
+		pvt->_sqlrc->debugPrint("\n");
+		pvt->_sqlrc->debugPreEnd();
+	}
+
+	uint64_t	offset=0;
+	for (;;) {
+
+		// get the type of the chunk
+		uint16_t	type;
+		if (getShort(&type)!=sizeof(uint16_t)) {
+			setError("Failed to get chunk type.\n"
+				"A network error may have occurred");
+			return false;
+		}
+
+		// check to see if we're done
+		if (type==END_LONG_DATA) {
+			break;
+		}
+
+		// get the length of the chunk
+		uint32_t	length;
+		if (getLong(&length)!=sizeof(uint32_t)) {
+			setError("Failed to get chunk length.\n"
+				"A network error may have occurred");
+			return false;
+		}
+
+		// grow the segment buffer if necessary, it's reused
+		// across segments, fields and rows
+		if (length>pvt->_lobsegmentsize) {
+			delete[] pvt->_lobsegment;
+			pvt->_lobsegment=new char[length+1];
+			pvt->_lobsegmentsize=length;
+		}
+
+		// get the chunk of data
+		if ((uint32_t)getString(pvt->_lobsegment,length)!=length) {
+			setError("Failed to get chunk data.\n"
+				"A network error may have occurred");
+			return false;
+		}
+		pvt->_lobsegment[length]='\0';
+
+		// as with the buffered case, the total length may be a
+		// character count rather than a byte count, so it could
+		// be exceeded
+		if (offset+length>totallength) {
+			totallength=offset+length;
+		}
+
+		// hand the segment off
+		pvt->_lobfieldcallback(this,row,col,offset,
+					pvt->_lobsegment,length,
+					totallength,
+					pvt->_lobfieldcallbackdata);
+
+		offset=offset+length;
+	}
+
+	// signal the end of the lob
+	pvt->_lobfieldcallback(this,row,col,offset,NULL,0,
+				offset,pvt->_lobfieldcallbackdata);
+	return true;
+}
+
 void sqlrcursor::createRowBuffers() {
 
 	// rows will hang around from now until the cursor is deleted,
@@ -5639,6 +5957,9 @@ void sqlrcursor::handleError() {
 
 bool sqlrcursor::fetchRowIntoBuffer(uint64_t row, uint64_t *rowbufferindex) {
 
+	// if this cursor's query was pipelined, then get its response first
+	syncPipeline();
+
 	// bail if the requested row is before the current block of rows
 	if (row<pvt->_firstrowindex) {
 		return false;
@@ -5689,7 +6010,12 @@ bool sqlrcursor::fetchRowIntoBuffer(uint64_t row, uint64_t *rowbufferindex) {
 		// (thus the outer loop)
 		// also, if we're fetching all rows then we shouldn't skip any
 		uint64_t	rowstoskip=0;
-		if (!pvt->_cachedest && pvt->_rsbuffersize) {
+		if (!pvt->_cachedest && pvt->_rsbufferbytes &&
+						pvt->_rsbuffersize) {
+			// blocks vary in size, so start the
+			// next one at the requested row
+			rowstoskip=row-pvt->_rowcount;
+		} else if (!pvt->_cachedest && pvt->_rsbuffersize) {
 			rowstoskip=
 			row-((pvt->_rsbuffersize)?(row%pvt->_rsbuffersize):0)-
 			pvt->_rowcount;
@@ -5708,7 +6034,12 @@ bool sqlrcursor::fetchRowIntoBuffer(uint64_t row, uint64_t *rowbufferindex) {
 
 	// the requested row must be in the current block of rows,
 	// return the row buffer index
-	*rowbufferindex=(pvt->_rsbuffersize)?(row%pvt->_rsbuffersize):row;
+	if (pvt->_rsbufferbytes && pvt->_rsbuffersize) {
+		*rowbufferindex=row-pvt->_firstrowindex;
+	} else {
+		*rowbufferindex=(pvt->_rsbuffersize)?
+					(row%pvt->_rsbuffersize):row;
+	}
 	return true;
 }
 
@@ -5861,12 +6192,23 @@ bool sqlrcursor::openCachedResultSet(const char *filename) {
 
 		delete[] indexfilename;
 
-		// make sure it's a cache file and skip the ttl
-		char		magicid[13];
+		// make sure it's a cache file, skip the ttl and map
+		// the file, unless it's an older one that has to be parsed
+		char		magicid[CACHE_MAGIC_LENGTH];
 		uint64_t	ttl;
-		if (getString(magicid,13)==13 &&
-			!charstring::compare(magicid,"SQLRELAYCACHE",13) &&
-			getLongLong(&ttl)==sizeof(uint64_t)) {
+		bool		valid=false;
+		if (getString(magicid,CACHE_MAGIC_LENGTH)==
+						CACHE_MAGIC_LENGTH) {
+			if (!charstring::compare(magicid,CACHE_MAGIC,
+						CACHE_MAGIC_LENGTH)) {
+				valid=mapCacheFiles();
+			} else if (!charstring::compare(magicid,CACHE_MAGIC_V1,
+							CACHE_MAGIC_LENGTH)) {
+				valid=(getLongLong(&ttl)==sizeof(uint64_t));
+			}
+		}
+
+		if (valid) {
 
 			// process the result set
 			return processInitialResultSet();
@@ -5900,6 +6242,203 @@ bool sqlrcursor::openCachedResultSet(const char *filename) {
 	return false;
 }
 
+bool sqlrcursor::mapCacheFiles() {
+
+	// get the version, skip the ttl,
+	// and get the row count and summary offset
+	uint16_t	version;
+	uint64_t	ttl;
+	uint64_t	rowcount;
+	uint64_t	summaryoffset;
+	if (getShort(&version)!=sizeof(uint16_t) ||
+			version!=CACHE_VERSION ||
+			getLongLong(&ttl)!=sizeof(uint64_t) ||
+			getLongLong(&rowcount)!=sizeof(uint64_t) ||
+			getLongLong(&summaryoffset)!=sizeof(uint64_t)) {
+		return false;
+	}
+
+	// map the files
+	off64_t	datasize=pvt->_cachesource->getSize();
+	off64_t	indexsize=pvt->_cachesourceind->getSize();
+	if (datasize<CACHE_HEADER_SIZE ||
+			indexsize<CACHE_INDEX_HEADER_SIZE ||
+			!pvt->_cachemap.attach(
+				pvt->_cachesource->getFileDescriptor(),
+				0,datasize,PROT_READ,MAP_PRIVATE)) {
+		return false;
+	}
+	if (!pvt->_cacheindmap.attach(
+				pvt->_cachesourceind->getFileDescriptor(),
+				0,indexsize,PROT_READ,MAP_PRIVATE)) {
+		pvt->_cachemap.detach();
+		return false;
+	}
+	pvt->_cachemapped=true;
+
+	pvt->_cachedata=(const unsigned char *)pvt->_cachemap.getData();
+	pvt->_cachedatasize=datasize;
+	pvt->_cacheindex=((const unsigned char *)
+				pvt->_cacheindmap.getData())+
+				CACHE_INDEX_HEADER_SIZE;
+
+	// If the whole result set was cached, then the row count is in the
+	// header.  Otherwise, the rows that made it into the index are all
+	// that's available.
+	uint64_t	indexrows=(indexsize-CACHE_INDEX_HEADER_SIZE)/
+							sizeof(int64_t);
+	pvt->_cacherowcount=(rowcount<=indexrows)?rowcount:indexrows;
+	pvt->_cachesummaryoffset=summaryoffset;
+	return true;
+}
+
+bool sqlrcursor::useCacheMap() {
+
+	if (pvt->_sqlrc->debug()) {
+		pvt->_sqlrc->debugPreStart();
+		pvt->_sqlrc->debugPrint("Mapped ");
+		pvt->_sqlrc->debugPrint((int64_t)pvt->_cacherowcount);
+		pvt->_sqlrc->debugPrint(" cached rows\n");
+		pvt->_sqlrc->debugPreEnd();
+	}
+
+	// the whole result set is available
+	pvt->_firstrowindex=0;
+	pvt->_rowcount=pvt->_cacherowcount;
+	pvt->_endofresultset=true;
+
+	// the fields of the current row
+	pvt->_cachefields=new char *[pvt->_colcount+1];
+	pvt->_cachefieldlengths=new uint32_t[pvt->_colcount+1];
+	pvt->_cachecurrentrow=(uint64_t)-1;
+
+	// Get the longest field, and whether each column is a long
+	// datatype, from the summary.  If the result set wasn't completely
+	// cached, then there's no summary, and the rows have to be examined.
+	bool		columninfo=(pvt->_sendcolumninfo==SEND_COLUMN_INFO &&
+				pvt->_sentcolumninfo==SEND_COLUMN_INFO);
+	uint64_t	summarysize=pvt->_colcount*
+				(sizeof(uint32_t)+sizeof(uint16_t));
+	if (pvt->_cachesummaryoffset>=CACHE_HEADER_SIZE &&
+			pvt->_cachesummaryoffset+summarysize<=
+						pvt->_cachedatasize) {
+
+		const unsigned char	*ptr=pvt->_cachedata+
+						pvt->_cachesummaryoffset;
+		for (uint32_t i=0; i<pvt->_colcount; i++) {
+			sqlrclientcolumn	*whichcol=getColumnInternal(i);
+			uint32_t	longest;
+			uint16_t	longdatatype;
+			bytestring::copy(&longest,ptr,sizeof(uint32_t));
+			ptr+=sizeof(uint32_t);
+			bytestring::copy(&longdatatype,ptr,sizeof(uint16_t));
+			ptr+=sizeof(uint16_t);
+			if (columninfo) {
+				whichcol->longest=longest;
+			}
+			whichcol->longdatatype=(longdatatype)?1:0;
+		}
+
+	} else {
+
+		for (uint32_t i=0; i<pvt->_colcount; i++) {
+			getColumnInternal(i)->longdatatype=0;
+		}
+		for (uint64_t row=0; row<pvt->_rowcount; row++) {
+			if (!mapCachedRow(row)) {
+				return false;
+			}
+			if (!columninfo) {
+				continue;
+			}
+			for (uint32_t i=0; i<pvt->_colcount; i++) {
+				sqlrclientcolumn	*whichcol=
+							getColumnInternal(i);
+				if (pvt->_cachefieldlengths[i]>
+							whichcol->longest) {
+					whichcol->longest=
+						pvt->_cachefieldlengths[i];
+				}
+			}
+		}
+	}
+
+	// cache the rows again, if we're caching
+	cacheData();
+
+	// the files themselves aren't needed any more
+	clearCacheSource();
+	return true;
+}
+
+bool sqlrcursor::mapCachedRow(uint64_t row) {
+
+	// bail if the row is already current
+	if (row==pvt->_cachecurrentrow) {
+		return true;
+	}
+
+	// get the offset of the row from the index
+	int64_t	offset;
+	bytestring::copy(&offset,pvt->_cacheindex+row*sizeof(int64_t),
+							sizeof(int64_t));
+	if (offset<CACHE_HEADER_SIZE ||
+			(uint64_t)offset>pvt->_cachedatasize) {
+		setError("The cache file index appears to be corrupt.");
+		return false;
+	}
+
+	// point the fields at the data in the file,
+	// making sure that none of them run past the end of it
+	const unsigned char	*ptr=pvt->_cachedata+offset;
+	const unsigned char	*end=pvt->_cachedata+pvt->_cachedatasize;
+	for (uint32_t i=0; i<pvt->_colcount; i++) {
+
+		int32_t	length;
+		if ((uint64_t)(end-ptr)<sizeof(int32_t)) {
+			setError("The cache file appears to be corrupt.");
+			return false;
+		}
+		bytestring::copy(&length,ptr,sizeof(int32_t));
+		ptr+=sizeof(int32_t);
+
+		if (length==CACHE_NULL_FIELD) {
+			pvt->_cachefields[i]=(pvt->_returnnulls)?
+						NULL:(char *)"";
+			pvt->_cachefieldlengths[i]=0;
+			continue;
+		}
+
+		if (length<0 || (uint64_t)(end-ptr)<(uint64_t)length+1) {
+			setError("The cache file appears to be corrupt.");
+			return false;
+		}
+		pvt->_cachefields[i]=(char *)ptr;
+		pvt->_cachefieldlengths[i]=length;
+		ptr+=length+1;
+	}
+
+	pvt->_cachecurrentrow=row;
+	return true;
+}
+
+void sqlrcursor::clearCacheMap() {
+	if (pvt->_cachemapped) {
+		pvt->_cachemap.detach();
+		pvt->_cacheindmap.detach();
+		pvt->_cachemapped=false;
+	}
+	pvt->_cachedata=NULL;
+	pvt->_cachedatasize=0;
+	pvt->_cacheindex=NULL;
+	pvt->_cacherowcount=0;
+	pvt->_cachesummaryoffset=0;
+	delete[] pvt->_cachefields;
+	pvt->_cachefields=NULL;
+	delete[] pvt->_cachefieldlengths;
+	pvt->_cachefieldlengths=NULL;
+}
+
 void sqlrcursor::clearCacheSource() {
 	if (pvt->_cachesource) {
 		pvt->_cachesource->close();
@@ -6187,6 +6726,9 @@ void sqlrcursor::getNullsAsNulls() {
 }
 
 char *sqlrcursor::getFieldInternal(uint64_t row, uint32_t col) {
+	if (pvt->_cachemapped) {
+		return (mapCachedRow(row))?pvt->_cachefields[col]:NULL;
+	}
 	if (row<OPTIMISTIC_ROW_COUNT) {
 		return pvt->_rows[row]->getField(col);
 	}
@@ -6194,6 +6736,9 @@ char *sqlrcursor::getFieldInternal(uint64_t row, uint32_t col) {
 }
 
 uint32_t sqlrcursor::getFieldLengthInternal(uint64_t row, uint32_t col) {
+	if (pvt->_cachemapped) {
+		return (mapCachedRow(row))?pvt->_cachefieldlengths[col]:0;
+	}
 	if (row<OPTIMISTIC_ROW_COUNT) {
 		return pvt->_rows[row]->getFieldLength(col);
 	}
@@ -6304,6 +6849,9 @@ const char * const *sqlrcursor::getRow(uint64_t row) {
 		if (!pvt->_fields) {
 			createFields();
 		}
+		if (!pvt->_fields[rowbufferindex]) {
+			createRowFields(rowbufferindex);
+		}
 		return pvt->_fields[rowbufferindex];
 	}
 	return NULL;
@@ -6318,14 +6866,24 @@ void sqlrcursor::createFields() {
 	pvt->_fields=new char **[rowbuffercount+1];
 	pvt->_fields[rowbuffercount]=(char **)NULL;
 	for (uint64_t i=0; i<rowbuffercount; i++) {
-		pvt->_fields[i]=new char *[pvt->_colcount+1];
-		pvt->_fields[i][pvt->_colcount]=(char *)NULL;
-		for (uint32_t j=0; j<pvt->_colcount; j++) {
-			pvt->_fields[i][j]=getFieldInternal(i,j);
+		// rows of mapped cache files are
+		// filled in as they're requested
+		if (pvt->_cachemapped) {
+			pvt->_fields[i]=NULL;
+		} else {
+			createRowFields(i);
 		}
 	}
 }
 
+void sqlrcursor::createRowFields(uint64_t row) {
+	pvt->_fields[row]=new char *[pvt->_colcount+1];
+	pvt->_fields[row][pvt->_colcount]=(char *)NULL;
+	for (uint32_t j=0; j<pvt->_colcount; j++) {
+		pvt->_fields[row][j]=getFieldInternal(row,j);
+	}
+}
+
 uint32_t *sqlrcursor::getRowLengths(uint64_t row) {
 
 	// fetch and return the row lengths
@@ -6334,6 +6892,9 @@ uint32_t *sqlrcursor::getRowLengths(uint64_t row) {
 		if (!pvt->_fieldlengths) {
 			createFieldLengths();
 		}
+		if (!pvt->_fieldlengths[rowbufferindex]) {
+			createRowFieldLengths(rowbufferindex);
+		}
 		return pvt->_fieldlengths[rowbufferindex];
 	}
 	return NULL;
@@ -6348,14 +6909,24 @@ void sqlrcursor::createFieldLengths() {
 	pvt->_fieldlengths=new uint32_t *[rowbuffercount+1];
 	pvt->_fieldlengths[rowbuffercount]=0;
 	for (uint64_t i=0; i<rowbuffercount; i++) {
-		pvt->_fieldlengths[i]=new uint32_t[pvt->_colcount+1];
-		pvt->_fieldlengths[i][pvt->_colcount]=0;
-		for (uint32_t j=0; j<pvt->_colcount; j++) {
-			pvt->_fieldlengths[i][j]=getFieldLengthInternal(i,j);
+		// rows of mapped cache files are
+		// filled in as they're requested
+		if (pvt->_cachemapped) {
+			pvt->_fieldlengths[i]=NULL;
+		} else {
+			createRowFieldLengths(i);
 		}
 	}
 }
 
+void sqlrcursor::createRowFieldLengths(uint64_t row) {
+	pvt->_fieldlengths[row]=new uint32_t[pvt->_colcount+1];
+	pvt->_fieldlengths[row][pvt->_colcount]=0;
+	for (uint32_t j=0; j<pvt->_colcount; j++) {
+		pvt->_fieldlengths[row][j]=getFieldLengthInternal(row,j);
+	}
+}
+
 void sqlrcursor::suspendResultSet() {
 
 	if (pvt->_sqlrc->debug()) {
@@ -6490,6 +7061,10 @@ void sqlrcursor::closeResultSet() {
 
 void sqlrcursor::closeResultSet(bool closeremote) {
 
+	// the server will send the response to a pipelined
+	// query regardless, so it has to be read first
+	syncPipeline();
+
 	// If the end of the previous result set was never reached, abort it.
 	// If we're caching data to a local file, get the rest of the data; we
 	// won't have to abort the result set in that case, the server will
@@ -6557,6 +7132,7 @@ void sqlrcursor::clearResultSet() {
 	// columns is cleared after rows because colcount is used in 
 	// clearRows() and set to 0 in clearColumns()
 	clearRows();
+	clearCacheMap();
 	clearColumns();
 
 	// clear row counters, since fetchRowIntoBuffer() and clearResultSet()
@@ -6583,8 +7159,9 @@ void sqlrcursor::clearError() {
 void sqlrcursor::clearRows() {
 
 	// delete data in rows for long datatypes
+	// (unless the rows are in a mapped cache file)
 	uint32_t	rowbuffercount=pvt->_rowcount-pvt->_firstrowindex;
-	for (uint32_t i=0; i<rowbuffercount; i++) {
+	for (uint32_t i=0; !pvt->_cachemapped && i<rowbuffercount; i++) {
 		for (uint32_t j=0; j<pvt->_colcount; j++) {
 			if (getColumnInternal(j)->longdatatype) {
 				char		*field=getFieldInternal(i,j);
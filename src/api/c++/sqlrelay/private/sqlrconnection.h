@@ -14,6 +14,8 @@
 					int32_t *timeoutsec,
 					int32_t *timeoutusec);
 		bool	openSession();
+		bool	openPipelinedSession();
+		bool	openSessionInternal();
 		bool	reConfigureSockets();
 		bool	validateCertificate();
 		void	setConnectFailedError();
@@ -43,6 +45,13 @@
 
 		void	flushWriteBuffer();
 
+		bool	pipelining();
+		void	queuePipelinedCommand(sqlrcursor *cur,
+						uint16_t command);
+		void	reservePipelineSpace(uint64_t bytes);
+		void	syncPipeline();
+		void	abandonPipeline();
+
 		socketclient	*cs();
 		bool		endsessionsent();
 		bool		suspendsessionsent();
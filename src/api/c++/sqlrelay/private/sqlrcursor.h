@@ -7,6 +7,7 @@
 		void	clearResultSet();
 		void	clearCacheDest();
 		void	clearCacheSource();
+		void	clearCacheMap();
 		void	clearError();
 		void	clearColumns();
 		void	clearRows();
@@ -73,7 +74,11 @@
 		void	performSubstitution(stringbuffer *buffer,
 							uint16_t which);
 		bool	runQuery();
+		uint64_t	pipelinedQuerySize();
 		bool	processInitialResultSet();
+		bool	processPipelinedResultSet();
+		void	abandonPipelinedResultSet();
+		void	syncPipeline();
 
 		int32_t	getString(char *string, int32_t size);
 		int32_t	getBool(bool *boolean);
@@ -92,6 +97,7 @@
 		bool	parseOutputBinds();
 		bool	parseInputOutputBinds();
 		bool	parseResults();
+		bool	streamLobField(uint64_t row, uint32_t col);
 		void	setError(const char *err);
 		void	getErrorFromServer();
 		void	handleError();
@@ -109,6 +115,11 @@
 		void	cacheData();
 		void	flushToCache();
 		void	finishCaching();
+		void	indexCacheFile(int64_t expiration);
+
+		bool	mapCacheFiles();
+		bool	useCacheMap();
+		bool	mapCachedRow(uint64_t row);
  
 		bool	fetchRowIntoBuffer(uint64_t row,
 						uint64_t *rowbufferindex);
@@ -117,6 +128,8 @@
 		void	createExtraRowArray();
 		void	createFields();
 		void	createFieldLengths();
+		void	createRowFields(uint64_t row);
+		void	createRowFieldLengths(uint64_t row);
 
 		char		*getFieldInternal(uint64_t row,
 							uint32_t col);
@@ -310,6 +310,45 @@ class SQLRCLIENT_DLLSPEC sqlrconnection : public object {
 
 
 
+		/** Causes subsequent queries, begins, commits, rollbacks and
+		 *  autocommit changes to be pipelined.  Rather than waiting
+		 *  for the response to each one before sending the next,
+		 *  they are sent to the server back-to-back and their
+		 *  responses are read all at once when endPipeline() is
+		 *  called.  This saves a round-trip per command when there
+		 *  is latency between the client and server.
+		 *
+		 *  While pipelining, sendQuery(), executeQuery(), begin(),
+		 *  commit(), rollback(), autoCommitOn() and autoCommitOff()
+		 *  return true if the command was sent, and their actual
+		 *  results (including the row and column counts, fields and
+		 *  errors of each cursor) are only available after
+		 *  endPipeline() returns.  Calling any other method that
+		 *  needs a response from the server (or fetching rows from a
+		 *  cursor whose query is still pending) causes the pending
+		 *  responses to be read first.
+		 *
+		 *  Requires an SQL Relay server that supports pipelining. */
+		void	beginPipeline();
+
+		/** Reads the responses to all of the commands that have been
+		 *  pipelined since beginPipeline() was called and stops
+		 *  pipelining.  Returns true if all of them succeeded and
+		 *  false if any of them failed.  Errors are reported by the
+		 *  cursor that ran the failed query, or by errorMessage()
+		 *  and errorNumber() for connection-level commands. */
+		bool	endPipeline();
+
+		/** Sets the maximum number of commands that will be pipelined
+		 *  before their responses are read.  Defaults to 32.  The
+		 *  maximum is 256.  Regardless of the depth, the responses
+		 *  are also read before more than 32KB of commands would be
+		 *  pipelined, to keep the client and server from blocking on
+		 *  each other's socket buffers. */
+		void	setPipelineDepth(uint16_t depth);
+
+
+
 		/** If an operation failed and generated an
 		 *  error, the error message is available here.
 		 *  If there is no error then this method 
@@ -366,6 +405,23 @@ class SQLRCLIENT_DLLSPEC sqlrconnection : public object {
 };
 
 
+/** Called by sqlrcursor for each segment of a LOB field when a LOB field
+ *  callback has been set using sqlrcursor::setLobFieldCallback().  "row" and
+ *  "col" identify the field, "offset" is the position of "segment" within the
+ *  LOB and "segmentlength" is its length in bytes.  "totallength" is the
+ *  expected length of the LOB, which may grow as segments arrive if the
+ *  database reports the length in characters rather than bytes.  After the
+ *  last segment, the callback is called once more with a NULL "segment", a
+ *  "segmentlength" of 0 and "totallength" set to the final length.
+ *  "segment" is only valid for the duration of the call. */
+typedef void (*sqlrlobfieldcallback)(sqlrcursor *cursor,
+					uint64_t row, uint32_t col,
+					uint64_t offset,
+					const char *segment,
+					uint32_t segmentlength,
+					uint64_t totallength,
+					void *data);
+
 class SQLRCLIENT_DLLSPEC sqlrcursor : public object {
 	public:
 			/** Creates a cursor to run queries and fetch result
@@ -388,6 +444,34 @@ class SQLRCLIENT_DLLSPEC sqlrcursor : public object {
 		 *  entire result set. */
 		uint64_t	getResultSetBufferSize();
 
+		/** Limits the rows buffered at a time to about
+		 *  "bytes" bytes, based on the width of the rows
+		 *  that have been received so far.  Blocks of rows
+		 *  are never larger than the result set buffer
+		 *  size, so this only has an effect if
+		 *  setResultSetBufferSize() has been called with
+		 *  a non-zero value.  0 (the default) means no
+		 *  limit. */
+		void	setResultSetBufferBytes(uint64_t bytes);
+
+		/** Returns the number of bytes that the buffered
+		 *  rows are limited to, or 0 for no limit. */
+		uint64_t	getResultSetBufferBytes();
+
+		/** Sets a callback to hand LOB fields to, segment by
+		 *  segment, as they are received from the server, rather
+		 *  than buffering each LOB in its entirety.  "data" is
+		 *  passed through to the callback.  When a callback is
+		 *  set, getField() and getFieldLength() return an empty
+		 *  string and 0 for LOB fields, and cached result sets
+		 *  don't contain the LOB data either.  Combined with
+		 *  setResultSetBufferSize(1), the callback is called as
+		 *  each row is fetched, so arbitrarily large LOBs can be
+		 *  processed in constant memory.  Set "callback" to NULL
+		 *  to resume buffering LOBs. */
+		void	setLobFieldCallback(sqlrlobfieldcallback callback,
+								void *data);
+
 
 
 		/** Tells the server not to send any column
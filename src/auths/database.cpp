@@ -42,6 +42,17 @@ const char *sqlrauth_database::auth(sqlrcredentials *cred) {
 		first=false;
 	}
 
+	// the controller may have logged back in as some other user on its
+	// own since the last time (eg. to resume a pooled session), if so,
+	// then re-initialize the lastuser/lastpassword from that user
+	if (lastuser.getStringLength() &&
+		charstring::compare(lastuser.getString(),cont->getUser())) {
+		lastuser.clear();
+		lastuser.append(cont->getUser());
+		lastpassword.clear();
+		lastpassword.append(cont->getPassword());
+	}
+
 	// get the user/password from the creds
 	const char	*user=
 			((sqlruserpasswordcredentials *)cred)->getUser();
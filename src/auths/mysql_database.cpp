@@ -69,6 +69,17 @@ const char *sqlrauth_mysql_database::auth(sqlrcredentials *cred) {
 		first=false;
 	}
 
+	// the controller may have logged back in as some other user on its
+	// own since the last time (eg. to resume a pooled session), if so,
+	// then re-initialize the lastuser/lastpassword from that user
+	if (lastuser.getStringLength() &&
+		charstring::compare(lastuser.getString(),cont->getUser())) {
+		lastuser.clear();
+		lastuser.append(cont->getUser());
+		lastpassword.clear();
+		lastpassword.append(cont->getPassword());
+	}
+
 	// if the user we want to change to is different from the user
 	// that's currently logged in, then try to change to that user
 	bool	success=true;
@@ -26,6 +26,8 @@ class SQLRSERVER_DLLSPEC sqlrauth_mysql_userlist : public sqlrauth {
 		const char	**passwordencryptions;
 		uint64_t	usercount;
 
+		sqlrauthcache	cache;
+
 		sensitivevalue	passwordvalue;
 
 		bool	debug;
@@ -76,6 +78,9 @@ sqlrauth_mysql_userlist::sqlrauth_mysql_userlist(
 
 		user=user->getNextTagSibling("user");
 	}
+
+	// index the users by name
+	cache.setUsers(users,usercount);
 }
 
 static const char *supportedauthplugins[]={
@@ -118,66 +123,82 @@ const char *sqlrauth_mysql_userlist::auth(sqlrcredentials *cred) {
 		return NULL;
 	}
 
-	// run through the user/password arrays...
-	for (uint32_t i=0; i<usercount; i++) {
-
-		// if the user matches...
-		if (!charstring::compare(user,users[i])) {
+	// find the user...
+	uint64_t	i=cache.getFirstIndex(user);
+	if (i<usercount) {
 
-			if (getPasswordEncryptions() &&
-				charstring::length(passwordencryptions[i])) {
+		if (getPasswordEncryptions() &&
+			charstring::length(passwordencryptions[i])) {
 
-				// if password encryption is being used...
+			// if password encryption is being used...
 
-				// get the module
-				sqlrpwdenc	*pe=
-					getPasswordEncryptions()->
-						getPasswordEncryptionById(
-							passwordencryptions[i]);
-				if (!pe) {
-					return NULL;
-				}
+			// get the module
+			sqlrpwdenc	*pe=
+				getPasswordEncryptions()->
+					getPasswordEncryptionById(
+						passwordencryptions[i]);
+			if (!pe) {
+				return NULL;
+			}
 
-				// The way the mysql_native_password encryption
-				// works, one-way passwords won't work.  For
-				// two-way encryption, decrypt the password
-				// from the configuration and compare it to the
-				// password that was passed in...
+			// The way the mysql_native_password encryption
+			// works, one-way passwords won't work.  For
+			// two-way encryption, decrypt the password
+			// from the configuration and compare it to the
+			// password that was passed in...
+
+			// FIXME: one-way encryption does work with
+			// the mysql_clear_password method.
+
+			// The challenge/response methods mix a random
+			// challenge into the response, so the same response
+			// never arrives twice and there's no point caching
+			// it.  Only cleartext verifications are cached.
+			bool	cacheable=!charstring::compare(method,
+						"mysql_clear_password");
+
+			// skip the decryption if these credentials
+			// were already verified against this entry
+			bool	retval=(cacheable &&
+					cache.verified(user,password,
+							passwordlength,
+							method,NULL,i));
+			if (!retval && !pe->oneWay()) {
 
-				// FIXME: one-way encryption does work with
-				// the mysql_clear_password method.
+				// decrypt the password
+				// from the configuration
+				char	*pwd=pe->decrypt(passwords[i]);
 
-				bool	retval=false;
-				if (!pe->oneWay()) {
+				// compare it to the password
+				// that was passed in
+				retval=compare(password,
+						passwordlength,
+						pwd,
+						method,extra);
 
-					// decrypt the password
-					// from the configuration
-					char	*pwd=pe->decrypt(passwords[i]);
+				// clean up
+				delete[] pwd;
 
-					// compare it to the password
-					// that was passed in
-					retval=compare(password,
+				// remember successful verifications
+				if (retval && cacheable) {
+					cache.setVerified(user,password,
 							passwordlength,
-							pwd,
-							method,extra);
-
-					// clean up
-					delete[] pwd;
+							method,NULL,i);
 				}
+			}
 
-				// return user or NULL
-				return (retval)?user:NULL;
+			// return user or NULL
+			return (retval)?user:NULL;
 
-			} else {
+		} else {
 
-				// if password encryption isn't being used,
-				// return the user if the passwords match
-				return (compare(password,
-						passwordlength,
-						passwords[i],
-						method,
-						extra))?user:NULL;
-			}
+			// if password encryption isn't being used,
+			// return the user if the passwords match
+			return (compare(password,
+					passwordlength,
+					passwords[i],
+					method,
+					extra))?user:NULL;
 		}
 	}
 	return NULL;
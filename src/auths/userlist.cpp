@@ -23,6 +23,8 @@ class SQLRSERVER_DLLSPEC sqlrauth_userlist : public sqlrauth {
 		const char	**passwordencryptions;
 		uint64_t	usercount;
 
+		sqlrauthcache	cache;
+
 		sensitivevalue	passwordvalue;
 };
 
@@ -67,6 +69,9 @@ sqlrauth_userlist::sqlrauth_userlist(sqlrservercontroller *cont,
 
 		user=user->getNextTagSibling("user");
 	}
+
+	// index the users by name
+	cache.setUsers(users,usercount);
 }
 
 sqlrauth_userlist::~sqlrauth_userlist() {
@@ -101,38 +106,44 @@ const char *sqlrauth_userlist::auth(sqlrcredentials *cred) {
 		return NULL;
 	}
 
-	// run through the user/password arrays...
-	for (uint64_t i=0; i<usercount; i++) {
-		if (up) {
+	// check the entries for the user...
+	if (up) {
+		for (uint64_t i=cache.getFirstIndex(user);
+				i<usercount; i=cache.getNextIndex(i)) {
 			const char	*result=userPassword(user,password,i);
 			if (result) {
 				return result;
 			}
-		} else if (gss) {
-			if (!charstring::compare(initiator,users[i])) {
-				return initiator;
-			}
-		} else if (tls) {
-			if (sans && sans->getLength()) {
-
-				// if subject alternate names were
-				// present then validate against those
-				for (listnode< char * > *node=sans->getFirst();
+		}
+	} else if (gss) {
+		if (cache.getFirstIndex(initiator)<usercount) {
+			return initiator;
+		}
+	} else if (tls) {
+		if (sans && sans->getLength()) {
+
+			// if subject alternate names were present then
+			// validate against those, preferring whichever
+			// one appears first in the configuration
+			const char	*result=NULL;
+			uint64_t	first=usercount;
+			for (listnode< char * > *node=sans->getFirst();
 						node; node=node->getNext()) {
-					if (!charstring::compare(
-						node->getValue(),users[i])) {
-						return node->getValue();
-					}
+				uint64_t	i=cache.getFirstIndex(
+							node->getValue());
+				if (i<first) {
+					first=i;
+					result=node->getValue();
 				}
+			}
+			return result;
 
-			} else {
+		} else {
 
-				// if no subject alternate names were present
-				// then validate against the common name
-				if (!charstring::compare(
-						commonname,users[i])) {
-					return commonname;
-				}
+			// if no subject alternate names were present
+			// then validate against the common name
+			if (cache.getFirstIndex(commonname)<usercount) {
+				return commonname;
 			}
 		}
 	}
@@ -160,6 +171,14 @@ const char *sqlrauth_userlist::userPassword(const char *user,
 			return NULL;
 		}
 
+		// skip the encryption if these credentials
+		// were already verified against this entry
+		uint64_t	passwordlength=charstring::length(password);
+		if (cache.verified(user,password,passwordlength,
+						NULL,NULL,index)) {
+			return user;
+		}
+
 		// For one-way encryption, encrypt the password that was passed
 		// in and compare it to the encrypted password in the
 		// configuration.  For two-way encryption, decrypt the password
@@ -192,6 +211,12 @@ const char *sqlrauth_userlist::userPassword(const char *user,
 		// clean up
 		delete[] pwd;
 
+		// remember successful verifications
+		if (result) {
+			cache.setVerified(user,password,passwordlength,
+							NULL,NULL,index);
+		}
+
 		// return the result
 		return (result)?user:NULL;
 	}
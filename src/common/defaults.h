@@ -21,6 +21,9 @@
 // default action to take at end of session
 #define DEFAULT_ENDOFSESSION "commit"
 
+// default policy for running session start/end queries ("always" or "dirty")
+#define DEFAULT_SESSIONQUERIES "always"
+
 // default maximum queue length before
 // another connection will be fired off
 #define DEFAULT_MAXQUEUELENGTH "0"
@@ -62,6 +65,22 @@
 // clients from listener to connection
 #define DEFAULT_HANDOFF "pass"
 
+// default granularity at which database connections are shared
+// between clients ("session" or "transaction")
+#define DEFAULT_POOLING "session"
+
+// default number of milliseconds that a transaction-pooled client can sit
+// idle between commands before its session is released back to the pool
+#define DEFAULT_POOLINGIDLETIMEOUT "5"
+
+// default method used to choose which idle connection a client is handed
+// off to ("none" or "user")
+#define DEFAULT_AFFINITY "none"
+
+// default number of microseconds that the listener waits for a client to
+// send its credentials when choosing a connection by user affinity
+#define DEFAULT_AFFINITYPEEKTIMEOUT 10000
+
 // default regular expression for IP's that are allowed to connect
 #define DEFAULT_ALLOWEDIPS ""
 
@@ -128,9 +147,24 @@
 // default maximum number of listeners
 #define DEFAULT_MAXLISTENERS "-1"
 
+// default number of proxy engine threads
+#define DEFAULT_PROXYTHREADS "0"
+
+// default number of client socket acceptor threads
+#define DEFAULT_ACCEPTORS "1"
+
 // default listener timeout
 #define DEFAULT_LISTENERTIMEOUT "0"
 
+// default result set spooling thresholds (0 disables each of them)
+#define DEFAULT_SPOOLROWS "0"
+#define DEFAULT_SPOOLBYTES "0"
+#define DEFAULT_SPOOLTIMEOUT "0"
+
+// default per-connection memory limits (0 disables each of them)
+#define DEFAULT_MEMORYSOFTLIMIT "0"
+#define DEFAULT_MEMORYHARDLIMIT "0"
+
 // default re-login at start attribute
 #define DEFAULT_RELOGINATSTART "no"
 
@@ -153,6 +187,10 @@
 // default interval that the cachemanager will scan on
 #define DEFAULT_INTERVAL 30
 
+// default interval that the cachemanager will check every file in a
+// cache directory on, even if the directory has an index
+#define DEFAULT_FULLSCANINTERVAL 3600
+
 // default kerberos service
 #define DEFAULT_KRBSERVICE SQLRELAY
 
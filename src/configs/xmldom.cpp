@@ -59,6 +59,7 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		bool		getDynamicScaling();
 		const char	*getEndOfSession();
 		bool		getEndOfSessionCommit();
+		bool		getSessionQueriesOnlyIfDirty();
 		uint32_t	getSessionTimeout();
 		const char	*getRunAsUser();
 		const char	*getRunAsGroup();
@@ -70,6 +71,9 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		bool		getAuthOnDatabase();
 		const char	*getSessionHandler();
 		const char	*getHandoff();
+		const char	*getPooling();
+		uint32_t	getPoolingIdleTimeout();
+		const char	*getAffinity();
 		const char	*getAllowedIps();
 		const char	*getDeniedIps();
 		const char	*getDebug();
@@ -105,6 +109,8 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		uint32_t	getMaxErrorLength();
 		int32_t		getIdleClientTimeout();
 		int64_t		getMaxListeners();
+		uint32_t	getProxyThreads();
+		uint32_t	getAcceptors();
 		uint32_t	getListenerTimeout();
 		bool		getReLoginAtStart();
 		bool		getFakeInputBindVariables();
@@ -118,6 +124,12 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		const char	*getIsolationLevel();
 		bool		getIgnoreSelectDatabase();
 		bool		getWaitForDownDatabase();
+		bool		getFingerprintStats();
+		uint64_t	getSpoolRows();
+		uint64_t	getSpoolBytes();
+		uint32_t	getSpoolTimeout();
+		uint64_t	getMemorySoftLimit();
+		uint64_t	getMemoryHardLimit();
 		const char	*getPasswordPath();
 
 		linkedlist< char *>	*getSessionStartQueries();
@@ -200,6 +212,7 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		uint16_t	maxsessioncount;
 		const char	*endofsession;
 		bool		endofsessioncommit;
+		bool		sessionqueriesonlyifdirty;
 		uint32_t	sessiontimeout;
 		const char	*runasuser;
 		const char	*runasgroup;
@@ -209,6 +222,9 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		const char	*authtier;
 		const char	*sessionhandler;
 		const char	*handoff;
+		const char	*pooling;
+		uint32_t	poolingidletimeout;
+		const char	*affinity;
 		bool		authonconnection;
 		bool		authondatabase;
 		const char	*allowedips;
@@ -246,6 +262,8 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		uint32_t	maxerrorlength;
 		int32_t		idleclienttimeout;
 		int64_t		maxlisteners;
+		uint32_t	proxythreads;
+		uint32_t	acceptors;
 		uint32_t	listenertimeout;
 		bool		reloginatstart;
 		bool		fakeinputbindvariables;
@@ -260,6 +278,12 @@ class SQLRUTIL_DLLSPEC sqlrconfig_xmldom : public sqlrconfig, public xmldom {
 		const char	*isolationlevel;
 		bool		ignoreselectdb;
 		bool		waitfordowndb;
+		bool		fingerprintstats;
+		uint64_t	spoolrows;
+		uint64_t	spoolbytes;
+		uint32_t	spooltimeout;
+		uint64_t	memorysoftlimit;
+		uint64_t	memoryhardlimit;
 		const char	*passwordpath;
 
 		linkedlist< char *>	sessionstartqueries;
@@ -345,6 +369,8 @@ void sqlrconfig_xmldom::init() {
 	maxsessioncount=charstring::toInteger(DEFAULT_MAXSESSIONCOUNT);
 	endofsession=DEFAULT_ENDOFSESSION;
 	endofsessioncommit=!charstring::compare(endofsession,"commit");
+	sessionqueriesonlyifdirty=
+		!charstring::compare(DEFAULT_SESSIONQUERIES,"dirty");
 	sessiontimeout=charstring::toUnsignedInteger(DEFAULT_SESSIONTIMEOUT);
 	runasuser=DEFAULT_RUNASUSER;
 	runasgroup=DEFAULT_RUNASGROUP;
@@ -356,6 +382,10 @@ void sqlrconfig_xmldom::init() {
 	authondatabase=false;
 	sessionhandler=DEFAULT_SESSION_HANDLER;
 	handoff=DEFAULT_HANDOFF;
+	pooling=DEFAULT_POOLING;
+	poolingidletimeout=charstring::toUnsignedInteger(
+					DEFAULT_POOLINGIDLETIMEOUT);
+	affinity=DEFAULT_AFFINITY;
 	allowedips=DEFAULT_DENIEDIPS;
 	deniedips=DEFAULT_DENIEDIPS;
 	debug=DEFAULT_DEBUG;
@@ -401,6 +431,8 @@ void sqlrconfig_xmldom::init() {
 	idleclienttimeout=charstring::toInteger(DEFAULT_IDLECLIENTTIMEOUT);
 	metrictotal=0;
 	maxlisteners=charstring::toInteger(DEFAULT_MAXLISTENERS);
+	proxythreads=charstring::toUnsignedInteger(DEFAULT_PROXYTHREADS);
+	acceptors=charstring::toUnsignedInteger(DEFAULT_ACCEPTORS);
 	listenertimeout=charstring::toUnsignedInteger(DEFAULT_LISTENERTIMEOUT);
 	reloginatstart=charstring::isYes(DEFAULT_RELOGINATSTART);
 	fakeinputbindvariables=charstring::isYes(
@@ -418,6 +450,12 @@ void sqlrconfig_xmldom::init() {
 	isolationlevel=NULL;
 	ignoreselectdb=false;
 	waitfordowndb=true;
+	fingerprintstats=false;
+	spoolrows=charstring::toUnsignedInteger(DEFAULT_SPOOLROWS);
+	spoolbytes=charstring::toUnsignedInteger(DEFAULT_SPOOLBYTES);
+	spooltimeout=charstring::toUnsignedInteger(DEFAULT_SPOOLTIMEOUT);
+	memorysoftlimit=charstring::toUnsignedInteger(DEFAULT_MEMORYSOFTLIMIT);
+	memoryhardlimit=charstring::toUnsignedInteger(DEFAULT_MEMORYHARDLIMIT);
 	passwordpath=NULL;
 
 	connectstringlist.setManageValues(true);
@@ -550,6 +588,10 @@ bool sqlrconfig_xmldom::getEndOfSessionCommit() {
 	return endofsessioncommit;
 }
 
+bool sqlrconfig_xmldom::getSessionQueriesOnlyIfDirty() {
+	return sessionqueriesonlyifdirty;
+}
+
 uint32_t sqlrconfig_xmldom::getSessionTimeout() {
 	return sessiontimeout;
 }
@@ -586,6 +628,18 @@ const char *sqlrconfig_xmldom::getHandoff() {
 	return handoff;
 }
 
+const char *sqlrconfig_xmldom::getPooling() {
+	return pooling;
+}
+
+uint32_t sqlrconfig_xmldom::getPoolingIdleTimeout() {
+	return poolingidletimeout;
+}
+
+const char *sqlrconfig_xmldom::getAffinity() {
+	return affinity;
+}
+
 bool sqlrconfig_xmldom::getAuthOnConnection() {
 	return authonconnection;
 }
@@ -734,6 +788,14 @@ int64_t sqlrconfig_xmldom::getMaxListeners() {
 	return maxlisteners;
 }
 
+uint32_t sqlrconfig_xmldom::getProxyThreads() {
+	return proxythreads;
+}
+
+uint32_t sqlrconfig_xmldom::getAcceptors() {
+	return acceptors;
+}
+
 uint32_t sqlrconfig_xmldom::getListenerTimeout() {
 	return listenertimeout;
 }
@@ -786,6 +848,30 @@ bool sqlrconfig_xmldom::getWaitForDownDatabase() {
 	return waitfordowndb;
 }
 
+bool sqlrconfig_xmldom::getFingerprintStats() {
+	return fingerprintstats;
+}
+
+uint64_t sqlrconfig_xmldom::getSpoolRows() {
+	return spoolrows;
+}
+
+uint64_t sqlrconfig_xmldom::getSpoolBytes() {
+	return spoolbytes;
+}
+
+uint32_t sqlrconfig_xmldom::getSpoolTimeout() {
+	return spooltimeout;
+}
+
+uint64_t sqlrconfig_xmldom::getMemorySoftLimit() {
+	return memorysoftlimit;
+}
+
+uint64_t sqlrconfig_xmldom::getMemoryHardLimit() {
+	return memoryhardlimit;
+}
+
 const char *sqlrconfig_xmldom::getPasswordPath() {
 	return passwordpath;
 }
@@ -1811,6 +1897,11 @@ void sqlrconfig_xmldom::getTreeValues() {
 		endofsession=attr->getValue();
 		endofsessioncommit=!charstring::compare(endofsession,"commit");
 	}
+	attr=instance->getAttribute("sessionqueries");
+	if (!attr->isNullNode()) {
+		sessionqueriesonlyifdirty=
+			!charstring::compare(attr->getValue(),"dirty");
+	}
 	attr=instance->getAttribute("sessiontimeout");
 	if (!attr->isNullNode()) {
 		sessiontimeout=atouint32_t(attr->getValue(),
@@ -1855,6 +1946,19 @@ void sqlrconfig_xmldom::getTreeValues() {
 	if (!attr->isNullNode()) {
 		handoff=attr->getValue();
 	}
+	attr=instance->getAttribute("pooling");
+	if (!attr->isNullNode()) {
+		pooling=attr->getValue();
+	}
+	attr=instance->getAttribute("poolingidletimeout");
+	if (!attr->isNullNode()) {
+		poolingidletimeout=charstring::toUnsignedInteger(
+							attr->getValue());
+	}
+	attr=instance->getAttribute("affinity");
+	if (!attr->isNullNode()) {
+		affinity=attr->getValue();
+	}
 	attr=instance->getAttribute("allowedips");
 	if (!attr->isNullNode()) {
 		allowedips=attr->getValue();
@@ -1933,6 +2037,17 @@ void sqlrconfig_xmldom::getTreeValues() {
 	if (!attr->isNullNode()) {
 		maxlisteners=charstring::toInteger(attr->getValue());
 	}
+	attr=instance->getAttribute("proxythreads");
+	if (!attr->isNullNode()) {
+		proxythreads=charstring::toUnsignedInteger(attr->getValue());
+	}
+	attr=instance->getAttribute("acceptors");
+	if (!attr->isNullNode()) {
+		acceptors=charstring::toUnsignedInteger(attr->getValue());
+		if (!acceptors) {
+			acceptors=1;
+		}
+	}
 	attr=instance->getAttribute("listenertimeout");
 	if (!attr->isNullNode()) {
 		listenertimeout=charstring::toUnsignedInteger(attr->getValue());
@@ -1982,6 +2097,30 @@ void sqlrconfig_xmldom::getTreeValues() {
 	if (!attr->isNullNode()) {
 		waitfordowndb=charstring::isYes(attr->getValue());
 	}
+	attr=instance->getAttribute("fingerprintstats");
+	if (!attr->isNullNode()) {
+		fingerprintstats=charstring::isYes(attr->getValue());
+	}
+	attr=instance->getAttribute("spoolrows");
+	if (!attr->isNullNode()) {
+		spoolrows=charstring::toUnsignedInteger(attr->getValue());
+	}
+	attr=instance->getAttribute("spoolbytes");
+	if (!attr->isNullNode()) {
+		spoolbytes=charstring::toUnsignedInteger(attr->getValue());
+	}
+	attr=instance->getAttribute("spooltimeout");
+	if (!attr->isNullNode()) {
+		spooltimeout=charstring::toUnsignedInteger(attr->getValue());
+	}
+	attr=instance->getAttribute("memorysoftlimit");
+	if (!attr->isNullNode()) {
+		memorysoftlimit=charstring::toUnsignedInteger(attr->getValue());
+	}
+	attr=instance->getAttribute("memoryhardlimit");
+	if (!attr->isNullNode()) {
+		memoryhardlimit=charstring::toUnsignedInteger(attr->getValue());
+	}
 	attr=instance->getAttribute("passwordpath");
 	if (!attr->isNullNode()) {
 		passwordpath=attr->getValue();
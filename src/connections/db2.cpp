@@ -60,10 +60,13 @@ class SQLRSERVER_DLLSPEC db2cursor : public sqlrservercursor {
 	private:
 		void		allocateResultSetBuffers(int32_t columncount);
 		void		deallocateResultSetBuffers();
+		uint64_t	resultSetBufferBytes(int32_t columncount);
 		bool		open();
 		bool		close();
 		bool		prepareQuery(const char *query,
 						uint32_t length);
+		void		*detachStatement();
+		bool		attachStatement(void *cachedstmt);
 		void		encodeBlob(stringbuffer *buffer,
 						const char *data,
 						uint32_t datasize);
@@ -215,6 +218,7 @@ class SQLRSERVER_DLLSPEC db2cursor : public sqlrservercursor {
 		SQLINTEGER	sqlnulldata;
 
 		uint64_t	rowgroupindex;
+		uint64_t	rowarraysize;
 		uint64_t	totalinrowgroup;
 		uint64_t	totalrows;
 		uint64_t	rownumber;
@@ -238,6 +242,8 @@ class SQLRSERVER_DLLSPEC db2connection : public sqlrserverconnection {
 		void	dbVersionSpecificTasks();
 		sqlrservercursor	*newCursor(uint16_t id);
 		void	deleteCursor(sqlrservercursor *curs);
+		bool	supportsStatementCache();
+		void	freeStatement(void *stmt);
 		void	logOut();
 		int16_t	nullBindValue();
 		bool	bindValueIsNull(int16_t isnull);
@@ -543,6 +549,14 @@ void db2connection::deleteCursor(sqlrservercursor *curs) {
 	delete (db2cursor *)curs;
 }
 
+bool db2connection::supportsStatementCache() {
+	return true;
+}
+
+void db2connection::freeStatement(void *stmt) {
+	SQLFreeHandle(SQL_HANDLE_STMT,(SQLHSTMT)stmt);
+}
+
 void db2connection::logOut() {
 	SQLDisconnect(dbc);
 	SQLFreeHandle(SQL_HANDLE_DBC,dbc);
@@ -771,6 +785,8 @@ db2cursor::db2cursor(sqlrserverconnection *conn, uint16_t id) :
 	sqlnulldata=SQL_NULL_DATA;
 	bindformaterror=false;
 	allocateResultSetBuffers(conn->cont->getMaxColumnCount());
+	countMemory(SQLRMEMORY_FETCH,
+		resultSetBufferBytes(conn->cont->getMaxColumnCount()));
 }
 
 db2cursor::~db2cursor() {
@@ -819,6 +835,8 @@ void db2cursor::allocateResultSetBuffers(int32_t columncount) {
 
 void db2cursor::deallocateResultSetBuffers() {
 	if (columncount) {
+		releaseMemory(SQLRMEMORY_FETCH,
+				resultSetBufferBytes(columncount));
 		for (int32_t i=0; i<columncount; i++) {
 			delete[] column[i].name;
 			delete[] field[i];
@@ -838,6 +856,22 @@ void db2cursor::deallocateResultSetBuffers() {
 	}
 }
 
+uint64_t db2cursor::resultSetBufferBytes(int32_t columncount) {
+	if (!columncount) {
+		return 0;
+	}
+	uint32_t	fetchatonce=getFetchAtOnce();
+	uint64_t	rowbytes=conn->cont->getMaxFieldLength()+
+					3*sizeof(SQLINTEGER);
+	uint64_t	bytes=((uint64_t)columncount)*
+				(sizeof(db2column)+4096+4*sizeof(void *)+
+					fetchatonce*rowbytes);
+	#if (DB2VERSION>7)
+	bytes+=fetchatonce*sizeof(SQLUSMALLINT);
+	#endif
+	return bytes;
+}
+
 bool db2cursor::open() {
 
 	if (!stmt) {
@@ -854,6 +888,7 @@ bool db2cursor::open() {
 		if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
 			return false;
 		}
+		rowarraysize=getFetchAtOnce();
 
 		#if (DB2VERSION>7)
 		if (conn->cont->getMaxColumnCount()) {
@@ -911,6 +946,52 @@ bool db2cursor::prepareQuery(const char *query, uint32_t length) {
 	return (erg==SQL_SUCCESS || erg==SQL_SUCCESS_WITH_INFO);
 }
 
+void *db2cursor::detachStatement() {
+
+	if (!stmt) {
+		return NULL;
+	}
+
+	// column and parameter bindings refer to this cursor's buffers
+	SQLFreeStmt(stmt,SQL_UNBIND);
+	SQLFreeStmt(stmt,SQL_RESET_PARAMS);
+
+	// allocate a new handle for subsequent queries
+	SQLHSTMT	detachedstmt=stmt;
+	stmt=0;
+	open();
+	return (void *)detachedstmt;
+}
+
+bool db2cursor::attachStatement(void *cachedstmt) {
+
+	#if (DB2VERSION>7)
+	if (conn->cont->getMaxColumnCount()) {
+
+		// the row status ptr still refers to
+		// the cursor that prepared the statement
+		erg=SQLSetStmtAttr((SQLHSTMT)cachedstmt,
+					SQL_ATTR_ROW_STATUS_PTR,
+					(SQLPOINTER)rowstat,0);
+		if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
+			return false;
+		}
+	}
+	#endif
+
+	bindformaterror=false;
+
+	// initialize column count
+	ncols=0;
+
+	// adopt the cached statement in place of our own handle
+	if (stmt) {
+		SQLFreeHandle(SQL_HANDLE_STMT,stmt);
+	}
+	stmt=(SQLHSTMT)cachedstmt;
+	return true;
+}
+
 void db2cursor::encodeBlob(stringbuffer *buffer,
 					const char *data, uint32_t datasize) {
 
@@ -1393,6 +1474,10 @@ bool db2cursor::executeQuery(const char *query, uint32_t length) {
 	// allocate buffers and limit column count if necessary
 	if (!conn->cont->getMaxColumnCount()) {
 
+		if (!reserveMemory(SQLRMEMORY_FETCH,
+					resultSetBufferBytes(ncols))) {
+			return false;
+		}
 		allocateResultSetBuffers(ncols);
 
 		#if (DB2VERSION>7)
@@ -1721,7 +1806,7 @@ bool db2cursor::fetchRow(bool *error) {
 
 	*error=false;
 
-	if (rowgroupindex==getFetchAtOnce()) {
+	if (rowgroupindex==rowarraysize) {
 		rowgroupindex=0;
 	}
 	if (rowgroupindex>0 && rowgroupindex==totalinrowgroup) {
@@ -1729,6 +1814,18 @@ bool db2cursor::fetchRow(bool *error) {
 	}
 	if (!rowgroupindex) {
 
+		// the group may be smaller than fetchatonce,
+		// if it's being adapted to the result set
+		uint32_t	fetchbatch=startFetchBatch();
+		if (fetchbatch!=rowarraysize) {
+			SQLRETURN	erg=SQLSetStmtAttr(stmt,
+						SQL_ATTR_ROW_ARRAY_SIZE,
+						(SQLPOINTER)(uint64_t)fetchbatch,0);
+			if (erg==SQL_SUCCESS || erg==SQL_SUCCESS_WITH_INFO) {
+				rowarraysize=fetchbatch;
+			}
+		}
+
 		// SQLFetchScroll should return SQL_SUCCESS or
 		// SQL_SUCCESS_WITH_INFO if it successfully fetched a group of
 		// rows, otherwise we're at the end of the result and there are
@@ -1749,7 +1846,7 @@ bool db2cursor::fetchRow(bool *error) {
 		// SQL_ATTR_ROW_NUMBER to always be 1, running through
 		// the row status buffer appears to work though.
 		uint32_t	index=0;
-		while (index<getFetchAtOnce() &&
+		while (index<rowarraysize &&
 			(rowstat[index]==SQL_ROW_SUCCESS ||
 			rowstat[index]==SQL_ROW_SUCCESS_WITH_INFO)) {
 			index++;
@@ -1770,6 +1867,7 @@ bool db2cursor::fetchRow(bool *error) {
 		}
 		totalinrowgroup=rownumber-totalrows;
 		totalrows=rownumber;
+		endFetchBatch(totalinrowgroup);
 	}
 	return true;
 }
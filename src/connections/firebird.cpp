@@ -56,6 +56,12 @@ struct datebind {
 	bool		*isnegative;
 };
 
+struct cachedstatement {
+	isc_stmt_handle	stmt;
+	ISC_LONG	querytype;
+	bool		queryisexecsp;
+};
+
 class firebirdconnection;
 
 class SQLRSERVER_DLLSPEC firebirdcursor : public sqlrservercursor {
@@ -66,6 +72,8 @@ class SQLRSERVER_DLLSPEC firebirdcursor : public sqlrservercursor {
 				~firebirdcursor();
 		void		allocateResultSetBuffers(int32_t columncount);
 		void		deallocateResultSetBuffers();
+		void		*detachStatement();
+		bool		attachStatement(void *cachedstmt);
 		bool		prepareQuery(const char *query,
 						uint32_t length);
 		bool		inputBind(const char *variable, 
@@ -228,6 +236,8 @@ class SQLRSERVER_DLLSPEC firebirdconnection : public sqlrserverconnection {
 		bool	logIn(const char **error, const char **warning);
 		sqlrservercursor	*newCursor(uint16_t id);
 		void	deleteCursor(sqlrservercursor *curs);
+		bool	supportsStatementCache();
+		void	freeStatement(void *stmt);
 		void	logOut();
 		bool	supportsTransactionBlocks();
 		bool	commit();
@@ -454,6 +464,16 @@ void firebirdconnection::deleteCursor(sqlrservercursor *curs) {
 	delete (firebirdcursor *)curs;
 }
 
+bool firebirdconnection::supportsStatementCache() {
+	return true;
+}
+
+void firebirdconnection::freeStatement(void *stmt) {
+	cachedstatement	*cs=(cachedstatement *)stmt;
+	isc_dsql_free_statement(error,&cs->stmt,DSQL_drop);
+	delete cs;
+}
+
 void firebirdconnection::logOut() {
 	isc_detach_database(error,&db);
 }
@@ -910,6 +930,63 @@ bool firebirdcursor::prepareQuery(const char *query, uint32_t length) {
 	return true;
 }
 
+void *firebirdcursor::detachStatement() {
+
+	if (!stmt) {
+		return NULL;
+	}
+
+	// Close the statement's cursor, if it has one open.  This fails if
+	// there's no open cursor, so use a separate status vector to avoid
+	// clobbering any error that's already been reported.
+	ISC_STATUS	status[20];
+	isc_dsql_free_statement(status,&stmt,DSQL_close);
+
+	// The statement type and whether it's a stored procedure were
+	// worked out from the query when it was prepared.  The cursor
+	// that borrows the statement won't have the query, so they have to
+	// be cached along with the statement.  (A new statement will be
+	// allocated for the next query that this cursor prepares.)
+	cachedstatement	*cs=new cachedstatement;
+	cs->stmt=stmt;
+	cs->querytype=querytype;
+	cs->queryisexecsp=queryisexecsp;
+	stmt=0;
+	return (void *)cs;
+}
+
+bool firebirdcursor::attachStatement(void *cachedstmt) {
+
+	cachedstatement	*cs=(cachedstatement *)cachedstmt;
+
+	// see prepareQuery()
+	outsqlda->sqld=0;
+	bindformaterror=false;
+	querytype=cs->querytype;
+	queryisexecsp=cs->queryisexecsp;
+
+	// describe the output columns (or output binds) and bind parameters
+	// into this cursor's sqlda's
+	if (isc_dsql_describe(firebirdconn->error,&cs->stmt,1,
+				(queryisexecsp)?outbindsqlda:outsqlda)) {
+		return false;
+	}
+	inbindsqlda->sqld=0;
+	if (isc_dsql_describe_bind(firebirdconn->error,
+					&cs->stmt,1,inbindsqlda)) {
+		return false;
+	}
+	inbindsqlda->sqln=inbindsqlda->sqld;
+
+	// adopt the cached statement in place of our own
+	if (stmt) {
+		isc_dsql_free_statement(firebirdconn->error,&stmt,DSQL_drop);
+	}
+	stmt=cs->stmt;
+	delete cs;
+	return true;
+}
+
 bool firebirdcursor::inputBind(const char *variable,
 					uint16_t variablesize,
 					const char *value,
@@ -58,10 +58,13 @@ class SQLRSERVER_DLLSPEC informixcursor : public sqlrservercursor {
 	private:
 		void		allocateResultSetBuffers(int32_t columncount);
 		void		deallocateResultSetBuffers();
+		uint64_t	resultSetBufferBytes(int32_t columncount);
 		bool		open();
 		bool		close();
 		bool		prepareQuery(const char *query,
 						uint32_t length);
+		void		*detachStatement();
+		bool		attachStatement(void *cachedstmt);
 		bool		inputBind(const char *variable, 
 						uint16_t variablesize,
 						const char *value, 
@@ -204,6 +207,7 @@ class SQLRSERVER_DLLSPEC informixcursor : public sqlrservercursor {
 		BOOL		truevalue;
 
 		uint64_t	rowgroupindex;
+		uint64_t	rowarraysize;
 		uint64_t	totalinrowgroup;
 		uint64_t	totalrows;
 		uint64_t	rownumber;
@@ -227,6 +231,8 @@ class SQLRSERVER_DLLSPEC informixconnection : public sqlrserverconnection {
 		const char	*logInError(const char *errmsg);
 		sqlrservercursor	*newCursor(uint16_t id);
 		void	deleteCursor(sqlrservercursor *curs);
+		bool	supportsStatementCache();
+		void	freeStatement(void *stmt);
 		void	logOut();
 		int16_t	nullBindValue();
 		bool	bindValueIsNull(int16_t isnull);
@@ -454,6 +460,14 @@ void informixconnection::deleteCursor(sqlrservercursor *curs) {
 	delete (informixcursor *)curs;
 }
 
+bool informixconnection::supportsStatementCache() {
+	return true;
+}
+
+void informixconnection::freeStatement(void *stmt) {
+	SQLFreeHandle(SQL_HANDLE_STMT,(SQLHSTMT)stmt);
+}
+
 void informixconnection::logOut() {
 	SQLDisconnect(dbc);
 	SQLFreeHandle(SQL_HANDLE_DBC,dbc);
@@ -804,6 +818,8 @@ informixcursor::informixcursor(sqlrserverconnection *conn, uint16_t id) :
 	sqlnulldata=SQL_NULL_DATA;
 	bindformaterror=false;
 	allocateResultSetBuffers(conn->cont->getMaxColumnCount());
+	countMemory(SQLRMEMORY_FETCH,
+		resultSetBufferBytes(conn->cont->getMaxColumnCount()));
 	truevalue=SQL_TRUE;
 }
 
@@ -844,6 +860,8 @@ void informixcursor::allocateResultSetBuffers(int32_t columncount) {
 
 void informixcursor::deallocateResultSetBuffers() {
 	if (columncount) {
+		releaseMemory(SQLRMEMORY_FETCH,
+				resultSetBufferBytes(columncount));
 		for (int32_t i=0; i<columncount; i++) {
 			delete[] column[i].name;
 			delete[] field[i];
@@ -858,6 +876,14 @@ void informixcursor::deallocateResultSetBuffers() {
 	}
 }
 
+uint64_t informixcursor::resultSetBufferBytes(int32_t columncount) {
+	uint64_t	rowbytes=conn->cont->getMaxFieldLength()+
+					2*sizeof(SQLLEN);
+	return ((uint64_t)columncount)*
+			(sizeof(informixcolumn)+4096+3*sizeof(void *)+
+				getFetchAtOnce()*rowbytes);
+}
+
 bool informixcursor::open() {
 
 	if (!stmt) {
@@ -874,6 +900,7 @@ bool informixcursor::open() {
 		if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
 			return false;
 		}
+		rowarraysize=getFetchAtOnce();
 
 		// enable smart-large-object automation for non-selects
 		erg=SQLSetStmtAttr(stmt,SQL_INFX_ATTR_LO_AUTOMATIC,
@@ -918,6 +945,42 @@ bool informixcursor::prepareQuery(const char *query, uint32_t length) {
 	return (erg==SQL_SUCCESS || erg==SQL_SUCCESS_WITH_INFO);
 }
 
+void *informixcursor::detachStatement() {
+
+	// noops aren't actually prepared
+	if (!stmt || noop) {
+		return NULL;
+	}
+
+	// column and parameter bindings refer to this cursor's buffers
+	SQLFreeStmt(stmt,SQL_UNBIND);
+	SQLFreeStmt(stmt,SQL_RESET_PARAMS);
+
+	// allocate a new handle for subsequent queries
+	SQLHSTMT	detachedstmt=stmt;
+	stmt=0;
+	open();
+	return (void *)detachedstmt;
+}
+
+bool informixcursor::attachStatement(void *cachedstmt) {
+
+	bindformaterror=false;
+
+	// initialize column count
+	ncols=0;
+
+	noop=false;
+
+	// adopt the cached statement in place of our own handle
+	// (all handles have the same row array size and lo automation)
+	if (stmt) {
+		SQLFreeHandle(SQL_HANDLE_STMT,stmt);
+	}
+	stmt=(SQLHSTMT)cachedstmt;
+	return true;
+}
+
 bool informixcursor::inputBind(const char *variable,
 					uint16_t variablesize,
 					const char *value,
@@ -1380,6 +1443,10 @@ bool informixcursor::executeQuery(const char *query, uint32_t length) {
 	// allocate buffers and limit column count if necessary
 	int32_t	maxcolumncount=conn->cont->getMaxColumnCount();
 	if (!maxcolumncount) {
+		if (!reserveMemory(SQLRMEMORY_FETCH,
+					resultSetBufferBytes(ncols))) {
+			return false;
+		}
 		allocateResultSetBuffers(ncols);
 	} else if (ncols>maxcolumncount) {
 		ncols=maxcolumncount;
@@ -1739,7 +1806,7 @@ bool informixcursor::fetchRow(bool *error) {
 		return false;
 	}
 
-	if (rowgroupindex==getFetchAtOnce()) {
+	if (rowgroupindex==rowarraysize) {
 		rowgroupindex=0;
 	}
 	if (rowgroupindex>0 && rowgroupindex==totalinrowgroup) {
@@ -1747,6 +1814,18 @@ bool informixcursor::fetchRow(bool *error) {
 	}
 	if (!rowgroupindex) {
 
+		// the group may be smaller than fetchatonce,
+		// if it's being adapted to the result set
+		uint32_t	fetchbatch=startFetchBatch();
+		if (fetchbatch!=rowarraysize) {
+			SQLRETURN	erg=SQLSetStmtAttr(stmt,
+						SQL_ATTR_ROW_ARRAY_SIZE,
+						(SQLPOINTER)(uint64_t)fetchbatch,0);
+			if (erg==SQL_SUCCESS || erg==SQL_SUCCESS_WITH_INFO) {
+				rowarraysize=fetchbatch;
+			}
+		}
+
 		// SQLFetchScroll should return SQL_SUCCESS or
 		// SQL_SUCCESS_WITH_INFO if it successfully fetched a group of
 		// rows, otherwise we're at the end of the result and there are
@@ -1775,6 +1854,7 @@ bool informixcursor::fetchRow(bool *error) {
 		}
 		totalinrowgroup=rownumber-totalrows;
 		totalrows=rownumber;
+		endFetchBatch(totalinrowgroup);
 	}
 	return true;
 }
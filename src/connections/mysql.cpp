@@ -52,6 +52,11 @@ class SQLRSERVER_DLLSPEC mysqlcursor : public sqlrservercursor {
 #endif
 		bool		prepareQuery(const char *query,
 						uint32_t length);
+#ifdef HAVE_MYSQL_STMT_PREPARE
+		bool		describeStatement();
+		void		*detachStatement();
+		bool		attachStatement(void *cachedstmt);
+#endif
 		bool		supportsNativeBinds(const char *query,
 							uint32_t length);
 #ifdef HAVE_MYSQL_STMT_PREPARE
@@ -204,6 +209,10 @@ class SQLRSERVER_DLLSPEC mysqlconnection : public sqlrserverconnection {
 		bool		logIn(const char **error, const char **warning);
 		sqlrservercursor	*newCursor(uint16_t id);
 		void		deleteCursor(sqlrservercursor *curs);
+#ifdef HAVE_MYSQL_STMT_PREPARE
+		bool		supportsStatementCache();
+		void		freeStatement(void *stmt);
+#endif
 		void		logOut();
 		bool		isTransactional();
 #ifdef HAVE_MYSQL_PING
@@ -632,6 +641,16 @@ void mysqlconnection::deleteCursor(sqlrservercursor *curs) {
 	delete (mysqlcursor *)curs;
 }
 
+#ifdef HAVE_MYSQL_STMT_PREPARE
+bool mysqlconnection::supportsStatementCache() {
+	return usestmtapi;
+}
+
+void mysqlconnection::freeStatement(void *stmt) {
+	mysql_stmt_close((MYSQL_STMT *)stmt);
+}
+#endif
+
 void mysqlconnection::logOut() {
 	connected=false;
 	mysql_close(mysqlptr);
@@ -1093,6 +1112,18 @@ bool mysqlcursor::prepareQuery(const char *query, uint32_t length) {
 
 	stmtfreeresult=true;
 
+	// get the column info and bind the fields
+	if (!describeStatement()) {
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+#ifdef HAVE_MYSQL_STMT_PREPARE
+bool mysqlcursor::describeStatement() {
+
 	uint32_t	maxcolumncount=conn->cont->getMaxColumnCount();
 
 	// get the column count
@@ -1139,11 +1170,72 @@ bool mysqlcursor::prepareQuery(const char *query, uint32_t length) {
 			return false;
 		}
 	}
-#endif
 
 	return true;
 }
 
+void *mysqlcursor::detachStatement() {
+
+	// only statements prepared with the stmt api can be cached
+	if (!usestmtprepare || !stmtfreeresult) {
+		return NULL;
+	}
+
+	// free the result set and metadata,
+	// which refer to this cursor's buffers
+	mysql_stmt_free_result(stmt);
+	stmtfreeresult=false;
+	if (mysqlresult) {
+		mysql_free_result(mysqlresult);
+		mysqlresult=NULL;
+	}
+
+	// allocate a new statement for subsequent queries
+	MYSQL_STMT	*detachedstmt=stmt;
+	stmt=mysql_stmt_init(mysqlconn->mysqlptr);
+	return (void *)detachedstmt;
+}
+
+bool mysqlcursor::attachStatement(void *cachedstmt) {
+
+	// initialize column count
+	ncols=0;
+
+	// see prepareQuery()
+	if (mysqlconn->firstquery) {
+		mysqlconn->firstquery=false;
+		mysqlconn->commit();
+	}
+
+	// reset bind-related stuff
+	if (boundvariables) {
+		bytestring::zero(bind,maxbindcount*sizeof(MYSQL_BIND));
+	}
+	boundvariables=false;
+	bindformaterror=false;
+	usestmtprepare=true;
+
+	// free any lingering statements and result sets
+	if (stmtfreeresult) {
+		mysql_stmt_free_result(stmt);
+		stmtfreeresult=false;
+	}
+	freeResult();
+
+	// adopt the cached statement in place of our own
+	if (stmt) {
+		mysql_stmt_close(stmt);
+	}
+	stmt=(MYSQL_STMT *)cachedstmt;
+	stmtreset=false;
+	stmtpreparefailed=false;
+	stmtfreeresult=true;
+
+	// get the column info and bind the fields to this cursor's buffers
+	return describeStatement();
+}
+#endif
+
 bool mysqlcursor::supportsNativeBinds(const char *query, uint32_t length) {
 #ifdef HAVE_MYSQL_STMT_PREPARE
 	usestmtprepare=mysqlconn->usestmtapi &&
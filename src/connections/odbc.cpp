@@ -83,6 +83,8 @@ class SQLRSERVER_DLLSPEC odbccursor : public sqlrservercursor {
 		void		deallocateResultSetBuffers();
 		bool		prepareQuery(const char *query,
 						uint32_t length);
+		void		*detachStatement();
+		bool		attachStatement(void *cachedstmt);
 		bool		allocateStatementHandle();
 		void		initializeColCounts();
 		void		initializeRowCounts();
@@ -203,7 +205,9 @@ class SQLRSERVER_DLLSPEC odbccursor : public sqlrservercursor {
 		const char	*getColumnTable(uint32_t i);
 		uint16_t	getColumnTableLength(uint32_t i);
 		bool		noRowsToReturn();
+		bool		skipRow(bool *error);
 		bool		fetchRow(bool *error);
+		void		nextRow();
 		void		getField(uint32_t col,
 					const char **field,
 					uint64_t *fieldlength,
@@ -243,12 +247,16 @@ class SQLRSERVER_DLLSPEC odbccursor : public sqlrservercursor {
 		char		**field;
 		#ifdef SQLBINDCOL_SQLLEN
 		SQLLEN		*loblength;
-		SQLLEN		*indicator;
+		SQLLEN		**indicator;
+		SQLULEN		rowsfetched;
 		#else
 		SQLINTEGER	*loblength;
-		SQLINTEGER	*indicator;
+		SQLINTEGER	**indicator;
+		SQLUINTEGER	rowsfetched;
 		#endif
 		odbccolumn 	*column;
+		uint32_t	rowsetsize;
+		bool		unboundcolumns;
 
 		uint16_t	maxbindcount;
 		datebind	**outdatebind;
@@ -305,6 +313,8 @@ class SQLRSERVER_DLLSPEC odbcconnection : public sqlrserverconnection {
 		const char	*logInError(const char *errmsg);
 		sqlrservercursor	*newCursor(uint16_t id);
 		void		deleteCursor(sqlrservercursor *curs);
+		bool		supportsStatementCache();
+		void		freeStatement(void *stmt);
 		void		logOut();
 		#if (ODBCVER>=0x0300)
 		bool		autoCommitOn();
@@ -397,6 +407,7 @@ class SQLRSERVER_DLLSPEC odbcconnection : public sqlrserverconnection {
 		SQLINTEGER	*columninfonotvalidyeterror;
 		bool		sqltypedatetosqlcbinary;
 		bool		fetchlobsasstrings;
+		bool		getdatablock;
 
 		#if (ODBCVER>=0x0300)
 		stringbuffer	errormsg;
@@ -799,8 +810,13 @@ void odbcconnection::handleConnectString() {
 		ncharencoding="UCS-2//TRANSLIT";
 	}
 
-	// unixodbc doesn't support array fetches
-	cont->setFetchAtOnce(1);
+	// Rows are fetched fetchatonce at a time, using bound column arrays.
+	// Each bound column needs fetchatonce*maxitembuffersize bytes though,
+	// and some drivers don't handle SQL_ATTR_ROW_ARRAY_SIZE properly, so
+	// fetch a row at a time unless fetchatonce was set explicitly.
+	if (!cont->getConnectStringValue("fetchatonce")) {
+		cont->setFetchAtOnce(1);
+	}
 }
 
 bool odbcconnection::logIn(const char **error, const char **warning) {
@@ -994,6 +1010,21 @@ bool odbcconnection::logIn(const char **error, const char **warning) {
 		dbmsnamebuffer[dbmsnamelen]='\0';
 	}
 
+	// Find out whether SQLGetData can be used with block cursors.  If it
+	// can't, then result sets with columns that can't be bound (LOBs) are
+	// fetched a row at a time.
+	getdatablock=false;
+	#if (ODBCVER >= 0x0300)
+	SQLUINTEGER	getdataextensions=0;
+	if (SQLGetInfo(dbc,
+			SQL_GETDATA_EXTENSIONS,
+			&getdataextensions,
+			sizeof(getdataextensions),
+			NULL)==SQL_SUCCESS) {
+		getdatablock=(getdataextensions&SQL_GD_BLOCK);
+	}
+	#endif
+
 	// set some default params
 	begintxquery=sqlrserverconnection::beginTransactionQuery();
 	usecharforlobbind=true;
@@ -1279,6 +1310,21 @@ void odbcconnection::deleteCursor(sqlrservercursor *curs) {
 	delete (odbccursor *)curs;
 }
 
+bool odbcconnection::supportsStatementCache() {
+	// when getting column tables, prepareQuery() re-prepares the query
+	// after describing it, and a cached statement couldn't be described
+	// the same way
+	return !getcolumntables;
+}
+
+void odbcconnection::freeStatement(void *stmt) {
+	#if (ODBCVER >= 0x0300)
+	SQLFreeHandle(SQL_HANDLE_STMT,(SQLHSTMT)stmt);
+	#else
+	SQLFreeStmt((SQLHSTMT)stmt,SQL_DROP);
+	#endif
+}
+
 void odbcconnection::logOut() {
 	SQLDisconnect(dbc);
 	#if (ODBCVER >= 0x0300)
@@ -2239,15 +2285,21 @@ void odbccursor::allocateResultSetBuffers(int32_t columncount) {
 		field=new char *[columncount];
 		#ifdef SQLBINDCOL_SQLLEN
 		loblength=new SQLLEN[columncount];
-		indicator=new SQLLEN[columncount];
+		indicator=new SQLLEN *[columncount];
 		#else
 		loblength=new SQLINTEGER[columncount];
-		indicator=new SQLINTEGER[columncount];
+		indicator=new SQLINTEGER *[columncount];
 		#endif
+		uint32_t	fetchatonce=getFetchAtOnce();
 		uint32_t	maxfieldlength=conn->cont->getMaxFieldLength();
 		column=new odbccolumn[columncount];
 		for (int32_t i=0; i<columncount; i++) {
-			field[i]=new char[maxfieldlength];
+			field[i]=new char[fetchatonce*maxfieldlength];
+			#ifdef SQLBINDCOL_SQLLEN
+			indicator[i]=new SQLLEN[fetchatonce];
+			#else
+			indicator[i]=new SQLINTEGER[fetchatonce];
+			#endif
 		}
 	}
 }
@@ -2256,6 +2308,7 @@ void odbccursor::deallocateResultSetBuffers() {
 	if (columncount) {
 		for (int32_t i=0; i<columncount; i++) {
 			delete[] field[i];
+			delete[] indicator[i];
 		}
 		delete[] column;
 		delete[] field;
@@ -2379,6 +2432,55 @@ bool odbccursor::prepareQuery(const char *query, uint32_t length) {
 	return (erg==SQL_SUCCESS || erg==SQL_SUCCESS_WITH_INFO);
 }
 
+void *odbccursor::detachStatement() {
+
+	// if the query was executed directly then it was never prepared
+	if (!stmt || getExecuteDirect()) {
+		return NULL;
+	}
+
+	// column and parameter bindings refer to this cursor's buffers
+	SQLFreeStmt(stmt,SQL_UNBIND);
+	SQLFreeStmt(stmt,SQL_RESET_PARAMS);
+
+	// prepareQuery() will allocate a new handle
+	SQLHSTMT	detachedstmt=stmt;
+	stmt=NULL;
+	return (void *)detachedstmt;
+}
+
+bool odbccursor::attachStatement(void *cachedstmt) {
+
+	// the query will be executed directly, so there's no need for
+	// a prepared statement
+	if (getExecuteDirect()) {
+		return false;
+	}
+
+	bindformaterror=false;
+
+	// initialize column count
+	initializeColCounts();
+
+	#ifdef HAVE_SQLCONNECTW
+	ucsinbindstrings.clear();
+	#endif
+
+	// adopt the cached statement and get its column info, just like
+	// prepareQuery() would have, but keep our own handle until we know
+	// that worked, so the cached statement can be given back if it didn't
+	SQLHSTMT	oldstmt=stmt;
+	stmt=(SQLHSTMT)cachedstmt;
+	if (!handleColumns(true,false)) {
+		stmt=oldstmt;
+		return false;
+	}
+	if (oldstmt) {
+		odbcconn->freeStatement((void *)oldstmt);
+	}
+	return true;
+}
+
 bool odbccursor::allocateStatementHandle() {
 
 	if (stmt) {
@@ -3379,6 +3481,9 @@ void odbccursor::initializeRowCounts() {
 	row=0;
 	maxrow=0;
 	totalrows=0;
+	rowsfetched=0;
+	rowsetsize=1;
+	unboundcolumns=false;
 	affectedrows=-1;
 }
 
@@ -3704,33 +3809,39 @@ bool odbccursor::handleColumns(bool getcolumninfo, bool bindcolumns) {
 		uint32_t	maxfieldlength=conn->cont->getMaxFieldLength();
 
 		// run through the columns
+		unboundcolumns=false;
 		for (SQLSMALLINT i=0; i<ncols; i++) {
 
 			// bind the column to a buffer
+			bool	bound=true;
 			#ifdef HAVE_SQLCONNECTW
 			if (odbcconn->unicode) {
 				if (column[i].type==SQL_WVARCHAR ||
 					column[i].type==SQL_WCHAR) {
 					erg=SQLBindCol(stmt,i+1,SQL_C_WCHAR,
 							field[i],maxfieldlength,
-							&(indicator[i]));
+							indicator[i]);
 				} else if (column[i].type==SQL_TYPE_TIMESTAMP ||
 					(odbcconn->sqltypedatetosqlcbinary &&
 					column[i].type==SQL_TYPE_DATE)) {
 					erg=SQLBindCol(stmt,i+1,SQL_C_BINARY,
 							field[i],maxfieldlength,
-							&(indicator[i]));
+							indicator[i]);
 				} else if (!isLob(column[i].type)) {
 					erg=SQLBindCol(stmt,i+1,SQL_C_CHAR,
 							field[i],maxfieldlength,
-							&(indicator[i]));
+							indicator[i]);
+				} else {
+					bound=false;
 				}
 			} else {
 			#endif
 				if (!isLob(column[i].type)) {
 					erg=SQLBindCol(stmt,i+1,SQL_C_CHAR,
 							field[i],maxfieldlength,
-							&(indicator[i]));
+							indicator[i]);
+				} else {
+					bound=false;
 				}
 			#ifdef HAVE_SQLCONNECTW
 			}
@@ -3739,7 +3850,42 @@ bool odbccursor::handleColumns(bool getcolumninfo, bool bindcolumns) {
 			if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
 				return false;
 			}
+			if (!bound) {
+				unboundcolumns=true;
+			}
+		}
+
+		// Fetch fetchatonce rows at a time into the bound column
+		// arrays.  Columns that couldn't be bound have to be fetched
+		// with SQLGetData, which only works with a block cursor if the
+		// driver supports SQL_GD_BLOCK.  If it doesn't, then fall back
+		// to fetching a row at a time.
+		rowsetsize=1;
+		#if (ODBCVER >= 0x0300)
+		if (!unboundcolumns || odbcconn->getdatablock) {
+			rowsetsize=getFetchAtOnce();
 		}
+		erg=SQLSetStmtAttr(stmt,SQL_ATTR_ROW_ARRAY_SIZE,
+					(SQLPOINTER)(uint64_t)rowsetsize,0);
+		if (erg==SQL_SUCCESS_WITH_INFO) {
+			// the driver may have used a smaller size
+			#ifdef SQLBINDCOL_SQLLEN
+			SQLULEN		actualsize=1;
+			#else
+			SQLUINTEGER	actualsize=1;
+			#endif
+			if (SQLGetStmtAttr(stmt,SQL_ATTR_ROW_ARRAY_SIZE,
+						&actualsize,0,NULL)==
+							SQL_SUCCESS &&
+						actualsize<rowsetsize) {
+				rowsetsize=actualsize;
+			}
+		} else if (erg!=SQL_SUCCESS) {
+			rowsetsize=1;
+		}
+		SQLSetStmtAttr(stmt,SQL_ATTR_ROWS_FETCHED_PTR,
+					(SQLPOINTER)&rowsfetched,0);
+		#endif
 	}
 
 	return true;
@@ -3935,16 +4081,48 @@ bool odbccursor::noRowsToReturn() {
 	return (!ncols);
 }
 
+bool odbccursor::skipRow(bool *error) {
+	if (fetchRow(error)) {
+		row++;
+		return true;
+	}
+	return false;
+}
+
 bool odbccursor::fetchRow(bool *error) {
 
 	*error=false;
-	erg=SQLFetch(stmt);
-	if (erg==SQL_ERROR) {
-		*error=true;
-		return false;
-	}
-	if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
-		return false;
+
+	// fetch another block of rows if we've used up the current one
+	if (row==maxrow) {
+
+		#if (ODBCVER >= 0x0300)
+		if (rowsetsize>1) {
+			rowsfetched=0;
+			erg=SQLFetchScroll(stmt,SQL_FETCH_NEXT,0);
+		} else {
+		#endif
+			erg=SQLFetch(stmt);
+			rowsfetched=1;
+		#if (ODBCVER >= 0x0300)
+		}
+		#endif
+		if (erg==SQL_ERROR) {
+			*error=true;
+			return false;
+		}
+		if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
+			return false;
+		}
+
+		// some drivers return success at the end of the result set
+		if (!rowsfetched) {
+			return false;
+		}
+
+		row=0;
+		maxrow=rowsfetched;
+		totalrows+=rowsfetched;
 	}
 	
 	#ifdef HAVE_SQLCONNECTW
@@ -3954,10 +4132,11 @@ bool odbccursor::fetchRow(bool *error) {
 		for (int i=0; i<ncols; i++) {
 			if (column[i].type==SQL_WVARCHAR ||
 					column[i].type==SQL_WCHAR) {
-				if (indicator[i]!=SQL_NULL_DATA && field[i]) {
+				char	*fld=field[i]+row*maxfieldlength;
+				if (indicator[i][row]!=SQL_NULL_DATA && field[i]) {
 					char	*err=NULL;
 					char	*u=convertCharset(
-						field[i],
+						fld,
 						odbcconn->ncharencoding,
 						"UTF-8",&err);
 					if (err) {
@@ -3971,10 +4150,10 @@ bool odbccursor::fetchRow(bool *error) {
 						s=maxfieldlength-
 							nullSize("UTF-8");
 					}
-					bytestring::zero(field[i]+s,
+					bytestring::zero(fld+s,
 							nullSize("UTF-8"));
-					bytestring::copy(field[i],u,s);
-					indicator[i]=s;
+					bytestring::copy(fld,u,s);
+					indicator[i][row]=s;
 					delete[] u;
 				}
 			}
@@ -3990,7 +4169,7 @@ void odbccursor::getField(uint32_t col,
 				bool *blob, bool *null) {
 
 	// handle NULLs
-	if (indicator[col]==SQL_NULL_DATA) {
+	if (indicator[col][row]==SQL_NULL_DATA) {
 		*null=true;
 		return;
 	}
@@ -4002,14 +4181,29 @@ void odbccursor::getField(uint32_t col,
 	}
 
 	// handle normal datatypes
-	*fld=field[col];
-	*fldlength=indicator[col];
+	*fld=field[col]+row*conn->cont->getMaxFieldLength();
+	*fldlength=indicator[col][row];
+}
+
+void odbccursor::nextRow() {
+	row++;
 }
 
 bool odbccursor::getLobFieldLength(uint32_t col, uint64_t *length) {
 
 	// get the length of the lob
 
+	// when fetching blocks of rows, SQLGetData
+	// operates on the row that the cursor is positioned on
+	#if (ODBCVER >= 0x0300)
+	if (rowsetsize>1) {
+		erg=SQLSetPos(stmt,row+1,SQL_POSITION,SQL_LOCK_NO_CHANGE);
+		if (erg!=SQL_SUCCESS && erg!=SQL_SUCCESS_WITH_INFO) {
+			return false;
+		}
+	}
+	#endif
+
 	// a valid buffer must be provided, but it's ok to fetch 0 bytes into it
 	SQLCHAR	buffer[1];
 	erg=SQLGetData(stmt,col+1,SQL_C_BINARY,buffer,0,&(loblength[col]));
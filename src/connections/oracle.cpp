@@ -192,6 +192,7 @@ class SQLRSERVER_DLLSPEC oraclecursor : public sqlrservercursor {
 				~oraclecursor();
 		void		allocateResultSetBuffers(int32_t columncount);
 		void		deallocateResultSetBuffers();
+		uint64_t	resultSetBufferBytes(int32_t columncount);
 		bool		open();
 		bool		close();
 		bool		prepareQuery(const char *query,
@@ -408,6 +409,7 @@ class SQLRSERVER_DLLSPEC oraclecursor : public sqlrservercursor {
 		uint64_t	row;
 		uint64_t	maxrow;
 		uint64_t	totalrows;
+		uint32_t	fetchbatch;
 
 		char		*query;
 		uint32_t	length;
@@ -2402,6 +2404,8 @@ oraclecursor::oraclecursor(sqlrserverconnection *conn, uint16_t id) :
 
 	oracleconn=(oracleconnection *)conn;
 	allocateResultSetBuffers(conn->cont->getMaxColumnCount());
+	countMemory(SQLRMEMORY_FETCH,
+		resultSetBufferBytes(conn->cont->getMaxColumnCount()));
 
 	maxbindcount=conn->cont->getConfig()->getMaxBindCount();
 	inbindpp=new OCIBind *[maxbindcount];
@@ -2452,6 +2456,7 @@ oraclecursor::oraclecursor(sqlrserverconnection *conn, uint16_t id) :
 	row=0;
 	maxrow=0;
 	totalrows=0;
+	fetchbatch=0;
 
 	query=NULL;
 	length=0;
@@ -2545,6 +2550,8 @@ void oraclecursor::allocateResultSetBuffers(int32_t columncount) {
 
 void oraclecursor::deallocateResultSetBuffers() {
 	if (columncount) {
+		releaseMemory(SQLRMEMORY_FETCH,
+				resultSetBufferBytes(columncount));
 		for (int32_t i=0; i<columncount; i++) {
 			delete[] def_col_retcode[i];
 			delete[] def_col_retlen[i];
@@ -2563,6 +2570,16 @@ void oraclecursor::deallocateResultSetBuffers() {
 	}
 }
 
+uint64_t oraclecursor::resultSetBufferBytes(int32_t columncount) {
+	uint64_t	rowbytes=conn->cont->getMaxFieldLength()+
+					sizeof(OCILobLocator *)+
+					sizeof(sb2)+sizeof(ub2)+sizeof(ub2);
+	return ((uint64_t)columncount)*
+			(sizeof(describe)+sizeof(OCIDefine *)+
+				5*sizeof(void *)+
+				getFetchAtOnce()*rowbytes);
+}
+
 bool oraclecursor::open() {
 
 	stmt=NULL;
@@ -3598,6 +3615,10 @@ bool oraclecursor::executeQueryOrFetchFromBindCursor(const char *query,
 
 		// allocate buffers, if necessary
 		if (!maxcolumncount) {
+			if (!reserveMemory(SQLRMEMORY_FETCH,
+					resultSetBufferBytes(ncols))) {
+				return false;
+			}
 			allocateResultSetBuffers(ncols);
 		}
 
@@ -3980,15 +4001,18 @@ bool oraclecursor::fetchRow(bool *error) {
 
 	*error=false;
 
-	if (row==getFetchAtOnce()) {
+	if (row==fetchbatch) {
 		row=0;
 	}
 	if (row>0 && row==maxrow) {
 		return false;
 	}
 	if (!row) {
+		// the batch may be smaller than fetchatonce,
+		// if it's being adapted to the result set
+		fetchbatch=startFetchBatch();
 		OCIStmtFetch(stmt,oracleconn->err,
-				(ub4)getFetchAtOnce(),
+				(ub4)fetchbatch,
 				OCI_FETCH_NEXT,OCI_DEFAULT);
 		ub4	currentrow;
 		OCIAttrGet(stmt,OCI_HTYPE_STMT,
@@ -3999,6 +4023,7 @@ bool oraclecursor::fetchRow(bool *error) {
 		}
 		maxrow=currentrow-totalrows;
 		totalrows=currentrow;
+		endFetchBatch(maxrow);
 	}
 	return true;
 }
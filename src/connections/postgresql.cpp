@@ -52,6 +52,14 @@ class SQLRSERVER_DLLSPEC postgresqlconnection : public sqlrserverconnection {
 		const char	*bindFormat();
 		const char	*nextvalFormat();
 
+		void		buildDictionary(PGresult *result,
+					dictionary< int32_t, char *> *dict);
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
+		PGresult	*getPipelinedResult();
+		bool		getPipelineSync();
+		bool		endPipeline();
+#endif
+
 		dictionary< int32_t, char *>	datatypes;
 		dictionary< int32_t, char *>	tables;
 
@@ -81,6 +89,15 @@ class SQLRSERVER_DLLSPEC postgresqlconnection : public sqlrserverconnection {
 
 		const char	*identity;
 
+#if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
+		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
+		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
+		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
+		uint32_t			stmtcachesize;
+		dictionary< char *, char * >	stmtcache;
+		uint32_t			stmtcounter;
+#endif
+
 #ifndef HAVE_POSTGRESQL_PQSETNOTICEPROCESSOR
 	private:
 		file	devnull;
@@ -172,6 +189,9 @@ class SQLRSERVER_DLLSPEC postgresqlcursor : public sqlrservercursor {
 		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
 		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
 		void		deallocateNamedStatement();
+		bool		prepareStatement(const char *name,
+							const char *query);
+		bool		prepareFailed();
 #endif
 #if ((defined(HAVE_POSTGRESQL_PQPREPARE) && \
 		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
@@ -200,6 +220,8 @@ class SQLRSERVER_DLLSPEC postgresqlcursor : public sqlrservercursor {
 		char		*cursorid;
 		stringbuffer	deallocatecursorid;
 		bool		allocated;
+		stringbuffer	stmtname;
+		bool		stmtcached;
 		uint16_t	maxbindcount;
 		char		**bindvalues;
 		int		*bindlengths;
@@ -235,6 +257,16 @@ postgresqlconnection::postgresqlconnection(sqlrservercontroller *cont) :
 
 	datatypes.setManageArrayValues(true);
 	tables.setManageArrayValues(true);
+
+#if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
+		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
+		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
+		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
+	stmtcachesize=0;
+	stmtcache.setManageArrayKeys(true);
+	stmtcache.setManageArrayValues(true);
+	stmtcounter=0;
+#endif
 }
 
 postgresqlconnection::~postgresqlconnection() {
@@ -279,6 +311,13 @@ void postgresqlconnection::handleConnectString() {
 		lastinsertidquery=liiquery.detachString();
 	}
 	identity=cont->getConnectStringValue("identity");
+#if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
+		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
+		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
+		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
+	stmtcachesize=charstring::toUnsignedInteger(
+				cont->getConnectStringValue("stmtcachesize"));
+#endif
 
 	// Re-process the fetchatonce parameter.  In the parent class, it ends
 	// up being set to 1 if it was configured to be 0.  However, with
@@ -376,6 +415,35 @@ bool postgresqlconnection::logIn(const char **error,
 	}
 #endif
 
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
+	// if both dictionaries need to be built,
+	// then get them both in one round trip
+	if (typemangling==2 && tablemangling==2 &&
+				PQenterPipelineMode(pgconn)) {
+		PQsendQueryParams(pgconn,"select oid,typname from pg_type",
+						0,NULL,NULL,NULL,NULL,0);
+		PQsendQueryParams(pgconn,"select oid,relname from pg_class",
+						0,NULL,NULL,NULL,NULL,0);
+		PQpipelineSync(pgconn);
+		PGresult	*typeresult=getPipelinedResult();
+		PGresult	*tableresult=getPipelinedResult();
+		bool		synced=endPipeline();
+		if (!synced || !typeresult) {
+			PQclear(typeresult);
+			PQclear(tableresult);
+			*error=logInError("Get datatypes failed");
+			return false;
+		}
+		if (!tableresult) {
+			PQclear(typeresult);
+			*error=logInError("Get tables failed");
+			return false;
+		}
+		buildDictionary(typeresult,&datatypes);
+		buildDictionary(tableresult,&tables);
+	} else {
+#endif
+
 	// build the datatype dictionary
 	if (typemangling==2) {
 		PGresult	*result=PQexec(pgconn,
@@ -384,12 +452,7 @@ bool postgresqlconnection::logIn(const char **error,
 			*error=logInError("Get datatypes failed");
 			return false;
 		}
-		for (int i=0; i<PQntuples(result); i++) {
-			datatypes.setValue(
-				charstring::toInteger(PQgetvalue(result,i,0)),
-				charstring::duplicate(PQgetvalue(result,i,1)));
-		}
-		PQclear(result);
+		buildDictionary(result,&datatypes);
 	}
 
 	// build the table dictionary
@@ -400,13 +463,12 @@ bool postgresqlconnection::logIn(const char **error,
 			*error=logInError("Get tables failed");
 			return false;
 		}
-		for (int i=0; i<PQntuples(result); i++) {
-			tables.setValue(
-				charstring::toInteger(PQgetvalue(result,i,0)),
-				charstring::duplicate(PQgetvalue(result,i,1)));
-		}
-		PQclear(result);
+		buildDictionary(result,&tables);
+	}
+
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
 	}
+#endif
 
 #if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
 		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
@@ -421,6 +483,47 @@ bool postgresqlconnection::logIn(const char **error,
 	return true;
 }
 
+void postgresqlconnection::buildDictionary(PGresult *result,
+					dictionary< int32_t, char *> *dict) {
+	for (int i=0; i<PQntuples(result); i++) {
+		dict->setValue(
+			charstring::toInteger(PQgetvalue(result,i,0)),
+			charstring::duplicate(PQgetvalue(result,i,1)));
+	}
+	PQclear(result);
+}
+
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
+PGresult *postgresqlconnection::getPipelinedResult() {
+
+	// in pipeline mode, the result of each
+	// query is followed by a NULL result
+	PGresult	*result=PQgetResult(pgconn);
+	if (result) {
+		PQgetResult(pgconn);
+	}
+	return result;
+}
+
+bool postgresqlconnection::getPipelineSync() {
+
+	// consume the result of a sync
+	// (unlike query results, it isn't followed by a NULL result)
+	PGresult	*result=PQgetResult(pgconn);
+	bool		synced=(result &&
+			PQresultStatus(result)==PGRES_PIPELINE_SYNC);
+	PQclear(result);
+	return synced;
+}
+
+bool postgresqlconnection::endPipeline() {
+
+	// consume the result of the sync and leave pipeline mode
+	bool	synced=getPipelineSync();
+	return (PQexitPipelineMode(pgconn) && synced);
+}
+#endif
+
 const char *postgresqlconnection::logInError(const char *errmsg) {
 
 	errormessage.clear();
@@ -461,6 +564,14 @@ void postgresqlconnection::logOut() {
 	if (typemangling==2) {
 		tables.clear();
 	}
+
+#if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
+		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
+		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
+		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
+	// prepared statements don't outlive the session
+	stmtcache.clear();
+#endif
 }
 
 void postgresqlconnection::errorMessage(char *errorbuffer,
@@ -747,6 +858,7 @@ postgresqlcursor::postgresqlcursor(sqlrserverconnection *conn, uint16_t id) :
 	charstring::replace(cursorid,'-','_');
 	deallocatecursorid.append("deallocate ")->append(cursorid);
 	allocated=false;
+	stmtcached=false;
 	maxbindcount=conn->cont->getConfig()->getMaxBindCount();
 	bindvalues=new char *[maxbindcount];
 	bytestring::zero(bindvalues,maxbindcount*sizeof(char *));
@@ -800,12 +912,154 @@ bool postgresqlcursor::prepareQuery(const char *query, uint32_t length) {
 	// reset the bind format error flag
 	bindformaterror=false;
 
+	// If this query has already been prepared (by any cursor) during this
+	// session then just reuse that statement.  Otherwise, if there's room
+	// in the statement cache, then prepare it under a new name and cache
+	// it.  Otherwise, prepare it under this cursor's name.
+	//
+	// Cached statements aren't evicted to make room for new ones, because
+	// other cursors may still be executing them.  Once the cache is full,
+	// queries that aren't in it are prepared under the cursor's name, as
+	// if there were no cache.
+	stmtname.clear();
+	stmtcached=false;
+	if (postgresqlconn->stmtcachesize) {
+
+		const char	*cachedname=
+			postgresqlconn->stmtcache.getValue((char *)query);
+		if (cachedname) {
+
+			// deallocate this cursor's named statement
+			deallocateNamedStatement();
+
+#if defined(HAVE_POSTGRESQL_PQDESCRIBEPREPARED)
+			// describe the query (get column info)
+			pgresult=PQdescribePrepared(postgresqlconn->pgconn,
+								cachedname);
+			if (!pgresult) {
+				return false;
+			}
+			if (prepareFailed()) {
+
+				// If the statement no longer exists (eg. the
+				// app ran "deallocate all") then remove it from
+				// the cache and prepare it again, below.
+				const char	*sqlstate=PQresultErrorField(
+							pgresult,
+							PG_DIAG_SQLSTATE);
+				if (charstring::compare(sqlstate,"26000")) {
+					return false;
+				}
+				PQclear(pgresult);
+				pgresult=NULL;
+				postgresqlconn->stmtcache.remove((char *)query);
+				cachedname=NULL;
+			} else {
+				ncols=PQnfields(pgresult);
+			}
+#endif
+		}
+
+		if (cachedname) {
+			stmtname.append(cachedname);
+			stmtcached=true;
+			return true;
+		}
+
+		if (postgresqlconn->stmtcache.getLength()<
+					postgresqlconn->stmtcachesize) {
+
+			char	*name=NULL;
+			charstring::printf(&name,"%s_s%d",
+					conn->cont->getConnectionId(),
+					++(postgresqlconn->stmtcounter));
+			charstring::replace(name,'-','_');
+			stmtname.append(name);
+
+			if (!prepareStatement(stmtname.getString(),query)) {
+				delete[] name;
+				return false;
+			}
+
+			postgresqlconn->stmtcache.setValue(
+					charstring::duplicate(query),name);
+			stmtcached=true;
+			return true;
+		}
+	}
+
+	stmtname.append(cursorid);
+	if (!prepareStatement(cursorid,query)) {
+		return false;
+	}
+	allocated=true;
+	return true;
+}
+
+bool postgresqlcursor::prepareStatement(const char *name, const char *query) {
+
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
+	// If possible, deallocate this cursor's previous statement, prepare
+	// the new one and describe it all in one round trip, rather than
+	// waiting for the result of each before sending the next.
+	PGconn	*pgconn=postgresqlconn->pgconn;
+	if (PQenterPipelineMode(pgconn)) {
+
+		// The deallocate gets its own sync so that, if it fails (eg.
+		// because the app ran "deallocate all"), the server doesn't
+		// abort the prepare and describe along with it.
+		bool	deallocate=allocated;
+		if (deallocate) {
+			PQsendQueryParams(pgconn,
+					deallocatecursorid.getString(),
+					0,NULL,NULL,NULL,NULL,0);
+			PQpipelineSync(pgconn);
+			allocated=false;
+		}
+		PQsendPrepare(pgconn,name,query,0,NULL);
+#if defined(HAVE_POSTGRESQL_PQDESCRIBEPREPARED)
+		PQsendDescribePrepared(pgconn,name);
+#endif
+		PQpipelineSync(pgconn);
+
+		// Get the results.  Whether the deallocate worked or not
+		// doesn't matter, but if the prepare failed then the describe
+		// will just be aborted, so the prepare's result is the one
+		// that matters.
+		if (deallocate) {
+			PQclear(postgresqlconn->getPipelinedResult());
+			postgresqlconn->getPipelineSync();
+		}
+		pgresult=postgresqlconn->getPipelinedResult();
+		bool	result=(pgresult && !prepareFailed());
+#if defined(HAVE_POSTGRESQL_PQDESCRIBEPREPARED)
+		PGresult	*describeresult=
+				postgresqlconn->getPipelinedResult();
+		if (result) {
+			PQclear(pgresult);
+			pgresult=describeresult;
+			result=(pgresult && !prepareFailed());
+		} else {
+			PQclear(describeresult);
+		}
+#endif
+		if (!postgresqlconn->endPipeline()) {
+			result=false;
+		}
+
+		// get the col count
+		if (result) {
+			ncols=PQnfields(pgresult);
+		}
+		return result;
+	}
+#endif
+
 	// deallocate named statement
 	deallocateNamedStatement();
 
 	// prepare the query
-	pgresult=PQprepare(postgresqlconn->pgconn,cursorid,query,0,NULL);
-	allocated=true;
+	pgresult=PQprepare(postgresqlconn->pgconn,name,query,0,NULL);
 
 	// handle some kind of outright failure
 	if (!pgresult) {
@@ -813,13 +1067,7 @@ bool postgresqlcursor::prepareQuery(const char *query, uint32_t length) {
 	}
 
 	// handle errors
-	bool	result=true;
-	pgstatus=PQresultStatus(pgresult);
-	if (pgstatus==PGRES_BAD_RESPONSE ||
-		pgstatus==PGRES_NONFATAL_ERROR ||
-		pgstatus==PGRES_FATAL_ERROR) {
-		result=false;
-	}
+	bool	result=!prepareFailed();
 
 #if defined(HAVE_POSTGRESQL_PQDESCRIBEPREPARED)
 
@@ -833,7 +1081,7 @@ bool postgresqlcursor::prepareQuery(const char *query, uint32_t length) {
 	}
 	
 	// describe the query (get column info)
-	pgresult=PQdescribePrepared(postgresqlconn->pgconn,cursorid);
+	pgresult=PQdescribePrepared(postgresqlconn->pgconn,name);
 
 	// handle some kind of outright failure
 	if (!pgresult) {
@@ -841,13 +1089,7 @@ bool postgresqlcursor::prepareQuery(const char *query, uint32_t length) {
 	}
 
 	// handle errors
-	result=true;
-	pgstatus=PQresultStatus(pgresult);
-	if (pgstatus==PGRES_BAD_RESPONSE ||
-		pgstatus==PGRES_NONFATAL_ERROR ||
-		pgstatus==PGRES_FATAL_ERROR) {
-		result=false;
-	}
+	result=!prepareFailed();
 
 	// get the col count
 	ncols=PQnfields(pgresult);
@@ -856,6 +1098,22 @@ bool postgresqlcursor::prepareQuery(const char *query, uint32_t length) {
 	return result;
 }
 
+bool postgresqlcursor::prepareFailed() {
+	pgstatus=PQresultStatus(pgresult);
+	if (pgstatus==PGRES_BAD_RESPONSE ||
+		pgstatus==PGRES_NONFATAL_ERROR ||
+		pgstatus==PGRES_FATAL_ERROR) {
+		return true;
+	}
+#ifdef HAVE_POSTGRESQL_PQENTERPIPELINEMODE
+	// an earlier query in the same pipeline failed
+	if (pgstatus==PGRES_PIPELINE_ABORTED) {
+		return true;
+	}
+#endif
+	return false;
+}
+
 bool postgresqlcursor::inputBind(const char *variable, 
 					uint16_t variablesize,
 					const char *value, 
@@ -1062,7 +1320,7 @@ bool postgresqlcursor::executeQuery(const char *query, uint32_t length) {
 		int	result=1;
 		if (bindcounter) {
 			result=PQsendQueryPrepared(postgresqlconn->pgconn,
-						cursorid,
+						stmtname.getString(),
 						bindcounter,bindvalues,
 						bindlengths,bindformats,0);
 			bindcounter=0;
@@ -1090,7 +1348,8 @@ bool postgresqlcursor::executeQuery(const char *query, uint32_t length) {
 #if defined(HAVE_POSTGRESQL_PQPREPARE) && \
 	defined(HAVE_POSTGRESQL_PQEXECPREPARED)
 		if (bindcounter) {
-			pgresult=PQexecPrepared(postgresqlconn->pgconn,cursorid,
+			pgresult=PQexecPrepared(postgresqlconn->pgconn,
+						stmtname.getString(),
 						bindcounter,bindvalues,
 						bindlengths,bindformats,0);
 			bindcounter=0;
@@ -1117,6 +1376,24 @@ bool postgresqlcursor::executeQuery(const char *query, uint32_t length) {
 	if (pgstatus==PGRES_BAD_RESPONSE ||
 		pgstatus==PGRES_NONFATAL_ERROR ||
 		pgstatus==PGRES_FATAL_ERROR) {
+#if (defined(HAVE_POSTGRESQL_PQPREPARE) && \
+		defined(HAVE_POSTGRESQL_PQEXECPREPARED)) || \
+		(defined(HAVE_POSTGRESQL_PQSENDQUERYPREPARED) && \
+		defined(HAVE_POSTGRESQL_PQSETSINGLEROWMODE))
+		// If a cached statement no longer exists (eg. the app ran
+		// "deallocate all") or can't be used any more (eg. a table
+		// that it depends on was altered) then remove it from the
+		// cache so the next attempt to run the query re-prepares it.
+		if (stmtcached) {
+			const char	*sqlstate=PQresultErrorField(pgresult,
+							PG_DIAG_SQLSTATE);
+			if (!charstring::compare(sqlstate,"26000") ||
+				!charstring::compare(sqlstate,"0A000")) {
+				postgresqlconn->stmtcache.remove((char *)query);
+				stmtcached=false;
+			}
+		}
+#endif
 		return false;
 	}
 
@@ -6,6 +6,8 @@
 #include <rudiments/character.h>
 #include <rudiments/snooze.h>
 #include <rudiments/regularexpression.h>
+#include <rudiments/thread.h>
+#include <rudiments/process.h>
 
 #include <datatypes.h>
 #include <defines.h>
@@ -41,6 +43,32 @@ struct cursorbindvar {
 	sqlrservercursor	*cursor;
 };
 
+enum routeroperation {
+	ROUTEROP_NONE=0,
+	ROUTEROP_AUTOCOMMITON,
+	ROUTEROP_AUTOCOMMITOFF,
+	ROUTEROP_BEGIN,
+	ROUTEROP_COMMIT,
+	ROUTEROP_ROLLBACK,
+	ROUTEROP_PING,
+	ROUTEROP_ENDSESSION,
+	ROUTEROP_PREPARETRANSACTION,
+	ROUTEROP_COMMITPREPARED,
+	ROUTEROP_ROLLBACKPREPARED
+};
+
+class routerconnection;
+
+struct routerjob {
+	routerconnection	*conn;
+	uint16_t		index;
+	routeroperation		op;
+	bool			afterlogin;
+	bool			result;
+	stringbuffer		error;
+	thread			thr;
+};
+
 class routercursor;
 
 class SQLRSERVER_DLLSPEC routerconnection : public sqlrserverconnection {
@@ -88,6 +116,15 @@ class SQLRSERVER_DLLSPEC routerconnection : public sqlrserverconnection {
 
 		void	route(bool *routed, bool *err);
 
+		bool	fanOut(routeroperation op, const bool *mask);
+		static void	fanOutThread(void *attr);
+		bool	runOperation(routerjob *job);
+		bool	sendTwoPhaseQuery(routerjob *job,
+						const char *command);
+		bool	twoPhaseCommit();
+		void	markTouched(sqlrconnection *con);
+		void	resetTouched();
+
 		void	autoCommitOnFailed(uint16_t index);
 		void	autoCommitOffFailed(uint16_t index);
 		void	beginFailed(uint16_t index);
@@ -104,6 +141,18 @@ class SQLRSERVER_DLLSPEC routerconnection : public sqlrserverconnection {
 		const char	**beginquery;
 		bool		anymustbegin;
 
+		bool		parallel;
+		bool		twophasecommit;
+		bool		*supportstwophase;
+		bool		*touched;
+		bool		*prepared;
+		routerjob	*jobs;
+		bool		autocommit;
+		bool		intransaction;
+		char		*gid;
+		uint64_t	gidsequence;
+		stringbuffer	twophaseerror;
+
 		sqlrconnection	*currentcon;
 		uint16_t	currentconindex;
 
@@ -285,6 +334,16 @@ routerconnection::routerconnection(sqlrservercontroller *cont) :
 	currentconindex=0;
 	beginquery=NULL;
 	anymustbegin=false;
+	parallel=false;
+	twophasecommit=false;
+	supportstwophase=NULL;
+	touched=NULL;
+	prepared=NULL;
+	jobs=NULL;
+	autocommit=true;
+	intransaction=false;
+	gid=NULL;
+	gidsequence=0;
 	justloggedin=false;
 	nullbindvalue=nullBindValue();
 	nonnullbindvalue=nonNullBindValue();
@@ -302,6 +361,11 @@ routerconnection::~routerconnection() {
 	delete[] conids;
 	delete[] cons;
 	delete[] beginquery;
+	delete[] supportstwophase;
+	delete[] touched;
+	delete[] prepared;
+	delete[] jobs;
+	delete[] gid;
 	routercursors.clear();
 	delete sqlrr;
 }
@@ -325,6 +389,16 @@ void routerconnection::handleConnectString() {
 	cont->setMaxColumnCount(0);
 	cont->setMaxFieldLength(0);
 
+	// Run commit, rollback, etc. on all of the connections at once, rather
+	// than one after another, unless told not to.
+	parallel=(thread::supported() &&
+			charstring::compare(
+				cont->getConnectStringValue("fanout"),
+				"serial"));
+
+	// use two-phase commit across connections that support it?
+	twophasecommit=charstring::isYes(
+			cont->getConnectStringValue("twophasecommit"));
 
 	// build the connections that we'll route to
 	// (this is just a convenient place to do it)
@@ -336,6 +410,10 @@ void routerconnection::handleConnectString() {
 	cons=new sqlrconnection *[concount];
 	beginquery=new const char *[concount];
 	anymustbegin=false;
+	supportstwophase=new bool[concount];
+	touched=new bool[concount];
+	prepared=new bool[concount];
+	jobs=new routerjob[concount];
 
 	uint16_t index=0;
 	connectstringnode	*csln=cslist->getFirst();
@@ -372,6 +450,17 @@ void routerconnection::handleConnectString() {
 			anymustbegin=true;
 		}
 
+		// PostgreSQL supports prepare transaction/commit prepared
+		supportstwophase[index]=
+				!charstring::compare(id,"postgresql");
+		touched[index]=false;
+		prepared[index]=false;
+		jobs[index].conn=this;
+		jobs[index].index=index;
+		jobs[index].op=ROUTEROP_NONE;
+		jobs[index].afterlogin=false;
+		jobs[index].result=true;
+
 		index++;
 		csln=csln->getNext();
 	}
@@ -442,41 +531,9 @@ bool routerconnection::autoCommitOn() {
 
 	// otherwise, turn autocommit on for all connections,
 	// if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->autoCommitOn();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			autoCommitOnFailed(index);
-		}
-		// The connection class calls autoCommitOn or autoCommitOff
-		// immediately after logging in, which will cause the 
-		// cons to connect to the relay's and tie them up unless we
-		// call endSession.  We'd rather not tie them up until a
-		// client connects, so if we just logged in, we'll call
-		// endSession.
-		if (justloggedin) {
-			// if any of the connections must begin transactions,
-			// then those connections will start off in auto-commit
-			// mode no matter what, so put all connections in
-			// autocommit mode
-			// (this is a convenient place to do this...)
-			if (anymustbegin) {
-				cons[index]->autoCommitOn();
-			}
-			cons[index]->endSession();
-		}
-		if (result) {
-			result=res;
-		}
+	bool	result=fanOut(ROUTEROP_AUTOCOMMITON,NULL);
+	if (result) {
+		autocommit=true;
 	}
 
 	if (debug) {
@@ -516,44 +573,11 @@ bool routerconnection::autoCommitOff() {
 		return (currentcon)?currentcon->autoCommitOff():true;
 	}
 
-	// otherwise, turn autocommit on for all connections,
+	// otherwise, turn autocommit off for all connections,
 	// if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->autoCommitOff();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			autoCommitOffFailed(index);
-		}
-		// The connection class calls autoCommitOn or autoCommitOff
-		// immediately after logging in, which will cause the 
-		// cons to connect to the relay's and tie them up unless we
-		// call endSession.  We'd rather not tie them up until a
-		// client connects, so if we just logged in, we'll call
-		// endSession.
-		if (justloggedin) {
-			// if any of the connections must begin transactions,
-			// then those connections will start off in auto-commit
-			// mode no matter what, so put all connections in
-			// autocommit mode, even if autocommit-off is called
-			// here
-			// (this is a convenient place to do this...)
-			if (anymustbegin) {
-				cons[index]->autoCommitOn();
-			}
-			cons[index]->endSession();
-		}
-		if (result) {
-			result=res;
-		}
+	bool	result=fanOut(ROUTEROP_AUTOCOMMITOFF,NULL);
+	if (result) {
+		autocommit=false;
 	}
 
 	if (debug) {
@@ -583,6 +607,9 @@ bool routerconnection::begin() {
 		return false;
 	}
 
+	// let the router modules know about the transaction
+	sqlrr->beginTransaction();
+
 	// if routing entire sessions, then just begin for
 	// the appropriate connection
 	if (routed && routeentiresession) {
@@ -594,24 +621,9 @@ bool routerconnection::begin() {
 	}
 
 	// otherwise, begin all connections, if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->begin();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			beginFailed(index);
-		}
-		if (result) {
-			result=res;
-		}
+	bool	result=fanOut(ROUTEROP_BEGIN,NULL);
+	if (result) {
+		intransaction=true;
 	}
 
 	if (debug) {
@@ -637,6 +649,9 @@ bool routerconnection::commit() {
 		return false;
 	}
 
+	// let the router modules know about the transaction
+	sqlrr->endTransaction(true);
+
 	// if routing entire sessions, then just commit for
 	// the appropriate connection
 	if (routed && routeentiresession) {
@@ -647,26 +662,13 @@ bool routerconnection::commit() {
 		return (currentcon)?currentcon->commit():true;
 	}
 
-	// otherwise, commit all connections, if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->commit();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			commitFailed(index);
-		}
-		if (result) {
-			result=res;
-		}
-	}
+	// otherwise, commit all connections, if any fail, return failure,
+	// using two-phase commit if more than one connection was used
+	bool	result=(twophasecommit && (!autocommit || intransaction))?
+				twoPhaseCommit():
+				fanOut(ROUTEROP_COMMIT,NULL);
+	intransaction=false;
+	resetTouched();
 
 	if (debug) {
 		stdoutput.printf("}\n");
@@ -691,6 +693,9 @@ bool routerconnection::rollback() {
 		return false;
 	}
 
+	// let the router modules know about the transaction
+	sqlrr->endTransaction(false);
+
 	// if routing entire sessions, then just rollback for
 	// the appropriate connection
 	if (routed && routeentiresession) {
@@ -702,25 +707,9 @@ bool routerconnection::rollback() {
 	}
 
 	// otherwise, rollback all connections, if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->rollback();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			rollbackFailed(index);
-		}
-		if (result) {
-			result=res;
-		}
-	}
+	bool	result=fanOut(ROUTEROP_ROLLBACK,NULL);
+	intransaction=false;
+	resetTouched();
 
 	if (debug) {
 		stdoutput.printf("}\n");
@@ -734,9 +723,20 @@ void routerconnection::errorMessage(char *errorbuffer,
 					int64_t *errorcode,
 					bool *liveconnection) {
 
+	// errors from two-phase commit queries are on cursors,
+	// rather than on the connections
+	if (twophaseerror.getSize()) {
+		*errorlength=twophaseerror.getSize();
+		charstring::safeCopy(errorbuffer,errorbufferlength,
+					twophaseerror.getString(),*errorlength);
+		*errorcode=0;
+		*liveconnection=true;
+		return;
+	}
+
 	for (uint16_t index=0; index<concount; index++) {
 		const char	*errormessage=cons[index]->errorMessage();
-		if (!charstring::length(errormessage)) {
+		if (charstring::length(errormessage)) {
 			*errorlength=charstring::length(errormessage);
 			charstring::safeCopy(errorbuffer,errorbufferlength,
 						errormessage,*errorlength);
@@ -954,22 +954,7 @@ bool routerconnection::ping() {
 	}
 
 	// ping all connections, if any fail, return failure
-	bool	result=true;
-	for (uint16_t index=0; index<concount; index++) {
-
-		if (debug) {
-			stdoutput.printf("	executing on: %s\n",
-							conids[index]);
-		}
-
-		bool	res=cons[index]->ping();
-		if (!res) {
-			if (debug) {
-				stdoutput.printf("	failed\n");
-			}
-			result=res;
-		}
-	}
+	bool	result=fanOut(ROUTEROP_PING,NULL);
 
 	if (debug) {
 		stdoutput.printf("}\n");
@@ -1026,14 +1011,10 @@ void routerconnection::endSession() {
 	} else {
 
 		// otherwise end-session on all connections
-		for (uint16_t index=0; index<concount; index++) {
-			if (debug) {
-				stdoutput.printf("	executing on: %s\n",
-								conids[index]);
-			}
-			cons[index]->endSession();
-		}
+		fanOut(ROUTEROP_ENDSESSION,NULL);
 	}
+	intransaction=false;
+	resetTouched();
 
 	// reset pointers and index
 	currentcon=NULL;
@@ -1045,6 +1026,7 @@ void routerconnection::endSession() {
 		rcur->currentcur=NULL;
 	}
 	sqlrr->setCurrentConnectionId(NULL);
+	sqlrr->endSession();
 
 	if (debug) {
 		stdoutput.printf("}\n");
@@ -1060,6 +1042,7 @@ void routerconnection::route(bool *routed, bool *err) {
 	// initialize return values
 	*err=false;
 	*routed=false;
+	twophaseerror.clear();
 
 	// bail if we're routing the entire session
 	// and we already have a currentcon
@@ -1125,6 +1108,290 @@ void routerconnection::route(bool *routed, bool *err) {
 	}
 }
 
+bool routerconnection::fanOut(routeroperation op, const bool *mask) {
+
+	twophaseerror.clear();
+
+	// set up the jobs
+	uint16_t	jobcount=0;
+	for (uint16_t index=0; index<concount; index++) {
+		jobs[index].op=(!mask || mask[index])?op:ROUTEROP_NONE;
+		jobs[index].afterlogin=justloggedin;
+		jobs[index].result=true;
+		jobs[index].error.clear();
+		if (jobs[index].op!=ROUTEROP_NONE) {
+			if (debug) {
+				stdoutput.printf("	executing on: %s\n",
+								conids[index]);
+			}
+			jobcount++;
+		}
+	}
+
+	// Each sqlrconnection has its own socket, so they can all be used at
+	// once, as long as each is only used by one thread.  Spawn a thread
+	// for all but the first job and run the first job in this thread.
+	// If a thread can't be spawned, then just run its job here.
+	bool	*spawned=NULL;
+	if (parallel && jobcount>1) {
+		spawned=new bool[concount];
+		bool	first=true;
+		for (uint16_t index=0; index<concount; index++) {
+			spawned[index]=false;
+			if (jobs[index].op==ROUTEROP_NONE) {
+				continue;
+			}
+			if (first) {
+				first=false;
+				continue;
+			}
+			spawned[index]=jobs[index].thr.spawn(
+					(void *(*)(void *))fanOutThread,
+					(void *)&jobs[index],false);
+		}
+	}
+	for (uint16_t index=0; index<concount; index++) {
+		if (jobs[index].op!=ROUTEROP_NONE &&
+				(!spawned || !spawned[index])) {
+			runOperation(&jobs[index]);
+		}
+	}
+	if (spawned) {
+		for (uint16_t index=0; index<concount; index++) {
+			if (spawned[index]) {
+				jobs[index].thr.join(NULL);
+			}
+		}
+		delete[] spawned;
+	}
+
+	// collect the results
+	bool	result=true;
+	for (uint16_t index=0; index<concount; index++) {
+		if (jobs[index].result) {
+			continue;
+		}
+		if (debug) {
+			stdoutput.printf("	failed on: %s\n",conids[index]);
+		}
+		// only the first error is reported
+		if (!twophaseerror.getSize() && jobs[index].error.getSize()) {
+			twophaseerror.append(conids[index])->append(": ");
+			twophaseerror.append(jobs[index].error.getString());
+		}
+		switch (op) {
+			case ROUTEROP_AUTOCOMMITON:
+				autoCommitOnFailed(index);
+				break;
+			case ROUTEROP_AUTOCOMMITOFF:
+				autoCommitOffFailed(index);
+				break;
+			case ROUTEROP_BEGIN:
+				beginFailed(index);
+				break;
+			case ROUTEROP_COMMIT:
+			case ROUTEROP_COMMITPREPARED:
+				commitFailed(index);
+				break;
+			case ROUTEROP_ROLLBACK:
+				rollbackFailed(index);
+				break;
+			default:
+				break;
+		}
+		result=false;
+	}
+	return result;
+}
+
+void routerconnection::fanOutThread(void *attr) {
+	routerjob	*job=(routerjob *)attr;
+	job->conn->runOperation(job);
+}
+
+bool routerconnection::runOperation(routerjob *job) {
+
+	sqlrconnection	*con=cons[job->index];
+
+	switch (job->op) {
+		case ROUTEROP_AUTOCOMMITON:
+			job->result=con->autoCommitOn();
+			break;
+		case ROUTEROP_AUTOCOMMITOFF:
+			job->result=con->autoCommitOff();
+			break;
+		case ROUTEROP_BEGIN:
+			job->result=con->begin();
+			break;
+		case ROUTEROP_COMMIT:
+			job->result=con->commit();
+			break;
+		case ROUTEROP_ROLLBACK:
+			job->result=con->rollback();
+			break;
+		case ROUTEROP_PING:
+			job->result=con->ping();
+			break;
+		case ROUTEROP_ENDSESSION:
+			con->endSession();
+			job->result=true;
+			break;
+		case ROUTEROP_PREPARETRANSACTION:
+			job->result=sendTwoPhaseQuery(job,
+							"prepare transaction");
+			break;
+		case ROUTEROP_COMMITPREPARED:
+			job->result=sendTwoPhaseQuery(job,
+							"commit prepared");
+			break;
+		case ROUTEROP_ROLLBACKPREPARED:
+			job->result=sendTwoPhaseQuery(job,
+							"rollback prepared");
+			break;
+		default:
+			job->result=true;
+			break;
+	}
+
+	// The connection class calls autoCommitOn or autoCommitOff
+	// immediately after logging in, which will cause the 
+	// cons to connect to the relay's and tie them up unless we
+	// call endSession.  We'd rather not tie them up until a
+	// client connects, so if we just logged in, we'll call
+	// endSession.
+	if (job->afterlogin && (job->op==ROUTEROP_AUTOCOMMITON ||
+				job->op==ROUTEROP_AUTOCOMMITOFF)) {
+		// if any of the connections must begin transactions,
+		// then those connections will start off in auto-commit
+		// mode no matter what, so put all connections in
+		// autocommit mode
+		// (this is a convenient place to do this...)
+		if (anymustbegin) {
+			con->autoCommitOn();
+		}
+		con->endSession();
+	}
+	return job->result;
+}
+
+bool routerconnection::sendTwoPhaseQuery(routerjob *job,
+						const char *command) {
+	stringbuffer	query;
+	query.append(command)->append(" '")->append(gid)->append("'");
+	sqlrcursor	cur(cons[job->index]);
+	if (cur.sendQuery(query.getString())) {
+		return true;
+	}
+	// This may run in a fan-out thread, so the error is kept with the
+	// job and fanOut() picks the one to report after joining them.
+	job->error.append(cur.errorMessage());
+	return false;
+}
+
+bool routerconnection::twoPhaseCommit() {
+
+	// figure out which connections to prepare, and which
+	// connections that were used in the transaction can't be prepared
+	uint16_t	touchedcount=0;
+	uint16_t	preparecount=0;
+	int32_t		lastresource=-1;
+	uint16_t	lastresourcecount=0;
+	for (uint16_t index=0; index<concount; index++) {
+		prepared[index]=(touched[index] && supportstwophase[index]);
+		if (touched[index]) {
+			touchedcount++;
+		}
+		if (prepared[index]) {
+			preparecount++;
+		} else if (touched[index]) {
+			lastresource=index;
+			lastresourcecount++;
+		}
+	}
+
+	// if only one connection was used, or none of them
+	// can be prepared, then just commit them all
+	if (touchedcount<2 || !preparecount) {
+		if (debug && touchedcount>1) {
+			stdoutput.printf("	no connections "
+					"support two-phase commit\n");
+		}
+		return fanOut(ROUTEROP_COMMIT,NULL);
+	}
+
+	delete[] gid;
+	charstring::printf(&gid,"sqlr-%s-%ld-%lld",
+				cont->getId(),(long)process::getProcessId(),
+				(long long)gidsequence++);
+	if (debug) {
+		stdoutput.printf("	two-phase commit: %s\n",gid);
+	}
+
+	// phase 1: prepare, and if any can't be prepared, roll everything back
+	if (!fanOut(ROUTEROP_PREPARETRANSACTION,prepared)) {
+		stringbuffer	error;
+		error.append(twophaseerror.getString());
+		bool	*rollbackprepared=new bool[concount];
+		bool	*rollbackother=new bool[concount];
+		for (uint16_t index=0; index<concount; index++) {
+			rollbackprepared[index]=
+				(prepared[index] && jobs[index].result);
+			rollbackother[index]=!rollbackprepared[index];
+		}
+		fanOut(ROUTEROP_ROLLBACKPREPARED,rollbackprepared);
+		fanOut(ROUTEROP_ROLLBACK,rollbackother);
+		delete[] rollbackprepared;
+		delete[] rollbackother;
+		twophaseerror.clear();
+		twophaseerror.append(error.getString());
+		return false;
+	}
+
+	// Commit everything that wasn't prepared.  If exactly one connection
+	// that was used in the transaction couldn't be prepared, then it
+	// decides the outcome.  If it fails to commit, then roll back the
+	// prepared transactions.
+	bool	*other=new bool[concount];
+	for (uint16_t index=0; index<concount; index++) {
+		other[index]=!prepared[index];
+	}
+	bool	result=fanOut(ROUTEROP_COMMIT,other);
+	if (lastresourcecount==1) {
+		if (!result && !jobs[lastresource].result) {
+			stringbuffer	error;
+			error.append(twophaseerror.getString());
+			fanOut(ROUTEROP_ROLLBACKPREPARED,prepared);
+			twophaseerror.clear();
+			twophaseerror.append(error.getString());
+			delete[] other;
+			return false;
+		}
+	}
+	// (with more than one, the outcome can't be guaranteed)
+	delete[] other;
+
+	// phase 2: commit the prepared transactions
+	if (!fanOut(ROUTEROP_COMMITPREPARED,prepared)) {
+		result=false;
+	}
+	return result;
+}
+
+void routerconnection::markTouched(sqlrconnection *con) {
+	for (uint16_t index=0; index<concount; index++) {
+		if (cons[index]==con) {
+			touched[index]=true;
+			return;
+		}
+	}
+}
+
+void routerconnection::resetTouched() {
+	for (uint16_t index=0; index<concount; index++) {
+		touched[index]=false;
+	}
+}
+
 void routerconnection::autoCommitOnFailed(uint16_t index) {
 	raiseIntegrityViolationEvent("autocommit-on",index);
 }
@@ -1594,6 +1861,9 @@ bool routercursor::executeQuery(const char *query, uint32_t length) {
 	}
 
 	if (!emptyquery) {
+		// keep track of which connections are used in the
+		// transaction, for two-phase commit
+		routerconn->markTouched(currentcon);
 		if (!currentcur->executeQuery()) {
 			return false;
 		}
@@ -27,6 +27,13 @@ extern "C" {
 	#define sqlite3_free(mem)		sqlite_free((char *)mem)
 #endif
 
+// every version of sqlite3 has the statement api, so always step through
+// result sets row by row rather than buffering the entire result set in
+// memory with sqlite3_get_table, even if the configure test couldn't tell
+#if defined(SQLITE3) && !defined(HAVE_SQLITE3_STMT)
+	#define HAVE_SQLITE3_STMT 1
+#endif
+
 #ifndef HAVE_SQLITE3_MALLOC
 	#include <stdlib.h>
 	#define sqlite3_malloc			malloc
@@ -40,6 +47,10 @@ class SQLRSERVER_DLLSPEC sqliteconnection : public sqlrserverconnection {
 	private:
 		void		handleConnectString();
 		bool		logIn(const char **error, const char **warning);
+		#ifdef SQLITE3
+		bool		openDatabase();
+		bool		configureDatabase();
+		#endif
 		sqlrservercursor	*newCursor(uint16_t id);
 		void		deleteCursor(sqlrservercursor *curs);
 		void		logOut();
@@ -81,6 +92,12 @@ class SQLRSERVER_DLLSPEC sqliteconnection : public sqlrserverconnection {
 
 		const char	*identity;
 
+		const char	*journalmode;
+		int64_t		mmapsize;
+		bool		sharedcache;
+		bool		readonly;
+		int32_t		busytimeout;
+
 		#ifdef SQLITE3
 		sqlite3	*sqliteptr;
 		#else
@@ -175,6 +192,11 @@ class SQLRSERVER_DLLSPEC sqlitecursor : public sqlrservercursor {
 sqliteconnection::sqliteconnection(sqlrservercontroller *cont) :
 					sqlrserverconnection(cont) {
 	identity=NULL;
+	journalmode=NULL;
+	mmapsize=-1;
+	sharedcache=false;
+	readonly=false;
+	busytimeout=0;
 	sqliteptr=NULL;
 	errmesg=NULL;
 	errcode=0;
@@ -192,6 +214,19 @@ void sqliteconnection::handleConnectString() {
 	db=charstring::duplicate(cont->getConnectStringValue("db"));
 	identity=cont->getConnectStringValue("identity");
 
+	// wal/mmap/shared-cache/read-only options
+	journalmode=cont->getConnectStringValue("journalmode");
+	const	char	*mmapsizestr=cont->getConnectStringValue("mmapsize");
+	if (!charstring::isNullOrEmpty(mmapsizestr)) {
+		mmapsize=charstring::toInteger(mmapsizestr);
+	}
+	sharedcache=charstring::isYes(
+			cont->getConnectStringValue("sharedcache"));
+	readonly=charstring::isYes(
+			cont->getConnectStringValue("readonly"));
+	busytimeout=charstring::toInteger(
+			cont->getConnectStringValue("busytimeout"));
+
 	cont->setFetchAtOnce(1);
 	cont->setMaxColumnCount(0);
 	cont->setMaxFieldLength(0);
@@ -200,11 +235,9 @@ void sqliteconnection::handleConnectString() {
 bool sqliteconnection::logIn(const char **error, const char **warning) {
 #ifdef SQLITE_TRANSACTIONAL
 	#ifdef SQLITE3
-		if (sqlite3_open(db,&sqliteptr)==SQLITE_OK) {
+		if (openDatabase()) {
 			return true;
 		}
-		errmesg=duplicate(sqlite3_errmsg(sqliteptr));
-		errcode=sqlite3_errcode(sqliteptr);
 	#else
 		if ((sqliteptr=sqlite3_open(db,666,&errmesg))) {
 			return true;
@@ -219,6 +252,86 @@ bool sqliteconnection::logIn(const char **error, const char **warning) {
 #endif
 }
 
+#ifdef SQLITE3
+bool sqliteconnection::openDatabase() {
+
+	clearErrors();
+
+	#ifdef HAVE_SQLITE3_OPEN_V2
+	// read-only handles can all read concurrently with one writer (when
+	// the database is in wal mode) and a shared cache lets the cursors of
+	// this connection share a single page cache
+	int	flags=(readonly)?SQLITE_OPEN_READONLY:
+				(SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE);
+	if (sharedcache) {
+		flags|=SQLITE_OPEN_SHAREDCACHE;
+	}
+	int	res=sqlite3_open_v2(db,&sqliteptr,flags,NULL);
+	#else
+	int	res=sqlite3_open(db,&sqliteptr);
+	#endif
+	if (res!=SQLITE_OK || !configureDatabase()) {
+		if (!errmesg) {
+			errmesg=duplicate(sqlite3_errmsg(sqliteptr));
+			errcode=sqlite3_errcode(sqliteptr);
+		}
+		sqlite3_close(sqliteptr);
+		sqliteptr=NULL;
+		return false;
+	}
+	return true;
+}
+
+bool sqliteconnection::configureDatabase() {
+
+	// wait for locks held by other connections rather than
+	// failing immediately with SQLITE_BUSY
+	if (busytimeout>0) {
+		sqlite3_busy_timeout(sqliteptr,busytimeout);
+	}
+
+	stringbuffer	pragma;
+
+	#ifndef HAVE_SQLITE3_OPEN_V2
+	// fall back to refusing writes
+	if (readonly) {
+		pragma.append("pragma query_only=1;");
+	}
+	#endif
+
+	// the journal mode is persistent, and changing it requires a write,
+	// so don't bother for read-only handles
+	if (!charstring::isNullOrEmpty(journalmode) && !readonly) {
+		pragma.append("pragma journal_mode=");
+		pragma.append(journalmode)->append(';');
+	}
+
+	// memory-mapped i/o lets every connection daemon read pages directly
+	// out of the os page cache rather than copying them into a private
+	// page cache of their own
+	if (mmapsize>=0) {
+		pragma.append("pragma mmap_size=");
+		pragma.append(mmapsize)->append(';');
+	}
+
+	if (!pragma.getSize()) {
+		return true;
+	}
+
+	char	*err=NULL;
+	if (sqlite3_exec(sqliteptr,pragma.getString(),
+					NULL,NULL,&err)==SQLITE_OK) {
+		return true;
+	}
+	errcode=sqlite3_errcode(sqliteptr);
+	if (err) {
+		errmesg=duplicate(err);
+		sqlite3_free(err);
+	}
+	return false;
+}
+#endif
+
 sqlrservercursor *sqliteconnection::newCursor(uint16_t id) {
 	return (sqlrservercursor *)new sqlitecursor(
 					(sqlrserverconnection *)this,id);
@@ -648,12 +761,7 @@ bool sqlitecursor::executeQuery(const char *query, uint32_t length) {
 		sqlite3_close(sqliteconn->sqliteptr);
 	}
 	#ifdef SQLITE3
-	if (sqlite3_open(sqliteconn->db,&(sqliteconn->sqliteptr))!=SQLITE_OK) {
-		sqliteconn->errmesg=
-			sqliteconn->duplicate(
-				sqlite3_errmsg(sqliteconn->sqliteptr));
-		sqliteconn->errcode=
-			sqlite3_errcode(sqliteconn->sqliteptr);
+	if (!sqliteconn->openDatabase()) {
 		return false;
 	}
 	#else
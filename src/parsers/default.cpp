@@ -3,10 +3,41 @@
 
 #include <sqlrelay/sqlrserver.h>
 
+class SQLRSERVER_DLLSPEC sqlrparser_default : public sqlrparser {
+	public:
+			sqlrparser_default(sqlrservercontroller *cont,
+						domnode *parameters);
+
+		bool	tokenize(const char *query,
+					uint32_t length,
+					sqlrparsedquery *result);
+	private:
+		bool	backslashescapes;
+};
+
+sqlrparser_default::sqlrparser_default(sqlrservercontroller *cont,
+						domnode *parameters) :
+						sqlrparser(cont,parameters) {
+
+	// mysql treats backslashes in strings as escapes by default,
+	// other databases don't
+	const char	*val=parameters->getAttributeValue("backslashescapes");
+	backslashescapes=(charstring::isNullOrEmpty(val))?
+				!charstring::compare(cont->identify(),"mysql"):
+				charstring::isYes(val);
+}
+
+bool sqlrparser_default::tokenize(const char *query,
+					uint32_t length,
+					sqlrparsedquery *result) {
+	result->setBackslashEscapes(backslashescapes);
+	return result->parse(query,length);
+}
+
 extern "C" {
 	SQLRSERVER_DLLSPEC sqlrparser *new_sqlrparser_default(
 						sqlrservercontroller *cont,
 						domnode *parameters) {
-		return new sqlrparser(cont,parameters);
+		return new sqlrparser_default(cont,parameters);
 	}
 }
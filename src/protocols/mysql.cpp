@@ -5012,7 +5012,7 @@ void sqlrprotocol_mysql::bindParameters(sqlrservercursor *cursor,
 }
 
 void sqlrprotocol_mysql::clearParams(sqlrservercursor *cursor) {
-	cont->getBindPool(cursor)->clear();
+	cont->clearBindPool(cursor);
 	cont->setInputBindCount(cursor,0);
 }
 
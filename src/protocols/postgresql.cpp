@@ -1258,7 +1258,7 @@ bool sqlrprotocol_postgresql::query() {
 	}
 
 	// clear binds
-	cont->getBindPool(cursor)->clear();
+	cont->clearBindPool(cursor);
 	cont->setInputBindCount(cursor,0);
 
 	// there could be multiple queries, process them individually...
@@ -1999,7 +1999,7 @@ bool sqlrprotocol_postgresql::parse() {
 	cont->setQueryLength(cursor,querylength);
 
 	// clear binds
-	cont->getBindPool(cursor)->clear();
+	cont->clearBindPool(cursor);
 	cont->setInputBindCount(cursor,0);
 
 	// prepare the query
@@ -18,6 +18,15 @@
 #include <defaults.h>
 #include <defines.h>
 
+#define MAX_BYTES_PER_CHAR	4
+
+// bounds on the size of the segments that lobs are sent in
+#define MIN_LOB_SEGMENT_SIZE	32768
+#define MAX_LOB_SEGMENT_SIZE	1048576
+
+// the most lob data to include in debug/log messages
+#define MAX_LOB_DEBUG_LENGTH	1024
+
 enum sqlrclientquerytype_t {
 	SQLRCLIENTQUERYTYPE_QUERY=0,
 	SQLRCLIENTQUERYTYPE_DATABASE_LIST,
@@ -43,11 +52,17 @@ class SQLRSERVER_DLLSPEC sqlrprotocol_sqlrclient : public sqlrprotocol {
 		clientsessionexitstatus_t	clientSession(
 							filedescriptor *cs);
 
+		bool	supportsSessionPooling();
+		void	getSessionState(bytebuffer *state);
+		void	setSessionState(const unsigned char *state,
+							size_t statelength);
+
 	private:
 		bool	acceptSecurityContext();
 		bool	getCommand(uint16_t *command);
 		sqlrservercursor	*getCursor(uint16_t command);
-		void	noAvailableCursors(uint16_t command);
+		bool	noAvailableCursors(uint16_t command);
+		void	flushWriteBuffer();
 		bool	authCommand();
 		bool	getUserFromClient();
 		bool	getPasswordFromClient();
@@ -159,6 +174,7 @@ class SQLRSERVER_DLLSPEC sqlrprotocol_sqlrclient : public sqlrprotocol {
 		void	sendField(const char *data, uint32_t size);
 		void	sendNullField();
 		void	sendLobField(sqlrservercursor *cursor, uint32_t col);
+		void	sizeLobBuffer(uint64_t loblength);
 		void	startSendingLong(uint64_t longlength);
 		void	sendLongSegment(const char *data, uint32_t size);
 		void	endSendingLong();
@@ -233,10 +249,14 @@ class SQLRSERVER_DLLSPEC sqlrprotocol_sqlrclient : public sqlrprotocol {
 		uint64_t	fetch;
 		bool		lazyfetch;
 
-		char		lobbuffer[32768];
+		char		*lobbuffer;
+		uint32_t	lobbuffersize;
+		uint64_t	lobdebuglength;
 
 		uint16_t	protocolversion;
 		uint16_t	endresultset;
+
+		bool		pipelining;
 };
 
 sqlrprotocol_sqlrclient::sqlrprotocol_sqlrclient(
@@ -270,11 +290,17 @@ sqlrprotocol_sqlrclient::sqlrprotocol_sqlrclient(
 
 	protocolversion=0;
 	endresultset=END_RESULT_SET;
+	pipelining=false;
+
+	lobbuffer=NULL;
+	lobbuffersize=0;
+	lobdebuglength=0;
 }
 
 sqlrprotocol_sqlrclient::~sqlrprotocol_sqlrclient() {
 	debugFunction();
 	delete[] clientinfo;
+	delete[] lobbuffer;
 }
 
 clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
@@ -294,6 +320,9 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 
 	clientsessionexitstatus_t	status=CLIENTSESSIONEXITSTATUS_ERROR;
 
+	// each session starts out unpipelined
+	pipelining=false;
+
 	// accept security context, if necessary
 	if (!acceptSecurityContext()) {
 		return status;
@@ -314,6 +343,27 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 			break;
 		}
 
+		// If the session could be resumed by another connection,
+		// then give the client a moment to send its next command,
+		// and release the session to the pool if it doesn't.
+		if (!pipelining && cont->sessionCanBeReleased()) {
+			uint32_t	timeout=cont->getConfig()->
+						getPoolingIdleTimeout();
+			ssize_t	result=clientsock->read(&command,
+						timeout/1000,
+						(timeout%1000)*1000);
+			if (result==RESULT_TIMEOUT) {
+				status=CLIENTSESSIONEXITSTATUS_RELEASED_SESSION;
+				endsession=false;
+				break;
+			} else if (result!=sizeof(uint16_t)) {
+				break;
+			}
+			debugstr.clear();
+			debugstr.append("command: ")->append(command);
+			cont->raiseDebugMessageEvent(debugstr.getString());
+		} else
+
 		// get a command from the client
 		if (!getCommand(&command)) {
 			break;
@@ -432,6 +482,20 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 			cont->incrementDbIpAddressCount();
 			dbIpAddressCommand();
 			continue;
+		} else if (command==BEGIN_PIPELINE) {
+			// The client is about to send a batch of commands
+			// without waiting for the response to each one.
+			// Buffer the responses until the end of the batch
+			// rather than flushing them one at a time.
+			cont->raiseDebugMessageEvent("begin pipeline");
+			pipelining=true;
+			continue;
+		} else if (command==END_PIPELINE) {
+			// send all of the buffered responses at once
+			cont->raiseDebugMessageEvent("end pipeline");
+			pipelining=false;
+			flushWriteBuffer();
+			continue;
 		}
 
 		// For the rest of the commands,
@@ -443,8 +507,9 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 			// commands don't look for a response from the server
 			// and it doesn't matter if a non-existent result set
 			// was aborted.
-			if (command!=ABORT_RESULT_SET) {
-				noAvailableCursors(command);
+			if (command!=ABORT_RESULT_SET &&
+					!noAvailableCursors(command)) {
+				break;
 			}
 			continue;
 		}
@@ -529,10 +594,15 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 		// FIXME: can we move this inside of processQueryOrBindCursor?
 		// verify that log/notification modules activated by
 		// raise*Event calls don't still need the bind values
-		cont->getBindPool(cursor)->clear();
+		cont->clearBindPool(cursor);
 
 	} while (loop);
 
+	// the controller hands released sessions back to the listener
+	if (status==CLIENTSESSIONEXITSTATUS_RELEASED_SESSION) {
+		return status;
+	}
+
 	// close the client connection
 	//
 	// If an error occurred, the client could still be sending an entire
@@ -593,6 +663,24 @@ clientsessionexitstatus_t sqlrprotocol_sqlrclient::clientSession(
 	return status;
 }
 
+bool sqlrprotocol_sqlrclient::supportsSessionPooling() {
+	// kerberos and tls contexts can't be handed off between connections
+	return (!useKrb() && !useTls());
+}
+
+void sqlrprotocol_sqlrclient::getSessionState(bytebuffer *state) {
+	state->append(protocolversion);
+}
+
+void sqlrprotocol_sqlrclient::setSessionState(const unsigned char *state,
+							size_t statelength) {
+	if (statelength<sizeof(uint16_t)) {
+		return;
+	}
+	bytestring::copy(&protocolversion,state,sizeof(uint16_t));
+	endresultset=(protocolversion==1)?3:END_RESULT_SET;
+}
+
 bool sqlrprotocol_sqlrclient::acceptSecurityContext() {
 
 	if (!useKrb() && !useTls()) {
@@ -722,9 +810,25 @@ sqlrservercursor *sqlrprotocol_sqlrclient::getCursor(uint16_t command) {
 	return cursor;
 }
 
-void sqlrprotocol_sqlrclient::noAvailableCursors(uint16_t command) {
+bool sqlrprotocol_sqlrclient::noAvailableCursors(uint16_t command) {
 	debugFunction();
 
+	// If the client is pipelining commands then the data that follows
+	// this command is interleaved with the commands that follow it and
+	// there's no way to absorb just this command's data.  Tell the
+	// client to disconnect rather than trying to resync the stream.
+	if (pipelining) {
+		clientsock->write((uint16_t)ERROR_OCCURRED_DISCONNECT);
+		clientsock->write((uint64_t)SQLR_ERROR_NOCURSORS);
+		uint16_t	len=charstring::length(
+					SQLR_ERROR_NOCURSORS_STRING);
+		clientsock->write(len);
+		clientsock->write(SQLR_ERROR_NOCURSORS_STRING,len);
+		pipelining=false;
+		flushWriteBuffer();
+		return false;
+	}
+
 	// If no cursor was available, the client
 	// could send an entire query and bind vars
 	// before it reads the error and closes the
@@ -783,6 +887,17 @@ void sqlrprotocol_sqlrclient::noAvailableCursors(uint16_t command) {
 	uint16_t	len=charstring::length(SQLR_ERROR_NOCURSORS_STRING);
 	clientsock->write(len);
 	clientsock->write(SQLR_ERROR_NOCURSORS_STRING,len);
+	flushWriteBuffer();
+	return true;
+}
+
+void sqlrprotocol_sqlrclient::flushWriteBuffer() {
+
+	// while the client is pipelining, responses are
+	// buffered and sent when the pipeline ends
+	if (pipelining) {
+		return;
+	}
 	clientsock->flushWriteBuffer(-1,-1);
 }
 
@@ -818,7 +933,7 @@ bool sqlrprotocol_sqlrclient::authCommand() {
 	clientsock->write((uint16_t)charstring::length(
 				SQLR_ERROR_AUTHENTICATIONERROR_STRING));
 	clientsock->write(SQLR_ERROR_AUTHENTICATIONERROR_STRING);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 	return false;
 }
 
@@ -898,7 +1013,7 @@ void sqlrprotocol_sqlrclient::suspendSessionCommand() {
 		clientsock->write(unixsocketname,unixsocketsize);
 	}
 	clientsock->write(inetportnumber);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 	cont->raiseDebugMessageEvent("done passing socket info to client");
 
 	cont->raiseDebugMessageEvent("done suspending session");
@@ -911,7 +1026,7 @@ void sqlrprotocol_sqlrclient::pingCommand() {
 	if (pingresult) {
 		cont->raiseDebugMessageEvent("ping succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("ping failed");
 		returnError(false);
@@ -934,7 +1049,7 @@ void sqlrprotocol_sqlrclient::identifyCommand() {
 	uint16_t	idlen=charstring::length(ident);
 	clientsock->write(idlen);
 	clientsock->write(ident,idlen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::autoCommitCommand() {
@@ -959,7 +1074,7 @@ void sqlrprotocol_sqlrclient::autoCommitCommand() {
 	if (success) {
 		cont->raiseDebugMessageEvent("succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("failed");
 		returnError(false);
@@ -972,7 +1087,7 @@ void sqlrprotocol_sqlrclient::beginCommand() {
 	if (cont->begin()) {
 		cont->raiseDebugMessageEvent("succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("failed");
 		returnError(false);
@@ -985,7 +1100,7 @@ void sqlrprotocol_sqlrclient::commitCommand() {
 	if (cont->commit()) {
 		cont->raiseDebugMessageEvent("succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("failed");
 		returnError(false);
@@ -998,7 +1113,7 @@ void sqlrprotocol_sqlrclient::rollbackCommand() {
 	if (cont->rollback()) {
 		cont->raiseDebugMessageEvent("succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("failed");
 		returnError(false);
@@ -1018,7 +1133,7 @@ void sqlrprotocol_sqlrclient::dbVersionCommand() {
 	uint16_t	dbvlen=charstring::length(dbversion);
 	clientsock->write(dbvlen);
 	clientsock->write(dbversion,dbvlen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::bindFormatCommand() {
@@ -1034,7 +1149,7 @@ void sqlrprotocol_sqlrclient::bindFormatCommand() {
 	uint16_t	bflen=charstring::length(bf);
 	clientsock->write(bflen);
 	clientsock->write(bf,bflen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::nextvalFormatCommand() {
@@ -1050,7 +1165,7 @@ void sqlrprotocol_sqlrclient::nextvalFormatCommand() {
 	uint16_t	nflen=charstring::length(nf);
 	clientsock->write(nflen);
 	clientsock->write(nf,nflen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::serverVersionCommand() {
@@ -1066,7 +1181,7 @@ void sqlrprotocol_sqlrclient::serverVersionCommand() {
 	uint16_t	svrvlen=charstring::length(svrversion);
 	clientsock->write(svrvlen);
 	clientsock->write(svrversion,svrvlen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::selectDatabaseCommand() {
@@ -1102,7 +1217,7 @@ void sqlrprotocol_sqlrclient::selectDatabaseCommand() {
 		result=clientsock->read(db,dblen,idleclienttimeout,0);
 		if ((uint32_t)result!=dblen) {
 			clientsock->write(false);
-			clientsock->flushWriteBuffer(-1,-1);
+			flushWriteBuffer();
 			delete[] db;
 			cont->raiseClientProtocolErrorEvent(NULL,
 				"select database failed: "
@@ -1115,7 +1230,7 @@ void sqlrprotocol_sqlrclient::selectDatabaseCommand() {
 	// Select the db and send back the result.
 	if (cont->selectDatabase(db)) {
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		returnError(false);
 	}
@@ -1138,7 +1253,7 @@ void sqlrprotocol_sqlrclient::getCurrentDatabaseCommand() {
 	uint16_t	currentdbsize=charstring::length(currentdb);
 	clientsock->write(currentdbsize);
 	clientsock->write(currentdb,currentdbsize);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	// clean up
 	delete[] currentdb;
@@ -1157,7 +1272,7 @@ void sqlrprotocol_sqlrclient::getCurrentSchemaCommand() {
 	uint16_t	currentschemasize=charstring::length(currentschema);
 	clientsock->write(currentschemasize);
 	clientsock->write(currentschema,currentschemasize);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	// clean up
 	delete[] currentschema;
@@ -1171,7 +1286,7 @@ void sqlrprotocol_sqlrclient::getLastInsertIdCommand() {
 		cont->raiseDebugMessageEvent("get last insert id succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
 		clientsock->write(id);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 	} else {
 		cont->raiseDebugMessageEvent("get last insert id failed");
 		returnError(false);
@@ -1188,7 +1303,7 @@ void sqlrprotocol_sqlrclient::dbHostNameCommand() {
 	uint16_t	hostnamelen=charstring::length(hostname);
 	clientsock->write(hostnamelen);
 	clientsock->write(hostname,hostnamelen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 void sqlrprotocol_sqlrclient::dbIpAddressCommand() {
@@ -1201,7 +1316,7 @@ void sqlrprotocol_sqlrclient::dbIpAddressCommand() {
 	uint16_t	ipaddresslen=charstring::length(ipaddress);
 	clientsock->write(ipaddresslen);
 	clientsock->write(ipaddress,ipaddresslen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 }
 
 bool sqlrprotocol_sqlrclient::newQueryCommand(sqlrservercursor *cursor) {
@@ -1302,7 +1417,7 @@ bool sqlrprotocol_sqlrclient::nextResultSetCommand(sqlrservercursor *cursor) {
 		cont->raiseDebugMessageEvent("nextResultSet succeeded");
 		clientsock->write((uint16_t)NO_ERROR_OCCURRED);
 		clientsock->write(nextresultsetavailable);
-		clientsock->flushWriteBuffer(-1,-1);
+		flushWriteBuffer();
 		if (nextresultsetavailable) {
 			cont->incrementNextResultSetAvailableCount();
 		}
@@ -2972,8 +3087,6 @@ void sqlrprotocol_sqlrclient::returnOutputBindClob(sqlrservercursor *cursor,
 	cont->closeLobOutputBind(cursor,index);
 }
 
-#define MAX_BYTES_PER_CHAR	4
-
 void sqlrprotocol_sqlrclient::sendLobOutputBind(sqlrservercursor *cursor,
 							uint16_t index) {
 	debugFunction();
@@ -2993,8 +3106,11 @@ void sqlrprotocol_sqlrclient::sendLobOutputBind(sqlrservercursor *cursor,
 		return;
 	}
 
+	// size the buffer
+	sizeLobBuffer(loblength);
+
 	// initialize sizes and status
-	uint64_t	charstoread=sizeof(lobbuffer)/MAX_BYTES_PER_CHAR;
+	uint64_t	charstoread=lobbuffersize/MAX_BYTES_PER_CHAR;
 	uint64_t	charsread=0;
 	uint64_t	offset=0;
 	bool		start=true;
@@ -3003,7 +3119,7 @@ void sqlrprotocol_sqlrclient::sendLobOutputBind(sqlrservercursor *cursor,
 
 		// read a segment from the lob
 		if (!cont->getLobOutputBindSegment(cursor,index,
-					lobbuffer,sizeof(lobbuffer),
+					lobbuffer,lobbuffersize,
 					offset,charstoread,&charsread) ||
 					!charsread) {
 
@@ -3365,7 +3481,7 @@ bool sqlrprotocol_sqlrclient::returnResultSetData(sqlrservercursor *cursor,
 		// for some queries, there are no rows to return, 
 		if (cont->noRowsToReturn(cursor)) {
 			clientsock->write(endresultset);
-			clientsock->flushWriteBuffer(-1,-1);
+			flushWriteBuffer();
 			cont->raiseDebugMessageEvent(
 				"done returning result set data");
 			return true;
@@ -3380,7 +3496,7 @@ bool sqlrprotocol_sqlrclient::returnResultSetData(sqlrservercursor *cursor,
 				cont->raiseDebugMessageEvent(
 					"done returning result set data");
 			}
-			clientsock->flushWriteBuffer(-1,-1);
+			flushWriteBuffer();
 			return true;
 		}
 
@@ -3408,7 +3524,7 @@ bool sqlrprotocol_sqlrclient::returnResultSetData(sqlrservercursor *cursor,
 			}
 		}
 	}
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	cont->raiseDebugMessageEvent("done returning result set data");
 	return true;
@@ -3505,8 +3621,6 @@ void sqlrprotocol_sqlrclient::sendNullField() {
 	clientsock->write((uint16_t)NULL_DATA);
 }
 
-#define MAX_BYTES_PER_CHAR	4
-
 void sqlrprotocol_sqlrclient::sendLobField(sqlrservercursor *cursor,
 							uint32_t col) {
 	debugFunction();
@@ -3528,8 +3642,11 @@ void sqlrprotocol_sqlrclient::sendLobField(sqlrservercursor *cursor,
 		return;
 	}
 
+	// size the buffer
+	sizeLobBuffer(loblength);
+
 	// initialize sizes and status
-	uint64_t	charstoread=sizeof(lobbuffer)/MAX_BYTES_PER_CHAR;
+	uint64_t	charstoread=lobbuffersize/MAX_BYTES_PER_CHAR;
 	uint64_t	charsread=0;
 	uint64_t	offset=0;
 	bool		start=true;
@@ -3538,7 +3655,7 @@ void sqlrprotocol_sqlrclient::sendLobField(sqlrservercursor *cursor,
 
 		// read a segment from the lob
 		if (!cont->getLobFieldSegment(cursor,col,
-					lobbuffer,sizeof(lobbuffer),
+					lobbuffer,lobbuffersize,
 					offset,charstoread,&charsread) ||
 					!charsread) {
 
@@ -3570,8 +3687,47 @@ void sqlrprotocol_sqlrclient::sendLobField(sqlrservercursor *cursor,
 	}
 }
 
+void sqlrprotocol_sqlrclient::sizeLobBuffer(uint64_t loblength) {
+	debugFunction();
+
+	// Size segments to match the socket's send buffer.  Each segment is
+	// written straight through to the socket, so whatever the size of the
+	// lob, no more than one segment is ever held in memory.  Smaller
+	// segments would require more round-trips to the database, and larger
+	// segments would just wait in user space for the client to catch up.
+	// Segments are never smaller than the 32KB that was used before
+	// though, as small socket buffers would otherwise mean more
+	// round-trips to the database than ever.
+	int32_t	segmentsize=0;
+	if (!clientsock->getSocketWriteBufferSize(&segmentsize) ||
+				segmentsize<MIN_LOB_SEGMENT_SIZE) {
+		segmentsize=MIN_LOB_SEGMENT_SIZE;
+	} else if (segmentsize>MAX_LOB_SEGMENT_SIZE) {
+		segmentsize=MAX_LOB_SEGMENT_SIZE;
+	}
+
+	// don't allocate more than the lob could need
+	if (loblength*MAX_BYTES_PER_CHAR<(uint64_t)segmentsize) {
+		segmentsize=loblength*MAX_BYTES_PER_CHAR;
+		if (segmentsize<MIN_LOB_SEGMENT_SIZE) {
+			segmentsize=MIN_LOB_SEGMENT_SIZE;
+		}
+	}
+
+	// keep the existing buffer if it's close enough
+	if (lobbuffer && (uint32_t)segmentsize<=lobbuffersize &&
+				(uint32_t)segmentsize>=lobbuffersize/2) {
+		return;
+	}
+
+	delete[] lobbuffer;
+	lobbuffersize=segmentsize;
+	lobbuffer=new char[lobbuffersize];
+}
+
 void sqlrprotocol_sqlrclient::startSendingLong(uint64_t longlength) {
 	debugFunction();
+	lobdebuglength=0;
 	clientsock->write((uint16_t)START_LONG_DATA);
 	clientsock->write(longlength);
 }
@@ -3579,8 +3735,19 @@ void sqlrprotocol_sqlrclient::startSendingLong(uint64_t longlength) {
 void sqlrprotocol_sqlrclient::sendLongSegment(const char *data, uint32_t size) {
 	debugFunction();
 
-	if (cont->logEnabled() || cont->notificationsEnabled()) {
-		debugstr.append(data,size);
+	// only log the beginning of the lob,
+	// otherwise debugstr would grow to the size of the entire lob
+	if ((cont->logEnabled() || cont->notificationsEnabled()) &&
+				lobdebuglength<MAX_LOB_DEBUG_LENGTH) {
+		uint32_t	debugsize=size;
+		if (lobdebuglength+debugsize>MAX_LOB_DEBUG_LENGTH) {
+			debugsize=MAX_LOB_DEBUG_LENGTH-lobdebuglength;
+		}
+		debugstr.append(data,debugsize);
+		lobdebuglength+=debugsize;
+		if (lobdebuglength==MAX_LOB_DEBUG_LENGTH) {
+			debugstr.append("...");
+		}
 	}
 
 	clientsock->write((uint16_t)STRING_DATA);
@@ -3622,7 +3789,7 @@ void sqlrprotocol_sqlrclient::returnError(bool forcedisconnect) {
 	// send the error string
 	clientsock->write((uint16_t)errorlength);
 	clientsock->write(errorstring,errorlength);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	cont->raiseDebugMessageEvent("done returning error");
 
@@ -3666,7 +3833,7 @@ void sqlrprotocol_sqlrclient::returnError(sqlrservercursor *cursor,
 	// need to send the client the id of the 
 	// cursor that it's going to use.
 	clientsock->write(cont->getId(cursor));
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	cont->raiseDebugMessageEvent("done returning error");
 
@@ -4236,7 +4403,7 @@ bool sqlrprotocol_sqlrclient::getQueryTreeCommand(sqlrservercursor *cursor) {
 	clientsock->write((uint16_t)NO_ERROR_OCCURRED);
 	clientsock->write((uint64_t)xml.getStringLength());
 	clientsock->write(xml.getString(),xml.getStringLength());
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	return true;
 }
@@ -4255,7 +4422,7 @@ bool sqlrprotocol_sqlrclient::getTranslatedQueryCommand(
 	clientsock->write((uint16_t)NO_ERROR_OCCURRED);
 	clientsock->write(querylen);
 	clientsock->write(query,querylen);
-	clientsock->flushWriteBuffer(-1,-1);
+	flushWriteBuffer();
 
 	return true;
 }
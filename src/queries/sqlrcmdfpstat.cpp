@@ -0,0 +1,256 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/charstring.h>
+//#define DEBUG_MESSAGES 1
+#include <rudiments/debugprint.h>
+#include <datatypes.h>
+
+class SQLRSERVER_DLLSPEC sqlrquery_sqlrcmdfpstat : public sqlrquery {
+	public:
+			sqlrquery_sqlrcmdfpstat(sqlrservercontroller *cont,
+							sqlrqueries *qs,
+							domnode *parameters);
+		bool	match(const char *querystring, uint32_t querylength);
+		sqlrquerycursor	*newCursor(sqlrserverconnection *conn,
+							uint16_t id);
+};
+
+class sqlrquery_sqlrcmdfpstatcursor : public sqlrquerycursor {
+	public:
+			sqlrquery_sqlrcmdfpstatcursor(
+						sqlrserverconnection *sqlrcon,
+						sqlrquery *q,
+						domnode *parameters,
+						uint16_t id);
+			~sqlrquery_sqlrcmdfpstatcursor();
+
+		bool		executeQuery(const char *query,
+						uint32_t length);
+		uint32_t	colCount();
+		const char	*getColumnName(uint32_t col);
+		uint16_t	getColumnType(uint32_t col);
+		uint32_t	getColumnLength(uint32_t col);
+		uint32_t	getColumnPrecision(uint32_t col);
+		uint32_t	getColumnScale(uint32_t col);
+		bool		noRowsToReturn();
+		bool		fetchRow(bool *error);
+		void		getField(uint32_t col,
+					const char **field,
+					uint64_t *fieldlength,
+					bool *blob, bool *null);
+	private:
+		uint32_t	rowcount;
+		uint32_t	currentrow;
+		char		*fieldbuffer[9];
+
+		sqlrfingerprintstats	*stats;
+		sqlrfingerprintstats	*fs;
+};
+
+sqlrquery_sqlrcmdfpstat::sqlrquery_sqlrcmdfpstat(sqlrservercontroller *cont,
+						sqlrqueries *qs,
+						domnode *parameters) :
+						sqlrquery(cont,qs,parameters) {
+	debugFunction();
+}
+
+bool sqlrquery_sqlrcmdfpstat::match(const char *querystring,
+					uint32_t querylength) {
+	debugFunction();
+	return !charstring::compareIgnoringCase(querystring,"sqlrcmd fpstat");
+}
+
+sqlrquerycursor *sqlrquery_sqlrcmdfpstat::newCursor(
+					sqlrserverconnection *sqlrcon,
+					uint16_t id) {
+	return new sqlrquery_sqlrcmdfpstatcursor(sqlrcon,this,
+						getParameters(),id);
+}
+
+sqlrquery_sqlrcmdfpstatcursor::sqlrquery_sqlrcmdfpstatcursor(
+					sqlrserverconnection *sqlrcon,
+					sqlrquery *q,
+					domnode *parameters,
+					uint16_t id) :
+				sqlrquerycursor(sqlrcon,q,parameters,id) {
+	rowcount=0;
+	currentrow=0;
+	for (uint16_t i=0; i<9; i++) {
+		fieldbuffer[i]=NULL;
+	}
+	stats=NULL;
+	fs=NULL;
+}
+
+sqlrquery_sqlrcmdfpstatcursor::~sqlrquery_sqlrcmdfpstatcursor() {
+	for (uint16_t i=0; i<9; i++) {
+		delete[] fieldbuffer[i];
+	}
+	delete[] stats;
+}
+
+bool sqlrquery_sqlrcmdfpstatcursor::executeQuery(const char *query,
+							uint32_t length) {
+
+	// copy the table, so entries that are replaced while the
+	// result set is being fetched don't change underneath it
+	if (!stats) {
+		stats=new sqlrfingerprintstats[STATFINGERPRINTS];
+	}
+	sqlrfingerprints	fps(conn->cont->getShm());
+	rowcount=fps.getSorted(stats);
+	currentrow=0;
+	return true;
+}
+
+uint32_t sqlrquery_sqlrcmdfpstatcursor::colCount() {
+	return 9;
+}
+
+struct colinfo_t {
+	const char	*name;
+	uint16_t	type;
+	uint32_t	length;
+	uint32_t	precision;
+	uint32_t	scale;
+};
+
+static struct colinfo_t colinfo[]={
+	{"FINGERPRINT",VARCHAR2_DATATYPE,16,0,0},
+	{"CALLS",NUMBER_DATATYPE,20,20,0},
+	{"ERRORS",NUMBER_DATATYPE,20,20,0},
+	{"ROWS",NUMBER_DATATYPE,20,20,0},
+	{"EXEC_TOTAL",NUMBER_DATATYPE,16,16,6},
+	{"EXEC_MAX",NUMBER_DATATYPE,16,16,6},
+	{"FETCH_TOTAL",NUMBER_DATATYPE,16,16,6},
+	{"FETCH_MAX",NUMBER_DATATYPE,16,16,6},
+	{"SQL_TEXT",VARCHAR2_DATATYPE,STATFINGERPRINTLEN-1,0,0}
+};
+
+const char *sqlrquery_sqlrcmdfpstatcursor::getColumnName(uint32_t col) {
+	return (col<9)?colinfo[col].name:NULL;
+}
+
+uint16_t sqlrquery_sqlrcmdfpstatcursor::getColumnType(uint32_t col) {
+	return (col<9)?colinfo[col].type:0;
+}
+
+uint32_t sqlrquery_sqlrcmdfpstatcursor::getColumnLength(uint32_t col) {
+	return (col<9)?colinfo[col].length:0;
+}
+
+uint32_t sqlrquery_sqlrcmdfpstatcursor::getColumnPrecision(uint32_t col) {
+	return (col<9)?colinfo[col].precision:0;
+}
+
+uint32_t sqlrquery_sqlrcmdfpstatcursor::getColumnScale(uint32_t col) {
+	return (col<9)?colinfo[col].scale:0;
+}
+
+bool sqlrquery_sqlrcmdfpstatcursor::noRowsToReturn() {
+	return false;
+}
+
+bool sqlrquery_sqlrcmdfpstatcursor::fetchRow(bool *error) {
+	*error=false;
+	if (currentrow<rowcount) {
+		fs=&(stats[currentrow]);
+		currentrow++;
+		return true;
+	}
+	return false;
+}
+
+void sqlrquery_sqlrcmdfpstatcursor::getField(uint32_t col,
+					const char **field,
+					uint64_t *fieldlength,
+					bool *blob,
+					bool *null) {
+	*field=NULL;
+	*fieldlength=0;
+	*blob=false;
+	*null=false;
+
+	delete[] fieldbuffer[col];
+	fieldbuffer[col]=NULL;
+
+	switch (col) {
+		case 0:
+			// fingerprint -
+			// hash of the normalized query, in hex
+			fieldbuffer[col]=new char[17];
+			charstring::printf(fieldbuffer[col],17,"%016llx",
+					(unsigned long long)fs->fingerprint);
+			break;
+		case 1:
+			// calls -
+			// number of times the query was executed
+			fieldbuffer[col]=charstring::parseNumber(fs->calls);
+			break;
+		case 2:
+			// errors -
+			// number of executions that failed
+			fieldbuffer[col]=charstring::parseNumber(fs->errors);
+			break;
+		case 3:
+			// rows -
+			// number of rows fetched
+			fieldbuffer[col]=charstring::parseNumber(fs->rows);
+			break;
+		case 4:
+			// exec_total -
+			// seconds spent executing the query
+			fieldbuffer[col]=charstring::parseNumber(
+					((double)fs->executeusec)/1000000.0,
+					colinfo[col].precision,
+					colinfo[col].scale);
+			break;
+		case 5:
+			// exec_max -
+			// seconds spent on the slowest execution
+			fieldbuffer[col]=charstring::parseNumber(
+					((double)fs->maxexecuteusec)/1000000.0,
+					colinfo[col].precision,
+					colinfo[col].scale);
+			break;
+		case 6:
+			// fetch_total -
+			// seconds spent fetching rows
+			fieldbuffer[col]=charstring::parseNumber(
+					((double)fs->fetchusec)/1000000.0,
+					colinfo[col].precision,
+					colinfo[col].scale);
+			break;
+		case 7:
+			// fetch_max -
+			// seconds spent fetching the slowest result set
+			fieldbuffer[col]=charstring::parseNumber(
+					((double)fs->maxfetchusec)/1000000.0,
+					colinfo[col].precision,
+					colinfo[col].scale);
+			break;
+		case 8:
+			// sql_text -
+			// normalized query
+			*field=fs->text;
+			*fieldlength=charstring::length(*field);
+			return;
+		default:
+			*null=true;
+			return;
+	}
+
+	*field=fieldbuffer[col];
+	*fieldlength=charstring::length(fieldbuffer[col]);
+}
+
+extern "C" {
+	SQLRSERVER_DLLSPEC sqlrquery *new_sqlrquery_sqlrcmdfpstat(
+						sqlrservercontroller *cont,
+						sqlrqueries *qs,
+						domnode *parameters) {
+		return new sqlrquery_sqlrcmdfpstat(cont,qs,parameters);
+	}
+}
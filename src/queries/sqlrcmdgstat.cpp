@@ -109,48 +109,34 @@ bool sqlrquery_sqlrcmdgstatcursor::executeQuery(const char *query,
 		gs->peak_connectedclients_1min=connectedclients;
 	}
 
-	int select_1=0, select_5=0, select_15=0;
-	int insert_1=0, insert_5=0, insert_15=0;
-	int update_1=0, update_5=0, update_15=0;
-	int delete_1=0, delete_5=0, delete_15=0;
-	int etc_1=0, etc_5=0, etc_15=0;
-	int sqlrcmd_1=0, sqlrcmd_5=0, sqlrcmd_15=0;
-	for (int j=0; j<60*15; j++) {
-		if (now-gs->timestamp[j]<60) {
-			select_1+=gs->qps_select[j];
-			insert_1+=gs->qps_insert[j];
-			update_1+=gs->qps_update[j];
-			delete_1+=gs->qps_delete[j];
-			etc_1+=gs->qps_create[j]+
-				gs->qps_drop[j]+
-				gs->qps_alter[j]+
-				gs->qps_etc[j];
-			sqlrcmd_1+=gs->qps_custom[j];
-		}
-		if (now-gs->timestamp[j]<60*5) {
-			select_5+=gs->qps_select[j];
-			insert_5+=gs->qps_insert[j];
-			update_5+=gs->qps_update[j];
-			delete_5+=gs->qps_delete[j];
-			etc_5+=gs->qps_create[j]+
-				gs->qps_drop[j]+
-				gs->qps_alter[j]+
-				gs->qps_etc[j];
-			sqlrcmd_5+=gs->qps_custom[j];
-		}
-		if (now-gs->timestamp[j]<60*15) {
-			select_15+= gs->qps_select[j];
-			insert_15+= gs->qps_insert[j];
-			update_15+= gs->qps_update[j];
-			delete_15+= gs->qps_delete[j];
-			etc_15+=gs->qps_create[j]+
-				gs->qps_drop[j]+
-				gs->qps_alter[j]+
-				gs->qps_etc[j];
-			sqlrcmd_15+= gs->qps_custom[j];
-
-		}
-	}
+	// query counts are kept per-connection, by minute, total them up
+	// over the last 1, 5, and 15 complete minutes
+	sqlrquerystats	qs(gs);
+	sqlrqpmbucket	qpm1;
+	sqlrqpmbucket	qpm5;
+	sqlrqpmbucket	qpm15;
+	qs.getQueriesPerMinute(now/60,1,&qpm1);
+	qs.getQueriesPerMinute(now/60,5,&qpm5);
+	qs.getQueriesPerMinute(now/60,15,&qpm15);
+
+	int select_1=qpm1.nselect;
+	int select_5=qpm5.nselect;
+	int select_15=qpm15.nselect;
+	int insert_1=qpm1.ninsert;
+	int insert_5=qpm5.ninsert;
+	int insert_15=qpm15.ninsert;
+	int update_1=qpm1.nupdate;
+	int update_5=qpm5.nupdate;
+	int update_15=qpm15.nupdate;
+	int delete_1=qpm1.ndelete;
+	int delete_5=qpm5.ndelete;
+	int delete_15=qpm15.ndelete;
+	int etc_1=qpm1.ncreate+qpm1.ndrop+qpm1.nalter+qpm1.netc;
+	int etc_5=qpm5.ncreate+qpm5.ndrop+qpm5.nalter+qpm5.netc;
+	int etc_15=qpm15.ncreate+qpm15.ndrop+qpm15.nalter+qpm15.netc;
+	int sqlrcmd_1=qpm1.ncustom;
+	int sqlrcmd_5=qpm5.ncustom;
+	int sqlrcmd_15=qpm15.ncustom;
 
 	int32_t qpm_1=select_1+insert_1+update_1+delete_1+etc_1+sqlrcmd_1;
 	int32_t	qpm_5=select_5+insert_5+update_5+delete_5+etc_5+sqlrcmd_5;
@@ -171,8 +157,9 @@ bool sqlrquery_sqlrcmdgstatcursor::executeQuery(const char *query,
 	strftime(tmpbuf,GSTAT_VALUE_LEN,"%Y/%m/%d %H:%M:%S",localtime(&now));
 	setGSResult("now",tmpbuf,rowcount++);
 	setGSResult("access_count",gs->opened_cli_connections,rowcount++);
-	setGSResult("query_total",gs->total_queries,rowcount++);
-	setGSResult("qpm",gs->total_queries*60/uptime,rowcount++);
+	uint64_t	totalqueries=qs.getTotalQueries();
+	setGSResult("query_total",totalqueries,rowcount++);
+	setGSResult("qpm",totalqueries*60/uptime,rowcount++);
 	setGSResult("qpm_1",qpm_1,rowcount++);
 	setGSResult("qpm_5",qpm_5/5,rowcount++);
 	setGSResult("qpm_15",qpm_15/15,rowcount++);
@@ -20,6 +20,8 @@ class SQLRSERVER_DLLSPEC sqlrrouter_clientiplist : public sqlrrouter {
 
 		const char	*connid;
 
+		sqlriplist	clientiplist;
+
 		const char	**clientips;
 		uint64_t	clientipcount;
 
@@ -43,12 +45,22 @@ sqlrrouter_clientiplist::sqlrrouter_clientiplist(sqlrservercontroller *cont,
 
 	connid=parameters->getAttributeValue("connectionid");
 
-	// this is faster than running through the xml over and over
-	clientipcount=parameters->getChildCount();
-	clientips=new const char *[clientipcount];
+	// Compile the patterns into a prefix list, so each lookup is a single
+	// walk over the bits of the address, no matter how many patterns there
+	// are.  Anything that the prefix list doesn't understand is kept and
+	// matched the old way.
+	clientipcount=0;
+	clientips=new const char *[parameters->getChildCount()];
 	domnode *clientip=parameters->getFirstTagChild("client");
-	for (uint64_t i=0; i<clientipcount; i++) {
-		clientips[i]=clientip->getAttributeValue("ip");
+	while (!clientip->isNullNode()) {
+		const char	*ip=clientip->getAttributeValue("ip");
+		if (!charstring::isNullOrEmpty(ip) && !clientiplist.add(ip)) {
+			if (debug) {
+				stdoutput.printf("	"
+						"matching %s by pattern\n",ip);
+			}
+			clientips[clientipcount++]=ip;
+		}
 		clientip=clientip->getNextTagSibling("client");
 	}
 }
@@ -79,7 +91,18 @@ const char *sqlrrouter_clientiplist::route(sqlrserverconnection *sqlrcon,
 		return NULL;
 	}
 
-	// run through the clientip array...
+	// check the prefix list
+	if (clientiplist.match(clientip)) {
+		if (debug) {
+			stdoutput.printf("			"
+						"routing client ip "
+						"\"%s\" to %s\n	}\n",
+						clientip,connid);
+		}
+		return connid;
+	}
+
+	// run through the remaining patterns...
 	for (uint64_t i=0; i<clientipcount; i++) {
 
 		// if the clientip matches...
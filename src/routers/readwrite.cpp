@@ -0,0 +1,512 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/character.h>
+#include <rudiments/datetime.h>
+#include <rudiments/randomnumber.h>
+#include <rudiments/snooze.h>
+#include <rudiments/thread.h>
+#include <rudiments/threadmutex.h>
+
+struct replica {
+	const char	*connid;
+	sqlrconnection	*probecon;
+	bool		healthy;
+	double		latency;
+	double		lag;
+};
+
+class SQLRSERVER_DLLSPEC sqlrrouter_readwrite : public sqlrrouter {
+	public:
+			sqlrrouter_readwrite(sqlrservercontroller *cont,
+						sqlrrouters *rs,
+						domnode *parameters);
+			~sqlrrouter_readwrite();
+
+		const char	*route(sqlrserverconnection *sqlrcon,
+						sqlrservercursor *sqlrcur,
+						const char **err,
+						int64_t *errn);
+
+		void	beginTransaction();
+		void	endTransaction(bool commit);
+		void	endSession();
+	private:
+		bool	isRead(sqlrservercursor *sqlrcur,
+					const char *query, uint32_t length,
+					sqlrquerytype_t *querytype);
+		bool	containsWord(const char *query, const char *word);
+		sqlrconnection	*newProbeConnection(const char *connid);
+		void		startProbing();
+		static void	probeThread(void *attr);
+		void		probeLoop();
+		void		probeReplicas();
+		void		probeReplica(replica *r);
+		replica		*chooseReplica();
+
+		sqlrservercontroller	*cont;
+
+		const char	*primary;
+
+		replica		*replicas;
+		uint16_t	replicacount;
+
+		const char	*lagquery;
+		double		maxlag;
+		uint32_t	probeinterval;
+		int32_t		probetimeout;
+		int64_t		lastprobe;
+
+		thread		probethr;
+		threadmutex	probemutex;
+		bool		probestarted;
+		bool		probethreadrunning;
+		volatile bool	stopprobing;
+
+		bool		sessionstickiness;
+
+		bool		intransaction;
+		bool		wroteintransaction;
+		bool		wroteinsession;
+		replica		*sessionreplica;
+
+		randomnumber	rnd;
+
+		bool	enabled;
+
+		bool	debug;
+};
+
+sqlrrouter_readwrite::sqlrrouter_readwrite(sqlrservercontroller *cont,
+						sqlrrouters *rs,
+						domnode *parameters) :
+					sqlrrouter(cont,rs,parameters) {
+	replicas=NULL;
+	replicacount=0;
+	lastprobe=-1;
+	probestarted=false;
+	probethreadrunning=false;
+	stopprobing=false;
+	intransaction=false;
+	wroteintransaction=false;
+	wroteinsession=false;
+	sessionreplica=NULL;
+
+	this->cont=cont;
+
+	debug=cont->getConfig()->getDebugRouters();
+	enabled=!charstring::isNo(parameters->getAttributeValue("enabled"));
+	if (!enabled && debug) {
+		stdoutput.printf("	disabled\n");
+		return;
+	}
+
+	primary=parameters->getAttributeValue("primary");
+
+	// lag probe
+	lagquery=parameters->getAttributeValue("lagquery");
+	if (charstring::isNullOrEmpty(lagquery)) {
+		lagquery=NULL;
+	}
+	const char	*val=parameters->getAttributeValue("maxlag");
+	maxlag=(charstring::isNullOrEmpty(val))?10.0:charstring::toFloat(val);
+	val=parameters->getAttributeValue("probeinterval");
+	probeinterval=(charstring::isNullOrEmpty(val))?5:
+				charstring::toUnsignedInteger(val);
+	val=parameters->getAttributeValue("probetimeout");
+	probetimeout=(charstring::isNullOrEmpty(val))?2:
+				charstring::toInteger(val);
+
+	// after a write, send reads to the primary for the rest of
+	// the transaction, or for the rest of the session
+	sessionstickiness=charstring::compare(
+			parameters->getAttributeValue("stickiness"),
+			"transaction");
+
+	// find the connections for the replicas
+	const char	**connids=getConnectionIds();
+	uint16_t	concount=getConnectionCount();
+	replicas=new replica[parameters->getChildCount()];
+	for (domnode *rn=parameters->getFirstTagChild("replica");
+				!rn->isNullNode();
+				rn=rn->getNextTagSibling("replica")) {
+
+		const char	*connid=rn->getAttributeValue("connectionid");
+		uint16_t	i=0;
+		while (i<concount && charstring::compare(connid,connids[i])) {
+			i++;
+		}
+		if (i==concount) {
+			if (debug) {
+				stdoutput.printf("	WARNING! replica %s "
+						"not found\n",connid);
+			}
+			continue;
+		}
+		if (debug) {
+			stdoutput.printf("	replica: %s\n",connid);
+		}
+
+		// The replicas are probed over their own connections, rather
+		// than the ones that queries are routed over, so that probes
+		// can run in the background without getting in the way of
+		// the client's session.
+		replica	*r=&replicas[replicacount++];
+		r->connid=connids[i];
+		r->probecon=newProbeConnection(connids[i]);
+		r->healthy=true;
+		r->latency=0.0;
+		r->lag=0.0;
+	}
+	if (debug && !replicacount) {
+		stdoutput.printf("	WARNING! no replicas found\n");
+	}
+
+	rnd.setSeed(randomnumber::getSeed());
+}
+
+sqlrrouter_readwrite::~sqlrrouter_readwrite() {
+	if (probethreadrunning) {
+		stopprobing=true;
+		probethr.join(NULL);
+	}
+	for (uint16_t i=0; i<replicacount; i++) {
+		delete replicas[i].probecon;
+	}
+	delete[] replicas;
+}
+
+sqlrconnection *sqlrrouter_readwrite::newProbeConnection(const char *connid) {
+
+	// find the replica's connect string
+	linkedlist< connectstringcontainer * >	*cslist=
+				cont->getConfig()->getConnectStringList();
+	for (listnode< connectstringcontainer * > *node=cslist->getFirst();
+						node; node=node->getNext()) {
+
+		connectstringcontainer	*csc=node->getValue();
+		if (charstring::compare(csc->getConnectionId(),connid)) {
+			continue;
+		}
+
+		sqlrconnection	*con=new sqlrconnection(
+				csc->getConnectStringValue("server"),
+				charstring::toUnsignedInteger(
+					csc->getConnectStringValue("port")),
+				csc->getConnectStringValue("socket"),
+				csc->getConnectStringValue("user"),
+				csc->getConnectStringValue("password"),
+				0,1);
+
+		// don't let an unreachable or hung replica stall the probes
+		con->setConnectTimeout(probetimeout,0);
+		con->setResponseTimeout(probetimeout,0);
+		return con;
+	}
+	return NULL;
+}
+
+const char *sqlrrouter_readwrite::route(sqlrserverconnection *sqlrcon,
+					sqlrservercursor *sqlrcur,
+					const char **err,
+					int64_t *errn) {
+
+	// let begin/commit/rollback/etc. go to all connections
+	if (!enabled || !sqlrcon || !sqlrcur) {
+		return NULL;
+	}
+
+	if (debug) {
+		stdoutput.printf("		route {\n");
+	}
+
+	const char	*query=sqlrcur->getQueryBuffer();
+	uint32_t	length=sqlrcur->getQueryLength();
+	sqlrquerytype_t	querytype;
+	bool		read=isRead(sqlrcur,query,length,&querytype);
+
+	// writes and transaction control go to the primary
+	if (!read) {
+		if (querytype==SQLRQUERYTYPE_BEGIN) {
+			beginTransaction();
+		} else if (querytype==SQLRQUERYTYPE_COMMIT ||
+				querytype==SQLRQUERYTYPE_ROLLBACK) {
+			endTransaction(querytype==SQLRQUERYTYPE_COMMIT);
+		} else {
+			wroteintransaction=true;
+			if (sessionstickiness) {
+				wroteinsession=true;
+			}
+		}
+		if (debug) {
+			stdoutput.printf("			"
+					"routing write to: %s\n		}\n",
+					primary);
+		}
+		return primary;
+	}
+
+	// reads in a transaction, or after a write, go to the primary
+	if (intransaction || wroteintransaction || wroteinsession) {
+		if (debug) {
+			stdoutput.printf("			"
+					"routing read to: %s "
+					"(after write/in transaction)\n"
+					"		}\n",primary);
+		}
+		return primary;
+	}
+
+	// other reads go to a replica, if one is usable
+	replica	*r=chooseReplica();
+	const char	*connid=(r)?r->connid:primary;
+	if (debug) {
+		stdoutput.printf("			"
+				"routing read to: %s\n		}\n",connid);
+	}
+	return connid;
+}
+
+bool sqlrrouter_readwrite::isRead(sqlrservercursor *sqlrcur,
+					const char *query, uint32_t length,
+					sqlrquerytype_t *querytype) {
+
+	// use the parsed query, if the parser supports it
+	sqlrparsedquery	*pq=cont->getParsedQuery(sqlrcur);
+	if (pq) {
+		*querytype=pq->getQueryType();
+
+		// select ... into, select ... for update/share, and
+		// selects from writable common table expressions
+		// have to run on the primary
+		return (*querytype==SQLRQUERYTYPE_SELECT &&
+				!pq->hasKeyword(SQLRKEYWORD_FOR) &&
+				!pq->hasKeyword(SQLRKEYWORD_INSERT) &&
+				!pq->hasKeyword(SQLRKEYWORD_UPDATE) &&
+				!pq->hasKeyword(SQLRKEYWORD_DELETE));
+	}
+
+	*querytype=sqlrcur->queryType(query,length);
+	if (*querytype!=SQLRQUERYTYPE_SELECT) {
+
+		// queryType() only recognizes lower case keywords
+		if (*querytype!=SQLRQUERYTYPE_ETC) {
+			return false;
+		}
+		const char	*ptr=cont->skipWhitespaceAndComments(query);
+		if (charstring::compareIgnoringCase(ptr,"select",6) ||
+				!character::isWhitespace(ptr[6])) {
+			return false;
+		}
+		*querytype=SQLRQUERYTYPE_SELECT;
+	}
+
+	// select ... into and select ... for update have to run on the primary
+	return (!containsWord(query,"into") && !containsWord(query,"for"));
+}
+
+bool sqlrrouter_readwrite::containsWord(const char *query, const char *word) {
+
+	// looks for the word outside of quotes, ignoring case
+	size_t	wordlen=charstring::length(word);
+	char	quote='\0';
+	for (const char *c=query; *c; c++) {
+		if (quote) {
+			if (*c==quote) {
+				quote='\0';
+			}
+			continue;
+		}
+		if (*c=='\'' || *c=='"' || *c=='`') {
+			quote=*c;
+			continue;
+		}
+		if (c>query && (character::isAlphanumeric(*(c-1)) ||
+							*(c-1)=='_')) {
+			continue;
+		}
+		if (!charstring::compareIgnoringCase(c,word,wordlen) &&
+				!character::isAlphanumeric(*(c+wordlen)) &&
+				*(c+wordlen)!='_') {
+			return true;
+		}
+	}
+	return false;
+}
+
+replica *sqlrrouter_readwrite::chooseReplica() {
+
+	if (!replicacount) {
+		return NULL;
+	}
+
+	// The replicas are probed by a background thread.  It's started here,
+	// rather than in the constructor, because the constructor runs before
+	// the connection daemon detaches from the controlling terminal, and
+	// the thread wouldn't survive the fork.
+	if (!probestarted) {
+		startProbing();
+	}
+
+	// if threads aren't available, then probe the
+	// replicas here, if it's time to
+	if (!probethreadrunning) {
+		datetime	dt;
+		dt.getSystemDateAndTime();
+		if (lastprobe<0 ||
+			dt.getEpoch()-lastprobe>=(int64_t)probeinterval) {
+			probeReplicas();
+			lastprobe=dt.getEpoch();
+		}
+	}
+
+	probemutex.lock();
+
+	// stay on the same replica for the rest of the session, if it's still
+	// healthy, so that a session doesn't hop between replicas with
+	// different amounts of lag
+	if (sessionreplica && sessionreplica->healthy) {
+		probemutex.unlock();
+		return sessionreplica;
+	}
+
+	// Pick two healthy replicas at random and use the one with the lower
+	// latency.  This favors faster replicas without sending every session
+	// to the same one.
+	replica		*healthy[2]={NULL,NULL};
+	uint16_t	healthycount=0;
+	for (uint16_t i=0; i<replicacount; i++) {
+		if (replicas[i].healthy) {
+			healthycount++;
+		}
+	}
+	if (!healthycount) {
+		probemutex.unlock();
+		if (debug) {
+			stdoutput.printf("			"
+					"no healthy replicas\n");
+		}
+		return NULL;
+	}
+	for (uint16_t pick=0; pick<2; pick++) {
+		int32_t	n;
+		rnd.generateScaledNumber(0,healthycount-1,&n);
+		for (uint16_t i=0; i<replicacount; i++) {
+			if (replicas[i].healthy && !(n--)) {
+				healthy[pick]=&replicas[i];
+				break;
+			}
+		}
+	}
+	sessionreplica=(healthy[1]->latency<healthy[0]->latency)?
+							healthy[1]:healthy[0];
+	probemutex.unlock();
+	return sessionreplica;
+}
+
+void sqlrrouter_readwrite::startProbing() {
+	probestarted=true;
+	if (thread::supported()) {
+		probethreadrunning=probethr.spawn(
+					(void *(*)(void *))probeThread,
+					(void *)this,false);
+	}
+	if (debug && !probethreadrunning) {
+		stdoutput.printf("			"
+				"probing replicas in the foreground\n");
+	}
+}
+
+void sqlrrouter_readwrite::probeThread(void *attr) {
+	((sqlrrouter_readwrite *)attr)->probeLoop();
+}
+
+void sqlrrouter_readwrite::probeLoop() {
+	while (!stopprobing) {
+		probeReplicas();
+
+		// wait for the next probe, a second at a time,
+		// so that shutting down isn't held up
+		for (uint32_t i=0; i<probeinterval && !stopprobing; i++) {
+			snooze::macrosnooze(1);
+		}
+	}
+}
+
+void sqlrrouter_readwrite::probeReplicas() {
+	for (uint16_t i=0; i<replicacount; i++) {
+		probeReplica(&replicas[i]);
+	}
+}
+
+void sqlrrouter_readwrite::probeReplica(replica *r) {
+
+	datetime	start;
+	start.getSystemDateAndTime();
+
+	// run the lag query, or just ping if there isn't one
+	bool	success=false;
+	double	lag=0.0;
+	if (r->probecon) {
+		if (lagquery) {
+			sqlrcursor	cur(r->probecon);
+			success=cur.sendQuery(lagquery);
+			if (success && cur.rowCount()) {
+				lag=charstring::toFloat(
+					cur.getField(0,(uint32_t)0));
+			}
+		} else {
+			success=r->probecon->ping();
+		}
+
+		// don't tie up one of the replica's connections between probes
+		r->probecon->endSession();
+	}
+
+	datetime	end;
+	end.getSystemDateAndTime();
+	double	usec=(double)(end.getEpoch()-start.getEpoch())*1000000.0+
+			(double)end.getMicroseconds()-
+			(double)start.getMicroseconds();
+
+	// keep a moving average of the round-trip time
+	probemutex.lock();
+	r->latency=(r->latency>0.0)?(r->latency*0.7+usec*0.3):usec;
+	r->lag=lag;
+	r->healthy=(success && lag<=maxlag);
+	probemutex.unlock();
+
+	if (debug) {
+		stdoutput.printf("			"
+				"replica %s: %s, latency %.0fus, lag %.3fs\n",
+				r->connid,(r->healthy)?"healthy":"unhealthy",
+				r->latency,r->lag);
+	}
+}
+
+void sqlrrouter_readwrite::beginTransaction() {
+	intransaction=true;
+}
+
+void sqlrrouter_readwrite::endTransaction(bool commit) {
+	intransaction=false;
+	wroteintransaction=false;
+}
+
+void sqlrrouter_readwrite::endSession() {
+	intransaction=false;
+	wroteintransaction=false;
+	wroteinsession=false;
+	sessionreplica=NULL;
+}
+
+extern "C" {
+	SQLRSERVER_DLLSPEC sqlrrouter *new_sqlrrouter_readwrite(
+						sqlrservercontroller *cont,
+						sqlrrouters *rs,
+						domnode *parameters) {
+		return new sqlrrouter_readwrite(cont,rs,parameters);
+	}
+}
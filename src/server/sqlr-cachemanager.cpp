@@ -9,8 +9,12 @@
 #include <rudiments/directory.h>
 #include <rudiments/process.h>
 #include <rudiments/permissions.h>
+#include <rudiments/stringbuffer.h>
+#include <rudiments/linkedlist.h>
+#include <rudiments/dictionary.h>
 #include <config.h>
 #include <defaults.h>
+#include <defines.h>
 #include <version.h>
 
 class dirnode {
@@ -20,6 +24,7 @@ class dirnode {
 			dirnode(const char *start, const char *end);
 			~dirnode();
 		char	*dirname;
+		int64_t	lastfullscan;
 		dirnode	*next;
 };
 
@@ -29,10 +34,14 @@ class sqlrcachemanager {
 			~sqlrcachemanager();
 		void	scan();
 	private:
+		bool	expireIndexed(const char *dirname);
+		void	expireAll(const char *dirname);
 		void	erase(const char *dirname, const char *filename);
+		bool	getTtl(const char *fullpathname, int64_t *ttl);
 		void	parseCacheDirs(const char *cachedirs);
 
 		int	scaninterval;
+		int	fullscaninterval;
 		dirnode	*firstdir;
 		dirnode	*currentdir;
 
@@ -44,11 +53,13 @@ class sqlrcachemanager {
 
 dirnode::dirnode(const char *dirname) {
 	this->dirname=charstring::duplicate(dirname);
+	lastfullscan=0;
 	next=NULL;
 }
 
 dirnode::dirnode(const char *start, const char *end) {
 	dirname=charstring::duplicate(start,end-start);
+	lastfullscan=0;
 	next=NULL;
 }
 
@@ -71,6 +82,14 @@ sqlrcachemanager::sqlrcachemanager(int argc, const char **argv) {
 		scaninterval=DEFAULT_INTERVAL;
 	}
 
+	// get the fullscaninterval
+	const char	*fullscanint=cmdl->getValue("-fullscaninterval");
+	if (!charstring::isNullOrEmpty(fullscanint)) {
+		fullscaninterval=charstring::toInteger(fullscanint);
+	} else {
+		fullscaninterval=DEFAULT_FULLSCANINTERVAL;
+	}
+
 	// get the directories to scan
 	const char	*cachedirs=cmdl->getValue("-cachedirs");
 	parseCacheDirs(cachedirs);
@@ -108,8 +127,6 @@ void sqlrcachemanager::scan() {
 	process::createPidFile(pidfile,permissions::ownerReadWrite());
 
 	// scan...
-	directory	dir;
-
 	for (;;) {
 
 		// start with the first dir in the list
@@ -117,26 +134,20 @@ void sqlrcachemanager::scan() {
 
 		while (currentdir) {
 
-			// open directory
-			if (dir.open(currentdir->dirname)) {
-
-				// loop through directory, erasing
-				for (;;) {
-					char	*name=dir.read();
-					if (!name) {
-						break;
-					}
-					if (charstring::compare(
-							name,".") &&
-						charstring::compare(
-							name,"..")) {
-						erase(currentdir->dirname,name);
-					}
-					delete[] name;
-				}
-
-				// close the directory
-				dir.close();
+			// expire the files listed in the directory's index,
+			// or check every file if there's no index (if it was
+			// only used by older clients, for example)
+			//
+			// Older clients, and clients that can't write to the
+			// index, don't list their files in it, so check every
+			// file once in a while, even if there is an index.
+			datetime	dt;
+			dt.getSystemDateAndTime();
+			if (!expireIndexed(currentdir->dirname) ||
+				dt.getEpoch()-currentdir->lastfullscan>=
+							fullscaninterval) {
+				expireAll(currentdir->dirname);
+				currentdir->lastfullscan=dt.getEpoch();
 			}
 
 			// move to the next dir in the list
@@ -149,38 +160,189 @@ void sqlrcachemanager::scan() {
 
 }
 
+bool sqlrcachemanager::expireIndexed(const char *dirname) {
+
+	// open the index
+	char	*indexname=NULL;
+	charstring::printf(&indexname,"%s/%s",dirname,CACHE_INDEX_FILE);
+	file	index;
+	bool	opened=index.open(indexname,O_RDWR);
+	delete[] indexname;
+	if (!opened) {
+		return false;
+	}
+
+	// clients add to the index under a lock,
+	// so hold it while the index is rewritten
+	if (!index.lockFile(F_WRLCK)) {
+		index.close();
+		return true;
+	}
+
+	// read the index
+	off64_t	size=index.getSize();
+	char	*contents=new char[size+1];
+	ssize_t	result=(size>0)?index.read(contents,size):0;
+	contents[(result>0)?result:0]='\0';
+
+	// Each entry is an expiration and a file name, separated by a tab.
+	// A file can be cached more than once, and its most recent entry is
+	// the one that counts.
+	dictionary<char *, int64_t>	expirations;
+	linkedlist<char *>		names;
+	char	*line=contents;
+	for (;;) {
+		char	*end=charstring::findFirst(line,'\n');
+		if (!end) {
+			break;
+		}
+		*end='\0';
+		char	*tab=charstring::findFirst(line,'\t');
+		if (tab) {
+			*tab='\0';
+			char	*name=tab+1;
+			int64_t	expiration;
+			if (!expirations.getValue(name,&expiration)) {
+				names.append(name);
+			}
+			expirations.setValue(name,charstring::toInteger(line));
+		}
+		line=end+1;
+	}
+
+	// remove the files that have expired, and
+	// keep the rest of the entries in the index
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	stringbuffer	remaining;
+	for (linkedlistnode<char *> *node=names.getFirst();
+					node; node=node->getNext()) {
+
+		char	*name=node->getValue();
+		int64_t	expiration=expirations.getValue(name);
+
+		// anyone who can write to the directory can write to the
+		// index too, so only accept names of files in the directory
+		if (charstring::isNullOrEmpty(name) ||
+				charstring::findFirst(name,'/') ||
+				!charstring::compare(name,".") ||
+				!charstring::compare(name,"..")) {
+			continue;
+		}
+
+		char	*fullpathname=NULL;
+		charstring::printf(&fullpathname,"%s/%s",dirname,name);
+		if (expiration<dt.getEpoch()) {
+
+			// only remove the file if it really is a cache file,
+			// and its own ttl has expired, otherwise keep
+			// its entry, with the ttl from the file
+			int64_t	ttl;
+			if (getTtl(fullpathname,&ttl)) {
+				if (ttl<dt.getEpoch()) {
+					char	*indname=NULL;
+					charstring::printf(&indname,"%s.ind",
+								fullpathname);
+					file::remove(fullpathname);
+					file::remove(indname);
+					delete[] indname;
+				} else {
+					remaining.append(ttl)->append('\t');
+					remaining.append(name)->append('\n');
+				}
+			}
+		} else if (file::exists(fullpathname)) {
+			remaining.append(expiration)->append('\t');
+			remaining.append(name)->append('\n');
+		}
+		delete[] fullpathname;
+	}
+
+	// rewrite the index
+	index.truncate(0);
+	index.setPositionRelativeToBeginning(0);
+	index.write(remaining.getString(),remaining.getSize());
+
+	index.unlockFile();
+	index.close();
+	delete[] contents;
+	return true;
+}
+
+void sqlrcachemanager::expireAll(const char *dirname) {
+
+	// open directory
+	directory	dir;
+	if (!dir.open(dirname)) {
+		return;
+	}
+
+	// loop through directory, erasing
+	for (;;) {
+		char	*name=dir.read();
+		if (!name) {
+			break;
+		}
+		if (charstring::compare(name,".") &&
+				charstring::compare(name,"..")) {
+			erase(dirname,name);
+		}
+		delete[] name;
+	}
+
+	// close the directory
+	dir.close();
+}
+
 void sqlrcachemanager::erase(const char *dirname, const char *filename) {
 
 	// derive the full pathname
 	char	*fullpathname=NULL;
 	charstring::printf(&fullpathname,"%s/%s",dirname,filename);
 
+	// delete the file if it's a cache file and the ttl has expired
+	int64_t	ttl;
+	if (getTtl(fullpathname,&ttl)) {
+		datetime	dt;
+		dt.getSystemDateAndTime();
+		if (ttl<dt.getEpoch()) {
+			file::remove(fullpathname);
+		}
+	}
+	delete[] fullpathname;
+}
+
+bool sqlrcachemanager::getTtl(const char *fullpathname, int64_t *ttl) {
+
 	// open the file
 	file	fl;
-	if (fl.open(fullpathname,O_RDONLY)) {
-
-		// get the "magic" identifier
-		char	magicid[13];
-		fl.read(magicid,13);
-		if (!charstring::compare(magicid,"SQLRELAYCACHE",13)) {
-
-			// get the ttl
-			int64_t ttl;
-			fl.read(&ttl);
-	
-			fl.close();
-	
-			// delete the file if the ttl has expired
-			datetime	dt;
-			dt.getSystemDateAndTime();
-			if (ttl<dt.getEpoch()) {
-				file::remove(fullpathname);
-			}
+	if (!fl.open(fullpathname,O_RDONLY)) {
+		return false;
+	}
+
+	// get the "magic" identifier,
+	// and the version of newer files
+	char		magicid[CACHE_MAGIC_LENGTH];
+	uint16_t	fileversion;
+	bool		cachefile=false;
+	if (fl.read(magicid,CACHE_MAGIC_LENGTH)==CACHE_MAGIC_LENGTH) {
+		if (!charstring::compare(magicid,CACHE_MAGIC,
+						CACHE_MAGIC_LENGTH)) {
+			cachefile=(fl.read(&fileversion)==sizeof(uint16_t));
 		} else {
-			fl.close();
+			cachefile=!charstring::compare(magicid,
+						CACHE_MAGIC_V1,
+						CACHE_MAGIC_LENGTH);
 		}
 	}
-	delete[] fullpathname;
+
+	// get the ttl
+	if (cachefile) {
+		cachefile=(fl.read(ttl)==sizeof(int64_t));
+	}
+
+	fl.close();
+	return cachefile;
 }
 
 void sqlrcachemanager::parseCacheDirs(const char *cachedirs) {
@@ -232,7 +394,7 @@ static void helpmessage(const char *progname) {
 	stdoutput.printf(
 		"%s is the %s client-side result-set cache manager.\n"
 		"\n"
-		"To improve the performance of frequently run queries, %s client applications can cache result sets locally and then access them rather than running the query again.  When a result set is cached, a time-to-live (expiration date) is assigned to it. The %s goes through the cached result sets periodically and removes the ones that have expired.\n"
+		"To improve the performance of frequently run queries, %s client applications can cache result sets locally and then access them rather than running the query again.  When a result set is cached, a time-to-live (expiration date) is assigned to it. The %s goes through the cached result sets periodically and removes the ones that have expired.  Client applications list the result sets that they cache, and their expirations, in an index in each cache directory, so usually only the index needs to be read.  Every file in each directory is still checked once per full scan interval, to catch result sets that weren't listed in the index.\n"
 		"\n"
 		"Only one %s needs to be run per machine.\n"
 		"\n"
@@ -248,6 +410,10 @@ static void helpmessage(const char *progname) {
 		"\n"
 		"	-scaninterval sec	Interval, in seconds, to scan the cache\n"
 		"				directories.\n"
+		"\n"
+		"	-fullscaninterval sec	Interval, in seconds, to check every file\n"
+		"				in the cache directories, even if they\n"
+		"				have an index.\n"
 		"\n",
 		progname,SQL_RELAY,SQL_RELAY,progname,
 		progname,SQL_RELAY,progname);
@@ -42,6 +42,7 @@ class SQLRSERVER_DLLSPEC scaler {
 		void	killConnection(pid_t connpid);
 		bool	openMoreConnections();
 		bool	reapChildren(pid_t connpid);
+		void	retireConnStats(pid_t connpid);
 		void	getRandomConnectionId();
 		bool	availableDatabase();
 
@@ -452,6 +453,11 @@ bool scaler::reapChildren(pid_t connpid) {
 							"continued",pid);
 			}
 
+			if (childstate==EXIT_CHILDSTATECHANGE ||
+				childstate==TERMINATED_CHILDSTATECHANGE) {
+				retireConnStats(pid);
+			}
+
 		} else {
 			if (!semset->wait(11,0,0)) {
 				break;
@@ -465,6 +471,23 @@ bool scaler::reapChildren(pid_t connpid) {
 	return reaped;
 }
 
+void scaler::retireConnStats(pid_t connpid) {
+
+	// A connection that exits cleanly folds its query counts into the
+	// instance totals and releases its connstats slot on the way out.
+	// One that crashed didn't get the chance to, so do it for it here.
+	sqlrquerystats	qs(shm);
+	semset->waitWithUndo(9);
+	for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+		sqlrconnstatistics	*cs=&(shm->connstats[i]);
+		if (cs->processid==(uint32_t)connpid) {
+			qs.retire(cs);
+			break;
+		}
+	}
+	semset->signalWithUndo(9);
+}
+
 pid_t scaler::openOneConnection() {
 
 	// build command name
@@ -8,7 +8,7 @@
 #include <rudiments/charstring.h>
 #include <rudiments/error.h>
 #include <rudiments/stdio.h>
-#include <sqlrelay/private/sqlrshm.h>
+#include <sqlrelay/sqlrserver.h>
 #include <sqlrelay/sqlrutil.h>
 #include <datatypes.h>
 #include <defines.h>
@@ -142,12 +142,14 @@ int main(int argc, const char **argv) {
 		stdoutput.printf("usage:\n"
 			" %s-status [-config config] -id id "
 			"[-localstatedir dir] [-short] "
-			"[-connection-detail [-query]]\n",SQLR);
+			"[-connection-detail [-query]] "
+			"[-fingerprints]\n",SQLR);
 		process::exit(1);
 	}
 	bool		shortoutput=cmdl.found("-short");
 	bool		connoutput=cmdl.found("-connection-detail");
 	bool		queryoutput=cmdl.found("-query");
+	bool		fingerprintoutput=cmdl.found("-fingerprints");
 	
 	// get the id filename and key
 	sqlrpaths	sqlrp(&cmdl);
@@ -187,6 +189,11 @@ int main(int argc, const char **argv) {
 	sqlrshm		*statistics=new sqlrshm;
 	*statistics=*shm;
 	semset.signalWithUndo(9);
+
+	// query and error counts are kept per-connection, total them up
+	sqlrquerystats	qs(statistics);
+	uint64_t	totalqueries=qs.getTotalQueries();
+	uint64_t	totalerrors=qs.getTotalErrors();
 	#define SEM_COUNT	13
 	int32_t	sem[SEM_COUNT];
 	for (uint16_t i=0; i<SEM_COUNT; i++) {
@@ -205,8 +212,8 @@ int main(int argc, const char **argv) {
 				"opened_client_connections=%d "
 				"new_cursor_used=%d "
 				"cursor_reused=%d "
-				"total_queries=%d "
-				"total_errors=%d\n",
+				"total_queries=%lld "
+				"total_errors=%lld\n",
 				!statistics->disabled,
 				statistics->open_db_connections,
 				statistics->opened_db_connections,
@@ -216,8 +223,8 @@ int main(int argc, const char **argv) {
 				statistics->opened_cli_connections,
 				statistics->times_new_cursor_used,
 				statistics->times_cursor_reused,
-				statistics->total_queries,
-				statistics->total_errors);
+				totalqueries,
+				totalerrors);
 		delete statistics;
 		process::exit(0);
 	}
@@ -238,10 +245,11 @@ int main(int argc, const char **argv) {
 		"  Times  New Cursor Used:       %d\n"
 		"  Times  Cursor Reused:         %d\n"
 		"\n"
-		"  Total  Queries:               %d\n" 
-		"  Total  Errors:                %d\n"
+		"  Total  Queries:               %lld\n" 
+		"  Total  Errors:                %lld\n"
 		"\n"
 		"  Forked Listeners:             %d\n"
+		"  Proxied Sessions:             %d\n"
 		"\n"
 		"Scaler's view:\n"
 		"  Connections:                  %d\n"
@@ -256,13 +264,133 @@ int main(int argc, const char **argv) {
 		statistics->opened_cli_connections,
 		statistics->times_new_cursor_used,
 		statistics->times_cursor_reused,
-		statistics->total_queries,
-		statistics->total_errors,
+		totalqueries,
+		totalerrors,
 		statistics->forked_listeners,
+		statistics->proxied_sessions,
 		statistics->totalconnections,
 		statistics->connectedclients
 		);
 
+	// session pooling stats are kept per-connection, total them up
+	uint64_t	nauth=0;
+	uint64_t	nreleasesession=0;
+	uint64_t	nresumesession=0;
+	uint64_t	npinsession=0;
+	uint64_t	nsessionresetskipped=0;
+	uint64_t	nsessionqueriesskipped=0;
+	uint64_t	nspooledresultsets=0;
+	uint64_t	nspooledrows=0;
+	uint64_t	nspooledbytes=0;
+	uint64_t	spoolusec=0;
+	uint64_t	memused=0;
+	uint64_t	mempeak=0;
+	uint64_t	memcategories[5]={0,0,0,0,0};
+	uint64_t	nmemshrink=0;
+	uint64_t	nmemrejected=0;
+	for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+		sqlrconnstatistics	*cs=&statistics->connstats[i];
+		nauth+=cs->nauth;
+		nreleasesession+=cs->nreleasesession;
+		nresumesession+=cs->nresumesession;
+		npinsession+=cs->npinsession;
+		nsessionresetskipped+=cs->nsessionresetskipped;
+		nsessionqueriesskipped+=cs->nsessionqueriesskipped;
+		nspooledresultsets+=cs->nspooledresultsets;
+		nspooledrows+=cs->nspooledrows;
+		nspooledbytes+=cs->nspooledbytes;
+		spoolusec+=cs->spoolusec;
+		memused+=cs->memused;
+		if (cs->mempeak>mempeak) {
+			mempeak=cs->mempeak;
+		}
+		memcategories[0]+=cs->memcursors;
+		memcategories[1]+=cs->memqueries;
+		memcategories[2]+=cs->membinds;
+		memcategories[3]+=cs->memlobs;
+		memcategories[4]+=cs->memfetch;
+		nmemshrink+=cs->nmemshrink;
+		nmemrejected+=cs->nmemrejected;
+	}
+
+	// the multiplexing ratio is the average number of connections that
+	// each client session was spread across, the pin ratio is the
+	// fraction of client sessions that ended up tied to one connection
+	stdoutput.printf("Session Pooling:\n"
+		"  Pooled Sessions:              %d\n"
+		"  Released Sessions:            %lld\n"
+		"  Resumed Sessions:             %lld\n"
+		"  Pinned Sessions:              %lld\n"
+		"  Multiplexing Ratio:           %.2f\n"
+		"  Pin Ratio:                    %.2f\n"
+		"\n",
+		statistics->pooled_sessions,
+		nreleasesession,
+		nresumesession,
+		npinsession,
+		(nauth)?(double)(nauth+nresumesession)/(double)nauth:0.0,
+		(nauth)?(double)npinsession/(double)nauth:0.0);
+
+	stdoutput.printf("User Affinity:\n"
+		"  Idle Connections:             %d\n"
+		"  Re-Logins Avoided:            %d\n"
+		"  Affinity Misses:              %d\n"
+		"\n",
+		statistics->idleconnectioncount,
+		statistics->affinity_relogins_avoided,
+		statistics->affinity_misses);
+
+	stdoutput.printf("Session Reset:\n"
+		"  Reset Steps Skipped:          %lld\n"
+		"  Session Queries Skipped:      %lld\n"
+		"\n",
+		nsessionresetskipped,
+		nsessionqueriesskipped);
+
+	stdoutput.printf("Query Fingerprints:\n"
+		"  Fingerprints:                 %d\n"
+		"  Fingerprints Replaced:        %lld\n"
+		"\n",
+		statistics->fingerprintcount,
+		statistics->fingerprintevictions);
+
+	// throughput is the rate at which rows were fetched from the
+	// database and written to spool files, in megabytes per second
+	stdoutput.printf("Result Set Spooling:\n"
+		"  Spooled Result Sets:          %lld\n"
+		"  Spooled Rows:                 %lld\n"
+		"  Spooled Bytes:                %lld\n"
+		"  Spool Throughput (MB/s):      %.2f\n"
+		"\n",
+		nspooledresultsets,
+		nspooledrows,
+		nspooledbytes,
+		(spoolusec)?((double)nspooledbytes/(1024.0*1024.0))/
+				((double)spoolusec/1000000.0):0.0);
+
+	// memory is what the connections have accounted for, the peak is
+	// the highest that any one connection has reached
+	stdoutput.printf("Memory:\n"
+		"  Bytes In Use:                 %lld\n"
+		"    Cursors:                    %lld\n"
+		"    Queries:                    %lld\n"
+		"    Binds:                      %lld\n"
+		"    Lobs:                       %lld\n"
+		"    Fetch Buffers:              %lld\n"
+		"  Peak Bytes Per Connection:    %lld\n"
+		"  Pools Shrunk:                 %lld\n"
+		"  Queries Rejected:             %lld\n"
+		"\n",
+		memused,
+		memcategories[0],
+		memcategories[1],
+		memcategories[2],
+		memcategories[3],
+		memcategories[4],
+		mempeak,
+		nmemshrink,
+		nmemrejected);
+
 	stdoutput.printf("Mutexes:\n");
 	stdoutput.printf("  Connection Announce               : ");
 	printAcquisitionStatus(sem[0]);
@@ -346,10 +474,12 @@ int main(int argc, const char **argv) {
 				// are treated as zero terminated.
 				stdoutput.printf(" clientinfo=%s "
 						"clientaddr=%s "
-						"user=%s\n",
+						"user=%s "
+						"dbuser=%s\n",
 						&conn[j].clientinfo[0],
 						&conn[j].clientaddr[0],
-						&conn[j].user[0]);
+						&conn[j].user[0],
+						&conn[j].dbuser[0]);
 				stdoutput.printf(" nautocommit=%d "
 						"nbegin=%d "
 						"ncommit=%d "
@@ -409,6 +539,38 @@ int main(int argc, const char **argv) {
 						conn[j].nnextresultset,
 						conn[j].nnextresultsetavailable
 						);
+				stdoutput.printf(" nerror=%lld "
+						"nstmtcachehit=%lld "
+						"nstmtcachemiss=%lld\n",
+						conn[j].nerror,
+						conn[j].nstmtcachehit,
+						conn[j].nstmtcachemiss);
+				stdoutput.printf(" nreleasesession=%d "
+						"nresumesession=%d "
+						"npinsession=%d\n",
+						conn[j].nreleasesession,
+						conn[j].nresumesession,
+						conn[j].npinsession);
+				stdoutput.printf(" nsessionresetskipped=%lld "
+						"nsessionqueriesskipped=%lld\n",
+						conn[j].nsessionresetskipped,
+						conn[j].nsessionqueriesskipped);
+				stdoutput.printf(" nspooledresultsets=%d "
+						"nspooledrows=%lld "
+						"nspooledbytes=%lld "
+						"spoolusec=%lld\n",
+						conn[j].nspooledresultsets,
+						conn[j].nspooledrows,
+						conn[j].nspooledbytes,
+						conn[j].spoolusec);
+				stdoutput.printf(" memused=%lld "
+						"mempeak=%lld "
+						"nmemshrink=%d "
+						"nmemrejected=%d\n",
+						conn[j].memused,
+						conn[j].mempeak,
+						conn[j].nmemshrink,
+						conn[j].nmemrejected);
 				if (queryoutput) {
 					printQuery(&(conn[j]));
 				}
@@ -416,6 +578,36 @@ int main(int argc, const char **argv) {
 		}
 	}
 
+	if (fingerprintoutput) {
+
+		// most expensive first, times are in seconds
+		sqlrfingerprintstats	*fps=
+				new sqlrfingerprintstats[STATFINGERPRINTS];
+		sqlrfingerprints	fp(statistics);
+		uint32_t		count=fp.getSorted(fps);
+
+		stdoutput.printf("\nFingerprints:\n");
+		stdoutput.printf("%-16s %10s %8s %12s %12s %10s %12s %10s "
+				"query\n",
+				"fingerprint","calls","errors","rows",
+				"exec","exec max","fetch","fetch max");
+		for (uint32_t i=0; i<count; i++) {
+			sqlrfingerprintstats	*f=&(fps[i]);
+			stdoutput.printf("%016llx %10lld %8lld %12lld "
+					"%12.6f %10.6f %12.6f %10.6f %s\n",
+					(unsigned long long)f->fingerprint,
+					f->calls,
+					f->errors,
+					f->rows,
+					(double)f->executeusec/1000000.0,
+					(double)f->maxexecuteusec/1000000.0,
+					(double)f->fetchusec/1000000.0,
+					(double)f->maxfetchusec/1000000.0,
+					f->text);
+		}
+		delete[] fps;
+	}
+
 	delete statistics;
 	process::exit(0);
 }
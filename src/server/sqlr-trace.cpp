@@ -0,0 +1,401 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <sqlrelay/sqlrutil.h>
+#include <rudiments/semaphoreset.h>
+#include <rudiments/sharedmemory.h>
+#include <rudiments/permissions.h>
+#include <rudiments/process.h>
+#include <rudiments/datetime.h>
+#include <rudiments/snooze.h>
+#include <rudiments/file.h>
+#include <rudiments/charstring.h>
+#include <rudiments/bytestring.h>
+#include <rudiments/error.h>
+#include <rudiments/stdio.h>
+#include <defines.h>
+#include <config.h>
+#include <version.h>
+
+static const char * const phasenames[]={
+	"state",
+	"prepare",
+	"bind",
+	"execute"
+};
+#define PHASECOUNT	4
+
+static const char * const statenames[]={
+	"NOT_AVAILABLE",
+	"INIT",
+	"WAIT_FOR_AVAIL_DB",
+	"WAIT_CLIENT",
+	"SESSION_START",
+	"GET_COMMAND",
+	"PROCESS_SQL",
+	"PROCESS_CUSTOM",
+	"RETURN_RESULT_SET",
+	"SESSION_END",
+	"ANNOUNCE_AVAILABILITY",
+	"WAIT_SEMAPHORE"
+};
+#define STATECOUNT	12
+
+static const char * const querytypenames[]={
+	"select",
+	"insert",
+	"insert-select",
+	"select-into",
+	"multi-insert",
+	"update",
+	"delete",
+	"create",
+	"drop",
+	"alter",
+	"custom",
+	"etc",
+	"begin",
+	"commit",
+	"rollback",
+	"autocommit-on",
+	"autocommit-off",
+	"set-autocommit-on",
+	"set-autocommit-off"
+};
+#define QUERYTYPECOUNT	19
+
+#define COMMANDCOUNT	32
+
+struct spanstats {
+	uint64_t	count;
+	uint64_t	total;
+	uint64_t	max;
+};
+
+static const char *commandName(uint16_t phase, uint32_t command) {
+	if (phase==SQLRTRACEPHASE_STATE) {
+		return (command<STATECOUNT)?statenames[command]:"undefined";
+	}
+	return (command<QUERYTYPECOUNT)?querytypenames[command]:"undefined";
+}
+
+static void helpmessage(const char *progname) {
+	stdoutput.printf(
+		"%s is the %s trace utility.\n"
+		"\n"
+		"The %s utility collects timing information from each connection of the specified instance, as it runs, and either summarizes it or writes it out in the Chrome trace-event JSON format, which can be loaded into chrome://tracing, Perfetto, or similar tools.\n"
+		"\n"
+		"While %s is running, each connection records the time it spends in each state, and preparing, binding, and executing each query, into a ring buffer in shared memory.  Connections record nothing while %s isn't running.\n"
+		"\n"
+		"Usage: %s [OPTIONS]\n"
+		"\n"
+		"Options:\n"
+		SERVEROPTIONS
+		"	-format format		Output format, either \"summary\" or\n"
+		"				\"chrome\".  Defaults to \"summary\".\n"
+		"\n"
+		"	-duration seconds	Trace for the specified number of\n"
+		"				seconds.  Defaults to tracing until\n"
+		"				interrupted.\n"
+		"\n"
+		"	-interval ms		Read the ring buffers every ms\n"
+		"				milliseconds.  Defaults to 100.\n"
+		"\n"
+		"	-ringsize spans		Size of the ring buffer for each\n"
+		"				connection.  Defaults to 1024.\n"
+		"\n"
+		"	-connections count	Number of connections to allocate ring\n"
+		"				buffers for.  Defaults to the number of\n"
+		"				connections that are currently running.\n"
+		"\n"
+		"Examples:\n"
+		"\n"
+		"Summarize the activity of the specified instance for 10 seconds.\n"
+		"\n"
+		"	%s -id myinst -duration 10\n"
+		"\n"
+		"Trace the specified instance until interrupted and write the result to\n"
+		"trace.json.\n"
+		"\n"
+		"	%s -id myinst -format chrome > trace.json\n"
+		"\n",
+		progname,SQL_RELAY,progname,progname,progname,progname,
+		progname,progname);
+}
+
+int main(int argc, const char **argv) {
+
+	version(argc,argv);
+	help(argc,argv);
+
+	// parse the command line
+	sqlrcmdline	cmdl(argc,argv);
+
+	const char	*id=cmdl.getValue("-id");
+	if (charstring::isNullOrEmpty(id)) {
+		stdoutput.printf("usage:\n"
+			" %s-trace [-config config] -id id "
+			"[-localstatedir dir] [-format summary|chrome] "
+			"[-duration seconds] [-interval ms] "
+			"[-ringsize spans] [-connections count]\n",SQLR);
+		process::exit(1);
+	}
+	bool		chrome=!charstring::compare(
+					cmdl.getValue("-format"),"chrome");
+	uint64_t	duration=charstring::toUnsignedInteger(
+					cmdl.getValue("-duration"));
+	uint64_t	interval=charstring::toUnsignedInteger(
+					cmdl.getValue("-interval"));
+	if (!interval) {
+		interval=100;
+	}
+	uint32_t	ringsize=charstring::toUnsignedInteger(
+					cmdl.getValue("-ringsize"));
+	if (!ringsize) {
+		ringsize=1024;
+	}
+	uint32_t	ringcount=charstring::toUnsignedInteger(
+					cmdl.getValue("-connections"));
+
+	// get the id filename and key
+	sqlrpaths	sqlrp(&cmdl);
+	stringbuffer	idfilename;
+	idfilename.append(sqlrp.getIpcDir())->append(id)->append(".ipc");
+	key_t	key=file::generateKey(idfilename.getString(),1);
+
+	// attach to the shared memory segment for the specified instance
+	sharedmemory	idmemory;
+	if (!idmemory.attach(key,sizeof(sqlrshm))) {
+		char	*err=error::getErrorString();
+		stderror.printf("Couldn't attach to shared memory segment: ");
+		stderror.printf("%s\n",err);
+		delete[] err;
+		process::exit(1);
+	}
+	sqlrshm	*shm=(sqlrshm *)idmemory.getPointer();
+	if (!shm) {
+		stderror.printf("failed to get pointer to shm\n");
+		process::exit(1);
+	}
+
+	// attach to the semaphore set for the specified instance
+	semaphoreset	semset;
+	if (!semset.attach(key,13)) {
+		char	*err=error::getErrorString();
+		stderror.printf("Couldn't attach to semaphore set: ");
+		stderror.printf("%s\n",err);
+		delete[] err;
+		process::exit(1);
+	}
+
+	// by default, allocate rings for the connections that are running now
+	if (!ringcount) {
+		for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+			if (shm->connstats[i].processid) {
+				ringcount=i+1;
+			}
+		}
+		if (!ringcount) {
+			stderror.printf("No connections are running\n");
+			process::exit(1);
+		}
+	}
+	if (ringcount>MAXCONNECTIONS) {
+		ringcount=MAXCONNECTIONS;
+	}
+
+	// create the trace buffer
+	stringbuffer	traceidfilename;
+	traceidfilename.append(sqlrp.getIpcDir())->append(id);
+	traceidfilename.append("-trace.ipc");
+	if (!file::exists(traceidfilename.getString()) &&
+			!file::createFile(traceidfilename.getString(),
+					permissions::ownerReadWrite())) {
+		char	*err=error::getErrorString();
+		stderror.printf("Couldn't create %s: %s\n",
+					traceidfilename.getString(),err);
+		delete[] err;
+		process::exit(1);
+	}
+	key_t	tracekey=file::generateKey(traceidfilename.getString(),1);
+	uint64_t	ringbytes=sizeof(sqlrtracering)+
+					ringsize*sizeof(sqlrtracespan);
+	uint64_t	size=sizeof(sqlrtraceheader)+ringcount*ringbytes;
+	sharedmemory	*tracememory=new sharedmemory;
+	if (!tracememory->create(tracekey,size,
+				permissions::evalPermString("rw-r-----"))) {
+		char	*err=error::getErrorString();
+		stderror.printf("Couldn't create trace buffer: %s\n"
+				"(is another %s-trace running?)\n",err,SQLR);
+		delete[] err;
+		process::exit(1);
+	}
+	unsigned char	*trace=(unsigned char *)tracememory->getPointer();
+	bytestring::zero(trace,size);
+	sqlrtraceheader	*header=(sqlrtraceheader *)trace;
+	header->ringcount=ringcount;
+	header->ringsize=ringsize;
+
+	// tell the connections to start tracing
+	semset.waitWithUndo(9);
+	uint32_t	generation=shm->tracegeneration+1;
+	if (!generation) {
+		generation=1;
+	}
+	shm->tracegeneration=generation;
+	semset.signalWithUndo(9);
+
+	process::setShutDownFlagOnShutDown();
+
+	uint64_t	*tails=new uint64_t[ringcount];
+	bytestring::zero(tails,ringcount*sizeof(uint64_t));
+	spanstats	stats[PHASECOUNT][COMMANDCOUNT];
+	bytestring::zero(stats,sizeof(stats));
+	uint64_t	spans=0;
+	uint64_t	lost=0;
+	bool		first=true;
+
+	if (chrome) {
+		stdoutput.printf("{\"traceEvents\":[");
+	}
+
+	datetime	start;
+	start.getSystemDateAndTime();
+	for (;;) {
+
+		bool	done=process::getShutDownFlag();
+		if (!done && duration) {
+			datetime	now;
+			now.getSystemDateAndTime();
+			done=((uint64_t)(now.getEpoch()-
+					start.getEpoch())>=duration);
+		}
+		if (!done) {
+			snooze::microsnooze(interval/1000,
+						(interval%1000)*1000);
+		}
+
+		// read whatever was written to each ring since the last pass
+		for (uint32_t r=0; r<ringcount; r++) {
+
+			sqlrtracering	*ring=(sqlrtracering *)
+						(trace+sizeof(sqlrtraceheader)+
+						r*ringbytes);
+			volatile sqlrtracespan	*ringspans=
+					(volatile sqlrtracespan *)(ring+1);
+			uint64_t	head=
+					((volatile sqlrtracering *)ring)->head;
+			uint32_t	pid=ring->processid;
+
+			// if the connection lapped us,
+			// then skip what was overwritten
+			if (head-tails[r]>ringsize) {
+				lost+=head-tails[r]-ringsize;
+				tails[r]=head-ringsize;
+			}
+
+			for (; tails[r]<head; tails[r]++) {
+
+				// copy the span out and make sure that it
+				// wasn't being overwritten while we did it
+				volatile sqlrtracespan	*s=
+						&(ringspans[tails[r]%ringsize]);
+				sqlrtracespan	span;
+				span.sequence=s->sequence;
+				span.start=s->start;
+				span.end=s->end;
+				span.command=s->command;
+				span.cursorid=s->cursorid;
+				span.phase=s->phase;
+				if (span.sequence!=tails[r]+1 ||
+						s->sequence!=span.sequence ||
+						span.phase>=PHASECOUNT) {
+					lost++;
+					continue;
+				}
+				spans++;
+
+				uint64_t	dur=(span.end>span.start)?
+						span.end-span.start:0;
+				if (span.command<COMMANDCOUNT) {
+					spanstats	*st=
+						&(stats[span.phase]
+							[span.command]);
+					st->count++;
+					st->total+=dur;
+					if (dur>st->max) {
+						st->max=dur;
+					}
+				}
+
+				if (chrome) {
+					// states on thread 0, query
+					// phases on their cursor's thread
+					stdoutput.printf("%s\n{\"name\":\"%s\","
+						"\"cat\":\"%s\","
+						"\"ph\":\"X\","
+						"\"ts\":%lld.%03lld,"
+						"\"dur\":%lld.%03lld,"
+						"\"pid\":%d,\"tid\":%d}",
+						(first)?"":",",
+						commandName(span.phase,
+								span.command),
+						phasenames[span.phase],
+						span.start/1000,
+						span.start%1000,
+						dur/1000,dur%1000,
+						pid,
+						(span.phase==
+						SQLRTRACEPHASE_STATE)?0:
+						span.cursorid+1);
+					first=false;
+				}
+			}
+		}
+
+		if (done) {
+			break;
+		}
+	}
+
+	// tell the connections to stop tracing, they'll detach
+	// from the buffer the next time they would have written
+	// to it, and it will go away when they all have
+	semset.waitWithUndo(9);
+	if (shm->tracegeneration==generation) {
+		shm->tracegeneration=0;
+	}
+	semset.signalWithUndo(9);
+	delete tracememory;
+	file::remove(traceidfilename.getString());
+
+	if (chrome) {
+		stdoutput.printf("\n],\"displayTimeUnit\":\"ms\"}\n");
+	} else {
+		stdoutput.printf("%-8s %-22s %10s %12s %12s %12s\n",
+					"phase","command","count",
+					"total(us)","avg(us)","max(us)");
+		for (uint16_t p=0; p<PHASECOUNT; p++) {
+			for (uint32_t c=0; c<COMMANDCOUNT; c++) {
+				spanstats	*st=&(stats[p][c]);
+				if (!st->count) {
+					continue;
+				}
+				stdoutput.printf("%-8s %-22s %10lld "
+						"%12lld %12lld %12lld\n",
+						phasenames[p],
+						commandName(p,c),
+						st->count,
+						st->total/1000,
+						st->total/st->count/1000,
+						st->max/1000);
+			}
+		}
+		stdoutput.printf("\n%lld spans, %lld lost\n",spans,lost);
+	}
+
+	delete[] tails;
+
+	process::exit(0);
+}
@@ -0,0 +1,214 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/charstring.h>
+#include <rudiments/bytestring.h>
+#include <rudiments/randomnumber.h>
+#include <rudiments/sha256.h>
+
+#define SQLRAUTHCACHE_SLOTS	256
+#define SQLRAUTHCACHE_DIGESTSIZE	32
+#define SQLRAUTHCACHE_SALTSIZE	16
+
+struct sqlrauthcacheentry {
+	unsigned char	digest[SQLRAUTHCACHE_DIGESTSIZE];
+	uint64_t	index;
+	bool		valid;
+};
+
+class sqlrauthcacheprivate {
+	friend class sqlrauthcache;
+	private:
+		const char * const	*_users;
+		uint64_t		_usercount;
+
+		// open-addressed hash table of the first index of each user,
+		// with the indices of any later entries for the same user
+		// chained through _next
+		uint64_t		*_buckets;
+		uint64_t		_bucketcount;
+		uint64_t		*_next;
+
+		unsigned char		_salt[SQLRAUTHCACHE_SALTSIZE];
+		sqlrauthcacheentry	_entries[SQLRAUTHCACHE_SLOTS];
+};
+
+static uint64_t hashUser(const char *user) {
+
+	// FNV-1a
+	uint64_t	hash=14695981039346656037ULL;
+	if (!user) {
+		return hash;
+	}
+	for (const unsigned char *c=(const unsigned char *)user; *c; c++) {
+		hash^=*c;
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+sqlrauthcache::sqlrauthcache() {
+	pvt=new sqlrauthcacheprivate;
+	pvt->_users=NULL;
+	pvt->_usercount=0;
+	pvt->_buckets=NULL;
+	pvt->_bucketcount=0;
+	pvt->_next=NULL;
+
+	// Salt the digests with bytes that are only known to this process,
+	// so the cache can't be used to test guesses at passwords offline.
+	randomnumber	rnd;
+	rnd.setSeed(randomnumber::getSeed());
+	for (uint16_t i=0; i<SQLRAUTHCACHE_SALTSIZE; i++) {
+		int32_t	b;
+		rnd.generateScaledNumber(0,255,&b);
+		pvt->_salt[i]=(unsigned char)b;
+	}
+
+	clear();
+}
+
+sqlrauthcache::~sqlrauthcache() {
+	clear();
+	delete[] pvt->_buckets;
+	delete[] pvt->_next;
+	delete pvt;
+}
+
+void sqlrauthcache::setUsers(const char * const *users, uint64_t usercount) {
+
+	// anything that was verified against the old users is no longer valid
+	clear();
+
+	delete[] pvt->_buckets;
+	delete[] pvt->_next;
+	pvt->_users=users;
+	pvt->_usercount=usercount;
+	pvt->_buckets=NULL;
+	pvt->_next=NULL;
+	pvt->_bucketcount=0;
+	if (!usercount) {
+		return;
+	}
+
+	// size the table to a power of two, at most half full
+	pvt->_bucketcount=2;
+	while (pvt->_bucketcount<usercount*2) {
+		pvt->_bucketcount=pvt->_bucketcount<<1;
+	}
+
+	// buckets and next pointers store index+1, with 0 meaning "none"
+	pvt->_buckets=new uint64_t[pvt->_bucketcount];
+	bytestring::zero(pvt->_buckets,pvt->_bucketcount*sizeof(uint64_t));
+	pvt->_next=new uint64_t[usercount];
+	bytestring::zero(pvt->_next,usercount*sizeof(uint64_t));
+
+	// keep track of the last entry for each user,
+	// so duplicates are chained in configuration order
+	uint64_t	*last=new uint64_t[pvt->_bucketcount];
+
+	for (uint64_t i=0; i<usercount; i++) {
+		uint64_t	b=hashUser(users[i])&(pvt->_bucketcount-1);
+		for (;;) {
+			if (!pvt->_buckets[b]) {
+				pvt->_buckets[b]=i+1;
+				last[b]=i;
+				break;
+			}
+			if (!charstring::compare(
+					users[pvt->_buckets[b]-1],users[i])) {
+				pvt->_next[last[b]]=i+1;
+				last[b]=i;
+				break;
+			}
+			b=(b+1)&(pvt->_bucketcount-1);
+		}
+	}
+
+	delete[] last;
+}
+
+uint64_t sqlrauthcache::getFirstIndex(const char *user) {
+	if (!pvt->_bucketcount || !user) {
+		return pvt->_usercount;
+	}
+	uint64_t	b=hashUser(user)&(pvt->_bucketcount-1);
+	while (pvt->_buckets[b]) {
+		uint64_t	index=pvt->_buckets[b]-1;
+		if (!charstring::compare(pvt->_users[index],user)) {
+			return index;
+		}
+		b=(b+1)&(pvt->_bucketcount-1);
+	}
+	return pvt->_usercount;
+}
+
+uint64_t sqlrauthcache::getNextIndex(uint64_t index) {
+	if (index>=pvt->_usercount || !pvt->_next[index]) {
+		return pvt->_usercount;
+	}
+	return pvt->_next[index]-1;
+}
+
+bool sqlrauthcache::verified(const char *user,
+				const char *response,
+				uint64_t responselength,
+				const char *method,
+				const char *extra,
+				uint64_t index) {
+	unsigned char	d[SQLRAUTHCACHE_DIGESTSIZE];
+	digest(user,response,responselength,method,extra,index,d);
+	sqlrauthcacheentry	*e=&pvt->_entries[d[0]%SQLRAUTHCACHE_SLOTS];
+	return (e->valid && e->index==index &&
+		!bytestring::compare(e->digest,d,SQLRAUTHCACHE_DIGESTSIZE));
+}
+
+void sqlrauthcache::setVerified(const char *user,
+				const char *response,
+				uint64_t responselength,
+				const char *method,
+				const char *extra,
+				uint64_t index) {
+
+	// the cache is direct-mapped, so a new entry
+	// just replaces whatever was in its slot
+	unsigned char	d[SQLRAUTHCACHE_DIGESTSIZE];
+	digest(user,response,responselength,method,extra,index,d);
+	sqlrauthcacheentry	*e=&pvt->_entries[d[0]%SQLRAUTHCACHE_SLOTS];
+	bytestring::copy(e->digest,d,SQLRAUTHCACHE_DIGESTSIZE);
+	e->index=index;
+	e->valid=true;
+}
+
+void sqlrauthcache::clear() {
+	bytestring::zero(pvt->_entries,sizeof(pvt->_entries));
+}
+
+void sqlrauthcache::digest(const char *user,
+				const char *response,
+				uint64_t responselength,
+				const char *method,
+				const char *extra,
+				uint64_t index,
+				unsigned char *result) {
+
+	// each field is prefixed with its length so that
+	// different combinations can't produce the same input
+	sha256		s;
+	uint64_t	len;
+	s.append(pvt->_salt,SQLRAUTHCACHE_SALTSIZE);
+	len=charstring::length(user);
+	s.append((const unsigned char *)&len,sizeof(len));
+	s.append((const unsigned char *)user,len);
+	s.append((const unsigned char *)&responselength,sizeof(len));
+	s.append((const unsigned char *)response,responselength);
+	len=charstring::length(method);
+	s.append((const unsigned char *)&len,sizeof(len));
+	s.append((const unsigned char *)method,len);
+	len=charstring::length(extra);
+	s.append((const unsigned char *)&len,sizeof(len));
+	s.append((const unsigned char *)extra,len);
+	s.append((const unsigned char *)&index,sizeof(index));
+	bytestring::copy(result,s.getHash(),SQLRAUTHCACHE_DIGESTSIZE);
+}
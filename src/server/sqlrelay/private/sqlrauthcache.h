@@ -0,0 +1,13 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		void	digest(const char *user,
+				const char *response,
+				uint64_t responselength,
+				const char *method,
+				const char *extra,
+				uint64_t index,
+				unsigned char *result);
+
+		sqlrauthcacheprivate	*pvt;
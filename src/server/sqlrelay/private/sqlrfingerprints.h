@@ -0,0 +1,10 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		sqlrfingerprintstats	*find(uint64_t fingerprint,
+						const char *text);
+		static void	add(sqlrfingerprintstats *to,
+					const sqlrfingerprintstats *from);
+
+		sqlrfingerprintsprivate	*pvt;
@@ -10,6 +10,9 @@
 		void	setSessionHandlerMethod();
 		void	setHandoffMethod();
 		void	setIpPermissions();
+		sqlriplist	*newIpList(const char *ips);
+		void	warnPartialIps(const char *directive,
+						const char *ips);
 		bool	createSharedMemoryAndSemaphores(const char *id);
 		void	ipcFileError(const char *idfilename);
 		void	keyError(const char *idfilename);
@@ -19,20 +22,48 @@
 		bool	listenOnClientSockets();
 		bool	listenOnClientSocket(uint16_t protocolindex,
 							domnode *ln);
+		bool	listenOnInetSocket(inetsocketserver *iss,
+						const char *address,
+						uint16_t port);
+		void	setAcceptors();
+		bool	startAcceptors();
+		void	stopAcceptors();
+		static void	acceptorThread(void *attr);
+		void	acceptorLoop(acceptorthread *at);
+		void	acceptClients(acceptorthread *at,
+						filedescriptor *fd);
 		bool	listenOnHandoffSocket(const char *id);
 		bool	listenOnDeregistrationSocket(const char *id);
 		bool	listenOnFixupSocket(const char *id);
+		bool	listenOnReleaseSocket(const char *id);
 		filedescriptor	*waitForTraffic();
 		bool	handleTraffic(filedescriptor *fd);
 		bool	registerHandoff(filedescriptor *sock);
 		bool	deRegisterHandoff(filedescriptor *sock);
 		bool	fixup(filedescriptor *sock);
-		bool	deniedIp(filedescriptor *clientsock);
+		bool	parkSession(filedescriptor *sock);
+		void	expirePooledSessions();
+		bool	handleClient(filedescriptor *clientsock,
+					uint16_t protocolindex,
+					bool inet,
+					regularexpression *denied,
+					regularexpression *allowed);
+		bool	deniedIp(filedescriptor *clientsock,
+					regularexpression *denied,
+					regularexpression *allowed);
+		bool	getPeerAddress(filedescriptor *clientsock,
+					unsigned char *address,
+					uint16_t *addresslength);
+		bool	isDeniedIp(const char *ip,
+					regularexpression *denied,
+					regularexpression *allowed);
 		void	forkChild(filedescriptor *clientsock,
-					uint16_t protocolindex);
+					uint16_t protocolindex,
+					pooledsessionnode *session);
 		static void	clientSessionThread(void *attr);
 		void	clientSession(filedescriptor *clientsock,
 					uint16_t protocolindex,
+					pooledsessionnode *session,
 					thread *thr);
 		void    errorClientSession(filedescriptor *clientsock,
 					int64_t errnum, const char *err);
@@ -47,11 +78,19 @@
 		void	waitForConnectionToBeReadyForHandoff();
 		bool	handOffOrProxyClient(filedescriptor *sock,
 					uint16_t protocolindex,
+					pooledsessionnode *session,
 					thread *thr);
+		bool	peekClientUser(filedescriptor *sock,
+					uint16_t protocolindex,
+					char *user);
+		bool	pickIdleConnection(const char *user,
+					uint32_t *connectionpid,
+					char *connectionid);
 		bool	getAConnection(uint32_t *connectionpid,
 					uint16_t *inetport,
 					char *unixportstr,
 					uint16_t *unixportstrlen,
+					const char *user,
 					filedescriptor *sock,
 					thread *thr);
 		bool	findMatchingSocket(uint32_t connectionpid,
@@ -61,6 +100,31 @@
 		bool	proxyClient(pid_t connectionpid,
 					filedescriptor *connectionsock,
 					filedescriptor *clientsock);
+		bool	startProxyEngine();
+		void	stopProxyEngine();
+		static void	proxyEngineThread(void *attr);
+		void	proxyEngineLoop(proxyenginethread *pet);
+		bool	addProxiedSession(filedescriptor *serversock,
+					filedescriptor *clientsock);
+		void	handleProxiedSessionEvent(proxyenginethread *pet,
+					proxiedsession *ps,
+					bool client,
+					uint32_t events,
+					uint64_t now);
+		bool	spliceProxiedData(proxiedsession *ps,
+					bool fromclient,
+					uint64_t now);
+		bool	drainProxiedData(proxiedsession *ps,
+					bool fromclient,
+					uint64_t now);
+		void	updateProxiedSessionEvents(proxyenginethread *pet,
+					proxiedsession *ps);
+		void	endProxiedSession(proxyenginethread *pet,
+					proxiedsession *ps);
+		bool	flushProxiedEndSession(proxiedsession *ps,
+					uint64_t now);
+		void	closeProxiedSession(proxyenginethread *pet,
+					proxiedsession *ps);
 		bool	connectionIsUp(const char *connectionid);
 		void	pingDatabase(uint32_t connectionpid,
 					const char *unixportstr,
@@ -81,6 +145,8 @@
 		void		incrementBusyListeners();
 		void		decrementBusyListeners();
 		int32_t		getBusyListeners();
+		void		incrementProxiedSessions();
+		void		decrementProxiedSessions();
 
 		void	raiseDebugMessageEvent(const char *info);
 		void	raiseClientProtocolErrorEvent(const char *info,
@@ -0,0 +1,5 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		sqlrmemorybudgetprivate	*pvt;
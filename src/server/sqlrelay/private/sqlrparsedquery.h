@@ -0,0 +1,17 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		void		addToken(const char *text, uint32_t length,
+						sqlrtokentype_t type,
+						sqlrkeyword_t keyword,
+						uint32_t depth);
+		void		*allocate(size_t size);
+		void		classify();
+		void		findTables();
+		uint32_t	addTable(uint32_t index);
+		uint32_t	skipParens(uint32_t index);
+		bool		isPunctuation(uint32_t index, char c);
+		bool		isFunctionArgument(uint32_t index);
+
+		sqlrparsedqueryprivate	*pvt;
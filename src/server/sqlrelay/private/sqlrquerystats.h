@@ -0,0 +1,12 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		static void	addBucket(sqlrqpmbucket *to,
+						const sqlrqpmbucket *from);
+		static void	addRecentBuckets(sqlrqpmbucket *to,
+						const sqlrqpmbucket *from,
+						uint32_t minute,
+						uint16_t minutes);
+
+		sqlrquerystatsprivate	*pvt;
@@ -32,6 +32,7 @@
 		void	initSession();
 
 		bool	announceAvailability(const char *connectionid);
+		bool	announceIdle(const char *connectionid);
 
 		bool	registerForHandoff();
 		void	deRegisterForHandoff();
@@ -39,6 +40,11 @@
 		int32_t	waitForClient();
 		bool	getProtocol();
 		void	clientSession();
+		bool	receiveSessionState();
+		void	resumeSession();
+		void	releaseSession();
+		bool	isSessionStateQuery(const char *query);
+		bool	sessionIsDirty();
 
 		bool	beginFakeTransactionBlock();
 		void	endTransaction(bool commit);
@@ -101,12 +107,21 @@
 
 		void	closeCursors(bool destroy);
 
+		bool	prepareQueryUsingStatementCache(
+						sqlrservercursor *cursor,
+						const char *query,
+						uint32_t querylen);
+		void	releaseCachedStatement(sqlrservercursor *cursor);
+		void	evictCachedStatement();
+		void	flushStatementCache();
+
 		bool	createSharedMemoryAndSemaphores(const char *id);
 
 		void	decrementConnectedClientCount();
 
 		bool	acquireAnnounceMutex();
 		void	releaseAnnounceMutex();
+		bool	waitForSemaphore(int32_t index, bool withundo);
 
 		void	signalListenerToRead();
 		void	unSignalListenerToRead();
@@ -121,10 +136,48 @@
 		void	initConnStats();
 		void	clearConnStats();
 
+		bool		tracing();
+		void		attachTrace();
+		void		detachTrace();
+		void		trace(sqlrtracephase_t phase,
+					uint32_t command,
+					uint16_t cursorid,
+					uint64_t start,
+					uint64_t end);
+
+		void		countFingerprint(sqlrservercursor *cursor,
+							bool success);
+		void		finishFingerprint(sqlrservercursor *cursor);
+		void		flushFingerprints();
+
+		bool		fetchNextRow(sqlrservercursor *cursor,
+							bool *error);
+		bool		fetchRowFromCursor(sqlrservercursor *cursor,
+							bool *error);
+		uint64_t	rowBytes(sqlrservercursor *cursor);
+
+		bool		reserveQueryMemory(sqlrservercursor *cursor);
+		void		clearPool(memorypool **pool, uint64_t *shrinks);
+
+		bool		shouldSpool(sqlrservercursor *cursor,
+							sqlrspool *spool);
+		bool		spoolResultSet(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							bool *error);
+		bool		spoolLobField(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							uint32_t col);
+		bool		fetchSpooledRow(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							bool *error);
+		bool		resultSetIsSpooled(sqlrservercursor *cursor);
+		void		clearSpool(sqlrservercursor *cursor);
+
 		sqlrparser	*newParser();
 
 		void	setClientSessionStartTime();
 		void	setClientAddr();
+		void	setCurrentDbUser();
 
 
 		void	sessionStartQueries();
@@ -149,5 +202,13 @@
 					linkedlist<char *> *columns);
 
 		static void     alarmHandler(int32_t signum);
+		static void     reloadHandler(int32_t signum);
+
+		void	loadChain(uint16_t chain, sqlrconfig *cfg);
+		void	reloadConfig();
+		void	reloadConnectString();
+		bool	reloadIfDue();
+		int32_t	getReloadTimeout();
+		void	retireConfigs();
 
 		sqlrservercontrollerprivate	*pvt;
@@ -7,6 +7,7 @@
 #include <rudiments/thread.h>
 #include <rudiments/memorypool.h>
 #include <rudiments/stringbuffer.h>
+#include <rudiments/bytebuffer.h>
 #include <rudiments/datetime.h>
 #include <rudiments/singlylinkedlist.h>
 #include <rudiments/dictionary.h>
@@ -30,6 +31,22 @@
 #include <sqlrelay/private/sqlrshm.h>
 
 class sqlrlistenerprivate;
+class pooledsessionnode;
+class proxiedsession;
+class proxyenginethread;
+class acceptorthread;
+class sqlrquerystats;
+class sqlrquerystatsprivate;
+class sqlrparsedquery;
+class sqlrparsedqueryprivate;
+class sqlrfingerprints;
+class sqlrfingerprintsprivate;
+class sqlrspool;
+class sqlrspoolprivate;
+class sqlrfetchbatch;
+class sqlrfetchbatchprivate;
+class sqlrmemorybudget;
+class sqlrmemorybudgetprivate;
 class sqlrservercontrollerprivate;
 class sqlrserverconnection;
 class sqlrserverconnectionprivate;
@@ -47,6 +64,8 @@ class sqlrauth;
 class sqlrauthprivate;
 class sqlrauths;
 class sqlrauthsprivate;
+class sqlrauthcache;
+class sqlrauthcacheprivate;
 class sqlrpwdenc;
 class sqlrpwdencprivate;
 class sqlrpwdencs;
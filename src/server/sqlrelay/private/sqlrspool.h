@@ -0,0 +1,10 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+	private:
+		bool		readBytes(void *buffer, uint64_t size);
+		bool		skipBytes(uint64_t size);
+		bool		writeFieldHeader(unsigned char flags,
+							uint64_t length);
+
+		sqlrspoolprivate	*pvt;
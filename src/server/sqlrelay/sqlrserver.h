@@ -111,6 +111,353 @@ class SQLRSERVER_DLLSPEC sqlrserverbindvar {
 		int16_t			isnull;
 };
 
+class SQLRSERVER_DLLSPEC sqlrquerystats {
+	public:
+		sqlrquerystats(sqlrshm *shm);
+		~sqlrquerystats();
+
+		// called by the connection that owns the slot, without locking
+		static void	countQuery(sqlrconnstatistics *cs,
+						sqlrquerytype_t querytype,
+						uint32_t minute);
+		static void	countError(sqlrconnstatistics *cs);
+
+		// folds the slot into the instance totals and clears it,
+		// the caller must hold semaphore 9
+		void		retire(sqlrconnstatistics *cs);
+
+		uint64_t	getTotalQueries();
+		uint64_t	getTotalErrors();
+		void		getQueriesPerMinute(uint32_t minute,
+							uint16_t minutes,
+							sqlrqpmbucket *counts);
+
+	#include <sqlrelay/private/sqlrquerystats.h>
+};
+
+enum sqlrtokentype_t {
+	SQLRTOKENTYPE_KEYWORD=0,
+	SQLRTOKENTYPE_IDENTIFIER,
+	SQLRTOKENTYPE_STRING,
+	SQLRTOKENTYPE_NUMBER,
+	SQLRTOKENTYPE_BIND,
+	SQLRTOKENTYPE_OPERATOR,
+	SQLRTOKENTYPE_PUNCTUATION
+};
+
+// keep these in alphabetical order, they're looked up with a binary search
+enum sqlrkeyword_t {
+	SQLRKEYWORD_NONE=0,
+	SQLRKEYWORD_ALL,
+	SQLRKEYWORD_ALTER,
+	SQLRKEYWORD_AND,
+	SQLRKEYWORD_AS,
+	SQLRKEYWORD_ASC,
+	SQLRKEYWORD_BEGIN,
+	SQLRKEYWORD_BETWEEN,
+	SQLRKEYWORD_BY,
+	SQLRKEYWORD_CALL,
+	SQLRKEYWORD_CASE,
+	SQLRKEYWORD_COMMIT,
+	SQLRKEYWORD_CREATE,
+	SQLRKEYWORD_CROSS,
+	SQLRKEYWORD_DELETE,
+	SQLRKEYWORD_DESC,
+	SQLRKEYWORD_DISTINCT,
+	SQLRKEYWORD_DROP,
+	SQLRKEYWORD_ELSE,
+	SQLRKEYWORD_END,
+	SQLRKEYWORD_EXCEPT,
+	SQLRKEYWORD_EXEC,
+	SQLRKEYWORD_EXECUTE,
+	SQLRKEYWORD_EXISTS,
+	SQLRKEYWORD_FOR,
+	SQLRKEYWORD_FROM,
+	SQLRKEYWORD_FULL,
+	SQLRKEYWORD_GROUP,
+	SQLRKEYWORD_HAVING,
+	SQLRKEYWORD_IF,
+	SQLRKEYWORD_IN,
+	SQLRKEYWORD_INDEX,
+	SQLRKEYWORD_INNER,
+	SQLRKEYWORD_INSERT,
+	SQLRKEYWORD_INTERSECT,
+	SQLRKEYWORD_INTO,
+	SQLRKEYWORD_IS,
+	SQLRKEYWORD_JOIN,
+	SQLRKEYWORD_LEFT,
+	SQLRKEYWORD_LIKE,
+	SQLRKEYWORD_LIMIT,
+	SQLRKEYWORD_LOCK,
+	SQLRKEYWORD_MERGE,
+	SQLRKEYWORD_NATURAL,
+	SQLRKEYWORD_NOT,
+	SQLRKEYWORD_NULL,
+	SQLRKEYWORD_OFFSET,
+	SQLRKEYWORD_ON,
+	SQLRKEYWORD_OR,
+	SQLRKEYWORD_ORDER,
+	SQLRKEYWORD_OUTER,
+	SQLRKEYWORD_REPLACE,
+	SQLRKEYWORD_RETURNING,
+	SQLRKEYWORD_RIGHT,
+	SQLRKEYWORD_ROLLBACK,
+	SQLRKEYWORD_SELECT,
+	SQLRKEYWORD_SET,
+	SQLRKEYWORD_SHARE,
+	SQLRKEYWORD_START,
+	SQLRKEYWORD_TABLE,
+	SQLRKEYWORD_THEN,
+	SQLRKEYWORD_TRANSACTION,
+	SQLRKEYWORD_TRUNCATE,
+	SQLRKEYWORD_UNION,
+	SQLRKEYWORD_UPDATE,
+	SQLRKEYWORD_USING,
+	SQLRKEYWORD_VALUES,
+	SQLRKEYWORD_VIEW,
+	SQLRKEYWORD_WHEN,
+	SQLRKEYWORD_WHERE,
+	SQLRKEYWORD_WITH,
+	SQLRKEYWORD_WORK
+};
+
+struct sqlrtoken {
+	// points into the query, it isn't null-terminated
+	const char	*text;
+	uint32_t	length;
+	sqlrtokentype_t	type;
+	sqlrkeyword_t	keyword;
+	// parenthesis nesting depth
+	uint32_t	depth;
+};
+
+class SQLRSERVER_DLLSPEC sqlrparsedquery {
+	public:
+		sqlrparsedquery();
+		~sqlrparsedquery();
+
+		// treat backslashes in strings as escapes (mysql-style)
+		void		setBackslashEscapes(bool backslashescapes);
+
+		// the tokens point into the query, so it must
+		// not change until the query is parsed again
+		bool		parse(const char *query, uint32_t length);
+		void		clear();
+
+		const char	*getQuery();
+		uint32_t	getQueryLength();
+
+		sqlrquerytype_t	getQueryType();
+
+		uint32_t		getTokenCount();
+		const sqlrtoken		*getToken(uint32_t index);
+
+		// qualified names (schema.table) are returned as one token
+		uint32_t		getTableCount();
+		const sqlrtoken		*getTable(uint32_t index);
+
+		uint32_t		getBindCount();
+		const sqlrtoken		*getBind(uint32_t index);
+
+		bool		hasKeyword(sqlrkeyword_t keyword);
+
+		static const char	*getKeywordName(sqlrkeyword_t keyword);
+		static sqlrkeyword_t	getKeyword(const char *word,
+							uint32_t length);
+
+	#include <sqlrelay/private/sqlrparsedquery.h>
+};
+
+class SQLRSERVER_DLLSPEC sqlrfingerprints {
+	public:
+		sqlrfingerprints(sqlrshm *shm);
+		~sqlrfingerprints();
+
+		// writes the query, with literals and bind variables replaced
+		// by ?, lists of them collapsed, keywords and identifiers
+		// lower-cased and whitespace collapsed, to "normalized" and
+		// returns a hash of it
+		static uint64_t	fingerprint(sqlrparsedquery *pq,
+						stringbuffer *normalized);
+
+		// adds to this process' totals for the fingerprint,
+		// without locking, and returns true if it's time to flush
+		bool		count(uint64_t fingerprint,
+					const char *text,
+					uint64_t calls,
+					uint64_t errors,
+					uint64_t rows,
+					uint64_t executeusec,
+					uint64_t fetchusec);
+
+		// merges this process' totals into the table in shared
+		// memory and clears them, the caller must hold semaphore 9
+		void		flush();
+
+		// copies the table in shared memory, sorted by total
+		// execute time, into "stats", which must have room for
+		// STATFINGERPRINTS entries, and returns the number copied
+		uint32_t	getSorted(sqlrfingerprintstats *stats);
+
+	#include <sqlrelay/private/sqlrfingerprints.h>
+};
+
+class SQLRSERVER_DLLSPEC sqlrspool {
+	public:
+		sqlrspool();
+		~sqlrspool();
+
+		// discards any spooled rows and starts watching a new result
+		// set, which started at "start" (in traceClock() nanoseconds)
+		void		clear(uint64_t start);
+
+		// adds the size of a row that was fetched from the
+		// database to the size of the result set so far
+		void		countRow(uint64_t bytes);
+		uint64_t	getResultSetBytes();
+		uint64_t	getResultSetStart();
+
+		// creates a spool file in "dir", which is removed right away,
+		// so it goes away when it's closed, or if the process dies
+		bool		create(const char *dir, uint16_t id);
+
+		// appends a field to the current row, or ends the row
+		bool		writeField(const char *field,
+						uint64_t fieldlength,
+						bool blob,
+						bool null);
+		void		endRow();
+
+		// appends a lob field to the current row, a segment at a
+		// time, the length is written as a placeholder and filled in
+		// when the field is ended, so the lob is never held in memory
+		bool		beginLobField();
+		bool		writeLobSegment(const char *segment,
+							uint64_t length);
+		bool		endLobField(bool null);
+
+		// ends writing and rewinds, so rows can be read back
+		bool		finishWriting();
+
+		// reads the next row back, the fields are valid until the
+		// next call, returns false at the end or if an error occurred
+		//
+		// lobs are left in the file and returned as empty fields,
+		// use getLobLength() and readLobSegment() to read them
+		bool		readRow(uint32_t colcount,
+						const char **fields,
+						uint64_t *fieldlengths,
+						bool *blobs,
+						bool *nulls,
+						bool *error);
+
+		// reads a segment of a lob in the current row
+		uint64_t	getLobLength(uint32_t col);
+		bool		readLobSegment(uint32_t col,
+						char *buffer,
+						uint64_t length,
+						uint64_t offset,
+						uint64_t *bytesread);
+
+		// returns the number of bytes that the spool's buffers have
+		// grown by since the last call, so that they can be counted
+		// against the connection's memory budget
+		uint64_t	getNewBufferBytes();
+
+		// true if the current result set is being served from the
+		// spool rather than from the database
+		bool		isActive();
+
+		uint64_t	getRowCount();
+		uint64_t	getSize();
+
+	#include <sqlrelay/private/sqlrspool.h>
+};
+
+class SQLRSERVER_DLLSPEC sqlrfetchbatch {
+	public:
+		sqlrfetchbatch();
+		~sqlrfetchbatch();
+
+		// sets the most rows that can be fetched at once (the size
+		// of the cursor's buffers) and the most bytes of data that
+		// a batch should contain (0 for no limit)
+		void		setMaxRows(uint32_t maxrows);
+		void		setMaxBytes(uint64_t maxbytes);
+
+		// starts sizing batches for a new result set
+		void		reset();
+
+		// returns the number of rows to fetch in the next batch
+		uint32_t	getRows();
+
+		// adds the size of a row that was fetched to the
+		// total, so the average row size is known
+		void		countRow(uint64_t bytes);
+
+		// sizes the next batch, given that the last one
+		// returned "rows" rows and took "nsec" nanoseconds
+		void		fetched(uint32_t rows, uint64_t nsec);
+
+	#include <sqlrelay/private/sqlrfetchbatch.h>
+};
+
+enum sqlrmemorycategory_t {
+	// buffers allocated when the cursor is opened
+	SQLRMEMORY_CURSORS=0,
+	// query text and parsed queries
+	SQLRMEMORY_QUERIES,
+	// bind variable values, other than lobs
+	SQLRMEMORY_BINDS,
+	// lob bind variable values
+	SQLRMEMORY_LOBS,
+	// buffers that rows are fetched into
+	SQLRMEMORY_FETCH,
+	SQLRMEMORY_CATEGORIES
+};
+
+class SQLRSERVER_DLLSPEC sqlrmemorybudget {
+	public:
+		sqlrmemorybudget();
+		~sqlrmemorybudget();
+
+		// sets the limits, 0 for no limit
+		void		setSoftLimit(uint64_t softlimit);
+		void		setHardLimit(uint64_t hardlimit);
+		uint64_t	getSoftLimit();
+		uint64_t	getHardLimit();
+
+		// statistics are written to "cs", if it's set
+		void		setStatistics(sqlrconnstatistics *cs);
+
+		// counts memory that has to be allocated regardless
+		void		count(sqlrmemorycategory_t category,
+							uint64_t bytes);
+
+		// counts memory, unless doing so would exceed the hard
+		// limit, in which case it returns false and counts nothing
+		bool		reserve(sqlrmemorycategory_t category,
+							uint64_t bytes);
+
+		// uncounts memory that was counted or reserved
+		void		release(sqlrmemorycategory_t category,
+							uint64_t bytes);
+
+		uint64_t	getUsed();
+		uint64_t	getUsed(sqlrmemorycategory_t category);
+		uint64_t	getPeak();
+
+		// returns true if usage has gone over the soft limit since
+		// the last time this was called with the same "seen" value,
+		// and updates "seen"
+		bool		shouldShrink(uint64_t *seen);
+
+		// counts pools and buffers that were shrunk
+		void		countShrink();
+
+	#include <sqlrelay/private/sqlrmemorybudget.h>
+};
+
 class SQLRSERVER_DLLSPEC sqlrservercontroller {
 	public:
 		sqlrservercontroller();
@@ -170,6 +517,12 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 						uint16_t *inetport);
 		void	endSession();
 
+		// session pooling
+		bool	getSessionPooling();
+		bool	sessionCanBeReleased();
+		void	pinSession(const char *reason);
+		bool	getSessionPinned();
+
 		// ping
 		bool	ping();
 
@@ -194,9 +547,20 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 		void		setFetchAtOnce(uint32_t fethatonce);
 		void		setMaxColumnCount(uint32_t maxcolumncount);
 		void		setMaxFieldLength(uint32_t maxfieldlength);
+		void		setAdaptiveFetch(bool adaptivefetch);
+		void		setFetchBatchBytes(uint64_t fetchbatchbytes);
 		uint32_t	getFetchAtOnce();
 		uint32_t	getMaxColumnCount();
 		uint32_t	getMaxFieldLength();
+		bool		getAdaptiveFetch();
+		uint64_t	getFetchBatchBytes();
+
+		// a monotonic clock (where available), in nanoseconds
+		uint64_t	traceClock();
+
+		// statement cache
+		void		setStatementCacheSize(uint32_t stmtcachesize);
+		uint32_t	getStatementCacheSize();
 
 		// db selection
 		bool	selectDatabase(const char *db);
@@ -310,6 +674,13 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 		void	incrementReLogInCount();
 		void	incrementNextResultSetCount();
 		void	incrementNextResultSetAvailableCount();
+		void	incrementStatementCacheHitCount();
+		void	incrementStatementCacheMissCount();
+		void	incrementReleaseSessionCount();
+		void	incrementResumeSessionCount();
+		void	incrementPinSessionCount();
+		void	incrementSkippedSessionResetCount();
+		void	incrementSkippedSessionQueriesCount();
 		uint32_t	getStatisticsIndex();
 
 
@@ -393,6 +764,7 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 
 		// query translations
 		xmldom		*getQueryTree(sqlrservercursor *cursor);
+		sqlrparsedquery	*getParsedQuery(sqlrservercursor *cursor);
 		const char	*getTranslatedQuery(sqlrservercursor *cursor);
 
 		// running queries
@@ -417,6 +789,7 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 
 		// bind variables
 		memorypool	*getBindPool(sqlrservercursor *cursor);
+		void		clearBindPool(sqlrservercursor *cursor);
 		memorypool	*getBindMappingsPool(sqlrservercursor *cursor);
 		dictionary<char *, char *>	*getBindMappings(
 						sqlrservercursor *cursor);
@@ -770,6 +1143,9 @@ class SQLRSERVER_DLLSPEC sqlrservercontroller {
 		memorypool	*getPerTransactionMemoryPool();
 		memorypool	*getPerSessionMemoryPool();
 
+		// memory budget
+		sqlrmemorybudget	*getMemoryBudget();
+
 		// query parser
 		sqlrparser	*getParser();
 
@@ -982,6 +1358,9 @@ class SQLRSERVER_DLLSPEC sqlrserverconnection {
 		virtual bool		isSynonym(const char *table);
 		virtual const char	*isSynonymQuery();
 
+		virtual bool		supportsStatementCache();
+		virtual void		freeStatement(void *stmt);
+
 		virtual sqlrservercursor	*newCursor(uint16_t id)=0;
 		virtual void			deleteCursor(
 						sqlrservercursor *curs)=0;
@@ -1024,6 +1403,8 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		virtual	bool	isCustomQuery();
 		virtual	bool	prepareQuery(const char *query,
 							uint32_t length);
+		virtual	void	*detachStatement();
+		virtual	bool	attachStatement(void *stmt);
 		virtual	bool	supportsNativeBinds(const char *query,
 							uint32_t length);
 		virtual	bool	inputBind(const char *variable, 
@@ -1241,6 +1622,7 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		bool		fakeInputBinds();
 
 		memorypool	*getBindPool();
+		void		clearBindPool();
 		memorypool	*getBindMappingsPool();
 		dictionary<char *, char *>	*getBindMappings();
 
@@ -1261,6 +1643,9 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 							int16_t index);
 		void	abort();
 
+		void		setStatementCacheKey(const char *key);
+		const char	*getStatementCacheKey();
+
 		char		*getQueryBuffer();
 		uint32_t 	getQueryLength();
 		void		setQueryLength(uint32_t querylength);
@@ -1272,6 +1657,30 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		xmldom		*getQueryTree();
 		void		clearQueryTree();
 
+		sqlrparsedquery	*getParsedQuery();
+		void		shrinkParsedQuery();
+
+		// modules count the buffers that they allocate for the
+		// cursor against the connection's memory budget, buffers
+		// that are allocated when the cursor is opened are counted
+		// with countMemory(), buffers that are allocated for a
+		// particular query are reserved with reserveMemory(), which
+		// sets an error and returns false if the connection's hard
+		// memory limit would be exceeded
+		void		countMemory(sqlrmemorycategory_t category,
+							uint64_t bytes);
+		bool		reserveMemory(sqlrmemorycategory_t category,
+							uint64_t bytes);
+		void		releaseMemory(sqlrmemorycategory_t category,
+							uint64_t bytes);
+
+		// memory reserved for the current query (its text and bind
+		// values) replaces the memory reserved for the previous one
+		bool		reserveQueryMemory(
+					sqlrmemorycategory_t category,
+					uint64_t bytes);
+		void		releaseQueryMemory();
+
 		stringbuffer	*getTranslatedQueryBuffer();
 
 		void		setCommandStart(uint64_t sec, uint64_t usec);
@@ -1302,6 +1711,18 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		void		tallyFetchTime();
 		uint64_t	getFetchUSec();
 
+		// fingerprint of the current query (0 if it hasn't been
+		// computed yet) and the normalized query that it's a hash of
+		void		setFingerprint(uint64_t fingerprint);
+		uint64_t	getFingerprint();
+		stringbuffer	*getFingerprintText();
+
+		// fingerprint of the query that was executed last, set until
+		// its rows and fetch time are added to the fingerprint's
+		// totals, which might be after the query is replaced
+		void		setPendingFingerprint(uint64_t fingerprint);
+		uint64_t	getPendingFingerprint();
+
 		void			setState(sqlrcursorstate_t state);
 		sqlrcursorstate_t	getState();
 
@@ -1312,6 +1733,13 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		void		clearTotalRowsFetched();
 		uint64_t	getTotalRowsFetched();
 		void		incrementTotalRowsFetched();
+		void		setTotalRowsFetched(uint64_t rows);
+
+		// spool that the rest of the result set is moved to if it
+		// gets too large, or the client is too slow to fetch it,
+		// deleted along with the cursor
+		void		setSpool(sqlrspool *spool);
+		sqlrspool	*getSpool();
 
 		void		setCurrentRowReformatted(bool crr);
 		bool		getCurrentRowReformatted();
@@ -1335,6 +1763,9 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		void	setQueryHasBeenPreProcessed(bool preprocessed);
 		bool	getQueryHasBeenPreProcessed();
 
+		void	setQueryHasBeenParsed(bool parsed);
+		bool	getQueryHasBeenParsed();
+
 		void	setQueryHasBeenPrepared(bool prepared);
 		bool	getQueryHasBeenPrepared();
 
@@ -1415,6 +1846,16 @@ class SQLRSERVER_DLLSPEC sqlrservercursor {
 		void		setFetchAtOnce(uint32_t fetchatonce);
 		uint32_t	getFetchAtOnce();
 
+		// modules call startFetchBatch() for the number of rows to
+		// fetch in each round trip (fetchatonce, unless adaptivefetch
+		// is enabled, in which case it's never more than fetchatonce)
+		// and endFetchBatch() with the number that were fetched
+		bool		getAdaptiveFetch();
+		uint32_t	startFetchBatch();
+		void		endFetchBatch(uint32_t rows);
+		void		countFetchedRow(uint64_t bytes);
+		void		resetFetchBatch();
+
 		void		setResultSetHeaderHasBeenHandled(
 					bool resultsetheaderhasbeenhandled);
 		bool		getResultSetHeaderHasBeenHandled();
@@ -1430,7 +1871,8 @@ enum clientsessionexitstatus_t {
 	CLIENTSESSIONEXITSTATUS_ERROR=0,
 	CLIENTSESSIONEXITSTATUS_CLOSED_CONNECTION,
 	CLIENTSESSIONEXITSTATUS_ENDED_SESSION,
-	CLIENTSESSIONEXITSTATUS_SUSPENDED_SESSION
+	CLIENTSESSIONEXITSTATUS_SUSPENDED_SESSION,
+	CLIENTSESSIONEXITSTATUS_RELEASED_SESSION
 };
 
 class SQLRSERVER_DLLSPEC sqlrprotocol {
@@ -1452,6 +1894,11 @@ class SQLRSERVER_DLLSPEC sqlrprotocol {
 		virtual void	endTransaction(bool commit);
 		virtual void	endSession();
 
+		virtual bool	supportsSessionPooling();
+		virtual void	getSessionState(bytebuffer *state);
+		virtual void	setSessionState(const unsigned char *state,
+							size_t statelength);
+
 	protected:
 		sqlrprotocols		*getProtocols();
 		domnode			*getParameters();
@@ -1792,6 +2239,33 @@ class SQLRSERVER_DLLSPEC sqlrauths {
 	#include <sqlrelay/private/sqlrauths.h>
 };
 
+class SQLRSERVER_DLLSPEC sqlrauthcache {
+	public:
+		sqlrauthcache();
+		~sqlrauthcache();
+
+		void		setUsers(const char * const *users,
+						uint64_t usercount);
+		uint64_t	getFirstIndex(const char *user);
+		uint64_t	getNextIndex(uint64_t index);
+
+		bool	verified(const char *user,
+					const char *response,
+					uint64_t responselength,
+					const char *method,
+					const char *extra,
+					uint64_t index);
+		void	setVerified(const char *user,
+					const char *response,
+					uint64_t responselength,
+					const char *method,
+					const char *extra,
+					uint64_t index);
+		void	clear();
+
+	#include <sqlrelay/private/sqlrauthcache.h>
+};
+
 class SQLRSERVER_DLLSPEC sqlrpwdenc {
 	public:
 		sqlrpwdenc(domnode *parameters, bool debug);
@@ -2041,6 +2515,7 @@ class SQLRSERVER_DLLSPEC sqlrrouter {
 
 		virtual	bool	routeEntireSession();
 
+		virtual void	beginTransaction();
 		virtual void	endTransaction(bool commit);
 		virtual void	endSession();
 
@@ -2069,6 +2544,7 @@ class SQLRSERVER_DLLSPEC sqlrrouters {
 						int64_t *errn);
 		bool	routeEntireSession();
 
+		void	beginTransaction();
 		void	endTransaction(bool commit);
 		void	endSession();
 
@@ -2100,6 +2576,10 @@ class SQLRSERVER_DLLSPEC sqlrparser {
 
 		virtual void	getMetaData(domnode *node);
 
+		virtual	bool	tokenize(const char *query,
+					uint32_t length,
+					sqlrparsedquery *result);
+
 		virtual void	endSession();
 
 	protected:
@@ -0,0 +1,106 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+
+// Batches start at this many rows (or at the most that can be fetched at
+// once, if that's fewer) and double while doing so makes each row cheaper
+// to fetch, which is the case as long as the round trip to the database is
+// a significant part of the time that a batch takes.  Once it isn't,
+// larger batches just hold more data at once.
+#define FETCHBATCHSTART 10
+
+// a batch has to be at least this much cheaper per row than the one before
+// it, in tenths, for the batches to keep growing
+#define FETCHBATCHGAIN 1
+
+class sqlrfetchbatchprivate {
+	friend class sqlrfetchbatch;
+	private:
+		uint32_t	_maxrows;
+		uint64_t	_maxbytes;
+
+		uint32_t	_rows;
+		bool		_growing;
+		uint64_t	_rowcost;
+
+		uint64_t	_fetchedrows;
+		uint64_t	_fetchedbytes;
+};
+
+sqlrfetchbatch::sqlrfetchbatch() {
+	pvt=new sqlrfetchbatchprivate;
+	pvt->_maxrows=1;
+	pvt->_maxbytes=0;
+	reset();
+}
+
+sqlrfetchbatch::~sqlrfetchbatch() {
+	delete pvt;
+}
+
+void sqlrfetchbatch::setMaxRows(uint32_t maxrows) {
+	pvt->_maxrows=(maxrows)?maxrows:1;
+	if (pvt->_rows>pvt->_maxrows) {
+		pvt->_rows=pvt->_maxrows;
+	}
+}
+
+void sqlrfetchbatch::setMaxBytes(uint64_t maxbytes) {
+	pvt->_maxbytes=maxbytes;
+}
+
+void sqlrfetchbatch::reset() {
+	pvt->_rows=(pvt->_maxrows<FETCHBATCHSTART)?
+				pvt->_maxrows:FETCHBATCHSTART;
+	pvt->_growing=true;
+	pvt->_rowcost=0;
+	pvt->_fetchedrows=0;
+	pvt->_fetchedbytes=0;
+}
+
+uint32_t sqlrfetchbatch::getRows() {
+	return pvt->_rows;
+}
+
+void sqlrfetchbatch::countRow(uint64_t bytes) {
+	pvt->_fetchedrows++;
+	pvt->_fetchedbytes+=bytes;
+}
+
+void sqlrfetchbatch::fetched(uint32_t rows, uint64_t nsec) {
+
+	// a short batch is the end of the result set
+	if (!rows || rows<pvt->_rows) {
+		return;
+	}
+
+	// grow the batch while it's paying off
+	uint64_t	rowcost=nsec/rows;
+	uint64_t	next=pvt->_rows;
+	if (pvt->_growing) {
+		if (!pvt->_rowcost ||
+			rowcost*10<pvt->_rowcost*(10-FETCHBATCHGAIN)) {
+			next*=2;
+		} else {
+			pvt->_growing=false;
+		}
+	}
+	pvt->_rowcost=rowcost;
+
+	// keep the batch within the byte limit, given the average row size
+	if (pvt->_maxbytes && pvt->_fetchedrows) {
+		uint64_t	rowbytes=pvt->_fetchedbytes/pvt->_fetchedrows;
+		if (rowbytes && next*rowbytes>pvt->_maxbytes) {
+			next=pvt->_maxbytes/rowbytes;
+		}
+	}
+
+	if (next>pvt->_maxrows) {
+		next=pvt->_maxrows;
+	}
+	if (!next) {
+		next=1;
+	}
+	pvt->_rows=next;
+}
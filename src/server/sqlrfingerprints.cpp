@@ -0,0 +1,353 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/charstring.h>
+#include <rudiments/character.h>
+#include <rudiments/bytestring.h>
+
+// for time_t, time()
+#include <time.h>
+
+// Each connection totals its queries in a small local table and merges it
+// into the table in shared memory about once per second, or when it starts
+// to fill up, rather than taking semaphore 9 for every query.
+#define LOCALFINGERPRINTS 64
+#define LOCALFLUSHCOUNT 48
+
+class sqlrfingerprintsprivate {
+	friend class sqlrfingerprints;
+	private:
+		sqlrshm			*_shm;
+		sqlrfingerprintstats	_local[LOCALFINGERPRINTS];
+		uint32_t		_localcount;
+		time_t			_lastflush;
+};
+
+sqlrfingerprints::sqlrfingerprints(sqlrshm *shm) {
+	pvt=new sqlrfingerprintsprivate;
+	pvt->_shm=shm;
+	bytestring::zero(pvt->_local,sizeof(pvt->_local));
+	pvt->_localcount=0;
+	pvt->_lastflush=time(NULL);
+}
+
+sqlrfingerprints::~sqlrfingerprints() {
+	delete pvt;
+}
+
+static bool isPunctuation(const sqlrtoken *t, char c) {
+	return (t->type==SQLRTOKENTYPE_PUNCTUATION && t->text[0]==c);
+}
+
+// returns the number of tokens making up the literal
+// or bind variable at "index", or 0 if there isn't one
+static uint32_t literalLength(sqlrparsedquery *pq,
+				uint32_t index, uint32_t count) {
+
+	if (index>=count) {
+		return 0;
+	}
+
+	const sqlrtoken	*t=pq->getToken(index);
+	if (t->type==SQLRTOKENTYPE_STRING ||
+			t->type==SQLRTOKENTYPE_NUMBER ||
+			t->type==SQLRTOKENTYPE_BIND) {
+		return 1;
+	}
+
+	// a sign in front of a number is part of the number, unless it
+	// follows something that it could be subtracted from or added to
+	if (t->type==SQLRTOKENTYPE_OPERATOR && t->length==1 &&
+			(t->text[0]=='-' || t->text[0]=='+') &&
+			index+1<count &&
+			pq->getToken(index+1)->type==SQLRTOKENTYPE_NUMBER) {
+		if (!index) {
+			return 2;
+		}
+		const sqlrtoken	*prev=pq->getToken(index-1);
+		if (prev->type!=SQLRTOKENTYPE_IDENTIFIER &&
+				prev->type!=SQLRTOKENTYPE_STRING &&
+				prev->type!=SQLRTOKENTYPE_NUMBER &&
+				prev->type!=SQLRTOKENTYPE_BIND &&
+				!isPunctuation(prev,')') &&
+				!isPunctuation(prev,']')) {
+			return 2;
+		}
+	}
+	return 0;
+}
+
+static void append(stringbuffer *normalized,
+				const char *text, uint32_t length,
+				bool lower, bool space) {
+	if (space) {
+		normalized->append(' ');
+	}
+	if (!lower) {
+		normalized->append(text,length);
+		return;
+	}
+	for (uint32_t i=0; i<length; i++) {
+		normalized->append((char)character::toLowerCase(text[i]));
+	}
+}
+
+uint64_t sqlrfingerprints::fingerprint(sqlrparsedquery *pq,
+					stringbuffer *normalized) {
+
+	normalized->clear();
+
+	// ignore trailing semicolons
+	uint32_t	count=pq->getTokenCount();
+	while (count && isPunctuation(pq->getToken(count-1),';')) {
+		count--;
+	}
+
+	bool		placeholder=false;
+	bool		space=false;
+	bool		invalues=false;
+	uint32_t	valuesdepth=0;
+	sqlrtokentype_t	prevtype=SQLRTOKENTYPE_PUNCTUATION;
+
+	uint32_t	i=0;
+	while (i<count) {
+
+		const sqlrtoken	*t=pq->getToken(i);
+
+		// literals and bind variables become ?
+		uint32_t	literal=literalLength(pq,i,count);
+		if (literal) {
+			append(normalized,"?",1,false,space);
+			placeholder=true;
+			space=true;
+			prevtype=SQLRTOKENTYPE_BIND;
+			i+=literal;
+			continue;
+		}
+
+		// the lexer keeps runs of operator characters together, so
+		// in a=-1 the sign is at the end of the = operator
+		if (t->type==SQLRTOKENTYPE_OPERATOR && t->length>1 &&
+				(t->text[t->length-1]=='-' ||
+					t->text[t->length-1]=='+') &&
+				i+1<count &&
+				pq->getToken(i+1)->type==
+						SQLRTOKENTYPE_NUMBER) {
+			append(normalized,t->text,t->length-1,false,space);
+			append(normalized,"?",1,false,true);
+			placeholder=true;
+			space=true;
+			prevtype=SQLRTOKENTYPE_BIND;
+			i+=2;
+			continue;
+		}
+
+		// lists of them, like in (1, 2, 3), become a single ?
+		if (placeholder && isPunctuation(t,',')) {
+			literal=literalLength(pq,i+1,count);
+			if (literal) {
+				i+=1+literal;
+				continue;
+			}
+		}
+		placeholder=false;
+
+		// and so do lists of rows, like values (1, 2), (3, 4)
+		if (invalues && t->depth==valuesdepth &&
+				isPunctuation(t,',') && i+1<count &&
+				isPunctuation(pq->getToken(i+1),'(')) {
+			for (i=i+2; i<count; i++) {
+				const sqlrtoken	*c=pq->getToken(i);
+				if (c->depth==valuesdepth &&
+						isPunctuation(c,')')) {
+					break;
+				}
+			}
+			i++;
+			continue;
+		}
+		if (t->keyword==SQLRKEYWORD_VALUES) {
+			invalues=true;
+			valuesdepth=t->depth;
+		} else if (t->type==SQLRTOKENTYPE_KEYWORD &&
+						t->depth<=valuesdepth) {
+			invalues=false;
+		}
+
+		// no space before commas, closing brackets or dots, or
+		// before the opening parenthesis of a function call or
+		// column list, and no space after opening brackets or dots
+		char	c=t->text[0];
+		bool	punctuation=(t->type==SQLRTOKENTYPE_PUNCTUATION);
+		if (punctuation && (c==',' || c==')' || c==']' ||
+						c=='.' || c==';')) {
+			space=false;
+		} else if (punctuation && c=='(' &&
+				prevtype==SQLRTOKENTYPE_IDENTIFIER) {
+			space=false;
+		}
+
+		// keywords and unquoted identifiers are case-insensitive
+		bool	lower=(t->type==SQLRTOKENTYPE_KEYWORD ||
+				(t->type==SQLRTOKENTYPE_IDENTIFIER &&
+							c!='"' && c!='`'));
+		append(normalized,t->text,t->length,lower,space);
+
+		space=!(punctuation && (c=='(' || c=='[' || c=='.'));
+		prevtype=t->type;
+		i++;
+	}
+
+	// FNV-1a, reserving 0 to mean "no fingerprint"
+	uint64_t		hash=14695981039346656037ULL;
+	const unsigned char	*ptr=(const unsigned char *)
+						normalized->getString();
+	const unsigned char	*end=ptr+normalized->getSize();
+	while (ptr<end) {
+		hash^=*ptr;
+		hash*=1099511628211ULL;
+		ptr++;
+	}
+	return (hash)?hash:1;
+}
+
+bool sqlrfingerprints::count(uint64_t fingerprint,
+					const char *text,
+					uint64_t calls,
+					uint64_t errors,
+					uint64_t rows,
+					uint64_t executeusec,
+					uint64_t fetchusec) {
+
+	sqlrfingerprintstats	*fs=find(fingerprint,text);
+	if (fs) {
+		fs->calls+=calls;
+		fs->errors+=errors;
+		fs->rows+=rows;
+		fs->executeusec+=executeusec;
+		if (executeusec>fs->maxexecuteusec) {
+			fs->maxexecuteusec=executeusec;
+		}
+		fs->fetchusec+=fetchusec;
+		if (fetchusec>fs->maxfetchusec) {
+			fs->maxfetchusec=fetchusec;
+		}
+	}
+
+	return (!fs || pvt->_localcount>=LOCALFLUSHCOUNT ||
+				time(NULL)!=pvt->_lastflush);
+}
+
+sqlrfingerprintstats *sqlrfingerprints::find(uint64_t fingerprint,
+							const char *text) {
+
+	// open addressing, the table is cleared on every flush,
+	// and flushed well before it fills up, so nothing is
+	// ever removed from it
+	uint32_t	start=fingerprint%LOCALFINGERPRINTS;
+	uint32_t	i=start;
+	do {
+		sqlrfingerprintstats	*fs=&(pvt->_local[i]);
+		if (fs->fingerprint==fingerprint) {
+			return fs;
+		}
+		if (!fs->fingerprint) {
+			fs->fingerprint=fingerprint;
+			charstring::copy(fs->text,text,STATFINGERPRINTLEN-1);
+			fs->text[STATFINGERPRINTLEN-1]='\0';
+			pvt->_localcount++;
+			return fs;
+		}
+		i=(i+1)%LOCALFINGERPRINTS;
+	} while (i!=start);
+	return NULL;
+}
+
+void sqlrfingerprints::flush() {
+
+	sqlrshm	*shm=pvt->_shm;
+
+	for (uint32_t i=0; i<LOCALFINGERPRINTS; i++) {
+
+		sqlrfingerprintstats	*from=&(pvt->_local[i]);
+		if (!from->fingerprint) {
+			continue;
+		}
+
+		// This is a linear search, but it's only done about once per
+		// second, for the fingerprints that were run during that
+		// second, and it keeps the shared table trivial to read.
+		sqlrfingerprintstats	*to=NULL;
+		for (uint32_t j=0; j<shm->fingerprintcount; j++) {
+			if (shm->fingerprints[j].fingerprint==
+						from->fingerprint) {
+				to=&(shm->fingerprints[j]);
+				break;
+			}
+		}
+
+		if (!to) {
+			if (shm->fingerprintcount<STATFINGERPRINTS) {
+				to=&(shm->fingerprints[shm->fingerprintcount]);
+				shm->fingerprintcount++;
+			} else {
+				// replace the least frequently called
+				to=&(shm->fingerprints[0]);
+				for (uint32_t j=1; j<STATFINGERPRINTS; j++) {
+					if (shm->fingerprints[j].calls<
+								to->calls) {
+						to=&(shm->fingerprints[j]);
+					}
+				}
+				shm->fingerprintevictions++;
+			}
+			bytestring::zero(to,sizeof(sqlrfingerprintstats));
+			to->fingerprint=from->fingerprint;
+			charstring::copy(to->text,from->text,
+						STATFINGERPRINTLEN-1);
+		}
+
+		add(to,from);
+	}
+
+	bytestring::zero(pvt->_local,sizeof(pvt->_local));
+	pvt->_localcount=0;
+	pvt->_lastflush=time(NULL);
+}
+
+uint32_t sqlrfingerprints::getSorted(sqlrfingerprintstats *stats) {
+
+	uint32_t	count=pvt->_shm->fingerprintcount;
+	if (count>STATFINGERPRINTS) {
+		count=STATFINGERPRINTS;
+	}
+
+	// insertion sort, by total execute time, descending
+	for (uint32_t i=0; i<count; i++) {
+		sqlrfingerprintstats	fs=pvt->_shm->fingerprints[i];
+		fs.text[STATFINGERPRINTLEN-1]='\0';
+		uint32_t	j=i;
+		while (j && stats[j-1].executeusec<fs.executeusec) {
+			stats[j]=stats[j-1];
+			j--;
+		}
+		stats[j]=fs;
+	}
+	return count;
+}
+
+void sqlrfingerprints::add(sqlrfingerprintstats *to,
+				const sqlrfingerprintstats *from) {
+	to->calls+=from->calls;
+	to->errors+=from->errors;
+	to->rows+=from->rows;
+	to->executeusec+=from->executeusec;
+	if (from->maxexecuteusec>to->maxexecuteusec) {
+		to->maxexecuteusec=from->maxexecuteusec;
+	}
+	to->fetchusec+=from->fetchusec;
+	if (from->maxfetchusec>to->maxfetchusec) {
+		to->maxfetchusec=from->maxfetchusec;
+	}
+}
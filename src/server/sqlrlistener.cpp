@@ -7,6 +7,7 @@
 #include <rudiments/unixsocketclient.h>
 #include <rudiments/inetsocketclient.h>
 #include <rudiments/bytestring.h>
+#include <rudiments/character.h>
 #include <rudiments/snooze.h>
 #include <rudiments/userentry.h>
 #include <rudiments/groupentry.h>
@@ -18,6 +19,7 @@
 #include <rudiments/sys.h>
 #include <rudiments/stdio.h>
 #include <rudiments/thread.h>
+#include <rudiments/threadmutex.h>
 #include <rudiments/semaphoreset.h>
 #include <rudiments/sharedmemory.h>
 #include <rudiments/unixsocketserver.h>
@@ -28,6 +30,22 @@
 #include <defaults.h>
 #include <defines.h>
 
+#ifdef WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+#endif
+
+#if defined(HAVE_EPOLL) && defined(HAVE_SPLICE)
+	#include <sys/epoll.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
 #ifndef MAXPATHLEN
 	#define MAXPATHLEN	256
 #endif
@@ -39,6 +57,77 @@ class SQLRSERVER_DLLSPEC handoffsocketnode {
 		filedescriptor	*sock;
 };
 
+class SQLRSERVER_DLLSPEC pooledsessionnode {
+	friend class sqlrlistener;
+	private:
+		filedescriptor	*sock;
+		uint16_t	protocolindex;
+		unsigned char	*state;
+		uint32_t	statelength;
+		uint64_t	parkedsec;
+};
+
+class SQLRSERVER_DLLSPEC proxyendpoint {
+	friend class sqlrlistener;
+	private:
+		proxiedsession	*session;
+		bool		client;
+};
+
+class SQLRSERVER_DLLSPEC proxiedsession {
+	friend class sqlrlistener;
+	private:
+		int32_t		clientfd;
+		int32_t		serverfd;
+		// data from the client to the server, and from the
+		// server to the client, is spliced through these pipes
+		int32_t		toserver[2];
+		int32_t		toclient[2];
+		size_t		toserverpending;
+		size_t		toclientpending;
+		uint32_t	clientevents;
+		uint32_t	serverevents;
+		proxyendpoint	clientend;
+		proxyendpoint	serverend;
+		uint64_t	lastactivity;
+		bool		endsession;
+		// an END_SESSION that's queued for the connection,
+		// once everything ahead of it has been written
+		bool		closing;
+		unsigned char	endsessioncmd[sizeof(uint16_t)];
+		size_t		endsessionpending;
+		bool		done;
+};
+
+class SQLRSERVER_DLLSPEC proxyenginethread {
+	friend class sqlrlistener;
+	private:
+		sqlrlistener			*lsnr;
+		thread				thr;
+		bool				running;
+		volatile bool			stop;
+		int32_t				epfd;
+		threadmutex			newsessionsmutex;
+		linkedlist< proxiedsession * >	newsessions;
+		linkedlist< proxiedsession * >	sessions;
+};
+
+class SQLRSERVER_DLLSPEC acceptorthread {
+	friend class sqlrlistener;
+	private:
+		sqlrlistener		*lsnr;
+		thread			thr;
+		bool			running;
+		volatile bool		stop;
+		listener		clientlsnr;
+		inetsocketserver	**clientsockin;
+		uint16_t		*clientsockinprotoindex;
+		unixsocketserver	**clientsockun;
+		uint16_t		*clientsockunprotoindex;
+		regularexpression	*denied;
+		regularexpression	*allowed;
+};
+
 class sqlrlistenerprivate {
 	friend class sqlrlistener;
 	private:
@@ -50,6 +139,14 @@ class sqlrlistenerprivate {
 		int64_t		_maxlisteners;
 		uint64_t	_listenertimeout;
 
+		uint32_t		_proxythreads;
+		proxyenginethread	*_proxyengine;
+		uint32_t		_proxyenginenext;
+		threadmutex		*_proxyenginemutex;
+
+		uint32_t		_acceptors;
+		acceptorthread		*_acceptor;
+
 		char		*_pidfile;
 
 		sqlrcmdline	*_cmdl;
@@ -83,12 +180,22 @@ class sqlrlistenerprivate {
 		char			*_removehandoffsockname;
 		unixsocketserver	*_fixupsockun;
 		char			*_fixupsockname;
+		unixsocketserver	*_releasesockun;
+		char			*_releasesockname;
 
 		uint16_t		_handoffmode;
 		handoffsocketnode	*_handoffsocklist;
 
+		bool	_sessionpooling;
+		bool	_affinity;
+		dictionary< filedescriptor *, pooledsessionnode * >
+							_pooledsessions;
+		uint64_t		_pooledsessionsexpired;
+
 		regularexpression	*_allowed;
 		regularexpression	*_denied;
+		sqlriplist		*_allowedlist;
+		sqlriplist		*_deniedlist;
 
 		uint32_t	_maxquerysize;
 		uint16_t	_maxbindcount;
@@ -124,6 +231,14 @@ sqlrlistener::sqlrlistener() {
 	pvt->_pidfile=NULL;
 	pvt->_sqlrpth=NULL;
 
+	pvt->_proxythreads=0;
+	pvt->_proxyengine=NULL;
+	pvt->_proxyenginenext=0;
+	pvt->_proxyenginemutex=NULL;
+
+	pvt->_acceptors=1;
+	pvt->_acceptor=NULL;
+
 	pvt->_clientsockin=NULL;
 	pvt->_clientsockinprotoindex=NULL;
 	pvt->_clientsockincount=0;
@@ -139,11 +254,19 @@ sqlrlistener::sqlrlistener() {
 	pvt->_removehandoffsockname=NULL;
 	pvt->_fixupsockun=NULL;
 	pvt->_fixupsockname=NULL;
+	pvt->_releasesockun=NULL;
+	pvt->_releasesockname=NULL;
 
 	pvt->_handoffsocklist=NULL;
 
+	pvt->_sessionpooling=false;
+	pvt->_affinity=false;
+	pvt->_pooledsessionsexpired=0;
+
 	pvt->_denied=NULL;
 	pvt->_allowed=NULL;
+	pvt->_deniedlist=NULL;
+	pvt->_allowedlist=NULL;
 
 	pvt->_maxquerysize=0;
 	pvt->_maxbindcount=0;
@@ -219,10 +342,15 @@ sqlrlistener::~sqlrlistener() {
 
 void sqlrlistener::cleanUp() {
 
+	if (!pvt->_isforkedchild) {
+		stopAcceptors();
+		stopProxyEngine();
+	}
+
 	delete[] pvt->_pidfile;
 
 	uint64_t	csind;
-	for (csind=0; csind<pvt->_clientsockincount; csind++) {
+	for (csind=0; csind<pvt->_clientsockincount*pvt->_acceptors; csind++) {
 		delete pvt->_clientsockin[csind];
 	}
 	delete[] pvt->_clientsockin;
@@ -258,8 +386,27 @@ void sqlrlistener::cleanUp() {
 	delete[] pvt->_fixupsockname;
 	delete pvt->_fixupsockun;
 
+	if (!pvt->_isforkedchild && pvt->_releasesockname) {
+		file::remove(pvt->_releasesockname);
+	}
+	delete[] pvt->_releasesockname;
+	delete pvt->_releasesockun;
+
+	for (listnode< filedescriptor * > *node=
+				pvt->_pooledsessions.getKeys()->getFirst();
+				node; node=node->getNext()) {
+		pooledsessionnode	*psn=NULL;
+		pvt->_pooledsessions.getValue(node->getValue(),&psn);
+		delete psn->sock;
+		delete[] psn->state;
+		delete psn;
+	}
+	pvt->_pooledsessions.clear();
+
 	delete pvt->_denied;
 	delete pvt->_allowed;
+	delete pvt->_deniedlist;
+	delete pvt->_allowedlist;
 	delete pvt->_sqlrlg;
 	delete pvt->_sqlrn;
 }
@@ -361,6 +508,8 @@ bool sqlrlistener::init(int argc, const char **argv) {
 
 	setHandoffMethod();
 
+	setAcceptors();
+
 	setSessionHandlerMethod();
 
 	setIpPermissions();
@@ -378,6 +527,10 @@ bool sqlrlistener::init(int argc, const char **argv) {
 	if (!listenOnFixupSocket(pvt->_cmdl->getId())) {
 		return false;
 	}
+	if (pvt->_sessionpooling &&
+		!listenOnReleaseSocket(pvt->_cmdl->getId())) {
+		return false;
+	}
 
 	if (!pvt->_cmdl->found("-nodetach")) {
 		process::detach();
@@ -510,6 +663,15 @@ void sqlrlistener::handleDynamicScaling() {
 
 void sqlrlistener::setSessionHandlerMethod() {
 	
+	// Proxied clients are handed off to the proxy threads, which run in
+	// the main listener process, so the listeners that wait for available
+	// connections on their behalf must be threads of that process too.
+	// Similarly, acceptor threads can't fork.
+	if (pvt->_proxythreads || pvt->_acceptors>1) {
+		pvt->_usethreads=true;
+		return;
+	}
+
 	pvt->_usethreads=false;
 	if (!charstring::compare(pvt->_cfg->getSessionHandler(),"thread")) {
 
@@ -567,6 +729,40 @@ void sqlrlistener::setHandoffMethod() {
         	delete[] os;
 	}
 
+	// transaction-level session pooling requires
+	// that clients can be passed between processes
+	if (!charstring::compare(pvt->_cfg->getPooling(),"transaction")) {
+		if (pvt->_handoffmode==HANDOFF_PASS) {
+			pvt->_sessionpooling=true;
+		} else {
+			stderror.printf("Warning: pooling=\"transaction\" "
+					"requires handoff=\"pass\", "
+					"falling back to "
+					"pooling=\"session\".\n");
+		}
+	}
+
+	// prefer connections that are already logged in as the client's user
+	pvt->_affinity=!charstring::compare(pvt->_cfg->getAffinity(),"user");
+
+	// multiplex proxied clients over a fixed set of threads
+	pvt->_proxythreads=0;
+	if (pvt->_handoffmode==HANDOFF_PROXY && pvt->_cfg->getProxyThreads()) {
+		#if defined(HAVE_EPOLL) && defined(HAVE_SPLICE)
+		if (thread::supported() && thread::reliable()) {
+			pvt->_proxythreads=pvt->_cfg->getProxyThreads();
+		} else {
+			stderror.printf("Warning: proxythreads requires "
+					"threads, which are not supported, "
+					"ignoring proxythreads.\n");
+		}
+		#else
+		stderror.printf("Warning: proxythreads not supported "
+					"on this platform, "
+					"ignoring proxythreads.\n");
+		#endif
+	}
+
 	// create the list of handoff nodes
 	pvt->_handoffsocklist=new handoffsocketnode[pvt->_maxconnections];
 	for (uint32_t i=0; i<pvt->_maxconnections; i++) {
@@ -575,16 +771,105 @@ void sqlrlistener::setHandoffMethod() {
 	}
 }
 
+void sqlrlistener::setAcceptors() {
+
+	pvt->_acceptors=pvt->_cfg->getAcceptors();
+	if (pvt->_acceptors<2) {
+		pvt->_acceptors=1;
+		return;
+	}
+
+	#ifdef SO_REUSEPORT
+	if (!thread::supported() || !thread::reliable()) {
+		stderror.printf("Warning: acceptors requires "
+				"threads, which are not supported, "
+				"ignoring acceptors.\n");
+		pvt->_acceptors=1;
+	}
+	#else
+	stderror.printf("Warning: acceptors not supported "
+				"on this platform, "
+				"ignoring acceptors.\n");
+	pvt->_acceptors=1;
+	#endif
+}
+
 void sqlrlistener::setIpPermissions() {
 
-	// get denied and allowed ip's and compile the expressions
+	// get denied and allowed ip's and compile them...
 	const char	*deniedips=pvt->_cfg->getDeniedIps();
 	const char	*allowedips=pvt->_cfg->getAllowedIps();
 	if (!charstring::isNullOrEmpty(deniedips)) {
-		pvt->_denied=new regularexpression(deniedips);
+		warnPartialIps("deniedips",deniedips);
+		pvt->_deniedlist=newIpList(deniedips);
+		if (!pvt->_deniedlist) {
+			pvt->_denied=new regularexpression(deniedips);
+		}
 	}
 	if (!charstring::isNullOrEmpty(allowedips)) {
-		pvt->_allowed=new regularexpression(allowedips);
+		warnPartialIps("allowedips",allowedips);
+		pvt->_allowedlist=newIpList(allowedips);
+		if (!pvt->_allowedlist) {
+			pvt->_allowed=new regularexpression(allowedips);
+		}
+	}
+}
+
+sqlriplist *sqlrlistener::newIpList(const char *ips) {
+
+	// If every entry is an address, CIDR block, or wildcard/range pattern
+	// then compile them into a prefix list.  Otherwise, the entries are
+	// treated as a regular expression, as they always have been.
+	sqlriplist	*iplist=new sqlriplist();
+	if (!iplist->addList(ips)) {
+		raiseDebugMessageEvent("ip list is a regular expression");
+		delete iplist;
+		return NULL;
+	}
+	raiseDebugMessageEvent("ip list compiled to prefix list");
+	return iplist;
+}
+
+void sqlrlistener::warnPartialIps(const char *directive, const char *ips) {
+
+	// Plain addresses used to be matched as substrings of the client's
+	// address, so entries like 192.168.1. or 10.0 were sometimes used to
+	// match a whole network.  Plain addresses match exactly now, so warn
+	// about entries that look like they were meant to be partial.
+	const char	*ptr=ips;
+	while (*ptr) {
+
+		while (*ptr==',' || character::isWhitespace(*ptr)) {
+			ptr++;
+		}
+		const char	*end=ptr;
+		uint16_t	dots=0;
+		bool		plain=true;
+		while (*end && *end!=',' && !character::isWhitespace(*end)) {
+			if (*end=='.') {
+				dots++;
+			} else if (!character::isDigit(*end)) {
+				plain=false;
+			}
+			end++;
+		}
+		if (end==ptr) {
+			break;
+		}
+
+		if (plain && dots && (dots<3 || *(end-1)=='.')) {
+			char	*entry=charstring::duplicate(ptr,end-ptr);
+			stderror.printf("Warning: %s entry \"%s\" looks like "
+					"a partial address.  Plain addresses "
+					"match exactly, use a CIDR block or "
+					"wildcard pattern (eg. 192.168.1.0/24 "
+					"or 192.168.1.*) to match a network."
+					"\n",
+					directive,entry);
+			delete[] entry;
+		}
+
+		ptr=end;
 	}
 }
 
@@ -811,8 +1096,11 @@ bool sqlrlistener::listenOnClientSockets() {
 			pvt->_clientsockuncount=pvt->_clientsockuncount+1;
 		}
 	}
-	pvt->_clientsockin=new inetsocketserver *[pvt->_clientsockincount];
-	pvt->_clientsockinprotoindex=new uint16_t[pvt->_clientsockincount];
+	// each acceptor thread gets its own set of inet sockets
+	pvt->_clientsockin=new inetsocketserver *
+				[pvt->_clientsockincount*pvt->_acceptors];
+	pvt->_clientsockinprotoindex=new uint16_t
+				[pvt->_clientsockincount*pvt->_acceptors];
 	pvt->_clientsockinindex=0;
 	pvt->_clientsockun=new unixsocketserver *[pvt->_clientsockuncount];
 	pvt->_clientsockunprotoindex=new uint16_t[pvt->_clientsockuncount];
@@ -858,15 +1146,20 @@ bool sqlrlistener::listenOnClientSocket(uint16_t protocolindex,
 	if (port && addrcount) {
 
 		for (index=0; index<addrcount; index++) {
+		for (uint32_t acc=0; acc<pvt->_acceptors; acc++) {
 
-			uint64_t	ind=pvt->_clientsockinindex+index;
+			uint64_t	ind=acc*pvt->_clientsockincount+
+						pvt->_clientsockinindex+index;
 			pvt->_clientsockin[ind]=new inetsocketserver();
 			pvt->_clientsockinprotoindex[ind]=protocolindex;
 
-			if (pvt->_clientsockin[ind]->
-					listen(addr[index],port,128)) {
-				pvt->_lsnr.addReadFileDescriptor(
+			if (listenOnInetSocket(pvt->_clientsockin[ind],
+							addr[index],port)) {
+				// acceptor threads listen on their own
+				if (pvt->_acceptors==1) {
+					pvt->_lsnr.addReadFileDescriptor(
 						pvt->_clientsockin[ind]);
+				}
 				listening=true;
 			} else {
 				stringbuffer	info;
@@ -890,8 +1183,9 @@ bool sqlrlistener::listenOnClientSocket(uint16_t protocolindex,
 				pvt->_clientsockin[ind]=NULL;
 			}
 		}
+		}
 
-		pvt->_clientsockinindex++;
+		pvt->_clientsockinindex+=addrcount;
 	}
 
 	// attempt to listen on the unix socket
@@ -905,8 +1199,11 @@ bool sqlrlistener::listenOnClientSocket(uint16_t protocolindex,
 
 		if (pvt->_clientsockun[pvt->_clientsockunindex]->
 						listen(sock,0000,128)) {
-			pvt->_lsnr.addReadFileDescriptor(
+			// the first acceptor thread listens on these
+			if (pvt->_acceptors==1) {
+				pvt->_lsnr.addReadFileDescriptor(
 				pvt->_clientsockun[pvt->_clientsockunindex]);
+			}
 			listening=true;
 		} else {
 			stringbuffer	info;
@@ -943,6 +1240,37 @@ bool sqlrlistener::listenOnClientSocket(uint16_t protocolindex,
 	return listening;
 }
 
+bool sqlrlistener::listenOnInetSocket(inetsocketserver *iss,
+						const char *address,
+						uint16_t port) {
+
+	if (pvt->_acceptors==1) {
+		return iss->listen(address,port,128);
+	}
+
+	// With multiple acceptor threads, each listens on its own socket,
+	// bound to the same address and port, and the kernel distributes
+	// new clients among them.  This requires setting SO_REUSEPORT on
+	// each of them before they're bound.
+	#ifdef SO_REUSEPORT
+	int	on=1;
+	if (!iss->initialize(address,port) ||
+		::setsockopt(iss->getFileDescriptor(),SOL_SOCKET,SO_REUSEADDR,
+					(const char *)&on,sizeof(on))==-1 ||
+		::setsockopt(iss->getFileDescriptor(),SOL_SOCKET,SO_REUSEPORT,
+					(const char *)&on,sizeof(on))==-1 ||
+		!iss->bind() || !iss->listen(128)) {
+		return false;
+	}
+
+	// accept clients in batches, until there are no more
+	iss->useNonBlockingMode();
+	return true;
+	#else
+	return iss->listen(address,port,128);
+	#endif
+}
+
 bool sqlrlistener::listenOnHandoffSocket(const char *id) {
 
 	// the handoff socket
@@ -1046,6 +1374,41 @@ bool sqlrlistener::listenOnFixupSocket(const char *id) {
 	return success;
 }
 
+bool sqlrlistener::listenOnReleaseSocket(const char *id) {
+
+	// the release socket
+	charstring::printf(&pvt->_releasesockname,
+				"%s%s-release.sock",
+				pvt->_sqlrpth->getSocketsDir(),id);
+
+	pvt->_releasesockun=new unixsocketserver();
+	bool	success=pvt->_releasesockun->listen(
+					pvt->_releasesockname,0077,128);
+
+	if (success) {
+		pvt->_lsnr.addReadFileDescriptor(pvt->_releasesockun);
+	} else {
+		stringbuffer	info;
+		info.append("failed to listen on release socket: ");
+		info.append(pvt->_releasesockname);
+		raiseInternalErrorEvent(info.getString());
+
+		char	*currentuser=userentry::getName(
+						process::getEffectiveUserId());
+		char	*currentgroup=groupentry::getName(
+						process::getEffectiveGroupId());
+		stderror.printf("Could not listen on unix socket: %s\n"
+				"Make sure that the directory is "
+				"writable by %s:%s.\n\n",
+				pvt->_releasesockname,
+				currentuser,currentgroup);
+		delete[] currentuser;
+		delete[] currentgroup;
+	}
+
+	return success;
+}
+
 bool sqlrlistener::listen() {
 
 	// wait until all of the connections have started
@@ -1074,6 +1437,17 @@ bool sqlrlistener::listen() {
 		return false;
 	}
 
+	// start the threads that proxied clients will be handed off to
+	if (pvt->_proxythreads && !startProxyEngine()) {
+		return false;
+	}
+
+	// Start the threads that accept clients.  This thread will
+	// continue to service connection daemon registrations.
+	if (pvt->_acceptors>1 && !startAcceptors()) {
+		return false;
+	}
+
 	for (;;) {
 
 		if (process::getShutDownFlag()) {
@@ -1104,6 +1478,11 @@ filedescriptor *sqlrlistener::waitForTraffic() {
 			return NULL;
 		}
 
+		// Expire idle pooled sessions.  This is done on every pass
+		// (rather than just when the listen times out) because a busy
+		// listener might never time out.
+		expirePooledSessions();
+
 		// wait for data on one of the sockets...
 		int32_t	result=pvt->_lsnr.listen(1,0);
 		if (result>=1) {
@@ -1159,6 +1538,34 @@ bool sqlrlistener::handleTraffic(filedescriptor *fd) {
 			return false;
 		}
 		return fixup(clientsock);
+	} else if (pvt->_releasesockun && fd==pvt->_releasesockun) {
+		clientsock=pvt->_releasesockun->accept();
+		if (!clientsock) {
+			return false;
+		}
+		return parkSession(clientsock);
+	}
+
+	// If a client with a pooled session sent something,
+	// then hand it off to whatever connection is available.
+	// (If acceptor threads are being used, then this thread only
+	// services registrations and must never wait on a connection.)
+	pooledsessionnode	*psn=NULL;
+	if (pvt->_sessionpooling && pvt->_pooledsessions.getValue(fd,&psn)) {
+		pvt->_lsnr.removeFileDescriptor(fd);
+		pvt->_pooledsessions.remove(fd);
+		pvt->_shm->pooled_sessions--;
+		if (pvt->_acceptors>1 ||
+				pvt->_dynamicscaling ||
+				getBusyListeners() ||
+				!pvt->_semset->getValue(2)) {
+			forkChild(psn->sock,psn->protocolindex,psn);
+		} else {
+			incrementBusyListeners();
+			clientSession(psn->sock,psn->protocolindex,psn,NULL);
+			decrementBusyListeners();
+		}
+		return true;
 	}
 
 	// handle connections to the client sockets
@@ -1185,34 +1592,39 @@ bool sqlrlistener::handleTraffic(filedescriptor *fd) {
 	}
 
 	if (iss) {
-
 		clientsock=iss->accept();
-		if (!clientsock) {
-			return false;
-		}
+	} else if (uss) {
+		clientsock=uss->accept();
+	} else {
+		return true;
+	}
+	if (!clientsock) {
+		return false;
+	}
+	return handleClient(clientsock,protocolindex,(iss!=NULL),
+					pvt->_denied,pvt->_allowed);
+}
+
+bool sqlrlistener::handleClient(filedescriptor *clientsock,
+					uint16_t protocolindex,
+					bool inet,
+					regularexpression *denied,
+					regularexpression *allowed) {
+
+	if (inet) {
 
 		// For inet clients, make sure that the ip address is
 		// not denied.  If the ip was denied, disconnect the
 		// socket and loop back.
-		if (pvt->_denied && deniedIp(clientsock)) {
+		if ((pvt->_deniedlist || denied) &&
+				deniedIp(clientsock,denied,allowed)) {
 			delete clientsock;
 			return true;
 		}
 
 		clientsock->dontUseNaglesAlgorithm();
-		clientsock->translateByteOrder();
-
-	} else if (uss) {
-
-		clientsock=uss->accept();
-		if (!clientsock) {
-			return false;
-		}
-		clientsock->translateByteOrder();
-
-	} else {
-		return true;
 	}
+	clientsock->translateByteOrder();
 
 	// Don't fork unless we have to.
 	//
@@ -1235,120 +1647,384 @@ bool sqlrlistener::handleTraffic(filedescriptor *fd) {
 	// id as this one and that is checked at startup.  However, if it did
 	// happen, getValue(10) would return something greater than 0 and we
 	// would have forked anyway.
+	//
+	// If acceptor threads are being used, then we always have to.  An
+	// acceptor thread must get back to accepting clients right away, and
+	// picking a connection for the client, waiting for one to become
+	// available, or (with affinity) waiting for the client's auth could
+	// all block it for an arbitrary amount of time.
 	if (pvt->_handoffmode==HANDOFF_PROXY ||
+			pvt->_acceptors>1 ||
 			pvt->_dynamicscaling ||
 			getBusyListeners() ||
 			!pvt->_semset->getValue(2)) {
-		forkChild(clientsock,protocolindex);
+		forkChild(clientsock,protocolindex,NULL);
 	} else {
 		incrementBusyListeners();
-		clientSession(clientsock,protocolindex,NULL);
+		clientSession(clientsock,protocolindex,NULL,NULL);
 		decrementBusyListeners();
 	}
 
 	return true;
 }
 
+bool sqlrlistener::startAcceptors() {
 
-bool sqlrlistener::registerHandoff(filedescriptor *sock) {
+	raiseDebugMessageEvent("starting acceptor threads...");
 
-	raiseDebugMessageEvent("registering handoff...");
+	pvt->_acceptor=new acceptorthread[pvt->_acceptors];
+	for (uint32_t i=0; i<pvt->_acceptors; i++) {
 
-	// get the connection daemon's pid
-	uint32_t processid;
-	if (sock->read(&processid)!=sizeof(uint32_t)) {
-		raiseInternalErrorEvent("failed to read process "
-					"id during registration");
-		delete sock;
-		return false;
-	}
+		acceptorthread	*at=&(pvt->_acceptor[i]);
+		at->lsnr=this;
+		at->running=false;
+		at->stop=false;
 
-	// find a free node in the list, if we find another node with the
-	// same pid, then the old connection must have died off mysteriously,
-	// replace it
-	bool		inserted=false;
-	uint32_t	index=0;
-	for (; index<pvt->_maxconnections; index++) {
-		if (!pvt->_handoffsocklist[index].pid ||
-			pvt->_handoffsocklist[index].pid==processid) {
-			pvt->_handoffsocklist[index].pid=processid;
-			pvt->_handoffsocklist[index].sock=sock;
-			inserted=true;
-			break;
+		// each acceptor thread gets its own set of inet sockets
+		at->clientsockin=pvt->_clientsockin+
+					i*pvt->_clientsockincount;
+		at->clientsockinprotoindex=pvt->_clientsockinprotoindex+
+					i*pvt->_clientsockincount;
+		for (uint64_t j=0; j<pvt->_clientsockincount; j++) {
+			if (at->clientsockin[j]) {
+				at->clientlsnr.addReadFileDescriptor(
+							at->clientsockin[j]);
+			}
+		}
+
+		// the first acceptor thread also services the unix sockets
+		at->clientsockun=NULL;
+		at->clientsockunprotoindex=NULL;
+		if (!i) {
+			at->clientsockun=pvt->_clientsockun;
+			at->clientsockunprotoindex=
+					pvt->_clientsockunprotoindex;
+			for (uint64_t j=0; j<pvt->_clientsockuncount; j++) {
+				if (at->clientsockun[j]) {
+					at->clientsockun[j]->
+						useNonBlockingMode();
+					at->clientlsnr.addReadFileDescriptor(
+							at->clientsockun[j]);
+				}
+			}
+		}
+
+		// regular expressions keep the results of the most recent
+		// match, so each acceptor thread needs its own copies
+		at->denied=NULL;
+		at->allowed=NULL;
+		if (pvt->_denied) {
+			at->denied=new regularexpression(
+						pvt->_cfg->getDeniedIps());
+		}
+		if (pvt->_allowed) {
+			at->allowed=new regularexpression(
+						pvt->_cfg->getAllowedIps());
 		}
 	}
 
-	// if for some reason the scaler started more connections than
-	// "maxconnections" or if someone manually started one and the number
-	// of connections exceeded maxconnections, then the new connection won't
-	// fit in our list, grow the list to accommodate it...
-	if (inserted==false) {
-		handoffsocketnode	*newhandoffsocklist=
-				new handoffsocketnode[pvt->_maxconnections+1];
-		for (uint32_t i=0; i<pvt->_maxconnections; i++) {
-			newhandoffsocklist[i].pid=
-				pvt->_handoffsocklist[i].pid;
-			newhandoffsocklist[i].sock=
-				pvt->_handoffsocklist[i].sock;
+	for (uint32_t i=0; i<pvt->_acceptors; i++) {
+		acceptorthread	*at=&(pvt->_acceptor[i]);
+		if (!at->thr.spawn((void *(*)(void *))acceptorThread,
+							(void *)at,false)) {
+			raiseInternalErrorEvent("failed to spawn "
+						"acceptor thread");
+			return false;
 		}
-		delete[] pvt->_handoffsocklist;
-		newhandoffsocklist[pvt->_maxconnections].pid=processid;
-		newhandoffsocklist[pvt->_maxconnections].sock=sock;
-		pvt->_maxconnections++;
-		pvt->_handoffsocklist=newhandoffsocklist;
+		at->running=true;
 	}
 
-	raiseDebugMessageEvent("finished registering handoff...");
+	raiseDebugMessageEvent("finished starting acceptor threads");
 	return true;
 }
 
-bool sqlrlistener::deRegisterHandoff(filedescriptor *sock) {
-
-	raiseDebugMessageEvent("de-registering handoff...");
+void sqlrlistener::stopAcceptors() {
 
-	// get the connection daemon's pid
-	uint32_t	processid;
-	if (sock->read(&processid)!=sizeof(uint32_t)) {
-		raiseInternalErrorEvent("failed to read process "
-				"id during deregistration");
-		delete sock;
-		return false;
+	if (!pvt->_acceptor) {
+		return;
 	}
 
-	// remove the matching socket from the list
-	for (uint32_t i=0; i<pvt->_maxconnections; i++) {
-		if (pvt->_handoffsocklist[i].pid==processid) {
-			pvt->_handoffsocklist[i].pid=0;
-			delete pvt->_handoffsocklist[i].sock;
-			pvt->_handoffsocklist[i].sock=NULL;
-			break;
+	for (uint32_t i=0; i<pvt->_acceptors; i++) {
+		pvt->_acceptor[i].stop=true;
+	}
+	for (uint32_t i=0; i<pvt->_acceptors; i++) {
+		acceptorthread	*at=&(pvt->_acceptor[i]);
+		if (at->running) {
+			at->thr.join(NULL);
 		}
+		delete at->denied;
+		delete at->allowed;
 	}
+	delete[] pvt->_acceptor;
+	pvt->_acceptor=NULL;
+}
 
-	// clean up
-	delete sock;
-
-	raiseDebugMessageEvent("finished de-registering handoff...");
-	return true;
+void sqlrlistener::acceptorThread(void *attr) {
+	acceptorthread	*at=(acceptorthread *)attr;
+	at->lsnr->acceptorLoop(at);
 }
 
-bool sqlrlistener::fixup(filedescriptor *sock) {
+void sqlrlistener::acceptorLoop(acceptorthread *at) {
 
-	raiseDebugMessageEvent("passing socket of newly spawned connection...");
+	for (;;) {
 
-	// get the pid of the connection daemon the child listener needs
-	uint32_t	processid;
-	if (sock->read(&processid)!=sizeof(uint32_t)) {
-		raiseInternalErrorEvent("failed to read process id during fixup");
-		delete sock;
-		return false;
-	}
+		if (process::getShutDownFlag() || at->stop) {
+			return;
+		}
 
-	// look through the handoffsocklist for the pid
-	bool	retval=false;
-	for (uint32_t i=0; i<pvt->_maxconnections; i++) {
-		if (pvt->_handoffsocklist[i].pid==processid) {
-			retval=sock->passSocket(pvt->_handoffsocklist[i].
+		// wait for clients, waking up once a
+		// second to see if we need to stop
+		if (at->clientlsnr.listen(1,0)<1) {
+			continue;
+		}
+
+		for (listnode< filedescriptor * > *node=
+				at->clientlsnr.getReadReadyList()->getFirst();
+				node; node=node->getNext()) {
+			acceptClients(at,node->getValue());
+		}
+	}
+}
+
+void sqlrlistener::acceptClients(acceptorthread *at, filedescriptor *fd) {
+
+	// figure out which socket it was
+	inetsocketserver	*iss=NULL;
+	unixsocketserver	*uss=NULL;
+	uint16_t		protocolindex=0;
+	for (uint64_t i=0; i<pvt->_clientsockincount; i++) {
+		if (fd==at->clientsockin[i]) {
+			iss=at->clientsockin[i];
+			protocolindex=at->clientsockinprotoindex[i];
+			break;
+		}
+	}
+	if (!iss && at->clientsockun) {
+		for (uint64_t i=0; i<pvt->_clientsockuncount; i++) {
+			if (fd==at->clientsockun[i]) {
+				uss=at->clientsockun[i];
+				protocolindex=at->clientsockunprotoindex[i];
+				break;
+			}
+		}
+	}
+	if (!iss && !uss) {
+		return;
+	}
+
+	// The listening sockets are in non-blocking mode, so accept clients
+	// until there are no more waiting, or until we've accepted a batch
+	// of them, so that the other sockets aren't starved.
+	for (uint32_t i=0; i<ACCEPTBATCHSIZE; i++) {
+
+		error::clearError();
+		filedescriptor	*clientsock=(iss)?iss->accept():uss->accept();
+		if (!clientsock) {
+
+			// if accept() failed with EMFILE (too many open
+			// files) then wait a second before trying again
+			// so we don't slam the system
+			if (error::getErrorNumber()==EMFILE) {
+				snooze::macrosnooze(1);
+			}
+			return;
+		}
+
+		// on some platforms, accepted sockets inherit
+		// the non-blocking mode of the listening socket
+		clientsock->useBlockingMode();
+
+		handleClient(clientsock,protocolindex,(iss!=NULL),
+						at->denied,at->allowed);
+	}
+}
+
+bool sqlrlistener::parkSession(filedescriptor *sock) {
+
+	raiseDebugMessageEvent("parking released session...");
+
+	// get the protocol index and session state
+	uint16_t	protocolindex;
+	uint32_t	statelength;
+	if (sock->read(&protocolindex)!=sizeof(uint16_t) ||
+			sock->read(&statelength)!=sizeof(uint32_t) ||
+			statelength>MAXSESSIONSTATELENGTH) {
+		raiseInternalErrorEvent("failed to read released session");
+		delete sock;
+		return false;
+	}
+	unsigned char	*state=new unsigned char[statelength];
+	if ((uint32_t)sock->read(state,statelength)!=statelength) {
+		raiseInternalErrorEvent("failed to read released session state");
+		delete[] state;
+		delete sock;
+		return false;
+	}
+
+	// get the client's file descriptor
+	int32_t	descriptor;
+	if (!sock->receiveSocket(&descriptor)) {
+		raiseInternalErrorEvent("failed to receive released session");
+		delete[] state;
+		delete sock;
+		return false;
+	}
+	delete sock;
+
+	// park the session until the client sends something
+	pooledsessionnode	*psn=new pooledsessionnode;
+	psn->sock=new filedescriptor;
+	psn->sock->setFileDescriptor(descriptor);
+	psn->sock->translateByteOrder();
+	psn->protocolindex=protocolindex;
+	psn->state=state;
+	psn->statelength=statelength;
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	psn->parkedsec=dt.getEpoch();
+	pvt->_pooledsessions.setValue(psn->sock,psn);
+	pvt->_lsnr.addReadFileDescriptor(psn->sock);
+	pvt->_shm->pooled_sessions++;
+
+	raiseDebugMessageEvent("finished parking released session");
+	return true;
+}
+
+void sqlrlistener::expirePooledSessions() {
+
+	if (!pvt->_sessionpooling || pvt->_idleclienttimeout<1) {
+		return;
+	}
+
+	// check at most once per second
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	uint64_t	now=dt.getEpoch();
+	if (now==pvt->_pooledsessionsexpired) {
+		return;
+	}
+	pvt->_pooledsessionsexpired=now;
+
+	// close the sockets of clients that have been idle too long
+	listnode< filedescriptor * >	*node=
+				pvt->_pooledsessions.getKeys()->getFirst();
+	while (node) {
+		listnode< filedescriptor * >	*next=node->getNext();
+		pooledsessionnode	*psn=NULL;
+		pvt->_pooledsessions.getValue(node->getValue(),&psn);
+		if (now-psn->parkedsec>=(uint64_t)pvt->_idleclienttimeout) {
+			raiseDebugMessageEvent("closing idle pooled session");
+			pvt->_lsnr.removeFileDescriptor(psn->sock);
+			pvt->_pooledsessions.remove(psn->sock);
+			pvt->_shm->pooled_sessions--;
+			delete psn->sock;
+			delete[] psn->state;
+			delete psn;
+		}
+		node=next;
+	}
+}
+
+
+bool sqlrlistener::registerHandoff(filedescriptor *sock) {
+
+	raiseDebugMessageEvent("registering handoff...");
+
+	// get the connection daemon's pid
+	uint32_t processid;
+	if (sock->read(&processid)!=sizeof(uint32_t)) {
+		raiseInternalErrorEvent("failed to read process "
+					"id during registration");
+		delete sock;
+		return false;
+	}
+
+	// find a free node in the list, if we find another node with the
+	// same pid, then the old connection must have died off mysteriously,
+	// replace it
+	bool		inserted=false;
+	uint32_t	index=0;
+	for (; index<pvt->_maxconnections; index++) {
+		if (!pvt->_handoffsocklist[index].pid ||
+			pvt->_handoffsocklist[index].pid==processid) {
+			pvt->_handoffsocklist[index].pid=processid;
+			pvt->_handoffsocklist[index].sock=sock;
+			inserted=true;
+			break;
+		}
+	}
+
+	// if for some reason the scaler started more connections than
+	// "maxconnections" or if someone manually started one and the number
+	// of connections exceeded maxconnections, then the new connection won't
+	// fit in our list, grow the list to accommodate it...
+	if (inserted==false) {
+		handoffsocketnode	*newhandoffsocklist=
+				new handoffsocketnode[pvt->_maxconnections+1];
+		for (uint32_t i=0; i<pvt->_maxconnections; i++) {
+			newhandoffsocklist[i].pid=
+				pvt->_handoffsocklist[i].pid;
+			newhandoffsocklist[i].sock=
+				pvt->_handoffsocklist[i].sock;
+		}
+		delete[] pvt->_handoffsocklist;
+		newhandoffsocklist[pvt->_maxconnections].pid=processid;
+		newhandoffsocklist[pvt->_maxconnections].sock=sock;
+		pvt->_maxconnections++;
+		pvt->_handoffsocklist=newhandoffsocklist;
+	}
+
+	raiseDebugMessageEvent("finished registering handoff...");
+	return true;
+}
+
+bool sqlrlistener::deRegisterHandoff(filedescriptor *sock) {
+
+	raiseDebugMessageEvent("de-registering handoff...");
+
+	// get the connection daemon's pid
+	uint32_t	processid;
+	if (sock->read(&processid)!=sizeof(uint32_t)) {
+		raiseInternalErrorEvent("failed to read process "
+				"id during deregistration");
+		delete sock;
+		return false;
+	}
+
+	// remove the matching socket from the list
+	for (uint32_t i=0; i<pvt->_maxconnections; i++) {
+		if (pvt->_handoffsocklist[i].pid==processid) {
+			pvt->_handoffsocklist[i].pid=0;
+			delete pvt->_handoffsocklist[i].sock;
+			pvt->_handoffsocklist[i].sock=NULL;
+			break;
+		}
+	}
+
+	// clean up
+	delete sock;
+
+	raiseDebugMessageEvent("finished de-registering handoff...");
+	return true;
+}
+
+bool sqlrlistener::fixup(filedescriptor *sock) {
+
+	raiseDebugMessageEvent("passing socket of newly spawned connection...");
+
+	// get the pid of the connection daemon the child listener needs
+	uint32_t	processid;
+	if (sock->read(&processid)!=sizeof(uint32_t)) {
+		raiseInternalErrorEvent("failed to read process id during fixup");
+		delete sock;
+		return false;
+	}
+
+	// look through the handoffsocklist for the pid
+	bool	retval=false;
+	for (uint32_t i=0; i<pvt->_maxconnections; i++) {
+		if (pvt->_handoffsocklist[i].pid==processid) {
+			retval=sock->passSocket(pvt->_handoffsocklist[i].
 						sock->getFileDescriptor());
 			raiseDebugMessageEvent("found socket for requested pid ");
 			if (retval) {
@@ -1368,14 +2044,35 @@ bool sqlrlistener::fixup(filedescriptor *sock) {
 	return retval;
 }
 
-bool sqlrlistener::deniedIp(filedescriptor *clientsock) {
+bool sqlrlistener::deniedIp(filedescriptor *clientsock,
+					regularexpression *denied,
+					regularexpression *allowed) {
 
 	raiseDebugMessageEvent("checking for valid ip...");
 
+	// If only prefix lists are in use, then check the binary address of
+	// the peer directly, and only format it if it's rejected.
+	unsigned char	address[16];
+	uint16_t	addresslength;
+	if (pvt->_deniedlist && (pvt->_allowedlist || !allowed) &&
+			getPeerAddress(clientsock,address,&addresslength)) {
+		if (!pvt->_deniedlist->match(address,addresslength) ||
+				(pvt->_allowedlist &&
+				pvt->_allowedlist->match(address,
+							addresslength))) {
+			raiseDebugMessageEvent("valid ip");
+			return false;
+		}
+		char	*ip=clientsock->getPeerAddress();
+		stringbuffer	info;
+		info.append("rejected IP address: ")->append(ip);
+		raiseClientConnectionRefusedEvent(info.getString());
+		delete[] ip;
+		return true;
+	}
+
 	char	*ip=clientsock->getPeerAddress();
-	if (ip && pvt->_denied->match(ip) &&
-			(!pvt->_allowed ||
-			(pvt->_allowed && !pvt->_allowed->match(ip)))) {
+	if (ip && isDeniedIp(ip,denied,allowed)) {
 
 		stringbuffer	info;
 		info.append("rejected IP address: ")->append(ip);
@@ -1391,6 +2088,50 @@ bool sqlrlistener::deniedIp(filedescriptor *clientsock) {
 	return false;
 }
 
+bool sqlrlistener::getPeerAddress(filedescriptor *clientsock,
+						unsigned char *address,
+						uint16_t *addresslength) {
+
+	struct sockaddr_storage	ss;
+	socklen_t		sslen=sizeof(ss);
+	if (getpeername(clientsock->getFileDescriptor(),
+				(struct sockaddr *)&ss,&sslen)) {
+		return false;
+	}
+	if (ss.ss_family==AF_INET) {
+		bytestring::copy(address,
+			&(((struct sockaddr_in *)&ss)->sin_addr),4);
+		*addresslength=4;
+		return true;
+	}
+	if (ss.ss_family==AF_INET6) {
+		bytestring::copy(address,
+			&(((struct sockaddr_in6 *)&ss)->sin6_addr),16);
+		*addresslength=16;
+		return true;
+	}
+	return false;
+}
+
+bool sqlrlistener::isDeniedIp(const char *ip,
+					regularexpression *denied,
+					regularexpression *allowed) {
+
+	// the prefix lists are read-only once built, so all acceptor threads
+	// can share them, but the regular expressions are per-thread
+	if (pvt->_deniedlist) {
+		if (!pvt->_deniedlist->match(ip)) {
+			return false;
+		}
+	} else if (!denied->match(ip)) {
+		return false;
+	}
+	if (pvt->_allowedlist) {
+		return !pvt->_allowedlist->match(ip);
+	}
+	return (!allowed || !allowed->match(ip));
+}
+
 void sqlrlistener::errorClientSession(filedescriptor *clientsock,
 							int64_t errnum,
 							const char *err) {
@@ -1407,14 +2148,16 @@ void sqlrlistener::errorClientSession(filedescriptor *clientsock,
 }
 
 struct clientsessionattr {
-	thread		*thr;
-	sqlrlistener	*lsnr;
-	filedescriptor	*clientsock;
-	uint16_t	protocolindex;
+	thread			*thr;
+	sqlrlistener		*lsnr;
+	filedescriptor		*clientsock;
+	uint16_t		protocolindex;
+	pooledsessionnode	*session;
 };
 
 void sqlrlistener::forkChild(filedescriptor *clientsock,
-					uint16_t protocolindex) {
+					uint16_t protocolindex,
+					pooledsessionnode *session) {
 
 	// increment the number of "forked listeners"
 	// do this before we actually fork to prevent a race condition where
@@ -1425,6 +2168,11 @@ void sqlrlistener::forkChild(filedescriptor *clientsock,
 
 	// if we already have too many listeners running,
 	// bail and return an error to the client
+	// (if proxied clients are handed off to the proxy threads, then
+	// maxlisteners limits the number of proxied sessions instead)
+	if (pvt->_proxythreads) {
+		forkedlisteners+=pvt->_shm->proxied_sessions;
+	}
 	if (pvt->_maxlisteners>-1 && forkedlisteners>pvt->_maxlisteners) {
 
 		// since we've decided not to fork, decrement the counters
@@ -1448,6 +2196,7 @@ void sqlrlistener::forkChild(filedescriptor *clientsock,
 		csa->lsnr=this;
 		csa->clientsock=clientsock;
 		csa->protocolindex=protocolindex;
+		csa->session=session;
 
 		// spawn the thread
 		if (thr->spawn((void *(*)(void *))clientSessionThread,
@@ -1488,7 +2237,7 @@ void sqlrlistener::forkChild(filedescriptor *clientsock,
 			pvt->_sqlrlg->init(this,NULL);
 		}
 
-		clientSession(clientsock,protocolindex,NULL);
+		clientSession(clientsock,protocolindex,session,NULL);
 
 		decrementBusyListeners();
 		decrementForkedListeners();
@@ -1509,6 +2258,10 @@ void sqlrlistener::forkChild(filedescriptor *clientsock,
 		// the main process doesn't need to stay connected
 		// to the client, only the forked process
 		delete clientsock;
+		if (session) {
+			delete[] session->state;
+			delete session;
+		}
 
 	} else {
 
@@ -1524,7 +2277,8 @@ void sqlrlistener::forkChild(filedescriptor *clientsock,
 
 void sqlrlistener::clientSessionThread(void *attr) {
 	clientsessionattr	*csa=(clientsessionattr *)attr;
-	csa->lsnr->clientSession(csa->clientsock,csa->protocolindex,csa->thr);
+	csa->lsnr->clientSession(csa->clientsock,csa->protocolindex,
+						csa->session,csa->thr);
 	csa->lsnr->decrementBusyListeners();
 	csa->lsnr->decrementForkedListeners();
 	delete csa->thr;
@@ -1533,13 +2287,15 @@ void sqlrlistener::clientSessionThread(void *attr) {
 
 void sqlrlistener::clientSession(filedescriptor *clientsock,
 					uint16_t protocolindex,
+					pooledsessionnode *session,
 					thread *thr) {
 
 	if (pvt->_dynamicscaling) {
 		incrementConnectedClientCount();
 	}
 
-	bool	passstatus=handOffOrProxyClient(clientsock,protocolindex,thr);
+	bool	passstatus=handOffOrProxyClient(clientsock,protocolindex,
+								session,thr);
 
 	// If the handoff failed, decrement the connected client count.
 	// If it had succeeded then the connection daemon would
@@ -1553,10 +2309,15 @@ void sqlrlistener::clientSession(filedescriptor *clientsock,
 	waitForClientClose(passstatus,clientsock);
 
 	delete clientsock;
+	if (session) {
+		delete[] session->state;
+		delete session;
+	}
 }
 
 bool sqlrlistener::handOffOrProxyClient(filedescriptor *sock,
 						uint16_t protocolindex,
+						pooledsessionnode *session,
 						thread *thr) {
 
 	unixsocketclient	connectionsock;
@@ -1566,6 +2327,33 @@ bool sqlrlistener::handOffOrProxyClient(filedescriptor *sock,
 	uint16_t		unixportstrlen;
 	bool			retval=false;
 
+	// get the user that the client is logging in as, so
+	// we can prefer a connection that's already logged
+	// in to the database as that user
+	char	user[USERSIZE];
+	user[0]='\0';
+	if (pvt->_affinity) {
+		if (session) {
+			// pooled sessions start with the user
+			uint16_t	userlen=0;
+			if (session->statelength>=sizeof(uint16_t)) {
+				bytestring::copy(&userlen,session->state,
+							sizeof(uint16_t));
+			}
+			if (userlen<USERSIZE &&
+				sizeof(uint16_t)+userlen<=
+						session->statelength) {
+				bytestring::copy(user,
+						session->state+
+						sizeof(uint16_t),
+						userlen);
+				user[userlen]='\0';
+			}
+		} else {
+			peekClientUser(sock,protocolindex,user);
+		}
+	}
+
 	// loop in case client doesn't get handed off successfully
 	for (;;) {
 
@@ -1575,7 +2363,7 @@ bool sqlrlistener::handOffOrProxyClient(filedescriptor *sock,
 
 		if (!getAConnection(&connectionpid,&inetport,
 					unixportstr,&unixportstrlen,
-					sock,thr)) {
+					user,sock,thr)) {
 			// fatal error occurred while getting a connection
 			retval=false;
 			break;
@@ -1594,12 +2382,32 @@ bool sqlrlistener::handOffOrProxyClient(filedescriptor *sock,
 		// been killed.  Loop back and get another connection...
 
 		// tell the connection what handoff mode to expect
-		connectionsock.write(pvt->_handoffmode);
+		connectionsock.write((session)?
+					(uint16_t)HANDOFF_RESUME:
+					pvt->_handoffmode);
 
 		// tell the connection which protocol to use
 		connectionsock.write(protocolindex);
 
-		if (pvt->_handoffmode==HANDOFF_PASS) {
+		if (session) {
+
+			// pass the file descriptor, followed
+			// by the state of the pooled session
+			if (!connectionsock.passSocket(
+					sock->getFileDescriptor()) ||
+				connectionsock.write(session->statelength)!=
+							sizeof(uint32_t) ||
+				(uint32_t)connectionsock.write(
+						session->state,
+						session->statelength)!=
+						session->statelength) {
+				raiseInternalErrorEvent("failed to resume "
+							"pooled session");
+				continue;
+			}
+			connectionsock.flushWriteBuffer(-1,-1);
+
+		} else if (pvt->_handoffmode==HANDOFF_PASS) {
 
 			// pass the file descriptor
 			if (!connectionsock.passSocket(
@@ -1770,7 +2578,12 @@ bool sqlrlistener::acceptAvailableConnection(thread *thr,
 	// between calls to signalListenerToRead() and
 	// waitForListenerToFinishReading().  It's safe to reset it here
 	// because of the lock on semaphore 1.
-	pvt->_semset->setValue(2,0);
+	//
+	// With user affinity, it counts the idle connections though, so it
+	// must be left alone.
+	if (!pvt->_affinity) {
+		pvt->_semset->setValue(2,0);
+	}
 
 	raiseDebugMessageEvent("succeeded in waiting for "
 				"an available connection");
@@ -1796,13 +2609,135 @@ void sqlrlistener::waitForConnectionToBeReadyForHandoff() {
 	raiseDebugMessageEvent("done waiting for connection to be ready for handoff");
 }
 
+bool sqlrlistener::peekClientUser(filedescriptor *sock,
+					uint16_t protocolindex,
+					char *user) {
+
+	user[0]='\0';
+
+	// only sqlrclient listeners that don't use
+	// kerberos or tls send credentials in the clear
+	domnode	*ln=pvt->_cfg->getListeners()->getFirstTagChild("listener");
+	for (uint16_t i=0; i<protocolindex && !ln->isNullNode(); i++) {
+		ln=ln->getNextTagSibling("listener");
+	}
+	if (ln->isNullNode() ||
+		charstring::compare(ln->getAttributeValue("protocol"),
+							"sqlrclient") ||
+		charstring::isYes(ln->getAttributeValue("krb")) ||
+		charstring::isYes(ln->getAttributeValue("tls"))) {
+		return false;
+	}
+
+	// give the client a moment to send its credentials
+	listener	lsnr;
+	lsnr.addReadFileDescriptor(sock);
+	if (lsnr.listen(0,DEFAULT_AFFINITYPEEKTIMEOUT)<1) {
+		return false;
+	}
+
+	// Peek at them without consuming them, the connection will read
+	// them for real.  The client sends (in network byte order):
+	// PROTOCOLVERSION, version, AUTH, user size, user, ...
+	unsigned char	buffer[3*sizeof(uint16_t)+sizeof(uint32_t)+USERSIZE];
+	ssize_t	size=::recv(sock->getFileDescriptor(),
+				(char *)buffer,sizeof(buffer),MSG_PEEK);
+	if (size<(ssize_t)(sizeof(uint16_t)+sizeof(uint32_t))) {
+		return false;
+	}
+	size_t	pos=0;
+	uint16_t	command=(buffer[0]<<8)|buffer[1];
+	if (command==PROTOCOLVERSION) {
+		pos=2*sizeof(uint16_t);
+		if (size<(ssize_t)(pos+sizeof(uint16_t)+sizeof(uint32_t))) {
+			return false;
+		}
+		command=(buffer[pos]<<8)|buffer[pos+1];
+	}
+	if (command!=AUTH) {
+		return false;
+	}
+	pos+=sizeof(uint16_t);
+	uint32_t	userlen=((uint32_t)buffer[pos]<<24)|
+				((uint32_t)buffer[pos+1]<<16)|
+				((uint32_t)buffer[pos+2]<<8)|
+				((uint32_t)buffer[pos+3]);
+	pos+=sizeof(uint32_t);
+	if (userlen>=USERSIZE || (size_t)size<pos+userlen) {
+		return false;
+	}
+	bytestring::copy(user,buffer+pos,userlen);
+	user[userlen]='\0';
+	return true;
+}
+
+bool sqlrlistener::pickIdleConnection(const char *user,
+					uint32_t *connectionpid,
+					char *connectionid) {
+
+	raiseDebugMessageEvent("picking an idle connection...");
+
+	// the list of idle connections is protected by the announce mutex
+	pvt->_semset->waitWithUndo(0);
+
+	// The semaphore that counts idle connections can be left
+	// incremented if a connection removed itself from the list
+	// because its ttl was reached.  In that case the list might
+	// be empty.
+	uint32_t	count=pvt->_shm->idleconnectioncount;
+	if (!count) {
+		pvt->_semset->signalWithUndo(0);
+		raiseDebugMessageEvent("no idle connections");
+		return false;
+	}
+
+	// Prefer the most recently idle connection that's already logged
+	// in to the database as the client's user, otherwise just use the
+	// most recently idle connection.
+	uint32_t	index=count-1;
+	if (!charstring::isNullOrEmpty(user)) {
+		bool	found=false;
+		for (uint32_t i=count; i>0; i--) {
+			if (!charstring::compare(
+				pvt->_shm->idleconnections[i-1].dbuser,user)) {
+				index=i-1;
+				found=true;
+				break;
+			}
+		}
+		if (!found) {
+			pvt->_shm->affinity_misses++;
+		} else if (index!=count-1) {
+			pvt->_shm->affinity_relogins_avoided++;
+		}
+	}
+
+	// take it out of the list
+	*connectionpid=pvt->_shm->idleconnections[index].connectionpid;
+	charstring::copy(connectionid,
+			pvt->_shm->idleconnections[index].connectionid,
+			MAXCONNECTIONIDLEN);
+	for (uint32_t i=index+1; i<count; i++) {
+		pvt->_shm->idleconnections[i-1]=pvt->_shm->idleconnections[i];
+	}
+	pvt->_shm->idleconnectioncount--;
+
+	pvt->_semset->signalWithUndo(0);
+
+	raiseDebugMessageEvent("finished picking an idle connection");
+	return true;
+}
+
 bool sqlrlistener::getAConnection(uint32_t *connectionpid,
 					uint16_t *inetport,
 					char *unixportstr,
 					uint16_t *unixportstrlen,
+					const char *user,
 					filedescriptor *sock,
 					thread *thr) {
 
+	char	connectionid[MAXCONNECTIONIDLEN];
+
 	for (;;) {
 
 		if (process::getShutDownFlag()) {
@@ -1827,7 +2762,13 @@ bool sqlrlistener::getAConnection(uint32_t *connectionpid,
 			// wait for an available connection
 			ok=acceptAvailableConnection(thr,&alldbsdown,&timeout);
 
-			if (ok) {
+			if (ok && pvt->_affinity) {
+
+				// pick one of the idle connections
+				ok=pickIdleConnection(user,connectionpid,
+								connectionid);
+
+			} else if (ok) {
 
 				// get the pid
 				*connectionpid=
@@ -1846,10 +2787,16 @@ bool sqlrlistener::getAConnection(uint32_t *connectionpid,
 
 			// wait for the connection to let us know that it's
 			// ready to have a client handed off to it
-			waitForConnectionToBeReadyForHandoff();
+			// (idle connections are already ready)
+			if (!pvt->_affinity) {
+				waitForConnectionToBeReadyForHandoff();
+				charstring::copy(connectionid,
+						pvt->_shm->connectionid,
+						MAXCONNECTIONIDLEN);
+			}
 
 			// make sure the connection is actually up...
-			if (connectionIsUp(pvt->_shm->connectionid)) {
+			if (connectionIsUp(connectionid)) {
 				if (pvt->_sqlrlg || pvt->_sqlrn) {
 					stringbuffer	debugstr;
 					debugstr.append("finished getting "
@@ -2077,6 +3024,13 @@ bool sqlrlistener::proxyClient(pid_t connectionpid,
 		return false;
 	}
 
+	// Hand the session off to the proxy threads, if we're using them.
+	// If that fails then fall back to proxying the client here.
+	if (pvt->_proxythreads && addProxiedSession(serversock,clientsock)) {
+		raiseDebugMessageEvent("handed client off to proxy threads");
+		return true;
+	}
+
 	// allow short reads and use non blocking mode
 	serversock->allowShortReads();
 	serversock->useNonBlockingMode();
@@ -2196,6 +3150,502 @@ bool sqlrlistener::proxyClient(pid_t connectionpid,
 	return true;
 }
 
+#if defined(HAVE_EPOLL) && defined(HAVE_SPLICE)
+
+bool sqlrlistener::startProxyEngine() {
+
+	raiseDebugMessageEvent("starting proxy threads...");
+
+	pvt->_proxyenginemutex=new threadmutex;
+	pvt->_proxyengine=new proxyenginethread[pvt->_proxythreads];
+	for (uint32_t i=0; i<pvt->_proxythreads; i++) {
+		proxyenginethread	*pet=&(pvt->_proxyengine[i]);
+		pet->lsnr=this;
+		pet->running=false;
+		pet->stop=false;
+		pet->epfd=epoll_create1(EPOLL_CLOEXEC);
+		if (pet->epfd==-1) {
+			raiseInternalErrorEvent("failed to create "
+						"proxy thread epoll set");
+			return false;
+		}
+	}
+	for (uint32_t i=0; i<pvt->_proxythreads; i++) {
+		proxyenginethread	*pet=&(pvt->_proxyengine[i]);
+		if (!pet->thr.spawn((void *(*)(void *))proxyEngineThread,
+							(void *)pet,false)) {
+			raiseInternalErrorEvent("failed to spawn proxy thread");
+			return false;
+		}
+		pet->running=true;
+	}
+
+	raiseDebugMessageEvent("finished starting proxy threads");
+	return true;
+}
+
+void sqlrlistener::stopProxyEngine() {
+
+	if (!pvt->_proxyengine) {
+		return;
+	}
+
+	// tell the threads to stop and wait for them to do so
+	for (uint32_t i=0; i<pvt->_proxythreads; i++) {
+		pvt->_proxyengine[i].stop=true;
+	}
+	for (uint32_t i=0; i<pvt->_proxythreads; i++) {
+		proxyenginethread	*pet=&(pvt->_proxyengine[i]);
+		if (pet->running) {
+			pet->thr.join(NULL);
+		}
+	}
+
+	// clean up whatever sessions were still being proxied
+	for (uint32_t i=0; i<pvt->_proxythreads; i++) {
+		proxyenginethread	*pet=&(pvt->_proxyengine[i]);
+		for (listnode< proxiedsession * > *node=
+					pet->newsessions.getFirst();
+					node; node=node->getNext()) {
+			pet->sessions.append(node->getValue());
+		}
+		pet->newsessions.clear();
+		for (listnode< proxiedsession * > *node=
+					pet->sessions.getFirst();
+					node; node=node->getNext()) {
+			proxiedsession	*ps=node->getValue();
+			if (!ps->done) {
+				endProxiedSession(pet,ps);
+			}
+			delete ps;
+		}
+		pet->sessions.clear();
+		if (pet->epfd!=-1) {
+			::close(pet->epfd);
+		}
+	}
+	delete[] pvt->_proxyengine;
+	pvt->_proxyengine=NULL;
+	delete pvt->_proxyenginemutex;
+	pvt->_proxyenginemutex=NULL;
+}
+
+void sqlrlistener::proxyEngineThread(void *attr) {
+	proxyenginethread	*pet=(proxyenginethread *)attr;
+	pet->lsnr->proxyEngineLoop(pet);
+}
+
+void sqlrlistener::proxyEngineLoop(proxyenginethread *pet) {
+
+	struct epoll_event	events[PROXYMAXEVENTS];
+	datetime		dt;
+	uint64_t		lastexpiry=0;
+
+	for (;;) {
+
+		if (process::getShutDownFlag() || pet->stop) {
+			return;
+		}
+
+		// take ownership of sessions that were handed to this thread
+		pet->newsessionsmutex.lock();
+		for (listnode< proxiedsession * > *node=
+					pet->newsessions.getFirst();
+					node; node=node->getNext()) {
+			pet->sessions.append(node->getValue());
+		}
+		pet->newsessions.clear();
+		pet->newsessionsmutex.unlock();
+
+		dt.getSystemDateAndTime();
+		uint64_t	now=dt.getEpoch();
+
+		// Free sessions that ended during the previous pass.  Once a
+		// second, also end sessions that have been idle too long.
+		bool	expire=(pvt->_idleclienttimeout>0 && now!=lastexpiry);
+		listnode< proxiedsession * >	*node=pet->sessions.getFirst();
+		while (node) {
+			listnode< proxiedsession * >	*next=node->getNext();
+			proxiedsession			*ps=node->getValue();
+			if (expire && !ps->done &&
+				now-ps->lastactivity>=
+				(uint64_t)pvt->_idleclienttimeout) {
+				if (ps->closing) {
+					// the connection isn't taking
+					// the END_SESSION, give up on it
+					raiseDebugMessageEvent(
+						"proxied connection "
+						"idle timeout");
+					closeProxiedSession(pet,ps);
+				} else {
+					raiseDebugMessageEvent(
+						"proxied client "
+						"idle timeout");
+					ps->endsession=true;
+					endProxiedSession(pet,ps);
+				}
+			}
+			if (ps->done) {
+				pet->sessions.remove(ps);
+				delete ps;
+			}
+			node=next;
+		}
+		if (expire) {
+			lastexpiry=now;
+		}
+
+		// wait for data from, or room to write to, any of the
+		// sockets, waking up once a second to check for idle sessions
+		int	count=epoll_wait(pet->epfd,events,PROXYMAXEVENTS,1000);
+		if (count<0) {
+			if (errno!=EINTR) {
+				raiseInternalErrorEvent("proxy thread "
+							"epoll_wait failed");
+			}
+			continue;
+		}
+
+		dt.getSystemDateAndTime();
+		now=dt.getEpoch();
+
+		for (int i=0; i<count; i++) {
+			proxyendpoint	*pe=(proxyendpoint *)events[i].data.ptr;
+
+			// the other end of the session may
+			// have ended it earlier in this pass
+			if (pe->session->done) {
+				continue;
+			}
+			handleProxiedSessionEvent(pet,pe->session,pe->client,
+							events[i].events,now);
+		}
+	}
+}
+
+bool sqlrlistener::addProxiedSession(filedescriptor *serversock,
+					filedescriptor *clientsock) {
+
+	// The proxy threads get their own copies of the descriptors.  The
+	// client socket is closed when this listener thread is done with it,
+	// and the server socket is the connection's handoff socket, which
+	// the main thread replaces when the connection re-registers.
+	proxiedsession	*ps=new proxiedsession;
+	ps->clientfd=::dup(clientsock->getFileDescriptor());
+	ps->serverfd=::dup(serversock->getFileDescriptor());
+	ps->toserver[0]=-1;
+	ps->toserver[1]=-1;
+	ps->toclient[0]=-1;
+	ps->toclient[1]=-1;
+	if (ps->clientfd==-1 || ps->serverfd==-1 ||
+			::pipe2(ps->toserver,O_NONBLOCK|O_CLOEXEC)==-1 ||
+			::pipe2(ps->toclient,O_NONBLOCK|O_CLOEXEC)==-1) {
+		raiseInternalErrorEvent("failed to set up proxied session");
+		int32_t	fds[]={ps->clientfd,ps->serverfd,
+				ps->toserver[0],ps->toserver[1],
+				ps->toclient[0],ps->toclient[1]};
+		for (uint16_t i=0; i<sizeof(fds)/sizeof(int32_t); i++) {
+			if (fds[i]!=-1) {
+				::close(fds[i]);
+			}
+		}
+		delete ps;
+		return false;
+	}
+	::fcntl(ps->clientfd,F_SETFL,
+			::fcntl(ps->clientfd,F_GETFL)|O_NONBLOCK);
+	::fcntl(ps->serverfd,F_SETFL,
+			::fcntl(ps->serverfd,F_GETFL)|O_NONBLOCK);
+	ps->toserverpending=0;
+	ps->toclientpending=0;
+	ps->clientevents=EPOLLIN;
+	ps->serverevents=EPOLLIN;
+	ps->clientend.session=ps;
+	ps->clientend.client=true;
+	ps->serverend.session=ps;
+	ps->serverend.client=false;
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	ps->lastactivity=dt.getEpoch();
+	ps->endsession=false;
+	ps->closing=false;
+	ps->endsessionpending=0;
+	ps->done=false;
+
+	// pick a thread
+	pvt->_proxyenginemutex->lock();
+	proxyenginethread	*pet=&(pvt->_proxyengine[pvt->_proxyenginenext]);
+	pvt->_proxyenginenext=(pvt->_proxyenginenext+1)%pvt->_proxythreads;
+	pvt->_proxyenginemutex->unlock();
+
+	incrementProxiedSessions();
+
+	// Give the session to the thread before adding its sockets to the
+	// epoll set.  The thread may see events for it before it takes
+	// ownership of it, but it won't free it until after it has.
+	pet->newsessionsmutex.lock();
+	pet->newsessions.append(ps);
+	pet->newsessionsmutex.unlock();
+
+	struct epoll_event	ev;
+	ev.events=ps->clientevents;
+	ev.data.ptr=&ps->clientend;
+	if (::epoll_ctl(pet->epfd,EPOLL_CTL_ADD,ps->clientfd,&ev)==-1) {
+		raiseInternalErrorEvent("failed to add proxied client");
+		endProxiedSession(pet,ps);
+		return false;
+	}
+	ev.events=ps->serverevents;
+	ev.data.ptr=&ps->serverend;
+	if (::epoll_ctl(pet->epfd,EPOLL_CTL_ADD,ps->serverfd,&ev)==-1) {
+		raiseInternalErrorEvent("failed to add proxied connection");
+		endProxiedSession(pet,ps);
+		return false;
+	}
+	return true;
+}
+
+void sqlrlistener::handleProxiedSessionEvent(proxyenginethread *pet,
+						proxiedsession *ps,
+						bool client,
+						uint32_t events,
+						uint64_t now) {
+
+	// once the session is ending, just keep writing
+	// to the connection until the END_SESSION is out
+	if (ps->closing) {
+		if (client) {
+			return;
+		}
+		if (!flushProxiedEndSession(ps,now) ||
+				(!ps->toserverpending &&
+					!ps->endsessionpending)) {
+			closeProxiedSession(pet,ps);
+		}
+		return;
+	}
+
+	// move whatever this side sent toward the other side
+	if ((events&(EPOLLIN|EPOLLHUP|EPOLLERR)) &&
+				!spliceProxiedData(ps,client,now)) {
+		endProxiedSession(pet,ps);
+		return;
+	}
+
+	// move whatever is waiting for this side to it
+	if ((events&EPOLLOUT) && !drainProxiedData(ps,!client,now)) {
+		endProxiedSession(pet,ps);
+		return;
+	}
+
+	updateProxiedSessionEvents(pet,ps);
+}
+
+bool sqlrlistener::spliceProxiedData(proxiedsession *ps,
+						bool fromclient,
+						uint64_t now) {
+
+	int32_t	src=(fromclient)?ps->clientfd:ps->serverfd;
+	int32_t	pipein=(fromclient)?ps->toserver[1]:ps->toclient[1];
+	size_t	*pending=(fromclient)?&ps->toserverpending:
+					&ps->toclientpending;
+
+	ssize_t	result=::splice(src,NULL,pipein,NULL,PROXYSPLICESIZE,
+					SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (result==0 || (result<0 && errno!=EAGAIN && errno!=EINTR)) {
+
+		// If the client closed the socket then we can't be sure
+		// whether it succeeded in transmitting an END_SESSION command
+		// or whether it even tried, so send one ourselves.  If the
+		// connection closed its end, then the session is already over.
+		if (pvt->_sqlrlg || pvt->_sqlrn) {
+			stringbuffer	debugstr;
+			debugstr.append("proxied ");
+			debugstr.append((fromclient)?"client":"connection");
+			debugstr.append(" closed");
+			raiseDebugMessageEvent(debugstr.getString());
+		}
+		ps->endsession=fromclient;
+		return false;
+	}
+	if (result>0) {
+		*pending+=result;
+		ps->lastactivity=now;
+	}
+	return drainProxiedData(ps,fromclient,now);
+}
+
+bool sqlrlistener::drainProxiedData(proxiedsession *ps,
+						bool fromclient,
+						uint64_t now) {
+
+	int32_t	pipeout=(fromclient)?ps->toserver[0]:ps->toclient[0];
+	int32_t	dst=(fromclient)?ps->serverfd:ps->clientfd;
+	size_t	*pending=(fromclient)?&ps->toserverpending:
+					&ps->toclientpending;
+
+	while (*pending) {
+		ssize_t	result=::splice(pipeout,NULL,dst,NULL,*pending,
+					SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+		if (result>0) {
+			*pending-=result;
+			ps->lastactivity=now;
+		} else if (result<0 && errno==EINTR) {
+			continue;
+		} else if (result<0 && errno==EAGAIN) {
+			// the destination is full, wait until it isn't
+			break;
+		} else {
+			// the destination went away
+			ps->endsession=!fromclient;
+			return false;
+		}
+	}
+	return true;
+}
+
+void sqlrlistener::updateProxiedSessionEvents(proxyenginethread *pet,
+							proxiedsession *ps) {
+
+	// Stop reading from a side while data that it sent is still waiting
+	// to be written to the other side, and wait for room to write to a
+	// side while data is waiting to be written to it.
+	uint32_t	clientevents=((ps->toserverpending)?0:EPOLLIN)|
+					((ps->toclientpending)?EPOLLOUT:0);
+	uint32_t	serverevents=((ps->toclientpending)?0:EPOLLIN)|
+					((ps->toserverpending)?EPOLLOUT:0);
+
+	struct epoll_event	ev;
+	if (clientevents!=ps->clientevents) {
+		ev.events=clientevents;
+		ev.data.ptr=&ps->clientend;
+		::epoll_ctl(pet->epfd,EPOLL_CTL_MOD,ps->clientfd,&ev);
+		ps->clientevents=clientevents;
+	}
+	if (serverevents!=ps->serverevents) {
+		ev.events=serverevents;
+		ev.data.ptr=&ps->serverend;
+		::epoll_ctl(pet->epfd,EPOLL_CTL_MOD,ps->serverfd,&ev);
+		ps->serverevents=serverevents;
+	}
+}
+
+void sqlrlistener::endProxiedSession(proxyenginethread *pet,
+						proxiedsession *ps) {
+
+	raiseDebugMessageEvent("ending proxied session...");
+
+	if (!ps->endsession || ps->closing) {
+		closeProxiedSession(pet,ps);
+		return;
+	}
+
+	// Send along whatever the client sent before it went away, followed
+	// by an END_SESSION.  Worst case, the connection will receive a second
+	// END_SESSION, but it's kludged to tolerate that.
+	//
+	// This thread is shared by many sessions, so it can't block until the
+	// connection reads all of that.  Stop listening to the client and
+	// queue the END_SESSION like any other data for the connection, and
+	// close the session once it's all been written.
+	raiseDebugMessageEvent("ending the session");
+	::epoll_ctl(pet->epfd,EPOLL_CTL_DEL,ps->clientfd,NULL);
+	ps->clientevents=0;
+	uint16_t	cmd=filedescriptor::hostToNet((uint16_t)END_SESSION);
+	bytestring::copy(ps->endsessioncmd,&cmd,sizeof(cmd));
+	ps->endsessionpending=sizeof(cmd);
+	ps->closing=true;
+
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	ps->lastactivity=dt.getEpoch();
+
+	if (!flushProxiedEndSession(ps,ps->lastactivity) ||
+			(!ps->toserverpending && !ps->endsessionpending)) {
+		closeProxiedSession(pet,ps);
+		return;
+	}
+
+	// wait for room to write the rest
+	struct epoll_event	ev;
+	ev.events=EPOLLOUT;
+	ev.data.ptr=&ps->serverend;
+	::epoll_ctl(pet->epfd,EPOLL_CTL_MOD,ps->serverfd,&ev);
+	ps->serverevents=EPOLLOUT;
+}
+
+bool sqlrlistener::flushProxiedEndSession(proxiedsession *ps, uint64_t now) {
+
+	// whatever the client sent goes first
+	if (!drainProxiedData(ps,true,now)) {
+		return false;
+	}
+	if (ps->toserverpending) {
+		return true;
+	}
+
+	while (ps->endsessionpending) {
+		ssize_t	result=::write(ps->serverfd,
+					ps->endsessioncmd+
+						sizeof(ps->endsessioncmd)-
+						ps->endsessionpending,
+					ps->endsessionpending);
+		if (result>0) {
+			ps->endsessionpending-=result;
+			ps->lastactivity=now;
+		} else if (result<0 && errno==EINTR) {
+			continue;
+		} else if (result<0 && errno==EAGAIN) {
+			break;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+void sqlrlistener::closeProxiedSession(proxyenginethread *pet,
+						proxiedsession *ps) {
+
+	::epoll_ctl(pet->epfd,EPOLL_CTL_DEL,ps->clientfd,NULL);
+	::epoll_ctl(pet->epfd,EPOLL_CTL_DEL,ps->serverfd,NULL);
+
+	// The server socket shares its blocking mode with the connection's
+	// handoff socket, so set it back to blocking mode.
+	::fcntl(ps->serverfd,F_SETFL,
+			::fcntl(ps->serverfd,F_GETFL)&~O_NONBLOCK);
+
+	::close(ps->clientfd);
+	::close(ps->serverfd);
+	::close(ps->toserver[0]);
+	::close(ps->toserver[1]);
+	::close(ps->toclient[0]);
+	::close(ps->toclient[1]);
+
+	// the proxy thread frees the session on its next pass
+	ps->done=true;
+
+	decrementProxiedSessions();
+
+	raiseDebugMessageEvent("finished ending proxied session");
+}
+
+#else
+
+bool sqlrlistener::startProxyEngine() {
+	return false;
+}
+
+void sqlrlistener::stopProxyEngine() {
+}
+
+bool sqlrlistener::addProxiedSession(filedescriptor *serversock,
+					filedescriptor *clientsock) {
+	return false;
+}
+
+#endif
+
 void sqlrlistener::waitForClientClose(bool passstatus,
 					filedescriptor *clientsock) {
 
@@ -2407,6 +3857,20 @@ int32_t sqlrlistener::getBusyListeners() {
 	return pvt->_semset->getValue(10);
 }
 
+void sqlrlistener::incrementProxiedSessions() {
+	pvt->_semset->waitWithUndo(9);
+	pvt->_shm->proxied_sessions++;
+	pvt->_semset->signalWithUndo(9);
+}
+
+void sqlrlistener::decrementProxiedSessions() {
+	pvt->_semset->waitWithUndo(9);
+	if (pvt->_shm->proxied_sessions) {
+		pvt->_shm->proxied_sessions--;
+	}
+	pvt->_semset->signalWithUndo(9);
+}
+
 void sqlrlistener::raiseDebugMessageEvent(const char *info) {
 	if (pvt->_sqlrlg) {
 		pvt->_sqlrlg->run(this,NULL,NULL,
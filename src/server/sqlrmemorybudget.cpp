@@ -0,0 +1,139 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+
+class sqlrmemorybudgetprivate {
+	friend class sqlrmemorybudget;
+	private:
+		uint64_t	_softlimit;
+		uint64_t	_hardlimit;
+
+		uint64_t	_used[SQLRMEMORY_CATEGORIES];
+		uint64_t	_total;
+		uint64_t	_peak;
+
+		// the number of times that usage has gone over the soft limit
+		uint64_t	_oversoft;
+		bool		_wasoversoft;
+
+		sqlrconnstatistics	*_cs;
+};
+
+sqlrmemorybudget::sqlrmemorybudget() {
+	pvt=new sqlrmemorybudgetprivate;
+	pvt->_softlimit=0;
+	pvt->_hardlimit=0;
+	for (uint16_t i=0; i<SQLRMEMORY_CATEGORIES; i++) {
+		pvt->_used[i]=0;
+	}
+	pvt->_total=0;
+	pvt->_peak=0;
+	pvt->_oversoft=0;
+	pvt->_wasoversoft=false;
+	pvt->_cs=NULL;
+}
+
+sqlrmemorybudget::~sqlrmemorybudget() {
+	delete pvt;
+}
+
+void sqlrmemorybudget::setSoftLimit(uint64_t softlimit) {
+	pvt->_softlimit=softlimit;
+}
+
+void sqlrmemorybudget::setHardLimit(uint64_t hardlimit) {
+	pvt->_hardlimit=hardlimit;
+}
+
+uint64_t sqlrmemorybudget::getSoftLimit() {
+	return pvt->_softlimit;
+}
+
+uint64_t sqlrmemorybudget::getHardLimit() {
+	return pvt->_hardlimit;
+}
+
+static void updateStatistics(sqlrconnstatistics *cs,
+				uint64_t *used, uint64_t total, uint64_t peak) {
+	if (!cs) {
+		return;
+	}
+	cs->memused=total;
+	cs->mempeak=peak;
+	cs->memcursors=used[SQLRMEMORY_CURSORS];
+	cs->memqueries=used[SQLRMEMORY_QUERIES];
+	cs->membinds=used[SQLRMEMORY_BINDS];
+	cs->memlobs=used[SQLRMEMORY_LOBS];
+	cs->memfetch=used[SQLRMEMORY_FETCH];
+}
+
+void sqlrmemorybudget::setStatistics(sqlrconnstatistics *cs) {
+	pvt->_cs=cs;
+	updateStatistics(pvt->_cs,pvt->_used,pvt->_total,pvt->_peak);
+}
+
+void sqlrmemorybudget::count(sqlrmemorycategory_t category, uint64_t bytes) {
+	pvt->_used[category]+=bytes;
+	pvt->_total+=bytes;
+	if (pvt->_total>pvt->_peak) {
+		pvt->_peak=pvt->_total;
+	}
+
+	// count each time that usage goes over the soft limit,
+	// rather than each allocation made while it's over it
+	bool	oversoft=(pvt->_softlimit && pvt->_total>pvt->_softlimit);
+	if (oversoft && !pvt->_wasoversoft) {
+		pvt->_oversoft++;
+	}
+	pvt->_wasoversoft=oversoft;
+
+	updateStatistics(pvt->_cs,pvt->_used,pvt->_total,pvt->_peak);
+}
+
+bool sqlrmemorybudget::reserve(sqlrmemorycategory_t category, uint64_t bytes) {
+	if (pvt->_hardlimit && pvt->_total+bytes>pvt->_hardlimit) {
+		if (pvt->_cs) {
+			pvt->_cs->nmemrejected++;
+		}
+		return false;
+	}
+	count(category,bytes);
+	return true;
+}
+
+void sqlrmemorybudget::release(sqlrmemorycategory_t category, uint64_t bytes) {
+	if (bytes>pvt->_used[category]) {
+		bytes=pvt->_used[category];
+	}
+	pvt->_used[category]-=bytes;
+	pvt->_total-=bytes;
+	pvt->_wasoversoft=(pvt->_softlimit && pvt->_total>pvt->_softlimit);
+	updateStatistics(pvt->_cs,pvt->_used,pvt->_total,pvt->_peak);
+}
+
+uint64_t sqlrmemorybudget::getUsed() {
+	return pvt->_total;
+}
+
+uint64_t sqlrmemorybudget::getUsed(sqlrmemorycategory_t category) {
+	return pvt->_used[category];
+}
+
+uint64_t sqlrmemorybudget::getPeak() {
+	return pvt->_peak;
+}
+
+bool sqlrmemorybudget::shouldShrink(uint64_t *seen) {
+	if (*seen==pvt->_oversoft) {
+		return false;
+	}
+	*seen=pvt->_oversoft;
+	return true;
+}
+
+void sqlrmemorybudget::countShrink() {
+	if (pvt->_cs) {
+		pvt->_cs->nmemshrink++;
+	}
+}
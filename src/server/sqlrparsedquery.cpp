@@ -0,0 +1,830 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/bytestring.h>
+
+// these must be in the same order as sqlrkeyword_t
+static const char	*keywords[]={
+	NULL,
+	"all",
+	"alter",
+	"and",
+	"as",
+	"asc",
+	"begin",
+	"between",
+	"by",
+	"call",
+	"case",
+	"commit",
+	"create",
+	"cross",
+	"delete",
+	"desc",
+	"distinct",
+	"drop",
+	"else",
+	"end",
+	"except",
+	"exec",
+	"execute",
+	"exists",
+	"for",
+	"from",
+	"full",
+	"group",
+	"having",
+	"if",
+	"in",
+	"index",
+	"inner",
+	"insert",
+	"intersect",
+	"into",
+	"is",
+	"join",
+	"left",
+	"like",
+	"limit",
+	"lock",
+	"merge",
+	"natural",
+	"not",
+	"null",
+	"offset",
+	"on",
+	"or",
+	"order",
+	"outer",
+	"replace",
+	"returning",
+	"right",
+	"rollback",
+	"select",
+	"set",
+	"share",
+	"start",
+	"table",
+	"then",
+	"transaction",
+	"truncate",
+	"union",
+	"update",
+	"using",
+	"values",
+	"view",
+	"when",
+	"where",
+	"with",
+	"work"
+};
+#define KEYWORDCOUNT	(sizeof(keywords)/sizeof(const char *))
+#define MAXKEYWORDLENGTH	11
+
+#define INITIALTOKENS	64
+#define INITIALTABLES	4
+#define INITIALBINDS	8
+
+class sqlrparsedqueryprivate {
+	friend class sqlrparsedquery;
+	private:
+		memorypool	_arena;
+
+		bool		_backslashescapes;
+
+		const char	*_query;
+		uint32_t	_querylength;
+		sqlrquerytype_t	_querytype;
+
+		sqlrtoken	*_tokens;
+		uint32_t	_tokencount;
+		uint32_t	_tokenalloc;
+
+		sqlrtoken	*_tables;
+		uint32_t	_tablecount;
+		uint32_t	_tablealloc;
+
+		uint32_t	*_binds;
+		uint32_t	_bindcount;
+		uint32_t	_bindalloc;
+
+	public:
+		sqlrparsedqueryprivate() : _arena(4096,4096,16) {}
+};
+
+static bool isSpace(char c) {
+	return (c==' ' || c=='\t' || c=='\n' || c=='\r' ||
+					c=='\f' || c=='\v');
+}
+
+static bool isDigit(char c) {
+	return (c>='0' && c<='9');
+}
+
+static bool isIdentifierStart(char c) {
+	return ((c>='a' && c<='z') || (c>='A' && c<='Z') ||
+			c=='_' || c=='#' || (unsigned char)c>=0x80);
+}
+
+static bool isIdentifierChar(char c) {
+	return (isIdentifierStart(c) || isDigit(c) || c=='$');
+}
+
+static bool isOperatorChar(char c) {
+	switch (c) {
+		case '+':
+		case '-':
+		case '*':
+		case '/':
+		case '<':
+		case '>':
+		case '=':
+		case '!':
+		case '|':
+		case '&':
+		case '^':
+		case '%':
+		case '~':
+		case ':':
+		case '@':
+			return true;
+	}
+	return false;
+}
+
+static const char *skipQuoted(const char *ptr, const char *end,
+					char quote, bool backslashescapes) {
+
+	// quotes are escaped by doubling them and, optionally, by backslashes
+	while (ptr<end) {
+		if (*ptr==quote) {
+			if (ptr+1<end && ptr[1]==quote) {
+				ptr+=2;
+				continue;
+			}
+			return ptr+1;
+		}
+		if (backslashescapes && *ptr=='\\' && ptr+1<end) {
+			ptr+=2;
+			continue;
+		}
+		ptr++;
+	}
+	return end;
+}
+
+static const char *skipDollarQuoted(const char *ptr, const char *end) {
+
+	// postgresql $tag$...$tag$ strings, returns NULL if ptr isn't
+	// the beginning of one
+	const char	*tagend=ptr+1;
+	while (tagend<end && *tagend!='$') {
+		if (!isIdentifierChar(*tagend)) {
+			return NULL;
+		}
+		tagend++;
+	}
+	if (tagend==end) {
+		return NULL;
+	}
+	size_t	taglength=tagend-ptr+1;
+	for (const char *c=tagend+1; c+taglength<=end; c++) {
+		if (*c=='$' && !bytestring::compare(c,ptr,taglength)) {
+			return c+taglength;
+		}
+	}
+	return end;
+}
+
+sqlrparsedquery::sqlrparsedquery() {
+	pvt=new sqlrparsedqueryprivate;
+	pvt->_backslashescapes=false;
+	pvt->_tokens=NULL;
+	pvt->_tables=NULL;
+	pvt->_binds=NULL;
+	clear();
+}
+
+sqlrparsedquery::~sqlrparsedquery() {
+	delete pvt;
+}
+
+void sqlrparsedquery::setBackslashEscapes(bool backslashescapes) {
+	pvt->_backslashescapes=backslashescapes;
+}
+
+void sqlrparsedquery::clear() {
+
+	// everything lives in the arena, so this is
+	// just a matter of resetting the arena
+	pvt->_arena.clear();
+	pvt->_query=NULL;
+	pvt->_querylength=0;
+	pvt->_querytype=SQLRQUERYTYPE_ETC;
+	pvt->_tokens=NULL;
+	pvt->_tokencount=0;
+	pvt->_tokenalloc=0;
+	pvt->_tables=NULL;
+	pvt->_tablecount=0;
+	pvt->_tablealloc=0;
+	pvt->_binds=NULL;
+	pvt->_bindcount=0;
+	pvt->_bindalloc=0;
+}
+
+bool sqlrparsedquery::parse(const char *query, uint32_t length) {
+
+	clear();
+
+	if (!query) {
+		return false;
+	}
+
+	pvt->_query=query;
+	pvt->_querylength=length;
+
+	const char	*ptr=query;
+	const char	*end=query+length;
+	uint32_t	depth=0;
+
+	while (ptr<end) {
+
+		char	c=*ptr;
+
+		// skip whitespace
+		if (isSpace(c)) {
+			ptr++;
+			continue;
+		}
+
+		// skip comments
+		if (c=='-' && ptr+1<end && ptr[1]=='-') {
+			while (ptr<end && *ptr!='\n') {
+				ptr++;
+			}
+			continue;
+		}
+		if (c=='/' && ptr+1<end && ptr[1]=='*') {
+			ptr+=2;
+			while (ptr+1<end && !(ptr[0]=='*' && ptr[1]=='/')) {
+				ptr++;
+			}
+			ptr=(ptr+1<end)?ptr+2:end;
+			continue;
+		}
+
+		const char	*start=ptr;
+		sqlrtokentype_t	type;
+		sqlrkeyword_t	keyword=SQLRKEYWORD_NONE;
+		uint32_t	tokendepth=depth;
+		const char	*dollarquoted;
+
+		if (c=='\'') {
+
+			type=SQLRTOKENTYPE_STRING;
+			ptr=skipQuoted(ptr+1,end,'\'',pvt->_backslashescapes);
+
+		} else if (c=='"' || c=='`') {
+
+			type=SQLRTOKENTYPE_IDENTIFIER;
+			ptr=skipQuoted(ptr+1,end,c,false);
+
+		} else if (isDigit(c) ||
+				(c=='.' && ptr+1<end && isDigit(ptr[1]))) {
+
+			type=SQLRTOKENTYPE_NUMBER;
+			if (c=='0' && ptr+1<end && (ptr[1]=='x' || ptr[1]=='X')) {
+				ptr+=2;
+				while (ptr<end && (isDigit(*ptr) ||
+					(*ptr>='a' && *ptr<='f') ||
+					(*ptr>='A' && *ptr<='F'))) {
+					ptr++;
+				}
+			} else {
+				while (ptr<end && (isDigit(*ptr) || *ptr=='.')) {
+					ptr++;
+				}
+				if (ptr<end && (*ptr=='e' || *ptr=='E')) {
+					const char	*exp=ptr+1;
+					if (exp<end && (*exp=='+' || *exp=='-')) {
+						exp++;
+					}
+					if (exp<end && isDigit(*exp)) {
+						ptr=exp;
+						while (ptr<end && isDigit(*ptr)) {
+							ptr++;
+						}
+					}
+				}
+			}
+
+		} else if (isIdentifierStart(c)) {
+
+			while (ptr<end && isIdentifierChar(*ptr)) {
+				ptr++;
+			}
+			keyword=getKeyword(start,ptr-start);
+			type=(keyword)?SQLRTOKENTYPE_KEYWORD:
+					SQLRTOKENTYPE_IDENTIFIER;
+
+		} else if (c=='?') {
+
+			type=SQLRTOKENTYPE_BIND;
+			ptr++;
+
+		} else if ((c==':' || c=='@') && ptr+1<end &&
+				isIdentifierChar(ptr[1]) &&
+				(ptr==query || ptr[-1]!=c)) {
+
+			// :name, :1 and @name, but not :: casts or @@variables
+			type=SQLRTOKENTYPE_BIND;
+			ptr++;
+			while (ptr<end && isIdentifierChar(*ptr)) {
+				ptr++;
+			}
+
+		} else if (c=='$' && ptr+1<end && isDigit(ptr[1])) {
+
+			// $1
+			type=SQLRTOKENTYPE_BIND;
+			ptr++;
+			while (ptr<end && isDigit(*ptr)) {
+				ptr++;
+			}
+
+		} else if (c=='$' &&
+				(dollarquoted=skipDollarQuoted(start,end))) {
+
+			type=SQLRTOKENTYPE_STRING;
+			ptr=dollarquoted;
+
+		} else if (c=='(' || c==')' || c==',' || c==';' ||
+				c=='.' || c=='[' || c==']' || c=='{' || c=='}') {
+
+			// parentheses are at the depth of the enclosing tokens
+			type=SQLRTOKENTYPE_PUNCTUATION;
+			if (c=='(') {
+				depth++;
+			} else if (c==')' && depth) {
+				depth--;
+				tokendepth=depth;
+			}
+			ptr=start+1;
+
+		} else if (isOperatorChar(c)) {
+
+			// runs of operator characters, up to a comment or bind
+			type=SQLRTOKENTYPE_OPERATOR;
+			ptr++;
+			while (ptr<end && isOperatorChar(*ptr)) {
+				if (ptr+1<end &&
+					((ptr[0]=='-' && ptr[1]=='-') ||
+					(ptr[0]=='/' && ptr[1]=='*') ||
+					((ptr[0]==':' || ptr[0]=='@') &&
+						isIdentifierChar(ptr[1]) &&
+						ptr[-1]!=ptr[0]))) {
+					break;
+				}
+				ptr++;
+			}
+
+		} else {
+
+			// anything else is passed along as an operator
+			type=SQLRTOKENTYPE_OPERATOR;
+			ptr=start+1;
+		}
+
+		addToken(start,ptr-start,type,keyword,tokendepth);
+		if (type==SQLRTOKENTYPE_BIND) {
+			if (pvt->_bindcount==pvt->_bindalloc) {
+				uint32_t	alloc=(pvt->_bindalloc)?
+						pvt->_bindalloc*2:INITIALBINDS;
+				uint32_t	*binds=(uint32_t *)
+						allocate(alloc*sizeof(uint32_t));
+				bytestring::copy(binds,pvt->_binds,
+						pvt->_bindcount*sizeof(uint32_t));
+				pvt->_binds=binds;
+				pvt->_bindalloc=alloc;
+			}
+			pvt->_binds[pvt->_bindcount++]=pvt->_tokencount-1;
+		}
+	}
+
+	classify();
+	findTables();
+	return true;
+}
+
+void sqlrparsedquery::addToken(const char *text, uint32_t length,
+						sqlrtokentype_t type,
+						sqlrkeyword_t keyword,
+						uint32_t depth) {
+
+	// grow the array by doubling it, the old one is
+	// reclaimed when the arena is cleared
+	if (pvt->_tokencount==pvt->_tokenalloc) {
+		uint32_t	alloc=(pvt->_tokenalloc)?
+					pvt->_tokenalloc*2:INITIALTOKENS;
+		sqlrtoken	*tokens=(sqlrtoken *)
+					allocate(alloc*sizeof(sqlrtoken));
+		bytestring::copy(tokens,pvt->_tokens,
+					pvt->_tokencount*sizeof(sqlrtoken));
+		pvt->_tokens=tokens;
+		pvt->_tokenalloc=alloc;
+	}
+
+	sqlrtoken	*t=&(pvt->_tokens[pvt->_tokencount++]);
+	t->text=text;
+	t->length=length;
+	t->type=type;
+	t->keyword=keyword;
+	t->depth=depth;
+}
+
+void *sqlrparsedquery::allocate(size_t size) {
+
+	// the memory pool doesn't align its allocations
+	unsigned char	*buffer=pvt->_arena.allocate(size+sizeof(uint64_t));
+	return (void *)(((size_t)buffer+sizeof(uint64_t)-1)&
+					~((size_t)sizeof(uint64_t)-1));
+}
+
+bool sqlrparsedquery::isPunctuation(uint32_t index, char c) {
+	return (index<pvt->_tokencount &&
+		pvt->_tokens[index].type==SQLRTOKENTYPE_PUNCTUATION &&
+		pvt->_tokens[index].text[0]==c);
+}
+
+uint32_t sqlrparsedquery::skipParens(uint32_t index) {
+
+	// skips from an opening parenthesis past the matching closing one
+	uint32_t	depth=pvt->_tokens[index].depth;
+	for (index++; index<pvt->_tokencount; index++) {
+		if (isPunctuation(index,')') &&
+				pvt->_tokens[index].depth==depth) {
+			return index+1;
+		}
+	}
+	return index;
+}
+
+void sqlrparsedquery::classify() {
+
+	sqlrtoken	*tokens=pvt->_tokens;
+	uint32_t	count=pvt->_tokencount;
+
+	// skip leading parentheses, eg. (select ...) union (select ...)
+	uint32_t	i=0;
+	while (i<count && isPunctuation(i,'(')) {
+		i++;
+	}
+	if (i==count || tokens[i].type!=SQLRTOKENTYPE_KEYWORD) {
+		return;
+	}
+
+	// for with ... select/insert/update/delete, classify the
+	// statement that follows the common table expressions
+	if (tokens[i].keyword==SQLRKEYWORD_WITH) {
+		uint32_t	depth=tokens[i].depth;
+		for (i++; i<count; i++) {
+			if (tokens[i].depth==depth &&
+				(tokens[i].keyword==SQLRKEYWORD_SELECT ||
+				tokens[i].keyword==SQLRKEYWORD_INSERT ||
+				tokens[i].keyword==SQLRKEYWORD_UPDATE ||
+				tokens[i].keyword==SQLRKEYWORD_DELETE)) {
+				break;
+			}
+		}
+		if (i==count) {
+			return;
+		}
+	}
+
+	uint32_t	depth=tokens[i].depth;
+	switch (tokens[i].keyword) {
+		case SQLRKEYWORD_SELECT:
+			pvt->_querytype=SQLRQUERYTYPE_SELECT;
+			for (uint32_t j=i+1; j<count; j++) {
+				if (tokens[j].depth!=depth) {
+					continue;
+				}
+				if (tokens[j].keyword==SQLRKEYWORD_FROM) {
+					break;
+				}
+				if (tokens[j].keyword==SQLRKEYWORD_INTO) {
+					pvt->_querytype=SQLRQUERYTYPE_SELECTINTO;
+					break;
+				}
+			}
+			break;
+		case SQLRKEYWORD_INSERT:
+		case SQLRKEYWORD_REPLACE:
+			pvt->_querytype=SQLRQUERYTYPE_INSERT;
+			for (uint32_t j=i+1; j<count; j++) {
+				if (tokens[j].keyword==SQLRKEYWORD_SELECT) {
+					pvt->_querytype=
+						SQLRQUERYTYPE_INSERTSELECT;
+					break;
+				}
+				if (tokens[j].keyword==SQLRKEYWORD_VALUES &&
+						tokens[j].depth==depth) {
+					// count the rows
+					uint32_t	rows=0;
+					for (j++; j<count; j++) {
+						if (isPunctuation(j,'(') &&
+							tokens[j].depth==depth) {
+							rows++;
+						}
+					}
+					if (rows>1) {
+						pvt->_querytype=
+						SQLRQUERYTYPE_MULTIINSERT;
+					}
+					break;
+				}
+			}
+			break;
+		case SQLRKEYWORD_UPDATE:
+			pvt->_querytype=SQLRQUERYTYPE_UPDATE;
+			break;
+		case SQLRKEYWORD_DELETE:
+			pvt->_querytype=SQLRQUERYTYPE_DELETE;
+			break;
+		case SQLRKEYWORD_CREATE:
+			pvt->_querytype=SQLRQUERYTYPE_CREATE;
+			break;
+		case SQLRKEYWORD_DROP:
+			pvt->_querytype=SQLRQUERYTYPE_DROP;
+			break;
+		case SQLRKEYWORD_ALTER:
+			pvt->_querytype=SQLRQUERYTYPE_ALTER;
+			break;
+		case SQLRKEYWORD_BEGIN:
+			{
+			// "begin", "begin work" and "begin transaction",
+			// but not the beginning of a pl/sql block
+			uint32_t	j=i+1;
+			if (j<count && (tokens[j].keyword==SQLRKEYWORD_WORK ||
+				tokens[j].keyword==SQLRKEYWORD_TRANSACTION)) {
+				j++;
+			}
+			if (j==count || isPunctuation(j,';')) {
+				pvt->_querytype=SQLRQUERYTYPE_BEGIN;
+			}
+			}
+			break;
+		case SQLRKEYWORD_START:
+			if (i+1<count &&
+				tokens[i+1].keyword==SQLRKEYWORD_TRANSACTION) {
+				pvt->_querytype=SQLRQUERYTYPE_BEGIN;
+			}
+			break;
+		case SQLRKEYWORD_COMMIT:
+			pvt->_querytype=SQLRQUERYTYPE_COMMIT;
+			break;
+		case SQLRKEYWORD_ROLLBACK:
+			pvt->_querytype=SQLRQUERYTYPE_ROLLBACK;
+			break;
+		default:
+			break;
+	}
+}
+
+void sqlrparsedquery::findTables() {
+
+	// Tables are found by looking at what follows the keywords that
+	// introduce them.  The keywords inside of subqueries are visited
+	// too, so their tables are found as well.
+	sqlrtoken	*tokens=pvt->_tokens;
+	uint32_t	count=pvt->_tokencount;
+
+	for (uint32_t i=0; i<count; i++) {
+
+		switch (tokens[i].keyword) {
+
+			case SQLRKEYWORD_FROM:
+				{
+				// but not extract(year from x), trim(y from x)
+				// and similar function arguments
+				if (isFunctionArgument(i)) {
+					break;
+				}
+
+				// from a, b c, (select ...) d, ...
+				uint32_t	j=i+1;
+				while (j<count) {
+					if (isPunctuation(j,'(')) {
+						j=skipParens(j);
+					} else {
+						uint32_t	next=addTable(j);
+						if (next==j) {
+							break;
+						}
+						j=next;
+					}
+					if (j<count && tokens[j].keyword==
+							SQLRKEYWORD_AS) {
+						j++;
+					}
+					if (j<count && tokens[j].type==
+						SQLRTOKENTYPE_IDENTIFIER) {
+						j++;
+					}
+					if (!isPunctuation(j,',')) {
+						break;
+					}
+					j++;
+				}
+				}
+				break;
+
+			case SQLRKEYWORD_JOIN:
+			case SQLRKEYWORD_INTO:
+				addTable(i+1);
+				break;
+
+			case SQLRKEYWORD_UPDATE:
+				// but not "for update" or "on duplicate
+				// key update", which follow other words
+				if (!i || isPunctuation(i-1,'(') ||
+					isPunctuation(i-1,')') ||
+					isPunctuation(i-1,';')) {
+					addTable(i+1);
+				}
+				break;
+
+			case SQLRKEYWORD_TABLE:
+				{
+				// create/drop/alter/truncate/lock
+				// table [if [not] exists] name
+				uint32_t	j=i+1;
+				if (j<count &&
+					tokens[j].keyword==SQLRKEYWORD_IF) {
+					j++;
+					if (j<count && tokens[j].keyword==
+							SQLRKEYWORD_NOT) {
+						j++;
+					}
+					if (j<count && tokens[j].keyword==
+							SQLRKEYWORD_EXISTS) {
+						j++;
+					}
+				}
+				addTable(j);
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+bool sqlrparsedquery::isFunctionArgument(uint32_t index) {
+
+	// find the enclosing opening parenthesis
+	// and see if a function name precedes it
+	uint32_t	depth=pvt->_tokens[index].depth;
+	if (!depth) {
+		return false;
+	}
+	while (index) {
+		index--;
+		if (isPunctuation(index,'(') &&
+				pvt->_tokens[index].depth==depth-1) {
+			return (index && pvt->_tokens[index-1].type==
+						SQLRTOKENTYPE_IDENTIFIER);
+		}
+	}
+	return false;
+}
+
+uint32_t sqlrparsedquery::addTable(uint32_t index) {
+
+	// reads a possibly-qualified name starting at index and returns the
+	// index of the token after it, or index if there isn't a name there
+	sqlrtoken	*tokens=pvt->_tokens;
+	uint32_t	count=pvt->_tokencount;
+	if (index>=count || tokens[index].type!=SQLRTOKENTYPE_IDENTIFIER) {
+		return index;
+	}
+	uint32_t	last=index;
+	while (last+2<count && isPunctuation(last+1,'.') &&
+			tokens[last+2].type==SQLRTOKENTYPE_IDENTIFIER) {
+		last+=2;
+	}
+
+	const char	*text=tokens[index].text;
+	uint32_t	length=tokens[last].text+tokens[last].length-text;
+
+	// don't add the same table twice
+	for (uint32_t i=0; i<pvt->_tablecount; i++) {
+		if (pvt->_tables[i].length==length &&
+			!charstring::compareIgnoringCase(
+					pvt->_tables[i].text,text,length)) {
+			return last+1;
+		}
+	}
+
+	if (pvt->_tablecount==pvt->_tablealloc) {
+		uint32_t	alloc=(pvt->_tablealloc)?
+					pvt->_tablealloc*2:INITIALTABLES;
+		sqlrtoken	*tables=(sqlrtoken *)
+					allocate(alloc*sizeof(sqlrtoken));
+		bytestring::copy(tables,pvt->_tables,
+					pvt->_tablecount*sizeof(sqlrtoken));
+		pvt->_tables=tables;
+		pvt->_tablealloc=alloc;
+	}
+	sqlrtoken	*t=&(pvt->_tables[pvt->_tablecount++]);
+	t->text=text;
+	t->length=length;
+	t->type=SQLRTOKENTYPE_IDENTIFIER;
+	t->keyword=SQLRKEYWORD_NONE;
+	t->depth=tokens[index].depth;
+	return last+1;
+}
+
+const char *sqlrparsedquery::getQuery() {
+	return pvt->_query;
+}
+
+uint32_t sqlrparsedquery::getQueryLength() {
+	return pvt->_querylength;
+}
+
+sqlrquerytype_t sqlrparsedquery::getQueryType() {
+	return pvt->_querytype;
+}
+
+uint32_t sqlrparsedquery::getTokenCount() {
+	return pvt->_tokencount;
+}
+
+const sqlrtoken *sqlrparsedquery::getToken(uint32_t index) {
+	return (index<pvt->_tokencount)?&(pvt->_tokens[index]):NULL;
+}
+
+uint32_t sqlrparsedquery::getTableCount() {
+	return pvt->_tablecount;
+}
+
+const sqlrtoken *sqlrparsedquery::getTable(uint32_t index) {
+	return (index<pvt->_tablecount)?&(pvt->_tables[index]):NULL;
+}
+
+uint32_t sqlrparsedquery::getBindCount() {
+	return pvt->_bindcount;
+}
+
+const sqlrtoken *sqlrparsedquery::getBind(uint32_t index) {
+	return (index<pvt->_bindcount)?
+			&(pvt->_tokens[pvt->_binds[index]]):NULL;
+}
+
+bool sqlrparsedquery::hasKeyword(sqlrkeyword_t keyword) {
+	for (uint32_t i=0; i<pvt->_tokencount; i++) {
+		if (pvt->_tokens[i].keyword==keyword) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *sqlrparsedquery::getKeywordName(sqlrkeyword_t keyword) {
+	return ((uint32_t)keyword<KEYWORDCOUNT)?keywords[keyword]:NULL;
+}
+
+sqlrkeyword_t sqlrparsedquery::getKeyword(const char *word, uint32_t length) {
+
+	if (length<2 || length>MAXKEYWORDLENGTH) {
+		return SQLRKEYWORD_NONE;
+	}
+
+	// lower-case the word
+	char	lower[MAXKEYWORDLENGTH+1];
+	for (uint32_t i=0; i<length; i++) {
+		char	c=word[i];
+		lower[i]=(c>='A' && c<='Z')?c+('a'-'A'):c;
+	}
+	lower[length]='\0';
+
+	// binary search for it, skipping the NULL at index 0
+	uint32_t	low=1;
+	uint32_t	high=KEYWORDCOUNT;
+	while (low<high) {
+		uint32_t	mid=(low+high)/2;
+		int32_t		result=charstring::compare(lower,keywords[mid]);
+		if (!result) {
+			return (sqlrkeyword_t)mid;
+		}
+		if (result<0) {
+			high=mid;
+		} else {
+			low=mid+1;
+		}
+	}
+	return SQLRKEYWORD_NONE;
+}
@@ -51,6 +51,12 @@ void sqlrparser::getMetaData(domnode *node) {
 	// by default, do nothing...
 }
 
+bool sqlrparser::tokenize(const char *query,
+				uint32_t length,
+				sqlrparsedquery *result) {
+	return false;
+}
+
 domnode *sqlrparser::getParameters() {
 	return pvt->_parameters;
 }
@@ -189,6 +189,17 @@ void sqlrprotocol::endTransaction(bool commit) {
 void sqlrprotocol::endSession() {
 }
 
+bool sqlrprotocol::supportsSessionPooling() {
+	return false;
+}
+
+void sqlrprotocol::getSessionState(bytebuffer *state) {
+}
+
+void sqlrprotocol::setSessionState(const unsigned char *state,
+						size_t statelength) {
+}
+
 sqlrprotocols *sqlrprotocol::getProtocols() {
 	return pvt->_ps;
 }
@@ -0,0 +1,160 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/bytestring.h>
+
+class sqlrquerystatsprivate {
+	friend class sqlrquerystats;
+	private:
+		sqlrshm	*_shm;
+};
+
+sqlrquerystats::sqlrquerystats(sqlrshm *shm) {
+	pvt=new sqlrquerystatsprivate;
+	pvt->_shm=shm;
+}
+
+sqlrquerystats::~sqlrquerystats() {
+	delete pvt;
+}
+
+void sqlrquerystats::countQuery(sqlrconnstatistics *cs,
+					sqlrquerytype_t querytype,
+					uint32_t minute) {
+
+	// Only the connection that owns the slot writes to it, so no lock
+	// is necessary.  A reader that catches a bucket while it's being
+	// reused for a new minute might be off by a few queries, which is
+	// fine for statistics.
+	sqlrqpmbucket	*b=&(cs->qpm[minute%STATQPMKEEP]);
+	if (b->minute!=minute) {
+		bytestring::zero(b,sizeof(sqlrqpmbucket));
+		b->minute=minute;
+	}
+
+	switch (querytype) {
+		case SQLRQUERYTYPE_SELECT:
+			b->nselect++;
+			break;
+		case SQLRQUERYTYPE_INSERT:
+			b->ninsert++;
+			break;
+		case SQLRQUERYTYPE_UPDATE:
+			b->nupdate++;
+			break;
+		case SQLRQUERYTYPE_DELETE:
+			b->ndelete++;
+			break;
+		case SQLRQUERYTYPE_CREATE:
+			b->ncreate++;
+			break;
+		case SQLRQUERYTYPE_DROP:
+			b->ndrop++;
+			break;
+		case SQLRQUERYTYPE_ALTER:
+			b->nalter++;
+			break;
+		case SQLRQUERYTYPE_CUSTOM:
+			b->ncustom++;
+			break;
+		case SQLRQUERYTYPE_ETC:
+		default:
+			b->netc++;
+			break;
+	}
+
+	if (querytype==SQLRQUERYTYPE_CUSTOM) {
+		cs->ncustomsql++;
+	} else {
+		cs->nsql++;
+	}
+}
+
+void sqlrquerystats::countError(sqlrconnstatistics *cs) {
+	cs->nerror++;
+}
+
+void sqlrquerystats::retire(sqlrconnstatistics *cs) {
+
+	sqlrshm	*shm=pvt->_shm;
+
+	shm->retired_queries+=cs->nsql+cs->ncustomsql;
+	shm->retired_errors+=cs->nerror;
+
+	for (uint16_t i=0; i<STATQPMKEEP; i++) {
+		const sqlrqpmbucket	*from=&(cs->qpm[i]);
+		if (!from->minute) {
+			continue;
+		}
+		sqlrqpmbucket	*to=&(shm->retired_qpm[
+					from->minute%STATQPMKEEP]);
+		if (to->minute==from->minute) {
+			addBucket(to,from);
+		} else if (to->minute<from->minute) {
+			*to=*from;
+		}
+		// buckets older than the retired
+		// ones have aged out, ignore them
+	}
+
+	bytestring::zero(cs,sizeof(sqlrconnstatistics));
+}
+
+uint64_t sqlrquerystats::getTotalQueries() {
+	uint64_t	total=pvt->_shm->retired_queries;
+	for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+		sqlrconnstatistics	*cs=&(pvt->_shm->connstats[i]);
+		total+=cs->nsql+cs->ncustomsql;
+	}
+	return total;
+}
+
+uint64_t sqlrquerystats::getTotalErrors() {
+	uint64_t	total=pvt->_shm->retired_errors;
+	for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+		total+=pvt->_shm->connstats[i].nerror;
+	}
+	return total;
+}
+
+void sqlrquerystats::getQueriesPerMinute(uint32_t minute,
+						uint16_t minutes,
+						sqlrqpmbucket *counts) {
+
+	// sum the complete minutes preceeding the specified minute
+	bytestring::zero(counts,sizeof(sqlrqpmbucket));
+	if (minutes>=STATQPMKEEP) {
+		minutes=STATQPMKEEP-1;
+	}
+	addRecentBuckets(counts,pvt->_shm->retired_qpm,minute,minutes);
+	for (uint32_t i=0; i<MAXCONNECTIONS; i++) {
+		sqlrconnstatistics	*cs=&(pvt->_shm->connstats[i]);
+		if (cs->processid) {
+			addRecentBuckets(counts,cs->qpm,minute,minutes);
+		}
+	}
+}
+
+void sqlrquerystats::addRecentBuckets(sqlrqpmbucket *to,
+					const sqlrqpmbucket *from,
+					uint32_t minute,
+					uint16_t minutes) {
+	for (uint16_t i=0; i<STATQPMKEEP; i++) {
+		if (from[i].minute<minute && from[i].minute+minutes>=minute) {
+			addBucket(to,&(from[i]));
+		}
+	}
+}
+
+void sqlrquerystats::addBucket(sqlrqpmbucket *to, const sqlrqpmbucket *from) {
+	to->nselect+=from->nselect;
+	to->ninsert+=from->ninsert;
+	to->nupdate+=from->nupdate;
+	to->ndelete+=from->ndelete;
+	to->ncreate+=from->ncreate;
+	to->ndrop+=from->ndrop;
+	to->nalter+=from->nalter;
+	to->ncustom+=from->ncustom;
+	to->netc+=from->netc;
+}
@@ -41,6 +41,9 @@ domnode *sqlrrouter::getParameters() {
 	return pvt->_parameters;
 }
 
+void sqlrrouter::beginTransaction() {
+}
+
 void sqlrrouter::endTransaction(bool commit) {
 }
 
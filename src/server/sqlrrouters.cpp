@@ -190,6 +190,14 @@ bool sqlrrouters::routeEntireSession() {
 	return true;
 }
 
+void sqlrrouters::beginTransaction() {
+	for (listnode< sqlrrouterplugin * > *node=
+						pvt->_llist.getFirst();
+						node; node=node->getNext()) {
+		node->getValue()->r->beginTransaction();
+	}
+}
+
 void sqlrrouters::endTransaction(bool commit) {
 	for (listnode< sqlrrouterplugin * > *node=
 						pvt->_llist.getFirst();
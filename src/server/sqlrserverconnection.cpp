@@ -8,6 +8,7 @@
 #include <defines.h>
 
 #define FETCH_AT_ONCE		10
+#define FETCH_BATCH_BYTES	1048576
 #define MAX_COLUMN_COUNT	256
 #define MAX_FIELD_LENGTH	32768	
 #define MAX_OUT_BIND_LOB_SIZE	2097152
@@ -100,6 +101,16 @@ void sqlrserverconnection::handleConnectString() {
 	}
 	cont->setFetchAtOnce(fetchatonce);
 
+	// adaptive fetch batches
+	cont->setAdaptiveFetch(charstring::isYes(
+			cont->getConnectStringValue("adaptivefetch")));
+	uint64_t	fetchbatchbytes=FETCH_BATCH_BYTES;
+	const char	*fbb=cont->getConnectStringValue("fetchbatchbytes");
+	if (fbb) {
+		fetchbatchbytes=charstring::toUnsignedInteger(fbb);
+	}
+	cont->setFetchBatchBytes(fetchbatchbytes);
+
 	// max column count
 	int32_t		maxcolumncount=MAX_COLUMN_COUNT;
 	const char	*mcc=cont->getConnectStringValue("maxcolumncount");
@@ -160,6 +171,11 @@ void sqlrserverconnection::handleConnectString() {
 	// detach before login
 	pvt->_detachbeforelogin=charstring::isYes(
 			cont->getConnectStringValue("detachbeforelogin"));
+
+	// statement cache size
+	// (only used if the connection module supports statement caching)
+	cont->setStatementCacheSize(charstring::toUnsignedInteger(
+			cont->getConnectStringValue("stmtcachesize")));
 }
 
 bool sqlrserverconnection::changeUser(const char *newuser,
@@ -956,6 +972,14 @@ bool sqlrserverconnection::bindValueIsNull(int16_t isnull) {
 	return (isnull==nullBindValue());
 }
 
+bool sqlrserverconnection::supportsStatementCache() {
+	return false;
+}
+
+void sqlrserverconnection::freeStatement(void *stmt) {
+	// by default, do nothing
+}
+
 const char *sqlrserverconnection::nextvalFormat() {
 	return "%s.nextval";
 }
@@ -30,6 +30,14 @@
 
 #include <defines.h>
 #include <defaults.h>
+
+// for time()
+#include <time.h>
+
+// result set spooling
+#define SPOOL_LOB_SEGMENT_SIZE 32768
+#define MAX_BYTES_PER_CHAR 4
+
 #define NEED_DATATYPESTRING 1
 #define NEED_IS_BIT_TYPE_CHAR 1
 #define NEED_IS_BIT_TYPE_INT 1
@@ -61,6 +69,41 @@
 	}
 #endif
 
+// When the configuration is reloaded, each connection applies a new connect
+// string this many seconds after the connection before it (in connstats
+// order), so they don't all log out of the database at once.
+#define RELOADSTAGGER 2
+
+// module chains that can be rebuilt when the configuration is reloaded,
+// in the order that they're loaded at startup
+enum sqlrreloadchain_t {
+	SQLRRELOAD_PASSWORDENCRYPTIONS=0,
+	SQLRRELOAD_AUTHS,
+	SQLRRELOAD_LOGGERS,
+	SQLRRELOAD_NOTIFICATIONS,
+	SQLRRELOAD_SCHEDULES,
+	SQLRRELOAD_DIRECTIVES,
+	SQLRRELOAD_QUERYTRANSLATIONS,
+	SQLRRELOAD_FILTERS,
+	SQLRRELOAD_BINDVARIABLETRANSLATIONS,
+	SQLRRELOAD_RESULTSETHEADERTRANSLATIONS,
+	SQLRRELOAD_RESULTSETTRANSLATIONS,
+	SQLRRELOAD_RESULTSETROWTRANSLATIONS,
+	SQLRRELOAD_RESULTSETROWBLOCKTRANSLATIONS,
+	SQLRRELOAD_ERRORTRANSLATIONS,
+	SQLRRELOAD_TRIGGERS,
+	SQLRRELOAD_CHAINS
+};
+
+// Modules keep pointers into the configuration that they were loaded from,
+// so each reloaded configuration is kept until none of the module chains
+// were loaded from it any more.
+struct sqlrreloadedconfig {
+	sqlrconfigs	*cfgs;
+	sqlrconfig	*cfg;
+	bool		keep;
+};
+
 class sqlrservercontrollerprivate {
 	friend class sqlrservercontroller;
 
@@ -78,14 +121,25 @@ class sqlrservercontrollerprivate {
 	// statistics
 	sqlrshm			*_shm;
 	sqlrconnstatistics	*_connstats;
+	sqlrfingerprints	*_fps;
 
 	sqlrcmdline	*_cmdl;
 
 	semaphoreset	*_semset;
 	sharedmemory	*_shmem;
 
+	// tracing
+	char		*_traceidfilename;
+	uint32_t	_tracegeneration;
+	sharedmemory	*_traceshmem;
+	sqlrtracering	*_tracering;
+	sqlrtracespan	*_tracespans;
+	uint32_t	_traceringsize;
+	uint64_t	_tracestatestart;
+
 	sqlrprotocols				*_sqlrpr;
 	sqlrparser				*_sqlrp;
+	bool					_sqlrploaded;
 	sqlrdirectives				*_sqlrd;
 	sqlrquerytranslations			*_sqlrt;
 	sqlrfilters				*_sqlrf;
@@ -117,6 +171,13 @@ class sqlrservercontrollerprivate {
 
 	connectstringcontainer	*_constr;
 
+	sqlrconfig			*_chaincfg[SQLRRELOAD_CHAINS];
+	linkedlist<sqlrreloadedconfig *>	_reloadedcfgs;
+	connectstringcontainer		*_pendingconstr;
+	sqlrconfig			*_pendingconstrcfg;
+	time_t				_pendingconstrtime;
+	bool				_recreatecursors;
+
 	char		*_updown;
 
 	uint16_t	_inetport;
@@ -153,8 +214,12 @@ class sqlrservercontrollerprivate {
 	uint64_t		_serversockincount;
 	unixsocketserver	*_serversockun;
 
-	memorypool	_txpool;
-	memorypool	_sessionpool;
+	memorypool	*_txpool;
+	memorypool	*_sessionpool;
+	uint64_t	_txpoolshrinks;
+	uint64_t	_sessionpoolshrinks;
+
+	sqlrmemorybudget	_membudget;
 
 	bool		_debugsql;
 	bool		_debugbulkload;
@@ -182,6 +247,8 @@ class sqlrservercontrollerprivate {
 	sqlrservercursor	**_cur;
 
 	char		*_decrypteddbpassword;
+	char		*_changeduser;
+	char		*_changedpassword;
 
 	unixsocketclient	_handoffsockun;
 	bool			_proxymode;
@@ -213,6 +280,31 @@ class sqlrservercontrollerprivate {
 	uint32_t	_fetchatonce;
 	uint32_t	_maxcolumncount;
 	uint32_t	_maxfieldlength;
+	bool		_adaptivefetch;
+	uint64_t	_fetchbatchbytes;
+
+	bool		_spooling;
+	uint64_t	_spoolrows;
+	uint64_t	_spoolbytes;
+	uint64_t	_spooltimeout;
+
+	uint32_t			_stmtcachesize;
+	dictionary< char *, void * >	_stmtcache;
+	singlylinkedlist< char * >	_stmtcacheorder;
+
+	bool		_sessionpooling;
+	bool		_sessionbegun;
+	bool		_sessionpinned;
+	bool		_resumedsession;
+	bytebuffer	_sessionstate;
+
+	bool		_affinity;
+
+	bool		_sessioncursorsused;
+	bool		_sessionstatechanged;
+	bool		_isolationlevelchanged;
+	bool		_sessionstartqueriesvalid;
+	bool		_sessionqueriesonlyifdirty;
 
 	uint64_t	_connecttimeout;
 	uint64_t	_querytimeout;
@@ -313,6 +405,9 @@ class sqlrservercontrollerprivate {
 static signalhandler		alarmhandler;
 static volatile sig_atomic_t	alarmrang=0;
 
+static signalhandler		reloadhandler;
+static volatile sig_atomic_t	reloadrequested=0;
+
 sqlrservercontroller::sqlrservercontroller() {
 
 	pvt=new sqlrservercontrollerprivate;
@@ -322,11 +417,20 @@ sqlrservercontroller::sqlrservercontroller() {
 	pvt->_cfg=NULL;
 	pvt->_pth=NULL;
 	pvt->_connstats=NULL;
+	pvt->_fps=NULL;
 
 	pvt->_cmdl=NULL;
 	pvt->_semset=NULL;
 	pvt->_shmem=NULL;
 
+	pvt->_traceidfilename=NULL;
+	pvt->_tracegeneration=0;
+	pvt->_traceshmem=NULL;
+	pvt->_tracering=NULL;
+	pvt->_tracespans=NULL;
+	pvt->_traceringsize=0;
+	pvt->_tracestatestart=0;
+
 	pvt->_updown=NULL;
 
 	pvt->_clientsock=NULL;
@@ -377,6 +481,33 @@ sqlrservercontroller::sqlrservercontroller() {
 	pvt->_fetchatonce=1;
 	pvt->_maxcolumncount=0;
 	pvt->_maxfieldlength=0;
+	pvt->_adaptivefetch=false;
+	pvt->_fetchbatchbytes=0;
+
+	pvt->_spooling=false;
+	pvt->_spoolrows=0;
+	pvt->_spoolbytes=0;
+	pvt->_spooltimeout=0;
+
+	pvt->_stmtcachesize=0;
+
+	pvt->_txpool=new memorypool;
+	pvt->_sessionpool=new memorypool;
+	pvt->_txpoolshrinks=0;
+	pvt->_sessionpoolshrinks=0;
+
+	pvt->_sessionpooling=false;
+	pvt->_sessionbegun=false;
+	pvt->_sessionpinned=false;
+	pvt->_resumedsession=false;
+
+	pvt->_affinity=false;
+
+	pvt->_sessioncursorsused=false;
+	pvt->_sessionstatechanged=false;
+	pvt->_isolationlevelchanged=false;
+	pvt->_sessionstartqueriesvalid=false;
+	pvt->_sessionqueriesonlyifdirty=false;
 
 	pvt->_connecttimeout=0;
 	pvt->_querytimeout=0;
@@ -390,6 +521,7 @@ sqlrservercontroller::sqlrservercontroller() {
 
 	pvt->_sqlrpr=NULL;
 	pvt->_sqlrp=NULL;
+	pvt->_sqlrploaded=false;
 	pvt->_sqlrd=NULL;
 	pvt->_sqlrt=NULL;
 	pvt->_sqlrf=NULL;
@@ -408,7 +540,17 @@ sqlrservercontroller::sqlrservercontroller() {
 	pvt->_sqlra=NULL;
 	pvt->_sqlrmd=NULL;
 
+	for (uint16_t i=0; i<SQLRRELOAD_CHAINS; i++) {
+		pvt->_chaincfg[i]=NULL;
+	}
+	pvt->_pendingconstr=NULL;
+	pvt->_pendingconstrcfg=NULL;
+	pvt->_pendingconstrtime=0;
+	pvt->_recreatecursors=false;
+
 	pvt->_decrypteddbpassword=NULL;
+	pvt->_changeduser=NULL;
+	pvt->_changedpassword=NULL;
 
 	pvt->_debugsql=false;
 	pvt->_debugbulkload=false;
@@ -475,8 +617,18 @@ sqlrservercontroller::~sqlrservercontroller() {
 
 	shutDown();
 
+	// merge this connection's fingerprint totals into the shared table
+	flushFingerprints();
+	delete pvt->_fps;
+
+	// fold this connection's query counts into the
+	// instance totals and release its connstats slot
 	if (pvt->_connstats) {
-		bytestring::zero(pvt->_connstats,sizeof(sqlrconnstatistics));
+		pvt->_membudget.setStatistics(NULL);
+		sqlrquerystats	qs(pvt->_shm);
+		pvt->_semset->waitWithUndo(9);
+		qs.retire(pvt->_connstats);
+		pvt->_semset->signalWithUndo(9);
 	}
 
 	delete pvt->_cmdl;
@@ -488,6 +640,9 @@ sqlrservercontroller::~sqlrservercontroller() {
 
 	delete pvt->_pth;
 
+	detachTrace();
+	delete[] pvt->_traceidfilename;
+
 	delete pvt->_shmem;
 
 	delete pvt->_semset;
@@ -516,7 +671,16 @@ sqlrservercontroller::~sqlrservercontroller() {
 	delete pvt->_sqlra;
 	delete pvt->_sqlrmd;
 
+	for (listnode<sqlrreloadedconfig *> *node=
+				pvt->_reloadedcfgs.getFirst();
+				node; node=node->getNext()) {
+		delete node->getValue()->cfgs;
+		delete node->getValue();
+	}
+
 	delete[] pvt->_decrypteddbpassword;
+	delete[] pvt->_changeduser;
+	delete[] pvt->_changedpassword;
 
 	if (pvt->_pidfile) {
 		file::remove(pvt->_pidfile);
@@ -545,6 +709,9 @@ sqlrservercontroller::~sqlrservercontroller() {
 	delete pvt->_schema;
 	delete pvt->_object;
 
+	delete pvt->_txpool;
+	delete pvt->_sessionpool;
+
 	delete pvt;
 }
 
@@ -596,22 +763,36 @@ bool sqlrservercontroller::init(int argc, const char **argv) {
 	pvt->_maxerrorlength=pvt->_cfg->getMaxErrorLength();
 	pvt->_idleclienttimeout=pvt->_cfg->getIdleClientTimeout();
 	pvt->_debugsql=pvt->_cfg->getDebugSql();
+
+	// result set spooling thresholds, the timeout is in milliseconds
+	// but is compared with traceClock(), which is in nanoseconds
+	pvt->_spoolrows=pvt->_cfg->getSpoolRows();
+	pvt->_spoolbytes=pvt->_cfg->getSpoolBytes();
+	pvt->_spooltimeout=((uint64_t)pvt->_cfg->getSpoolTimeout())*1000000;
+	pvt->_spooling=(pvt->_spoolrows ||
+				pvt->_spoolbytes ||
+				pvt->_spooltimeout);
+
+	// memory limits, in bytes
+	pvt->_membudget.setSoftLimit(pvt->_cfg->getMemorySoftLimit());
+	pvt->_membudget.setHardLimit(pvt->_cfg->getMemoryHardLimit());
+
+	// transaction pooling requires that client sockets can be passed
+	// back and forth between the listener and the connections
+	pvt->_sessionpooling=
+		!charstring::compare(pvt->_cfg->getPooling(),"transaction") &&
+		!charstring::compare(pvt->_cfg->getHandoff(),"pass") &&
+		filedescriptor::supportsPassReceiveSocket();
+	pvt->_affinity=!charstring::compare(pvt->_cfg->getAffinity(),"user");
+	pvt->_sessionqueriesonlyifdirty=
+			pvt->_cfg->getSessionQueriesOnlyIfDirty();
 	pvt->_debugbulkload=pvt->_cfg->getDebugBulkLoad();
 
 	// get password encryptions
-	domnode	*pwdencs=pvt->_cfg->getPasswordEncryptions();
-	if (!pwdencs->isNullNode()) {
-		pvt->_sqlrpe=new sqlrpwdencs(
-			pvt->_pth,pvt->_cfg->getDebugPasswordEncryptions());
-		pvt->_sqlrpe->load(pwdencs);
-	}	
+	loadChain(SQLRRELOAD_PASSWORDENCRYPTIONS,pvt->_cfg);
 
 	// initialize auth
-	domnode	*auths=pvt->_cfg->getAuths();
-	if (!auths->isNullNode()) {
-		pvt->_sqlra=new sqlrauths(this);
-		pvt->_sqlra->load(auths,pvt->_sqlrpe);
-	}
+	loadChain(SQLRRELOAD_AUTHS,pvt->_cfg);
 
 	// load database plugin
 	pvt->_conn=initConnection(pvt->_cfg->getDbase());
@@ -620,26 +801,13 @@ bool sqlrservercontroller::init(int argc, const char **argv) {
 	}
 
 	// get loggers
-	domnode	*loggers=pvt->_cfg->getLoggers();
-	if (!loggers->isNullNode()) {
-		pvt->_sqlrlg=new sqlrloggers(pvt->_pth);
-		pvt->_sqlrlg->load(loggers);
-		pvt->_sqlrlg->init(NULL,pvt->_conn);
-	}
+	loadChain(SQLRRELOAD_LOGGERS,pvt->_cfg);
 
 	// get notifications
-	domnode	*notifications=pvt->_cfg->getNotifications();
-	if (!notifications->isNullNode()) {
-		pvt->_sqlrn=new sqlrnotifications(pvt->_pth);
-		pvt->_sqlrn->load(notifications);
-	}
+	loadChain(SQLRRELOAD_NOTIFICATIONS,pvt->_cfg);
 
 	// get schedules
-	domnode	*schedules=pvt->_cfg->getSchedules();
-	if (!schedules->isNullNode()) {
-		pvt->_sqlrs=new sqlrschedules(this);
-		pvt->_sqlrs->load(schedules);
-	}
+	loadChain(SQLRRELOAD_SCHEDULES,pvt->_cfg);
 
 	// handle the pid file
 	if (!handlePidFile()) {
@@ -699,6 +867,11 @@ bool sqlrservercontroller::init(int argc, const char **argv) {
 	}
 	initConnStats();
 
+	// keep per-fingerprint query statistics
+	if (pvt->_cfg->getFingerprintStats()) {
+		pvt->_fps=new sqlrfingerprints(pvt->_shm);
+	}
+
 	// get the module datas
 	pvt->_debugsqlrmoduledata=pvt->_cfg->getDebugModuleDatas();
 	domnode	*moduledatas=pvt->_cfg->getModuleDatas();
@@ -709,102 +882,48 @@ bool sqlrservercontroller::init(int argc, const char **argv) {
 
 	// get the query directives
 	pvt->_debugsqlrdirectives=pvt->_cfg->getDebugDirectives();
-	domnode	*directives=pvt->_cfg->getDirectives();
-	if (!directives->isNullNode()) {
-		pvt->_sqlrd=new sqlrdirectives(this);
-		pvt->_sqlrd->load(directives);
-	}
+	loadChain(SQLRRELOAD_DIRECTIVES,pvt->_cfg);
 
 	// get the query translations
 	pvt->_debugsqlrquerytranslations=pvt->_cfg->getDebugQueryTranslations();
-	domnode	*querytranslations=pvt->_cfg->getQueryTranslations();
-	if (!querytranslations->isNullNode()) {
-		pvt->_sqlrp=newParser();
-		pvt->_sqlrt=new sqlrquerytranslations(this);
-		pvt->_sqlrt->load(querytranslations);
-	}
+	loadChain(SQLRRELOAD_QUERYTRANSLATIONS,pvt->_cfg);
 
 	// get the query filters
 	pvt->_debugsqlrfilters=pvt->_cfg->getDebugFilters();
-	domnode	*filters=pvt->_cfg->getFilters();
-	if (!filters->isNullNode()) {
-		if (!pvt->_sqlrp) {
-			pvt->_sqlrp=newParser();
-		}
-		pvt->_sqlrf=new sqlrfilters(this);
-		pvt->_sqlrf->load(filters);
-	}
+	loadChain(SQLRRELOAD_FILTERS,pvt->_cfg);
 
 	// get the bind variable translations
 	pvt->_debugsqlrbindvariabletranslation=
 				pvt->_cfg->getDebugBindVariableTranslations();
-	domnode	*bindvariabletranslations=
-				pvt->_cfg->getBindVariableTranslations();
-	if (!bindvariabletranslations->isNullNode()) {
-		pvt->_sqlrbvt=new sqlrbindvariabletranslations(this);
-		pvt->_sqlrbvt->load(bindvariabletranslations);
-	}
+	loadChain(SQLRRELOAD_BINDVARIABLETRANSLATIONS,pvt->_cfg);
 
 	// get the result set header translations
 	pvt->_debugsqlrresultsetheadertranslation=
 			pvt->_cfg->getDebugResultSetHeaderTranslations();
-	domnode	*resultsetheadertranslations=
-			pvt->_cfg->getResultSetHeaderTranslations();
-	if (!resultsetheadertranslations->isNullNode()) {
-		pvt->_sqlrrsht=new sqlrresultsetheadertranslations(this);
-		pvt->_sqlrrsht->load(resultsetheadertranslations);
-	}
+	loadChain(SQLRRELOAD_RESULTSETHEADERTRANSLATIONS,pvt->_cfg);
 
 	// get the result set translations
 	pvt->_debugsqlrresultsettranslation=
 				pvt->_cfg->getDebugResultSetTranslations();
-	domnode	*resultsettranslations=
-				pvt->_cfg->getResultSetTranslations();
-	if (!resultsettranslations->isNullNode()) {
-		pvt->_sqlrrst=new sqlrresultsettranslations(this);
-		pvt->_sqlrrst->load(resultsettranslations);
-	}
+	loadChain(SQLRRELOAD_RESULTSETTRANSLATIONS,pvt->_cfg);
 
 	// get the result set row translations
 	pvt->_debugsqlrresultsetrowtranslation=
 				pvt->_cfg->getDebugResultSetRowTranslations();
-	domnode	*resultsetrowtranslations=
-				pvt->_cfg->getResultSetRowTranslations();
-	if (!resultsetrowtranslations->isNullNode()) {
-		pvt->_sqlrrsrt=new sqlrresultsetrowtranslations(this);
-		pvt->_sqlrrsrt->load(resultsetrowtranslations);
-	}
+	loadChain(SQLRRELOAD_RESULTSETROWTRANSLATIONS,pvt->_cfg);
 
 	// get the result set row block translations
 	pvt->_debugsqlrresultsetrowblocktranslation=
 			pvt->_cfg->getDebugResultSetRowBlockTranslations();
-	domnode	*resultsetrowblocktranslations=
-				pvt->_cfg->getResultSetRowBlockTranslations();
-	if (!resultsetrowblocktranslations->isNullNode()) {
-		pvt->_sqlrrsrbt=new sqlrresultsetrowblocktranslations(this);
-		pvt->_sqlrrsrbt->load(resultsetrowblocktranslations);
-	}
+	loadChain(SQLRRELOAD_RESULTSETROWBLOCKTRANSLATIONS,pvt->_cfg);
 
 	// get the error translations
 	pvt->_debugsqlrerrortranslation=
 			pvt->_cfg->getDebugErrorTranslations();
-	domnode	*errortranslations=
-			pvt->_cfg->getErrorTranslations();
-	if (!errortranslations->isNullNode()) {
-		pvt->_sqlret=new sqlrerrortranslations(this);
-		pvt->_sqlret->load(errortranslations);
-	}
+	loadChain(SQLRRELOAD_ERRORTRANSLATIONS,pvt->_cfg);
 
 	// get the triggers
-	domnode	*triggers=pvt->_cfg->getTriggers();
-	if (!triggers->isNullNode()) {
-		// for triggers, we'll need an sqlrparser as well
-		if (!pvt->_sqlrp) {
-			pvt->_sqlrp=newParser();
-		}
-		pvt->_sqlrtr=new sqlrtriggers(this);
-		pvt->_sqlrtr->load(triggers);
-	}
+	loadChain(SQLRRELOAD_TRIGGERS,pvt->_cfg);
 
 	// get fake input bind variable behavior
 	// (this may have already been set true by the connect string)
@@ -880,9 +999,394 @@ bool sqlrservercontroller::init(int argc, const char **argv) {
 	}
 	#endif
 
+	// reload the configuration on SIGHUP
+	#ifdef SIGHUP
+	reloadhandler.setHandler(reloadHandler);
+	reloadhandler.handleSignal(SIGHUP);
+	#endif
+
 	return true;
 }
 
+static domnode *getChainSection(sqlrconfig *cfg, sqlrreloadchain_t chain) {
+	switch (chain) {
+		case SQLRRELOAD_PASSWORDENCRYPTIONS:
+			return cfg->getPasswordEncryptions();
+		case SQLRRELOAD_AUTHS:
+			return cfg->getAuths();
+		case SQLRRELOAD_LOGGERS:
+			return cfg->getLoggers();
+		case SQLRRELOAD_NOTIFICATIONS:
+			return cfg->getNotifications();
+		case SQLRRELOAD_SCHEDULES:
+			return cfg->getSchedules();
+		case SQLRRELOAD_DIRECTIVES:
+			return cfg->getDirectives();
+		case SQLRRELOAD_QUERYTRANSLATIONS:
+			return cfg->getQueryTranslations();
+		case SQLRRELOAD_FILTERS:
+			return cfg->getFilters();
+		case SQLRRELOAD_BINDVARIABLETRANSLATIONS:
+			return cfg->getBindVariableTranslations();
+		case SQLRRELOAD_RESULTSETHEADERTRANSLATIONS:
+			return cfg->getResultSetHeaderTranslations();
+		case SQLRRELOAD_RESULTSETTRANSLATIONS:
+			return cfg->getResultSetTranslations();
+		case SQLRRELOAD_RESULTSETROWTRANSLATIONS:
+			return cfg->getResultSetRowTranslations();
+		case SQLRRELOAD_RESULTSETROWBLOCKTRANSLATIONS:
+			return cfg->getResultSetRowBlockTranslations();
+		case SQLRRELOAD_ERRORTRANSLATIONS:
+			return cfg->getErrorTranslations();
+		case SQLRRELOAD_TRIGGERS:
+			return cfg->getTriggers();
+		default:
+			return NULL;
+	}
+}
+
+void sqlrservercontroller::loadChain(uint16_t chain, sqlrconfig *cfg) {
+
+	domnode	*section=getChainSection(cfg,(sqlrreloadchain_t)chain);
+	bool	load=!section->isNullNode();
+
+	switch (chain) {
+		case SQLRRELOAD_PASSWORDENCRYPTIONS:
+			delete pvt->_sqlrpe;
+			pvt->_sqlrpe=NULL;
+			if (load) {
+				pvt->_sqlrpe=new sqlrpwdencs(pvt->_pth,
+				pvt->_cfg->getDebugPasswordEncryptions());
+				pvt->_sqlrpe->load(section);
+			}
+			break;
+		case SQLRRELOAD_AUTHS:
+			delete pvt->_sqlra;
+			pvt->_sqlra=NULL;
+			if (load) {
+				pvt->_sqlra=new sqlrauths(this);
+				pvt->_sqlra->load(section,pvt->_sqlrpe);
+			}
+			break;
+		case SQLRRELOAD_LOGGERS:
+			delete pvt->_sqlrlg;
+			pvt->_sqlrlg=NULL;
+			if (load) {
+				pvt->_sqlrlg=new sqlrloggers(pvt->_pth);
+				pvt->_sqlrlg->load(section);
+				pvt->_sqlrlg->init(NULL,pvt->_conn);
+			}
+			break;
+		case SQLRRELOAD_NOTIFICATIONS:
+			delete pvt->_sqlrn;
+			pvt->_sqlrn=NULL;
+			if (load) {
+				pvt->_sqlrn=new sqlrnotifications(pvt->_pth);
+				pvt->_sqlrn->load(section);
+			}
+			break;
+		case SQLRRELOAD_SCHEDULES:
+			delete pvt->_sqlrs;
+			pvt->_sqlrs=NULL;
+			if (load) {
+				pvt->_sqlrs=new sqlrschedules(this);
+				pvt->_sqlrs->load(section);
+			}
+			break;
+		case SQLRRELOAD_DIRECTIVES:
+			delete pvt->_sqlrd;
+			pvt->_sqlrd=NULL;
+			if (load) {
+				pvt->_sqlrd=new sqlrdirectives(this);
+				pvt->_sqlrd->load(section);
+			}
+			break;
+		case SQLRRELOAD_QUERYTRANSLATIONS:
+			delete pvt->_sqlrt;
+			pvt->_sqlrt=NULL;
+			if (load) {
+				if (!pvt->_sqlrp) {
+					pvt->_sqlrp=newParser();
+				}
+				pvt->_sqlrt=new sqlrquerytranslations(this);
+				pvt->_sqlrt->load(section);
+			}
+			break;
+		case SQLRRELOAD_FILTERS:
+			delete pvt->_sqlrf;
+			pvt->_sqlrf=NULL;
+			if (load) {
+				if (!pvt->_sqlrp) {
+					pvt->_sqlrp=newParser();
+				}
+				pvt->_sqlrf=new sqlrfilters(this);
+				pvt->_sqlrf->load(section);
+			}
+			break;
+		case SQLRRELOAD_BINDVARIABLETRANSLATIONS:
+			delete pvt->_sqlrbvt;
+			pvt->_sqlrbvt=NULL;
+			if (load) {
+				pvt->_sqlrbvt=
+					new sqlrbindvariabletranslations(this);
+				pvt->_sqlrbvt->load(section);
+			}
+			break;
+		case SQLRRELOAD_RESULTSETHEADERTRANSLATIONS:
+			delete pvt->_sqlrrsht;
+			pvt->_sqlrrsht=NULL;
+			if (load) {
+				pvt->_sqlrrsht=
+				new sqlrresultsetheadertranslations(this);
+				pvt->_sqlrrsht->load(section);
+			}
+			break;
+		case SQLRRELOAD_RESULTSETTRANSLATIONS:
+			delete pvt->_sqlrrst;
+			pvt->_sqlrrst=NULL;
+			if (load) {
+				pvt->_sqlrrst=
+					new sqlrresultsettranslations(this);
+				pvt->_sqlrrst->load(section);
+			}
+			break;
+		case SQLRRELOAD_RESULTSETROWTRANSLATIONS:
+			delete pvt->_sqlrrsrt;
+			pvt->_sqlrrsrt=NULL;
+			if (load) {
+				pvt->_sqlrrsrt=
+					new sqlrresultsetrowtranslations(this);
+				pvt->_sqlrrsrt->load(section);
+			}
+			break;
+		case SQLRRELOAD_RESULTSETROWBLOCKTRANSLATIONS:
+			delete pvt->_sqlrrsrbt;
+			pvt->_sqlrrsrbt=NULL;
+			if (load) {
+				pvt->_sqlrrsrbt=
+				new sqlrresultsetrowblocktranslations(this);
+				pvt->_sqlrrsrbt->load(section);
+			}
+			break;
+		case SQLRRELOAD_ERRORTRANSLATIONS:
+			delete pvt->_sqlret;
+			pvt->_sqlret=NULL;
+			if (load) {
+				pvt->_sqlret=new sqlrerrortranslations(this);
+				pvt->_sqlret->load(section);
+			}
+			break;
+		case SQLRRELOAD_TRIGGERS:
+			delete pvt->_sqlrtr;
+			pvt->_sqlrtr=NULL;
+			if (load) {
+				// for triggers, we'll need an sqlrparser too
+				if (!pvt->_sqlrp) {
+					pvt->_sqlrp=newParser();
+				}
+				pvt->_sqlrtr=new sqlrtriggers(this);
+				pvt->_sqlrtr->load(section);
+			}
+			break;
+		default:
+			return;
+	}
+
+	pvt->_chaincfg[chain]=cfg;
+}
+
+static bool sectionChanged(domnode *oldsection, domnode *newsection) {
+	if (oldsection->isNullNode() || newsection->isNullNode()) {
+		return (oldsection->isNullNode()!=newsection->isNullNode());
+	}
+	stringbuffer	oldxml;
+	stringbuffer	newxml;
+	oldsection->write(&oldxml,false);
+	newsection->write(&newxml,false);
+	return charstring::compare(oldxml.getString(),newxml.getString());
+}
+
+void sqlrservercontroller::reloadConfig() {
+
+	reloadrequested=0;
+
+	raiseDebugMessageEvent("reloading configuration...");
+
+	// parse the configuration again
+	sqlrconfigs	*sqlrcfgs=new sqlrconfigs(pvt->_pth);
+	sqlrconfig	*cfg=sqlrcfgs->load(pvt->_pth->getConfigUrl(),
+						pvt->_cmdl->getId());
+	if (!cfg) {
+		delete sqlrcfgs;
+		raiseInternalErrorEvent(NULL,"configuration reload failed, "
+					"the configuration couldn't be loaded");
+		return;
+	}
+	sqlrreloadedconfig	*rc=new sqlrreloadedconfig;
+	rc->cfgs=sqlrcfgs;
+	rc->cfg=cfg;
+	rc->keep=false;
+	pvt->_reloadedcfgs.append(rc);
+
+	// Rebuild the module chains whose sections changed.  Auth modules
+	// are handed the password encryption modules, so they have to be
+	// rebuilt along with them.
+	bool	pwdencsreloaded=false;
+	for (uint16_t i=0; i<SQLRRELOAD_CHAINS; i++) {
+
+		sqlrreloadchain_t	chain=(sqlrreloadchain_t)i;
+		domnode	*oldsection=getChainSection(pvt->_chaincfg[chain],chain);
+		domnode	*newsection=getChainSection(cfg,chain);
+		if (!sectionChanged(oldsection,newsection) &&
+			!(chain==SQLRRELOAD_AUTHS && pwdencsreloaded &&
+					!newsection->isNullNode())) {
+			continue;
+		}
+
+		pvt->_debugstr.clear();
+		pvt->_debugstr.append("reloading ");
+		pvt->_debugstr.append((newsection->isNullNode())?
+						oldsection->getName():
+						newsection->getName());
+		raiseDebugMessageEvent(pvt->_debugstr.getString());
+
+		loadChain(chain,cfg);
+		if (chain==SQLRRELOAD_PASSWORDENCRYPTIONS) {
+			pwdencsreloaded=true;
+		}
+	}
+
+	// The router connection module builds its routers along with the
+	// connections that it routes to, when it handles its connect string.
+	if (sectionChanged(pvt->_cfg->getRouters(),cfg->getRouters())) {
+		raiseInternalErrorEvent(NULL,"configuration reload: "
+					"routers changed, "
+					"restart the instance to apply them");
+	}
+
+	// Connect string changes are applied later, one connection at a time.
+	connectstringcontainer	*constr=
+			cfg->getConnectString(pvt->_connectionid);
+	if (!constr) {
+		raiseInternalErrorEvent(NULL,"configuration reload: "
+					"connection id no longer configured");
+	} else if (charstring::compare(constr->getString(),
+					pvt->_constr->getString()) ||
+			charstring::compare(constr->getPasswordEncryption(),
+				pvt->_constr->getPasswordEncryption())) {
+		if (!charstring::compare(pvt->_cfg->getDbase(),"router")) {
+			raiseInternalErrorEvent(NULL,"configuration reload: "
+					"connect string changed, "
+					"restart the instance to apply it");
+		} else {
+			pvt->_pendingconstr=constr;
+			pvt->_pendingconstrcfg=cfg;
+			pvt->_pendingconstrtime=time(NULL)+
+				((pvt->_connstats)?
+					pvt->_connstats->index*RELOADSTAGGER:0);
+		}
+	} else {
+		// the connect string was changed back
+		pvt->_pendingconstr=NULL;
+		pvt->_pendingconstrcfg=NULL;
+	}
+
+	retireConfigs();
+
+	raiseDebugMessageEvent("done reloading configuration");
+}
+
+void sqlrservercontroller::reloadConnectString() {
+
+	if (time(NULL)<pvt->_pendingconstrtime) {
+		return;
+	}
+
+	raiseDebugMessageEvent("applying new connect string...");
+
+	// Connection modules may keep pointers into the connect string
+	// that they were handed, so its configuration is kept for good.
+	for (listnode<sqlrreloadedconfig *> *node=
+				pvt->_reloadedcfgs.getFirst();
+				node; node=node->getNext()) {
+		if (node->getValue()->cfg==pvt->_pendingconstrcfg) {
+			node->getValue()->keep=true;
+		}
+	}
+
+	pvt->_constr=pvt->_pendingconstr;
+	pvt->_pendingconstr=NULL;
+	pvt->_pendingconstrcfg=NULL;
+
+	// Cursors size their buffers from connect string values like
+	// maxfieldlength, fetchatonce and maxcolumncount, so they have to
+	// be destroyed and rebuilt, rather than just closed and reopened,
+	// when logging back in with the new connect string.
+	pvt->_recreatecursors=true;
+
+	// log back in with the new connect string
+	pvt->_conn->handleConnectString();
+	reLogIn();
+
+	raiseDebugMessageEvent("done applying new connect string");
+}
+
+bool sqlrservercontroller::reloadIfDue() {
+
+	// Apply a configuration reload, or a new connect string, if one is
+	// due.  This is called while waiting for a client, so that reloads
+	// happen on time, even if no clients are connecting.
+	enum sqlrconnectionstate_t	state=getState();
+	bool	reloaded=false;
+	if (reloadrequested) {
+		reloadConfig();
+		reloaded=true;
+	}
+	if (pvt->_pendingconstr && time(NULL)>=pvt->_pendingconstrtime) {
+		reloadConnectString();
+		reloaded=true;
+	}
+	if (reloaded) {
+		setState(state);
+	}
+	return reloaded;
+}
+
+int32_t sqlrservercontroller::getReloadTimeout() {
+
+	// the number of seconds until the new connect string is due,
+	// or -1 if there isn't one
+	if (!pvt->_pendingconstr) {
+		return -1;
+	}
+	time_t	now=time(NULL);
+	return (pvt->_pendingconstrtime>now)?
+			(int32_t)(pvt->_pendingconstrtime-now):0;
+}
+
+void sqlrservercontroller::retireConfigs() {
+
+	listnode<sqlrreloadedconfig *>	*node=
+					pvt->_reloadedcfgs.getFirst();
+	while (node) {
+
+		listnode<sqlrreloadedconfig *>	*next=node->getNext();
+		sqlrreloadedconfig			*rc=node->getValue();
+
+		bool	inuse=(rc->keep || rc->cfg==pvt->_pendingconstrcfg);
+		for (uint16_t i=0; !inuse && i<SQLRRELOAD_CHAINS; i++) {
+			inuse=(pvt->_chaincfg[i]==rc->cfg);
+		}
+		if (!inuse) {
+			delete rc->cfgs;
+			delete rc;
+			pvt->_reloadedcfgs.remove(node);
+		}
+
+		node=next;
+	}
+}
+
 void sqlrservercontroller::setUserAndGroup() {
 
 	// get the user that we're currently running as
@@ -1138,6 +1642,12 @@ bool sqlrservercontroller::logIn(bool printerrors) {
 		}
 	}
 
+	setCurrentDbUser();
+
+	// this is a new database session, so
+	// session start queries need to be run
+	pvt->_sessionstartqueriesvalid=false;
+
 	raiseDbLogInEvent();
 
 	return true;
@@ -1152,6 +1662,9 @@ void sqlrservercontroller::logOut() {
 
 	raiseDebugMessageEvent("logging out...");
 
+	// cached statements are only valid for this login
+	flushStatementCache();
+
 	// log out
 	pvt->_conn->logOut();
 
@@ -1433,6 +1946,14 @@ bool sqlrservercontroller::listen() {
 			return true;
 		}
 
+		// apply configuration changes between sessions
+		if (reloadrequested) {
+			reloadConfig();
+		}
+		if (pvt->_pendingconstr) {
+			reloadConnectString();
+		}
+
 		waitForAvailableDatabase();
 		initSession();
 		if (!announceAvailability(pvt->_connectionid)) {
@@ -1451,6 +1972,17 @@ bool sqlrservercontroller::listen() {
 
 			if (success==1) {
 
+				// apply configuration changes that were
+				// requested while waiting for the client,
+				// before the client is authenticated (a new
+				// connect string waits until after the session)
+				if (reloadrequested) {
+					enum sqlrconnectionstate_t	state=
+								getState();
+					reloadConfig();
+					setState(state);
+				}
+
 				pvt->_suspendedsession=false;
 
 				// have a session with the client
@@ -1572,7 +2104,8 @@ void sqlrservercontroller::reLogIn() {
 
 	// attempt to log in over and over, once every 5 seconds
 	int32_t	oldcursorcount=pvt->_cursorcount;
-	closeCursors(false);
+	closeCursors(pvt->_recreatecursors);
+	pvt->_recreatecursors=false;
 	logOut();
 	for (;;) {
 
@@ -1645,6 +2178,12 @@ bool sqlrservercontroller::announceAvailability(const char *connectionid) {
 		}
 	}
 
+	// with user affinity, the listener picks from
+	// all of the idle connections rather than just this one
+	if (pvt->_affinity) {
+		return announceIdle(connectionid);
+	}
+
 	// save the original ttl
 	int32_t	originalttl=pvt->_ttl;
 
@@ -1811,8 +2350,9 @@ int32_t sqlrservercontroller::waitForClient() {
 
 	setState(WAIT_CLIENT);
 
-	// reset proxy mode flag
+	// reset proxy mode and resumed session flags
 	pvt->_proxymode=false;
+	pvt->_resumedsession=false;
 
 	if (!pvt->_suspendedsession) {
 
@@ -1885,6 +2425,37 @@ int32_t sqlrservercontroller::waitForClient() {
 				return -1;
 			}
 
+		} else if (command==HANDOFF_RESUME) {
+
+			if (!getProtocol()) {
+				return -1;
+			}
+
+			raiseDebugMessageEvent(
+				"listener is resuming a pooled session");
+
+			// Receive the client file descriptor and use it.
+			if (!pvt->_handoffsockun.receiveSocket(&descriptor)) {
+				raiseInternalErrorEvent(NULL,
+						"failed to receive "
+						"client file descriptor");
+				raiseDebugMessageEvent(
+						"done waiting for client");
+				return -1;
+			}
+
+			// receive the state of the session
+			if (!receiveSessionState()) {
+				filedescriptor	clientsock;
+				clientsock.setFileDescriptor(descriptor);
+				clientsock.close();
+				raiseDebugMessageEvent(
+						"done waiting for client");
+				return -1;
+			}
+
+			pvt->_resumedsession=true;
+
 		} else if (command==HANDOFF_PROXY) {
 
 			if (!getProtocol()) {
@@ -2013,8 +2584,14 @@ void sqlrservercontroller::clientSession() {
 	clientsessionexitstatus_t	exitstatus=
 					CLIENTSESSIONEXITSTATUS_ERROR;
 	if (pvt->_currentprotocol) {
+		if (pvt->_resumedsession) {
+			resumeSession();
+		}
 		exitstatus=pvt->_currentprotocol->clientSession(
 							pvt->_clientsock);
+		if (exitstatus==CLIENTSESSIONEXITSTATUS_RELEASED_SESSION) {
+			releaseSession();
+		}
 	} else {
 		closeClientConnection(0);
 	}
@@ -2032,6 +2609,9 @@ void sqlrservercontroller::clientSession() {
 		case CLIENTSESSIONEXITSTATUS_SUSPENDED_SESSION:
 			info="client suspended the session";
 			break;
+		case CLIENTSESSIONEXITSTATUS_RELEASED_SESSION:
+			info="client session released to the pool";
+			break;
 		case CLIENTSESSIONEXITSTATUS_ERROR:
 		default:
 			// Don't use the word "error" here.
@@ -2067,6 +2647,208 @@ void sqlrservercontroller::clientSession() {
 	raiseDebugMessageEvent("done with client session");
 }
 
+bool sqlrservercontroller::receiveSessionState() {
+
+	// get the size of the session state
+	uint32_t	statelength=0;
+	if (pvt->_handoffsockun.read(&statelength)!=sizeof(uint32_t) ||
+					statelength>MAXSESSIONSTATELENGTH) {
+		raiseInternalErrorEvent(NULL,
+				"failed to receive session state length");
+		return false;
+	}
+
+	// get the session state itself
+	unsigned char	*state=new unsigned char[statelength];
+	bool	success=((uint32_t)pvt->_handoffsockun.read(
+						state,statelength)==statelength);
+	if (success) {
+		pvt->_sessionstate.clear();
+		pvt->_sessionstate.append(state,statelength);
+	} else {
+		raiseInternalErrorEvent(NULL,"failed to receive session state");
+	}
+	delete[] state;
+	return success;
+}
+
+void sqlrservercontroller::resumeSession() {
+
+	raiseDebugMessageEvent("resuming session...");
+
+	// the session state is the current user, followed by
+	// whatever the protocol needs to pick up where it left off
+	const unsigned char	*state=pvt->_sessionstate.getBuffer();
+	size_t			statelength=pvt->_sessionstate.getSize();
+	uint16_t		userlen=0;
+	if (statelength>=sizeof(uint16_t)) {
+		bytestring::copy(&userlen,state,sizeof(uint16_t));
+		state+=sizeof(uint16_t);
+		statelength-=sizeof(uint16_t);
+	}
+	if (userlen>statelength) {
+		userlen=statelength;
+	}
+	setCurrentUser((const char *)state,userlen);
+	state+=userlen;
+	statelength-=userlen;
+
+	// pooled sessions are only released from connections that are
+	// logged in to the database as the configured user, so if this
+	// connection was left logged in as some other user, switch back
+	const char	*user=getConnectStringValue("user");
+	if (charstring::compare(pvt->_user,user)) {
+		changeUser(user,getConnectStringValue("password"));
+	}
+
+	pvt->_currentprotocol->setSessionState(state,statelength);
+
+	beginSession();
+
+	incrementResumeSessionCount();
+
+	raiseDebugMessageEvent("done resuming session");
+}
+
+void sqlrservercontroller::releaseSession() {
+
+	raiseDebugMessageEvent("releasing session...");
+
+	// build the session state
+	const char	*user=getCurrentUser();
+	uint16_t	userlen=charstring::length(user);
+	pvt->_sessionstate.clear();
+	pvt->_sessionstate.append(userlen);
+	pvt->_sessionstate.append((const unsigned char *)user,userlen);
+	pvt->_currentprotocol->getSessionState(&pvt->_sessionstate);
+	uint32_t	statelength=pvt->_sessionstate.getSize();
+
+	// construct the name of the socket to connect to
+	char	*releasesockname=NULL;
+	charstring::printf(&releasesockname,
+				"%s%s-release.sock",
+				pvt->_pth->getSocketsDir(),
+				pvt->_cmdl->getId());
+
+	// hand the client back to the listener, along with the
+	// session state, so it can be resumed by any connection
+	unixsocketclient	releasesockun;
+	bool	released=false;
+	if (releasesockun.connect(releasesockname,-1,-1,0,1)==
+							RESULT_SUCCESS &&
+		releasesockun.write(pvt->_protocolindex)==
+							sizeof(uint16_t) &&
+		releasesockun.write(statelength)==sizeof(uint32_t) &&
+		(uint32_t)releasesockun.write(
+				pvt->_sessionstate.getBuffer(),
+				statelength)==statelength) {
+		releasesockun.flushWriteBuffer(-1,-1);
+		released=releasesockun.passSocket(
+				pvt->_clientsock->getFileDescriptor());
+	}
+	releasesockun.close();
+	delete[] releasesockname;
+
+	if (!released) {
+		raiseInternalErrorEvent(NULL,
+				"failed to release session to the listener");
+	}
+
+	// close our copy of the client socket
+	pvt->_clientsock->close();
+	delete pvt->_clientsock;
+	pvt->_clientsock=NULL;
+
+	endSession();
+
+	if (released) {
+		incrementReleaseSessionCount();
+	}
+
+	raiseDebugMessageEvent("done releasing session");
+}
+
+bool sqlrservercontroller::getSessionPooling() {
+	return pvt->_sessionpooling;
+}
+
+bool sqlrservercontroller::sessionCanBeReleased() {
+
+	if (!pvt->_sessionpooling || !pvt->_sessionbegun ||
+		pvt->_sessionpinned || !pvt->_currentprotocol ||
+		!pvt->_currentprotocol->supportsSessionPooling()) {
+		return false;
+	}
+
+	// a session that's logged in to the database as some user
+	// other than the configured user has to stay where it is
+	if (charstring::compare(pvt->_user,getConnectStringValue("user"))) {
+		pinSession("logged in as a different user");
+		return false;
+	}
+
+	// a session that changed the autocommit mode
+	// can't be resumed by a different connection
+	if (pvt->_autocommitforthissession!=pvt->_initialautocommit) {
+		pinSession("autocommit mode changed");
+		return false;
+	}
+
+	// the session can't be released mid-transaction
+	if (pvt->_needscommitorrollback || pvt->_infaketransactionblock) {
+		return false;
+	}
+
+	// ...or while any result sets or prepared statements are open
+	for (uint16_t i=0; i<pvt->_cursorcount; i++) {
+		if (pvt->_cur[i] &&
+			pvt->_cur[i]->getState()!=SQLRCURSORSTATE_AVAILABLE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void sqlrservercontroller::pinSession(const char *reason) {
+	if (!pvt->_sessionpooling || !pvt->_sessionbegun ||
+					pvt->_sessionpinned) {
+		return;
+	}
+	pvt->_sessionpinned=true;
+	incrementPinSessionCount();
+	pvt->_debugstr.clear();
+	pvt->_debugstr.append("session pinned: ")->append(reason);
+	raiseDebugMessageEvent(pvt->_debugstr.getString());
+}
+
+bool sqlrservercontroller::getSessionPinned() {
+	return pvt->_sessionpinned;
+}
+
+bool sqlrservercontroller::isSessionStateQuery(const char *query) {
+	static const char	*prefixes[]={
+		"set ",
+		"use ",
+		"alter session ",
+		"prepare ",
+		"listen ",
+		"create temporary ",
+		"create temp ",
+		"create global temporary ",
+		"create local temporary ",
+		"declare global temporary ",
+		NULL
+	};
+	query=skipWhitespaceAndComments(query);
+	for (const char **p=prefixes; *p; p++) {
+		if (!charstring::compareIgnoringCase(query,*p,
+						charstring::length(*p))) {
+			return true;
+		}
+	}
+	return false;
+}
+
 sqlrservercursor *sqlrservercontroller::getCursor(uint16_t id) {
 
 	// get the specified cursor
@@ -2226,21 +3008,52 @@ bool sqlrservercontroller::auth(sqlrcredentials *cred) {
 bool sqlrservercontroller::changeUser(const char *newuser,
 					const char *newpassword) {
 	raiseDebugMessageEvent("change user");
+	pinSession("change user");
 	closeCursors(false);
 	logOut();
-	setUser(newuser);
-	setPassword(newpassword);
+
+	// keep copies of the user/password, the buffers they're passed in
+	// may be reused long before we're done with them
+	char	*user=charstring::duplicate(newuser);
+	char	*password=charstring::duplicate(newpassword);
+	delete[] pvt->_changeduser;
+	delete[] pvt->_changedpassword;
+	pvt->_changeduser=user;
+	pvt->_changedpassword=password;
+	setUser(pvt->_changeduser);
+	setPassword(pvt->_changedpassword);
+
 	return (logIn(false) && initCursors(pvt->_cursorcount));
 }
 
 bool sqlrservercontroller::changeProxiedUser(const char *newuser,
 						const char *newpassword) {
 	raiseDebugMessageEvent("change proxied user");
+	pinSession("change proxied user");
 	return pvt->_conn->changeProxiedUser(newuser,newpassword);
 }
 
 void sqlrservercontroller::beginSession() {
-	sessionStartQueries();
+
+	// If the previous session left nothing for the session end queries
+	// to clean up, then they weren't run, and whatever the session start
+	// queries set up for it is still in place.
+	if (pvt->_sessionqueriesonlyifdirty &&
+			pvt->_sessionstartqueriesvalid &&
+			pvt->_cfg->getSessionStartQueries()->getLength()) {
+		raiseDebugMessageEvent("skipping session start queries");
+		incrementSkippedSessionQueriesCount();
+	} else {
+		sessionStartQueries();
+		pvt->_sessionstartqueriesvalid=true;
+	}
+
+	// start tracking what this session changes (after the session start
+	// queries, so that they don't count as changes made by the session)
+	pvt->_sessionbegun=true;
+	pvt->_sessioncursorsused=false;
+	pvt->_sessionstatechanged=false;
+	pvt->_isolationlevelchanged=false;
 }
 
 void sqlrservercontroller::suspendSession(const char **unixsocket,
@@ -2491,8 +3304,8 @@ void sqlrservercontroller::endTransaction(bool commit) {
 	pvt->_autoinccolcache.clear();
 	pvt->_primarykeycolcache.clear();
 
-	// clear per-session pool
-	pvt->_txpool.clear();
+	// clear per-transaction pool
+	clearPool(&pvt->_txpool,&pvt->_txpoolshrinks);
 
 	// set in-tx flag
 	pvt->_intransaction=!pvt->_autocommitforthissession;
@@ -2516,13 +3329,24 @@ bool sqlrservercontroller::rollback() {
 	return false;
 }
 
-bool sqlrservercontroller::selectDatabase(const char *db) {
-	return (pvt->_cfg->getIgnoreSelectDatabase())?
-			true:pvt->_conn->selectDatabase(db);
+bool sqlrservercontroller::selectDatabase(const char *db) {
+	if (pvt->_cfg->getIgnoreSelectDatabase()) {
+		return true;
+	}
+
+	// cached statements may refer to objects in the current db
+	flushStatementCache();
+
+	// the session now depends on this connection's current db
+	pinSession("select database");
+
+	return pvt->_conn->selectDatabase(db);
 }
 
 void sqlrservercontroller::dbHasChanged() {
 	pvt->_dbchanged=true;
+	flushStatementCache();
+	pinSession("database changed");
 }
 
 char *sqlrservercontroller::getCurrentDatabase() {
@@ -2538,6 +3362,7 @@ bool sqlrservercontroller::getLastInsertId(uint64_t *id) {
 }
 
 bool sqlrservercontroller::setIsolationLevel(const char *isolevel) {
+	pvt->_isolationlevelchanged=true;
 	return pvt->_conn->setIsolationLevel(isolevel);
 }
 
@@ -2559,6 +3384,8 @@ bool sqlrservercontroller::fakePrepareAndExecuteForApiCall(
 		return false;
 	}
 	cursor->clearTotalRowsFetched();
+	clearSpool(cursor);
+	cursor->resetFetchBatch();
 	return true;
 }
 
@@ -3288,13 +4115,26 @@ bool sqlrservercontroller::blockCanBeIntercepted(const char *block) {
 
 bool sqlrservercontroller::isCommitQuery(const char *query) {
 
-	return (!charstring::compareIgnoringCase(query,"commit",6) ||
-		(!charstring::compareIgnoringCase(query,"et",2) &&
-						*(query+2)=='\0'));
+	// "commit prepared 'xid'" finishes a two-phase commit
+	// and must be passed through to the database
+	if (!charstring::compareIgnoringCase(query,"commit",6)) {
+		return (charstring::compareIgnoringCase(
+				skipWhitespaceAndComments(query+6),
+				"prepared",8)!=0);
+	}
+	return (!charstring::compareIgnoringCase(query,"et",2) &&
+						*(query+2)=='\0');
 }
 
 bool sqlrservercontroller::isRollbackQuery(const char *query) {
-	return !charstring::compareIgnoringCase(query,"rollback",8);
+
+	// likewise for "rollback prepared 'xid'"
+	if (!charstring::compareIgnoringCase(query,"rollback",8)) {
+		return (charstring::compareIgnoringCase(
+				skipWhitespaceAndComments(query+8),
+				"prepared",8)!=0);
+	}
+	return false;
 }
 
 bool sqlrservercontroller::skipComment(const char **ptr,
@@ -4931,6 +5771,8 @@ bool sqlrservercontroller::prepareQuery(sqlrservercursor *cursor,
 						bool enabletranslations,
 						bool enablefilters) {
 
+	pvt->_sessioncursorsused=true;
+
 	if (pvt->_debugsql) {
 		stdoutput.printf("\n===================="
 				 "===================="
@@ -4975,12 +5817,19 @@ bool sqlrservercontroller::prepareQuery(sqlrservercursor *cursor,
 	// clean up the previous result set
 	closeResultSet(cursor);
 
+	// return the statement that the cursor was holding to the cache
+	releaseCachedStatement(cursor);
+
+	// give back memory that the previous query's tokens grew to
+	cursor->shrinkParsedQuery();
+
 	// re-init error data
 	clearError(cursor);
 
 	// reset flags
 	cursor->setColumnInfoIsValid(false);
 	cursor->setQueryHasBeenPreProcessed(false);
+	cursor->setQueryHasBeenParsed(false);
 	cursor->setQueryHasBeenPrepared(false);
 	cursor->setQueryHasBeenExecuted(false);
 	cursor->setQueryNeedsIntercept(false);
@@ -5118,7 +5967,12 @@ bool sqlrservercontroller::prepareQuery(sqlrservercursor *cursor,
 	cursor->setQueryStart(dt.getSeconds(),dt.getMicroseconds());
 
 	// prepare the query
-	bool	success=cursor->prepareQuery(query,querylen);
+	uint64_t	tracestart=(tracing())?traceClock():0;
+	bool	success=prepareQueryUsingStatementCache(cursor,query,querylen);
+	if (tracestart) {
+		trace(SQLRTRACEPHASE_PREPARE,cursor->queryType(query,querylen),
+				cursor->getId(),tracestart,traceClock());
+	}
 
 	// log result
 	raiseDebugMessageEvent((success)?"prepare query succeeded":
@@ -5331,6 +6185,26 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 							getStringLength();
 	}
 
+	// make sure that running the query won't take the
+	// connection over its hard memory limit
+	if (!reserveQueryMemory(cursor)) {
+
+		// set the query end time
+		dt.getSystemDateAndTime();
+		cursor->setQueryEnd(dt.getSeconds(),dt.getMicroseconds());
+
+		// update query and error counts
+		incrementQueryCounts(cursor->queryType(query,querylen));
+		incrementTotalErrors();
+
+		raiseDebugMessageEvent("memory limit exceeded");
+
+		// log the query (attempt)
+		raiseQueryEvent(cursor);
+
+		return false;
+	}
+
 	// if the query still hasn't been prepared (probably
 	// because we're faking binds), then prepare it now
 	if (!cursor->getQueryHasBeenPrepared()) {
@@ -5342,7 +6216,13 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 		cursor->setQueryStart(dt.getSeconds(),dt.getMicroseconds());
 
 		// prepare the query
+		uint64_t	tracestart=(tracing())?traceClock():0;
 		success=cursor->prepareQuery(query,querylen);
+		if (tracestart) {
+			trace(SQLRTRACEPHASE_PREPARE,
+					cursor->queryType(query,querylen),
+					cursor->getId(),tracestart,traceClock());
+		}
 
 		// log result
 		raiseDebugMessageEvent((success)?"prepare query succeeded":
@@ -5393,7 +6273,14 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 		dt.getSystemDateAndTime();
 		cursor->setQueryStart(dt.getSeconds(),dt.getMicroseconds());
 
-		if (!handleBinds(cursor)) {
+		uint64_t	tracestart=(tracing())?traceClock():0;
+		bool		bindsuccess=handleBinds(cursor);
+		if (tracestart) {
+			trace(SQLRTRACEPHASE_BIND,
+					cursor->queryType(query,querylen),
+					cursor->getId(),tracestart,traceClock());
+		}
+		if (!bindsuccess) {
 
 			// set the query end time
 			dt.getSystemDateAndTime();
@@ -5443,8 +6330,20 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 		stdoutput.write('\n');
 	}
 
+	// keep track of what the session has done, so
+	// endSession() can skip resetting what it didn't
+	pvt->_sessioncursorsused=true;
+	if (!pvt->_sessionstatechanged && isSessionStateQuery(query)) {
+		pvt->_sessionstatechanged=true;
+	}
+
 	// execute the query
+	uint64_t	tracestart=(tracing())?traceClock():0;
 	success=cursor->executeQuery(query,querylen);
+	if (tracestart) {
+		trace(SQLRTRACEPHASE_EXECUTE,cursor->queryType(query,querylen),
+				cursor->getId(),tracestart,traceClock());
+	}
 
 	// set flag indicating that the query has been executed
 	// NOTE: We want to do this whether the query succeeds or fails so that
@@ -5492,12 +6391,15 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 
 	// reset total rows fetched
 	cursor->clearTotalRowsFetched();
+	clearSpool(cursor);
+	cursor->resetFetchBatch();
 
 	// update query and error counts
 	incrementQueryCounts(cursor->queryType(query,querylen));
 	if (!success) {
 		incrementTotalErrors();
 	}
+	countFingerprint(cursor,success);
 
 	// handle after-triggers
 	if (enabletriggers && pvt->_sqlrtr) {
@@ -5507,6 +6409,11 @@ bool sqlrservercontroller::executeQuery(sqlrservercursor *cursor,
 	// was the query a commit or rollback?
 	commitOrRollback(cursor);
 
+	// did the query change the state of the session?
+	if (pvt->_sessionstatechanged) {
+		pinSession("session state query");
+	}
+
 	// commit if necessary
 	if (success && pvt->_conn->isTransactional() &&
 			!pvt->_conn->supportsTransactionBlocks() &&
@@ -6598,13 +7505,34 @@ void sqlrservercontroller::endSession() {
 
 	setState(SESSION_END);
 
-	raiseDebugMessageEvent("aborting all cursors...");
-	for (int32_t i=0; i<pvt->_cursorcount; i++) {
-		if (pvt->_cur[i]) {
-			pvt->_cur[i]->abort();
+	pvt->_sessionbegun=false;
+	pvt->_sessionpinned=false;
+
+	// decide whether the session end queries need to be run before
+	// the steps below clean up the things that would make them necessary
+	bool	runsessionendqueries=
+			(!pvt->_sessionqueriesonlyifdirty || sessionIsDirty());
+
+	// cursors that the session never prepared or executed on
+	// don't have anything to abort
+	if (pvt->_sessioncursorsused) {
+		raiseDebugMessageEvent("aborting all cursors...");
+		for (int32_t i=0; i<pvt->_cursorcount; i++) {
+			if (pvt->_cur[i]) {
+				finishFingerprint(pvt->_cur[i]);
+				pvt->_cur[i]->abort();
+				releaseCachedStatement(pvt->_cur[i]);
+			}
 		}
+		raiseDebugMessageEvent("done aborting all cursors");
+
+		// publish the session's fingerprint totals
+		// rather than waiting for the next query
+		flushFingerprints();
+	} else {
+		raiseDebugMessageEvent("no cursors used, skipping abort");
+		incrementSkippedSessionResetCount();
 	}
-	raiseDebugMessageEvent("done aborting all cursors");
 
 	// must set suspendedsession to false here so resumed sessions won't 
 	// automatically re-suspend
@@ -6644,7 +7572,12 @@ void sqlrservercontroller::endSession() {
 		// Worst case, if we weren't in a fake transaction block (and
 		// were in autocommit mode) and the db cares, then it will
 		// throw an error, which will be ignored.
-		pvt->_faketransactionblocks ||
+		//
+		// If the session never ran a query though, then there can't
+		// be anything to commit or roll back.
+		(pvt->_faketransactionblocks &&
+			(pvt->_infaketransactionblock ||
+				pvt->_sessioncursorsused)) ||
 
 		(pvt->_conn->isTransactional() &&
 			pvt->_needscommitorrollback)) {
@@ -6668,25 +7601,50 @@ void sqlrservercontroller::endSession() {
 	// with oracle, it may be necessary to log out and log back in to
 	// drop a temp table.  With each log-out the session end queries
 	// are run and with each log-in the session start queries are run.)
-	truncateTempTables(pvt->_cur[0]);
+	if (pvt->_sessioncursorsused) {
+		truncateTempTables(pvt->_cur[0]);
+	}
 	dropTempTables(pvt->_cur[0]);
 
-	// run session-end queries
-	sessionEndQueries();
+	// run session-end queries, unless they're only supposed to be run
+	// after sessions that changed something, and this one didn't
+	if (!runsessionendqueries) {
+		if (pvt->_cfg->getSessionEndQueries()->getLength()) {
+			raiseDebugMessageEvent("session is clean, "
+						"skipping session end queries");
+			incrementSkippedSessionQueriesCount();
+		}
+	} else {
+		sessionEndQueries();
+		pvt->_sessionstartqueriesvalid=false;
+	}
 
 	// reset database/schema
 	if (pvt->_dbchanged) {
+		flushStatementCache();
 		// FIXME: we're ignoring the result and error,
 		// should we do something if there's an error?
 		pvt->_conn->selectDatabase(pvt->_originaldb);
 		pvt->_dbchanged=false;
 	}
 
-	// reset initial autocommit behavior
-	setAutoCommit(pvt->_initialautocommit);
+	// reset initial autocommit behavior, if the session changed it, or
+	// if it may have been changed by a query that the session ran, or
+	// if resetting it would start a new transaction
+	if (pvt->_autocommitforthissession!=pvt->_initialautocommit ||
+		pvt->_sessionstatechanged ||
+		(!pvt->_initialautocommit && !pvt->_intransaction)) {
+		setAutoCommit(pvt->_initialautocommit);
+	} else {
+		incrementSkippedSessionResetCount();
+	}
 
-	// set isolation level
-	pvt->_conn->setIsolationLevel(pvt->_isolationlevel);
+	// reset isolation level, if it may have been changed
+	if (pvt->_isolationlevelchanged || pvt->_sessionstatechanged) {
+		pvt->_conn->setIsolationLevel(pvt->_isolationlevel);
+	} else {
+		incrementSkippedSessionResetCount();
+	}
 
 	// NOTE: For debugging, it's nice to know what the most recent
 	// clientinfo was, so lets not reset this.  Hopefully not resetting it
@@ -6785,7 +7743,7 @@ void sqlrservercontroller::endSession() {
 	}
 
 	// clear per-session pool
-	pvt->_sessionpool.clear();
+	clearPool(&pvt->_sessionpool,&pvt->_sessionpoolshrinks);
 
 	// shrink the cursor array, if necessary
 	// FIXME: it would probably be more efficient to scale
@@ -7069,7 +8027,10 @@ void sqlrservercontroller::closeCursors(bool destroy) {
 			pvt->_cursorcount--;
 
 			if (pvt->_cur[pvt->_cursorcount]) {
+				finishFingerprint(pvt->_cur[pvt->_cursorcount]);
 				pvt->_cur[pvt->_cursorcount]->closeResultSet();
+				pvt->_cur[pvt->_cursorcount]->
+						setStatementCacheKey(NULL);
 				close(pvt->_cur[pvt->_cursorcount]);
 				if (destroy) {
 					deleteCursor(
@@ -7087,6 +8048,119 @@ void sqlrservercontroller::closeCursors(bool destroy) {
 	raiseDebugMessageEvent("done closing cursors...");
 }
 
+bool sqlrservercontroller::prepareQueryUsingStatementCache(
+						sqlrservercursor *cursor,
+						const char *query,
+						uint32_t querylen) {
+
+	// bail if statement caching is disabled or unsupported
+	if (!pvt->_stmtcachesize || !pvt->_conn->supportsStatementCache()) {
+		return cursor->prepareQuery(query,querylen);
+	}
+
+	// cached statements are keyed by the final, translated query
+	char	*key=charstring::duplicate(query,querylen);
+
+	// if another cursor already prepared this query and returned the
+	// statement to the cache, then borrow it rather than re-preparing
+	void	*stmt=NULL;
+	if (pvt->_stmtcache.getValue(key,&stmt)) {
+
+		char	*cachedkey=NULL;
+		for (listnode< char * > *node=
+					pvt->_stmtcacheorder.getFirst();
+					node; node=node->getNext()) {
+			if (!charstring::compare(node->getValue(),key)) {
+				cachedkey=node->getValue();
+				break;
+			}
+		}
+		pvt->_stmtcacheorder.remove(cachedkey);
+		pvt->_stmtcache.remove(cachedkey);
+		delete[] cachedkey;
+
+		if (cursor->attachStatement(stmt)) {
+			incrementStatementCacheHitCount();
+			cursor->setStatementCacheKey(key);
+			delete[] key;
+			return true;
+		}
+		pvt->_conn->freeStatement(stmt);
+	}
+
+	// prepare it the usual way
+	incrementStatementCacheMissCount();
+	bool	success=cursor->prepareQuery(query,querylen);
+	cursor->setStatementCacheKey((success)?key:NULL);
+	delete[] key;
+	return success;
+}
+
+void sqlrservercontroller::releaseCachedStatement(sqlrservercursor *cursor) {
+
+	// bail if the cursor isn't holding a statement
+	// that was prepared using the cache
+	const char	*key=cursor->getStatementCacheKey();
+	if (!key) {
+		return;
+	}
+
+	void	*stmt=cursor->detachStatement();
+	if (stmt) {
+		if (pvt->_stmtcache.getValue((char *)key)) {
+
+			// the cache already has a statement for this query
+			pvt->_conn->freeStatement(stmt);
+
+		} else {
+
+			// make room, if necessary
+			if (pvt->_stmtcache.getLength()>=
+					pvt->_stmtcachesize) {
+				evictCachedStatement();
+			}
+
+			char	*cachedkey=charstring::duplicate(key);
+			pvt->_stmtcache.setValue(cachedkey,stmt);
+			pvt->_stmtcacheorder.append(cachedkey);
+		}
+	}
+
+	cursor->setStatementCacheKey(NULL);
+}
+
+void sqlrservercontroller::evictCachedStatement() {
+
+	// evict the statement that was returned to the cache longest ago
+	listnode< char * >	*first=pvt->_stmtcacheorder.getFirst();
+	if (!first) {
+		return;
+	}
+	char	*key=first->getValue();
+	pvt->_conn->freeStatement(pvt->_stmtcache.getValue(key));
+	pvt->_stmtcacheorder.remove(key);
+	pvt->_stmtcache.remove(key);
+	delete[] key;
+}
+
+void sqlrservercontroller::flushStatementCache() {
+
+	// free the cached statements
+	while (pvt->_stmtcacheorder.getLength()) {
+		evictCachedStatement();
+	}
+
+	// make sure that the statements that cursors are
+	// currently holding don't get returned to the cache
+	if (pvt->_cur) {
+		for (uint16_t i=0; i<pvt->_cursorcount; i++) {
+			if (pvt->_cur[i]) {
+				pvt->_cur[i]->setStatementCacheKey(NULL);
+			}
+		}
+	}
+}
+
 void sqlrservercontroller::deleteCursor(sqlrservercursor *curs) {
 	pvt->_conn->deleteCursor(curs);
 	decrementOpenDatabaseCursors();
@@ -7097,6 +8171,12 @@ bool sqlrservercontroller::createSharedMemoryAndSemaphores(const char *id) {
 	char	*idfilename=NULL;
 	charstring::printf(&idfilename,"%s%s.ipc",pvt->_pth->getIpcDir(),id);
 
+	// sqlr-trace creates the trace buffer, if it's
+	// running, keyed off of this file
+	delete[] pvt->_traceidfilename;
+	charstring::printf(&pvt->_traceidfilename,"%s%s-trace.ipc",
+						pvt->_pth->getIpcDir(),id);
+
 	pvt->_debugstr.clear();
 	pvt->_debugstr.append("attaching to shared memory and semaphores ");
 	pvt->_debugstr.append("id filename: ")->append(idfilename);
@@ -7194,24 +8274,7 @@ bool sqlrservercontroller::acquireAnnounceMutex() {
 	setState(WAIT_SEMAPHORE);
 
 	// Wait.  Bail if ttl is exceeded
-	bool	result=false;
-	if (pvt->_ttl>0 && pvt->_semset->supportsTimedSemaphoreOperations()) {
-		result=pvt->_semset->waitWithUndo(0,pvt->_ttl,0);
-	} else if (pvt->_ttl>0 && sys::signalsInterruptSystemCalls()) {
-		pvt->_semset->dontRetryInterruptedOperations();
-		alarmrang=0;
-		signalmanager::alarm(pvt->_ttl);
-		do {
-			error::setErrorNumber(0);
-			result=pvt->_semset->waitWithUndo(0);
-		} while (!result && error::getErrorNumber()==EINTR &&
-					!process::getShutDownFlag() &&
-					!alarmrang);
-		signalmanager::alarm(0);
-		pvt->_semset->retryInterruptedOperations();
-	} else {
-		result=pvt->_semset->waitWithUndo(0);
-	}
+	bool	result=waitForSemaphore(0,true);
 	if (result) {
 		raiseDebugMessageEvent("done acquiring announce mutex");
 	} else {
@@ -7221,6 +8284,77 @@ bool sqlrservercontroller::acquireAnnounceMutex() {
 	return result;
 }
 
+bool sqlrservercontroller::waitForSemaphore(int32_t index, bool withundo) {
+
+	// Wait on the semaphore until the ttl is reached, if there is one.
+	//
+	// Configuration reloads that are requested, and new connect strings
+	// that come due, during the wait are applied and then the wait
+	// resumes.  So, the wait is also cut short when a new connect string
+	// is due, and interrupted by the reload signal, if possible.
+	time_t	ttlreached=(pvt->_ttl>0)?time(NULL)+pvt->_ttl:0;
+	bool	timed=pvt->_semset->supportsTimedSemaphoreOperations();
+	bool	interruptible=sys::signalsInterruptSystemCalls();
+	if (interruptible) {
+		pvt->_semset->dontRetryInterruptedOperations();
+	}
+
+	bool	result=false;
+	for (;;) {
+
+		// wait until the ttl is reached or the
+		// new connect string is due, whichever is first
+		int32_t	timeout=-1;
+		if (ttlreached) {
+			timeout=ttlreached-time(NULL);
+			if (timeout<=0) {
+				break;
+			}
+		}
+		int32_t	reloadtimeout=getReloadTimeout();
+		if (reloadtimeout>=0 && (timeout<0 || reloadtimeout<timeout)) {
+			timeout=reloadtimeout;
+		}
+
+		error::setErrorNumber(0);
+		if (!timeout) {
+			// the new connect string is already due
+		} else if (timeout>0 && timed) {
+			result=(withundo)?
+				pvt->_semset->waitWithUndo(index,timeout,0):
+				pvt->_semset->wait(index,timeout,0);
+		} else {
+			if (timeout>0 && interruptible) {
+				alarmrang=0;
+				signalmanager::alarm(timeout);
+			}
+			result=(withundo)?
+				pvt->_semset->waitWithUndo(index):
+				pvt->_semset->wait(index);
+			if (timeout>0 && interruptible) {
+				signalmanager::alarm(0);
+			}
+		}
+		if (result || process::getShutDownFlag()) {
+			break;
+		}
+
+		// bail on errors other than timeouts and interruptions
+		int32_t	err=error::getErrorNumber();
+		if (timeout && err!=EINTR && err!=EAGAIN) {
+			break;
+		}
+
+		// apply configuration changes, if any are due, and wait again
+		reloadIfDue();
+	}
+
+	if (interruptible) {
+		pvt->_semset->retryInterruptedOperations();
+	}
+	return result;
+}
+
 void sqlrservercontroller::releaseAnnounceMutex() {
 	raiseDebugMessageEvent("releasing announce mutex");
 	pvt->_semset->signalWithUndo(0);
@@ -7242,24 +8376,7 @@ bool sqlrservercontroller::waitForListenerToFinishReading() {
 	raiseDebugMessageEvent("waiting for listener");
 
 	// Wait.  Bail if ttl is exceeded
-	bool	result=false;
-	if (pvt->_ttl>0 && pvt->_semset->supportsTimedSemaphoreOperations()) {
-		result=pvt->_semset->wait(3,pvt->_ttl,0);
-	} else if (pvt->_ttl>0 && sys::signalsInterruptSystemCalls()) {
-		pvt->_semset->dontRetryInterruptedOperations();
-		alarmrang=0;
-		signalmanager::alarm(pvt->_ttl);
-		do {
-			error::setErrorNumber(0);
-			result=pvt->_semset->wait(3);
-		} while (!result && error::getErrorNumber()==EINTR &&
-					!process::getShutDownFlag() &&
-					!alarmrang);
-		signalmanager::alarm(0);
-		pvt->_semset->retryInterruptedOperations();
-	} else {
-		result=pvt->_semset->wait(3);
-	}
+	bool	result=waitForSemaphore(3,false);
 	if (result) {
 		raiseDebugMessageEvent("done waiting for listener");
 	} else {
@@ -7282,6 +8399,106 @@ void sqlrservercontroller::signalListenerToHandoff() {
 	raiseDebugMessageEvent("done signalling listener to handoff");
 }
 
+bool sqlrservercontroller::announceIdle(const char *connectionid) {
+
+	raiseDebugMessageEvent("announcing idle...");
+
+	// add this connection to the list of idle connections
+	if (!acquireAnnounceMutex()) {
+		raiseDebugMessageEvent("ttl reached, aborting announcing idle");
+		return false;
+	}
+
+	setState(ANNOUNCE_AVAILABILITY);
+
+	uint32_t	count=pvt->_shm->idleconnectioncount;
+	if (count>=MAXCONNECTIONS) {
+		// someone started more than MAXCONNECTIONS manually,
+		// there's no room in the list, just wait to be shut down
+		releaseAnnounceMutex();
+		raiseInternalErrorEvent(NULL,"idle connection list is full");
+		snooze::macrosnooze(1);
+		return false;
+	}
+	sqlridleconnection	*ic=&(pvt->_shm->idleconnections[count]);
+	ic->connectionpid=process::getProcessId();
+	charstring::copy(ic->connectionid,connectionid,MAXCONNECTIONIDLEN);
+	ic->dbuser[0]='\0';
+	if (pvt->_user) {
+		charstring::copy(ic->dbuser,pvt->_user,USERSIZE-1);
+		ic->dbuser[USERSIZE-1]='\0';
+	}
+	pvt->_shm->idleconnectioncount++;
+
+	releaseAnnounceMutex();
+
+	signalListenerToRead();
+
+	// Wait for the listener to pick this connection, up to the ttl,
+	// applying configuration changes as they come due.  If there's no
+	// ttl and no pending connect string then the listener will
+	// eventually pick this connection and waitForClient() will wait for
+	// it to do so.
+	listener	lsnr;
+	lsnr.addReadFileDescriptor(&pvt->_handoffsockun);
+	time_t	ttlreached=(pvt->_ttl>0)?time(NULL)+pvt->_ttl:0;
+	for (;;) {
+		int32_t	timeout=-1;
+		if (ttlreached) {
+			timeout=ttlreached-time(NULL);
+			if (timeout<0) {
+				timeout=0;
+			}
+		}
+		int32_t	reloadtimeout=getReloadTimeout();
+		if (reloadtimeout>=0 && (timeout<0 || reloadtimeout<timeout)) {
+			timeout=reloadtimeout;
+		}
+		if (timeout<0) {
+			raiseDebugMessageEvent("done announcing idle");
+			return true;
+		}
+		if (lsnr.listen(timeout,0)>0) {
+			raiseDebugMessageEvent("done announcing idle");
+			return true;
+		}
+		if (process::getShutDownFlag() ||
+				(ttlreached && time(NULL)>=ttlreached)) {
+			break;
+		}
+		reloadIfDue();
+	}
+
+	bool	removed=false;
+	pvt->_semset->waitWithUndo(0);
+	pid_t	pid=process::getProcessId();
+	count=pvt->_shm->idleconnectioncount;
+	for (uint32_t i=0; i<count; i++) {
+		if (pvt->_shm->idleconnections[i].connectionpid==pid) {
+			for (uint32_t j=i+1; j<count; j++) {
+				pvt->_shm->idleconnections[j-1]=
+					pvt->_shm->idleconnections[j];
+			}
+			pvt->_shm->idleconnectioncount--;
+			removed=true;
+			break;
+		}
+	}
+	pvt->_semset->signalWithUndo(0);
+
+	if (!removed) {
+		raiseDebugMessageEvent("done announcing idle");
+		return true;
+	}
+
+	// The semaphore that we signalled earlier will be left incremented.
+	// The listener will find no matching entry in the list when it
+	// consumes it, and will just wait for another connection.
+
+	raiseDebugMessageEvent("ttl reached, aborting announcing idle");
+	return false;
+}
+
 void sqlrservercontroller::acquireConnectionCountMutex() {
 	raiseDebugMessageEvent("acquiring connection count mutex");
 	pvt->_semset->waitWithUndo(4);
@@ -7316,11 +8533,12 @@ void sqlrservercontroller::initConnStats() {
 
 			// initialize the connection stats
 			clearConnStats();
-			setState(INIT);
 			pvt->_connstats->index=i;
+			setState(INIT);
 			pvt->_connstats->processid=process::getProcessId();
 			pvt->_connstats->loggedinsec=pvt->_loggedinsec;
 			pvt->_connstats->loggedinusec=pvt->_loggedinusec;
+			pvt->_membudget.setStatistics(pvt->_connstats);
 			return;
 		}
 	}
@@ -7339,8 +8557,73 @@ void sqlrservercontroller::clearConnStats() {
 	bytestring::zero(pvt->_connstats,sizeof(struct sqlrconnstatistics));
 }
 
+void sqlrservercontroller::countFingerprint(sqlrservercursor *cursor,
+							bool success) {
+
+	if (!pvt->_fps) {
+		return;
+	}
+
+	// add the rows and fetch time of the previous execution,
+	// in case the result set wasn't closed
+	finishFingerprint(cursor);
+
+	// the query is normalized and hashed the first time that it's
+	// executed and the fingerprint is kept until the query changes
+	if (!cursor->getFingerprint()) {
+		sqlrparsedquery	*pq=getParsedQuery(cursor);
+		if (!pq) {
+			return;
+		}
+		cursor->setFingerprint(sqlrfingerprints::fingerprint(
+					pq,cursor->getFingerprintText()));
+	}
+
+	uint64_t	executeusec=
+			((cursor->getQueryEndSec()-
+				cursor->getQueryStartSec())*1000000)+
+			cursor->getQueryEndUSec()-cursor->getQueryStartUSec();
+
+	// rows and fetch time are added when the result set is closed
+	cursor->setPendingFingerprint(cursor->getFingerprint());
+	cursor->resetFetchTime();
+
+	if (pvt->_fps->count(cursor->getFingerprint(),
+				cursor->getFingerprintText()->getString(),
+				1,(success)?0:1,0,executeusec,0)) {
+		flushFingerprints();
+	}
+}
+
+void sqlrservercontroller::finishFingerprint(sqlrservercursor *cursor) {
+
+	uint64_t	fingerprint=cursor->getPendingFingerprint();
+	if (!fingerprint || !pvt->_fps) {
+		return;
+	}
+	cursor->setPendingFingerprint(0);
+
+	if (pvt->_fps->count(fingerprint,
+				cursor->getFingerprintText()->getString(),
+				0,0,cursor->getTotalRowsFetched(),
+				0,cursor->getFetchUSec())) {
+		flushFingerprints();
+	}
+}
+
+void sqlrservercontroller::flushFingerprints() {
+	if (!pvt->_fps) {
+		return;
+	}
+	pvt->_semset->waitWithUndo(9);
+	pvt->_fps->flush();
+	pvt->_semset->signalWithUndo(9);
+}
+
 sqlrparser *sqlrservercontroller::newParser() {
 
+	pvt->_sqlrploaded=true;
+
 	pvt->_sqlrpnode=pvt->_cfg->getParser();
 	const char	*module=pvt->_sqlrpnode->getAttributeValue("module");
 	if (charstring::isNullOrEmpty(module)) {
@@ -8540,11 +9823,128 @@ void sqlrservercontroller::setState(enum sqlrconnectionstate_t state) {
 	if (!pvt->_connstats) {
 		return;
 	}
+
+	// end the span for the previous state and start one for the new one
+	if (tracing()) {
+		uint64_t	now=traceClock();
+		if (pvt->_tracestatestart) {
+			trace(SQLRTRACEPHASE_STATE,pvt->_connstats->state,0,
+						pvt->_tracestatestart,now);
+		}
+		pvt->_tracestatestart=now;
+	}
+
 	pvt->_connstats->state=state;
 	datetime	dt;
 	dt.getSystemDateAndTime();
-	pvt->_connstats->statestartsec=dt.getSeconds();
-	pvt->_connstats->statestartusec=dt.getMicroseconds();
+	pvt->_connstats->statestartsec=dt.getSeconds();
+	pvt->_connstats->statestartusec=dt.getMicroseconds();
+}
+
+bool sqlrservercontroller::tracing() {
+
+	// This is called at the start of every traced phase.  Unless
+	// sqlr-trace has just started or stopped, it's just a comparison.
+	if (!pvt->_connstats) {
+		return false;
+	}
+	if (pvt->_shm->tracegeneration!=pvt->_tracegeneration) {
+		attachTrace();
+	}
+	return (pvt->_tracering!=NULL);
+}
+
+void sqlrservercontroller::attachTrace() {
+
+	detachTrace();
+
+	// a generation of 0 means that sqlr-trace stopped
+	pvt->_tracegeneration=pvt->_shm->tracegeneration;
+	if (!pvt->_tracegeneration) {
+		return;
+	}
+
+	key_t	key=file::generateKey(pvt->_traceidfilename,1);
+	if (key==-1) {
+		return;
+	}
+
+	// attach to the header to find out how big the buffer is
+	sharedmemory	*shmem=new sharedmemory;
+	if (!shmem->attach(key,sizeof(sqlrtraceheader))) {
+		delete shmem;
+		return;
+	}
+	sqlrtraceheader	*header=(sqlrtraceheader *)shmem->getPointer();
+	uint32_t	ringcount=header->ringcount;
+	uint32_t	ringsize=header->ringsize;
+	delete shmem;
+	if (pvt->_connstats->index>=ringcount || !ringsize) {
+		return;
+	}
+
+	// attach to the whole buffer and find the ring for this connection
+	uint64_t	ringbytes=sizeof(sqlrtracering)+
+					ringsize*sizeof(sqlrtracespan);
+	shmem=new sharedmemory;
+	if (!shmem->attach(key,sizeof(sqlrtraceheader)+ringcount*ringbytes)) {
+		delete shmem;
+		return;
+	}
+	unsigned char	*ptr=(unsigned char *)shmem->getPointer();
+	pvt->_traceshmem=shmem;
+	pvt->_tracering=(sqlrtracering *)(ptr+sizeof(sqlrtraceheader)+
+					pvt->_connstats->index*ringbytes);
+	pvt->_tracespans=(sqlrtracespan *)(pvt->_tracering+1);
+	pvt->_traceringsize=ringsize;
+	pvt->_tracering->processid=process::getProcessId();
+
+	// the current state started before tracing did
+	pvt->_tracestatestart=0;
+}
+
+void sqlrservercontroller::detachTrace() {
+	delete pvt->_traceshmem;
+	pvt->_traceshmem=NULL;
+	pvt->_tracering=NULL;
+	pvt->_tracespans=NULL;
+	pvt->_traceringsize=0;
+}
+
+uint64_t sqlrservercontroller::traceClock() {
+#ifdef HAVE_CLOCK_MONOTONIC
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ((uint64_t)ts.tv_sec)*1000000000+ts.tv_nsec;
+#else
+	// (not monotonic, but at least it doesn't wrap)
+	datetime	dt;
+	dt.getSystemDateAndTime();
+	return (((uint64_t)dt.getEpoch())*1000000+
+				dt.getMicroseconds())*1000;
+#endif
+}
+
+void sqlrservercontroller::trace(sqlrtracephase_t phase,
+					uint32_t command,
+					uint16_t cursorid,
+					uint64_t start,
+					uint64_t end) {
+
+	// Invalidate the span, fill it in, then validate it with its position
+	// in the ring.  sqlr-trace reads the rings without locking, and
+	// discards any span whose sequence changed while it was reading it.
+	uint64_t		head=pvt->_tracering->head;
+	volatile sqlrtracespan	*span=&(pvt->_tracespans[
+					head%pvt->_traceringsize]);
+	span->sequence=0;
+	span->start=start;
+	span->end=end;
+	span->command=command;
+	span->cursorid=cursorid;
+	span->phase=phase;
+	span->sequence=head+1;
+	((volatile sqlrtracering *)pvt->_tracering)->head=head+1;
 }
 
 enum sqlrconnectionstate_t sqlrservercontroller::getState() {
@@ -8577,6 +9977,18 @@ void sqlrservercontroller::setCurrentUser(const char *user,
 	pvt->_connstats->user[len]='\0';
 }
 
+void sqlrservercontroller::setCurrentDbUser() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->dbuser[0]='\0';
+	if (pvt->_user) {
+		charstring::copy(pvt->_connstats->dbuser,
+					pvt->_user,USERSIZE-1);
+		pvt->_connstats->dbuser[USERSIZE-1]='\0';
+	}
+}
+
 void sqlrservercontroller::setCurrentQuery(const char *query,
 						uint32_t querylen) {
 	if (!pvt->_connstats) {
@@ -8709,79 +10121,29 @@ void sqlrservercontroller::incrementTimesCursorReused() {
 
 void sqlrservercontroller::incrementQueryCounts(sqlrquerytype_t querytype) {
 
-	pvt->_semset->waitWithUndo(9);
-
-	// update total queries
-	pvt->_shm->total_queries++;
-
-	// update queries-per-second stats...
-
-	// re-init stats if necessary
-	datetime	dt;
-	dt.getSystemDateAndTime();
-	time_t	now=dt.getEpoch();
-	int	index=now%STATQPSKEEP;
-	if (pvt->_shm->timestamp[index]!=now) {
-		pvt->_shm->timestamp[index]=now;
-		pvt->_shm->qps_select[index]=0;
-		pvt->_shm->qps_update[index]=0;
-		pvt->_shm->qps_insert[index]=0;
-		pvt->_shm->qps_delete[index]=0;
-		pvt->_shm->qps_create[index]=0;
-		pvt->_shm->qps_drop[index]=0;
-		pvt->_shm->qps_alter[index]=0;
-		pvt->_shm->qps_custom[index]=0;
-		pvt->_shm->qps_etc[index]=0;
-	}
-
-	// increment per-query-type stats
-	switch (querytype) {
-		case SQLRQUERYTYPE_SELECT:
-			pvt->_shm->qps_select[index]++;
-			break;
-		case SQLRQUERYTYPE_INSERT:
-			pvt->_shm->qps_insert[index]++;
-			break;
-		case SQLRQUERYTYPE_UPDATE:
-			pvt->_shm->qps_update[index]++;
-			break;
-		case SQLRQUERYTYPE_DELETE:
-			pvt->_shm->qps_delete[index]++;
-			break;
-		case SQLRQUERYTYPE_CREATE:
-			pvt->_shm->qps_create[index]++;
-			break;
-		case SQLRQUERYTYPE_DROP:
-			pvt->_shm->qps_drop[index]++;
-			break;
-		case SQLRQUERYTYPE_ALTER:
-			pvt->_shm->qps_alter[index]++;
-			break;
-		case SQLRQUERYTYPE_CUSTOM:
-			pvt->_shm->qps_custom[index]++;
-			break;
-		case SQLRQUERYTYPE_ETC:
-		default:
-			pvt->_shm->qps_etc[index]++;
-			break;
-	}
-
-	pvt->_semset->signalWithUndo(9);
-
+	// Query counts are kept in this connection's connstats slot, rather
+	// than in instance-wide counters, so that connections don't have to
+	// contend for a semaphore on every query.  sqlr-status, etc. add the
+	// slots up when they need the totals.
 	if (!pvt->_connstats) {
+		// if this connection didn't get a slot, then
+		// just count the query as if it had exited
+		pvt->_semset->waitWithUndo(9);
+		pvt->_shm->retired_queries++;
+		pvt->_semset->signalWithUndo(9);
 		return;
 	}
-	if (querytype==SQLRQUERYTYPE_CUSTOM) {
-		pvt->_connstats->ncustomsql++;
-	} else {
-		pvt->_connstats->nsql++;
-	}
+	sqlrquerystats::countQuery(pvt->_connstats,querytype,time(NULL)/60);
 }
 
 void sqlrservercontroller::incrementTotalErrors() {
-	pvt->_semset->waitWithUndo(9);
-	pvt->_shm->total_errors++;
-	pvt->_semset->signalWithUndo(9);
+	if (!pvt->_connstats) {
+		pvt->_semset->waitWithUndo(9);
+		pvt->_shm->retired_errors++;
+		pvt->_semset->signalWithUndo(9);
+		return;
+	}
+	sqlrquerystats::countError(pvt->_connstats);
 }
 
 void sqlrservercontroller::incrementAuthCount() {
@@ -9001,6 +10363,65 @@ void sqlrservercontroller::incrementNextResultSetAvailableCount() {
 	pvt->_connstats->nnextresultsetavailable++;
 }
 
+void sqlrservercontroller::incrementStatementCacheHitCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nstmtcachehit++;
+}
+
+void sqlrservercontroller::incrementStatementCacheMissCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nstmtcachemiss++;
+}
+
+void sqlrservercontroller::incrementReleaseSessionCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nreleasesession++;
+}
+
+void sqlrservercontroller::incrementResumeSessionCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nresumesession++;
+}
+
+bool sqlrservercontroller::sessionIsDirty() {
+	return (pvt->_sessionstatechanged ||
+		pvt->_dbchanged ||
+		pvt->_isolationlevelchanged ||
+		pvt->_autocommitforthissession!=pvt->_initialautocommit ||
+		pvt->_sessiontemptablesfordrop.getLength() ||
+		pvt->_sessiontemptablesfortrunc.getLength() ||
+		pvt->_changeduser);
+}
+
+void sqlrservercontroller::incrementPinSessionCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->npinsession++;
+}
+
+void sqlrservercontroller::incrementSkippedSessionResetCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nsessionresetskipped++;
+}
+
+void sqlrservercontroller::incrementSkippedSessionQueriesCount() {
+	if (!pvt->_connstats) {
+		return;
+	}
+	pvt->_connstats->nsessionqueriesskipped++;
+}
+
 uint32_t sqlrservercontroller::getStatisticsIndex() {
 	if (!pvt->_connstats) {
 		return 0;
@@ -9171,6 +10592,22 @@ void sqlrservercontroller::setMaxFieldLength(uint32_t maxfieldlength) {
 	pvt->_maxfieldlength=maxfieldlength;
 }
 
+void sqlrservercontroller::setAdaptiveFetch(bool adaptivefetch) {
+	pvt->_adaptivefetch=adaptivefetch;
+}
+
+void sqlrservercontroller::setFetchBatchBytes(uint64_t fetchbatchbytes) {
+	pvt->_fetchbatchbytes=fetchbatchbytes;
+}
+
+void sqlrservercontroller::setStatementCacheSize(uint32_t stmtcachesize) {
+	pvt->_stmtcachesize=stmtcachesize;
+}
+
+uint32_t sqlrservercontroller::getStatementCacheSize() {
+	return pvt->_stmtcachesize;
+}
+
 uint32_t sqlrservercontroller::getFetchAtOnce() {
 	return pvt->_fetchatonce;
 }
@@ -9183,6 +10620,14 @@ uint32_t sqlrservercontroller::getMaxFieldLength() {
 	return pvt->_maxfieldlength;
 }
 
+bool sqlrservercontroller::getAdaptiveFetch() {
+	return pvt->_adaptivefetch;
+}
+
+uint64_t sqlrservercontroller::getFetchBatchBytes() {
+	return pvt->_fetchbatchbytes;
+}
+
 bool sqlrservercontroller::getColumnNames(const char *query,
 					stringbuffer *output) {
 
@@ -9207,6 +10652,7 @@ bool sqlrservercontroller::getColumnNames(const char *query,
 }
 
 void sqlrservercontroller::addSessionTempTableForDrop(const char *table) {
+	pinSession("temp table");
 	pvt->_sessiontemptablesfordrop.append(charstring::duplicate(table));
 }
 
@@ -9233,6 +10679,7 @@ void sqlrservercontroller::addGlobalTempTables(const char *gtts) {
 }
 
 void sqlrservercontroller::addSessionTempTableForTrunc(const char *table) {
+	pinSession("temp table");
 	pvt->_sessiontemptablesfortrunc.append(charstring::duplicate(table));
 }
 
@@ -9610,6 +11057,10 @@ void sqlrservercontroller::alarmHandler(int32_t signum) {
 	alarmrang=1;
 }
 
+void sqlrservercontroller::reloadHandler(int32_t signum) {
+	reloadrequested=1;
+}
+
 const char *sqlrservercontroller::dbHostName() {
 	if (!pvt->_dbhostname || !pvt->_conn->cacheDbHostInfo()) {
 		pvt->_dbhostname=pvt->_conn->dbHostName();
@@ -9705,6 +11156,8 @@ bool sqlrservercontroller::fetchFromBindCursor(sqlrservercursor *cursor) {
 	
 	// reset total rows fetched
 	cursor->clearTotalRowsFetched();
+	clearSpool(cursor);
+	cursor->resetFetchBatch();
 
 	if (success) {
 		success=handleResultSetHeader(cursor);
@@ -10189,11 +11642,33 @@ bool sqlrservercontroller::noRowsToReturn(sqlrservercursor *cursor) {
 }
 
 bool sqlrservercontroller::skipRow(sqlrservercursor *cursor, bool *error) {
+	sqlrspool	*spool=cursor->getSpool();
+	if (spool && spool->isActive()) {
+		return fetchSpooledRow(cursor,spool,error);
+	}
 	return cursor->skipRow(error);
 }
 
 bool sqlrservercontroller::fetchRow(sqlrservercursor *cursor, bool *error) {
 
+	// only time fetches if they'll be added to a fingerprint's totals
+	if (!cursor->getPendingFingerprint()) {
+		return fetchNextRow(cursor,error);
+	}
+
+	uint64_t	start=traceClock();
+	bool		result=fetchNextRow(cursor,error);
+	uint64_t	end=traceClock();
+
+	cursor->setFetchStart(0,start/1000);
+	cursor->setFetchEnd(0,end/1000);
+	cursor->tallyFetchTime();
+	return result;
+}
+
+bool sqlrservercontroller::fetchRowFromCursor(sqlrservercursor *cursor,
+								bool *error) {
+
 	// initialize error
 	*error=false;
 
@@ -10213,9 +11688,6 @@ bool sqlrservercontroller::fetchRow(sqlrservercursor *cursor, bool *error) {
 	uint32_t	colcount=(cursor->getColumnInfoIsValid())?
 						cursor->colCount():0;
 
-	// for timings...
-	datetime	dt;
-
 	if (pvt->_sqlrrsrbt) {
 
 		// if we have row block translations, then
@@ -10378,8 +11850,303 @@ bool sqlrservercontroller::fetchRow(sqlrservercursor *cursor, bool *error) {
 	return true;
 }
 
+bool sqlrservercontroller::fetchNextRow(sqlrservercursor *cursor,
+								bool *error) {
+
+	sqlrspool	*spool=cursor->getSpool();
+	if (!spool) {
+		if (!fetchRowFromCursor(cursor,error)) {
+			return false;
+		}
+		if (cursor->getAdaptiveFetch()) {
+			cursor->countFetchedRow(rowBytes(cursor));
+		}
+		return true;
+	}
+
+	// spool the rest of the result set if it's grown too large,
+	// or if the client is taking too long to fetch it
+	if (!spool->isActive() && shouldSpool(cursor,spool) &&
+				!spoolResultSet(cursor,spool,error)) {
+		return false;
+	}
+
+	// once the result set has been spooled, serve it from the spool
+	if (spool->isActive()) {
+		if (!fetchSpooledRow(cursor,spool,error)) {
+			return false;
+		}
+		cursor->incrementTotalRowsFetched();
+		return true;
+	}
+
+	if (!fetchRowFromCursor(cursor,error)) {
+		return false;
+	}
+
+	// keep track of the size of the result set, if it matters
+	if (pvt->_spoolbytes || cursor->getAdaptiveFetch()) {
+		uint64_t	bytes=rowBytes(cursor);
+		if (pvt->_spoolbytes) {
+			spool->countRow(bytes);
+		}
+		cursor->countFetchedRow(bytes);
+	}
+	return true;
+}
+
+static void bindBytes(sqlrserverbindvar *vars, uint16_t count,
+					uint64_t *binds, uint64_t *lobs) {
+	for (uint16_t i=0; i<count; i++) {
+		switch (vars[i].type) {
+			case SQLRSERVERBINDVARTYPE_STRING:
+				*binds+=vars[i].valuesize+1;
+				break;
+			case SQLRSERVERBINDVARTYPE_BLOB:
+			case SQLRSERVERBINDVARTYPE_CLOB:
+				*lobs+=vars[i].valuesize;
+				break;
+			case SQLRSERVERBINDVARTYPE_DATE:
+				*binds+=vars[i].value.dateval.buffersize;
+				break;
+			default:
+				// the value is stored in the bind itself
+				break;
+		}
+	}
+}
+
+bool sqlrservercontroller::reserveQueryMemory(sqlrservercursor *cursor) {
+
+	// By the time that this runs, the protocol module has already read
+	// the bind values into the bind pool and the query has been rewritten,
+	// so the hard limit is enforced after that memory has been allocated.
+	// It's bounded by maxbindcount and the max bind value lengths, and
+	// rejecting the query here, rather than while the protocol is reading
+	// the binds, leaves the client connection in a usable state.
+
+	// the query buffer itself is allocated along with the cursor,
+	// but rewritten copies of the query grow with the query
+	uint64_t	queries=cursor->getTranslatedQueryBuffer()->getSize()+
+				cursor->getQueryWithFakeInputBindsBuffer()->
+								getSize();
+
+	// bind values are allocated from the cursor's bind pool
+	uint64_t	binds=0;
+	uint64_t	lobs=0;
+	bindBytes(cursor->getInputBinds(),
+			cursor->getInputBindCount(),&binds,&lobs);
+	bindBytes(cursor->getOutputBinds(),
+			cursor->getOutputBindCount(),&binds,&lobs);
+	bindBytes(cursor->getInputOutputBinds(),
+			cursor->getInputOutputBindCount(),&binds,&lobs);
+
+	if (cursor->reserveQueryMemory(SQLRMEMORY_QUERIES,queries) &&
+		cursor->reserveQueryMemory(SQLRMEMORY_BINDS,binds) &&
+		cursor->reserveQueryMemory(SQLRMEMORY_LOBS,lobs)) {
+		return true;
+	}
+	cursor->releaseQueryMemory();
+	return false;
+}
+
+uint64_t sqlrservercontroller::rowBytes(sqlrservercursor *cursor) {
+	uint32_t	colcount=(cursor->getColumnInfoIsValid())?
+						cursor->colCount():0;
+	uint64_t	bytes=0;
+	for (uint32_t i=0; i<colcount; i++) {
+		bytes+=pvt->_fieldlengths[i];
+	}
+	return bytes;
+}
+
+bool sqlrservercontroller::shouldSpool(sqlrservercursor *cursor,
+							sqlrspool *spool) {
+
+	if (!cursor->getColumnInfoIsValid() || !cursor->colCount()) {
+		return false;
+	}
+	if (pvt->_spoolrows &&
+		cursor->getTotalRowsFetched()>=pvt->_spoolrows) {
+		return true;
+	}
+	if (pvt->_spoolbytes &&
+		spool->getResultSetBytes()>=pvt->_spoolbytes) {
+		return true;
+	}
+	return (pvt->_spooltimeout &&
+		traceClock()-spool->getResultSetStart()>=pvt->_spooltimeout);
+}
+
+bool sqlrservercontroller::spoolResultSet(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							bool *error) {
+
+	raiseDebugMessageEvent("spooling result set...");
+
+	uint64_t	start=traceClock();
+
+	if (!spool->create(pvt->_pth->getTmpDir(),cursor->getId())) {
+		raiseDebugMessageEvent("failed to create spool file");
+		*error=true;
+		setError(cursor,SQLR_ERROR_RESULTSETSPOOL_STRING,
+					SQLR_ERROR_RESULTSETSPOOL,true);
+		return false;
+	}
+
+	// Fetch the rest of the rows from the database and write them to the
+	// spool.  Once the database has returned the last row, it's done with
+	// the result set, even though the client is still fetching it.
+	uint64_t	rowsfetched=cursor->getTotalRowsFetched();
+	uint32_t	colcount=cursor->colCount();
+	bool		success=true;
+	while (success && fetchRowFromCursor(cursor,error)) {
+		for (uint32_t i=0; success && i<colcount; i++) {
+			if (pvt->_blobs[i] && !pvt->_nulls[i]) {
+				success=spoolLobField(cursor,spool,i);
+			} else {
+				success=spool->writeField(pvt->_fields[i],
+							pvt->_fieldlengths[i],
+							pvt->_blobs[i],
+							pvt->_nulls[i]);
+			}
+		}
+		spool->endRow();
+		cursor->nextRow();
+	}
+
+	// the rows are counted as they're returned to the client
+	cursor->setTotalRowsFetched(rowsfetched);
+
+	if (*error) {
+		raiseDebugMessageEvent("spooling result set "
+					"encountered an error");
+		spool->clear(spool->getResultSetStart());
+		return false;
+	}
+	if (!success || !spool->finishWriting()) {
+		raiseDebugMessageEvent("failed to write spool file");
+		spool->clear(spool->getResultSetStart());
+		*error=true;
+		setError(cursor,SQLR_ERROR_RESULTSETSPOOL_STRING,
+					SQLR_ERROR_RESULTSETSPOOL,true);
+		return false;
+	}
+
+	uint64_t	usec=(traceClock()-start)/1000;
+
+	if (pvt->_connstats) {
+		pvt->_connstats->nspooledresultsets++;
+		pvt->_connstats->nspooledrows+=spool->getRowCount();
+		pvt->_connstats->nspooledbytes+=spool->getSize();
+		pvt->_connstats->spoolusec+=usec;
+	}
+
+	if (pvt->_sqlrlg) {
+		pvt->_debugstr.clear();
+		pvt->_debugstr.append("spooled ");
+		pvt->_debugstr.append(spool->getRowCount());
+		pvt->_debugstr.append(" rows, ");
+		pvt->_debugstr.append(spool->getSize());
+		pvt->_debugstr.append(" bytes in ");
+		pvt->_debugstr.append(usec);
+		pvt->_debugstr.append(" usec");
+		raiseDebugMessageEvent(pvt->_debugstr.getString());
+	}
+	return true;
+}
+
+bool sqlrservercontroller::spoolLobField(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							uint32_t col) {
+
+	uint64_t	loblength;
+	if (!cursor->getLobFieldLength(col,&loblength)) {
+		cursor->closeLobField(col);
+		return spool->writeField(NULL,0,true,true);
+	}
+
+	// write the lob to the spool a segment at a time
+	if (!spool->beginLobField()) {
+		cursor->closeLobField(col);
+		return false;
+	}
+	bool		success=true;
+	uint64_t	written=0;
+	if (loblength) {
+		char		segment[SPOOL_LOB_SEGMENT_SIZE];
+		uint64_t	charstoread=sizeof(segment)/MAX_BYTES_PER_CHAR;
+		uint64_t	charsread=0;
+		uint64_t	offset=0;
+		while (success &&
+			cursor->getLobFieldSegment(col,segment,sizeof(segment),
+						offset,charstoread,&charsread) &&
+						charsread) {
+			success=spool->writeLobSegment(segment,charsread);
+			written=written+charsread;
+			offset=offset+charstoread;
+		}
+	}
+	cursor->closeLobField(col);
+
+	// like the protocols do, treat a lob that
+	// couldn't be read at all as a NULL
+	return (success && spool->endLobField(loblength && !written));
+}
+
+bool sqlrservercontroller::fetchSpooledRow(sqlrservercursor *cursor,
+							sqlrspool *spool,
+							bool *error) {
+
+	cursor->getFieldPointers(&(pvt->_fieldnames),
+					&(pvt->_fields),
+					&(pvt->_fieldlengths),
+					&(pvt->_blobs),
+					&(pvt->_nulls));
+
+	// the rows were reformatted and translated as they were spooled
+	uint32_t	colcount=cursor->colCount();
+	if (!spool->readRow(colcount,pvt->_fields,pvt->_fieldlengths,
+					pvt->_blobs,pvt->_nulls,error)) {
+		if (*error) {
+			setError(cursor,SQLR_ERROR_RESULTSETSPOOL_STRING,
+						SQLR_ERROR_RESULTSETSPOOL,true);
+		}
+		return false;
+	}
+	cursor->countMemory(SQLRMEMORY_FETCH,spool->getNewBufferBytes());
+	for (uint32_t i=0; i<colcount; i++) {
+		pvt->_fieldnames[i]=getColumnName(cursor,i);
+	}
+	return true;
+}
+
+bool sqlrservercontroller::resultSetIsSpooled(sqlrservercursor *cursor) {
+	sqlrspool	*spool=cursor->getSpool();
+	return (spool && spool->isActive());
+}
+
+void sqlrservercontroller::clearSpool(sqlrservercursor *cursor) {
+
+	if (!pvt->_spooling) {
+		return;
+	}
+
+	// the spool is created the first time the cursor is used and is
+	// reused for each result set after that, the file is only created
+	// if the result set is actually spooled
+	sqlrspool	*spool=cursor->getSpool();
+	if (!spool) {
+		spool=new sqlrspool;
+		cursor->setSpool(spool);
+	}
+	spool->clear(traceClock());
+}
+
 void sqlrservercontroller::nextRow(sqlrservercursor *cursor) {
-	cursor->nextRow();
+	if (!resultSetIsSpooled(cursor)) {
+		cursor->nextRow();
+	}
 }
 
 bool sqlrservercontroller::getField(sqlrservercursor *cursor,
@@ -10405,6 +12172,10 @@ bool sqlrservercontroller::getField(sqlrservercursor *cursor,
 bool sqlrservercontroller::getLobFieldLength(sqlrservercursor *cursor,
 							uint32_t col,
 							uint64_t *length) {
+	if (resultSetIsSpooled(cursor)) {
+		*length=cursor->getSpool()->getLobLength(mapColumn(col));
+		return true;
+	}
 	return cursor->getLobFieldLength(mapColumn(col),length);
 }
 
@@ -10415,16 +12186,36 @@ bool sqlrservercontroller::getLobFieldSegment(sqlrservercursor *cursor,
 							uint64_t offset,
 							uint64_t charstoread,
 							uint64_t *charsread) {
+
+	// spooled lobs are read from the spool file a segment at a time
+	if (resultSetIsSpooled(cursor)) {
+		if (charstoread>buffersize) {
+			charstoread=buffersize;
+		}
+		if (!cursor->getSpool()->readLobSegment(mapColumn(col),
+							buffer,charstoread,
+							offset,charsread)) {
+			setError(cursor,SQLR_ERROR_RESULTSETSPOOL_STRING,
+						SQLR_ERROR_RESULTSETSPOOL,true);
+			return false;
+		}
+		return true;
+	}
+
 	return cursor->getLobFieldSegment(mapColumn(col),buffer,buffersize,
 						offset,charstoread,charsread);
 }
 
 void sqlrservercontroller::closeLobField(sqlrservercursor *cursor,
 							uint32_t col) {
-	cursor->closeLobField(mapColumn(col));
+	if (!resultSetIsSpooled(cursor)) {
+		cursor->closeLobField(mapColumn(col));
+	}
 }
 
 void sqlrservercontroller::closeResultSet(sqlrservercursor *cursor) {
+	finishFingerprint(cursor);
+	clearSpool(cursor);
 	cursor->closeResultSet();
 	if (pvt->_sqlrmd) {
 		pvt->_sqlrmd->closeResultSet(cursor);
@@ -10439,6 +12230,10 @@ memorypool *sqlrservercontroller::getBindPool(sqlrservercursor *cursor) {
 	return cursor->getBindPool();
 }
 
+void sqlrservercontroller::clearBindPool(sqlrservercursor *cursor) {
+	cursor->clearBindPool();
+}
+
 memorypool *sqlrservercontroller::getBindMappingsPool(
 						sqlrservercursor *cursor) {
 	return cursor->getBindMappingsPool();
@@ -10592,6 +12387,30 @@ xmldom *sqlrservercontroller::getQueryTree(sqlrservercursor *cursor) {
 	return cursor->getQueryTree();
 }
 
+sqlrparsedquery *sqlrservercontroller::getParsedQuery(
+					sqlrservercursor *cursor) {
+
+	// The query is tokenized the first time that something asks for it
+	// and the tokens are kept with the cursor until the query changes.
+	// Returns NULL if the parser module can't tokenize queries.
+	sqlrparsedquery	*pq=cursor->getParsedQuery();
+	if (cursor->getQueryHasBeenParsed()) {
+		return (pq->getQuery())?pq:NULL;
+	}
+
+	// load the parser if nothing else needed it
+	if (!pvt->_sqlrp && !pvt->_sqlrploaded) {
+		pvt->_sqlrp=newParser();
+	}
+
+	if (!pvt->_sqlrp || !pvt->_sqlrp->tokenize(cursor->getQueryBuffer(),
+						cursor->getQueryLength(),pq)) {
+		pq->clear();
+	}
+	cursor->setQueryHasBeenParsed(true);
+	return (pq->getQuery())?pq:NULL;
+}
+
 const char *sqlrservercontroller::getTranslatedQuery(
 					sqlrservercursor *cursor) {
 	return cursor->getTranslatedQueryBuffer()->getString();
@@ -10724,11 +12543,29 @@ void sqlrservercontroller::setLiveConnection(sqlrservercursor *cursor,
 }
 
 memorypool *sqlrservercontroller::getPerTransactionMemoryPool() {
-	return &pvt->_txpool;
+	return pvt->_txpool;
 }
 
 memorypool *sqlrservercontroller::getPerSessionMemoryPool() {
-	return &pvt->_sessionpool;
+	return pvt->_sessionpool;
+}
+
+void sqlrservercontroller::clearPool(memorypool **pool, uint64_t *shrinks) {
+
+	// A pool keeps the memory that it grew to when it's cleared.  If the
+	// connection has gone over its soft memory limit since the last time
+	// that this pool was cleared, then replace it with an empty one.
+	if (pvt->_membudget.shouldShrink(shrinks)) {
+		delete *pool;
+		*pool=new memorypool;
+		pvt->_membudget.countShrink();
+	} else {
+		(*pool)->clear();
+	}
+}
+
+sqlrmemorybudget *sqlrservercontroller::getMemoryBudget() {
+	return &pvt->_membudget;
 }
 
 sqlrparser *sqlrservercontroller::getParser() {
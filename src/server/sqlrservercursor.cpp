@@ -6,6 +6,7 @@
 #include <rudiments/character.h>
 #include <rudiments/stdio.h>
 #include <rudiments/process.h>
+#include <rudiments/datetime.h>
 
 #define NEED_DATATYPESTRING 1
 #include <datatypes.h>
@@ -30,7 +31,13 @@ class sqlrservercursorprivate {
 		xmldom		*_querytree;
 		stringbuffer	_translatedquery;
 
-		memorypool	_bindpool;
+		sqlrparsedquery	*_parsedquery;
+
+		uint64_t	_fingerprint;
+		stringbuffer	_fingerprinttext;
+		uint64_t	_pendingfingerprint;
+
+		memorypool	*_bindpool;
 		memorypool	_bindmappingspool;
 		dictionary<char *, char *>	*_bindmappings;
 
@@ -43,6 +50,8 @@ class sqlrservercursorprivate {
 
 		uint64_t	_totalrowsfetched;
 
+		sqlrspool	*_spool;
+
 		bool		_currentrowreformatted;
 
 		uint64_t	_commandstartsec;
@@ -73,6 +82,7 @@ class sqlrservercursorprivate {
 		bool	_columninfoisvalid;
 
 		bool	_queryhasbeenpreprocessed;
+		bool	_queryhasbeenparsed;
 		bool	_queryhasbeenprepared;
 		bool	_queryhasbeenexecuted;
 		bool	_queryneedsintercept;
@@ -110,9 +120,18 @@ class sqlrservercursorprivate {
 		bool		_executedirect;
 		bool		_executerpc;
 		uint32_t	_fetchatonce;
+		sqlrfetchbatch	*_fetchbatch;
+		uint64_t	_fetchbatchstart;
+
+		uint64_t	_memory[SQLRMEMORY_CATEGORIES];
+		uint64_t	_querymemory[SQLRMEMORY_CATEGORIES];
+		uint64_t	_bindpoolshrinks;
+		uint64_t	_parsedqueryshrinks;
 
 		bool		_resultsetheaderhasbeenhandled;
 
+		char		*_stmtcachekey;
+
 		unsigned char	_moduledata[1024];
 };
 
@@ -124,6 +143,7 @@ sqlrservercursor::sqlrservercursor(sqlrserverconnection *conn, uint16_t id) {
 
 	pvt->_maxerrorlength=conn->cont->getConfig()->getMaxErrorLength();
 
+	pvt->_bindpool=new memorypool;
 	pvt->_bindmappings=new dictionary<char *, char *>();
 
 	setInputBindCount(0);
@@ -160,6 +180,8 @@ sqlrservercursor::sqlrservercursor(sqlrserverconnection *conn, uint16_t id) {
 
 	pvt->_querybuffer=
 		new char[conn->cont->getConfig()->getMaxQuerySize()+1];
+	pvt->_parsedquery=NULL;
+	pvt->_pendingfingerprint=0;
 	setQueryLength(0);
 
 	setQueryStatus(SQLRQUERYSTATUS_ERROR);
@@ -180,11 +202,14 @@ sqlrservercursor::sqlrservercursor(sqlrserverconnection *conn, uint16_t id) {
 
 	clearTotalRowsFetched();
 
+	pvt->_spool=NULL;
+
 	pvt->_id=id;
 
 	pvt->_columninfoisvalid=false;
 
 	pvt->_queryhasbeenpreprocessed=false;
+	pvt->_queryhasbeenparsed=false;
 	pvt->_queryhasbeenprepared=false;
 	pvt->_queryhasbeenexecuted=false;
 	pvt->_queryneedsintercept=false;
@@ -227,21 +252,53 @@ sqlrservercursor::sqlrservercursor(sqlrserverconnection *conn, uint16_t id) {
 	pvt->_executedirect=conn->cont->getExecuteDirect();
 	pvt->_executerpc=false;
 	pvt->_fetchatonce=conn->cont->getFetchAtOnce();
+	pvt->_fetchbatch=NULL;
+	if (conn->cont->getAdaptiveFetch()) {
+		pvt->_fetchbatch=new sqlrfetchbatch;
+		pvt->_fetchbatch->setMaxRows(pvt->_fetchatonce);
+		pvt->_fetchbatch->setMaxBytes(conn->cont->getFetchBatchBytes());
+		pvt->_fetchbatch->reset();
+	}
+	pvt->_fetchbatchstart=0;
+
+	// count the buffers allocated above against the memory budget
+	for (uint16_t i=0; i<SQLRMEMORY_CATEGORIES; i++) {
+		pvt->_memory[i]=0;
+		pvt->_querymemory[i]=0;
+	}
+	pvt->_bindpoolshrinks=0;
+	pvt->_parsedqueryshrinks=0;
+	countMemory(SQLRMEMORY_CURSORS,
+		conn->cont->getConfig()->getMaxQuerySize()+1+
+		pvt->_maxerrorlength+1+
+		3*conn->cont->getConfig()->getMaxBindCount()*
+					sizeof(sqlrserverbindvar));
 
 	pvt->_resultsetheaderhasbeenhandled=false;
+
+	pvt->_stmtcachekey=NULL;
 }
 
 sqlrservercursor::~sqlrservercursor() {
 	delete[] pvt->_querybuffer;
 	delete pvt->_querytree;
+	delete pvt->_parsedquery;
+	delete pvt->_bindpool;
 	delete pvt->_bindmappings;
 	delete[] pvt->_inbindvars;
 	delete[] pvt->_outbindvars;
 	delete[] pvt->_inoutbindvars;
 	delete pvt->_customquerycursor;
+	delete pvt->_spool;
+	delete pvt->_fetchbatch;
 	delete[] pvt->_error;
+	delete[] pvt->_stmtcachekey;
 	deallocateColumnPointers();
 	deallocateFieldPointers();
+	sqlrmemorybudget	*mb=conn->cont->getMemoryBudget();
+	for (uint16_t i=0; i<SQLRMEMORY_CATEGORIES; i++) {
+		mb->release((sqlrmemorycategory_t)i,pvt->_memory[i]);
+	}
 	delete pvt;
 }
 
@@ -315,6 +372,16 @@ bool sqlrservercursor::prepareQuery(const char *query, uint32_t length) {
 	return true;
 }
 
+void *sqlrservercursor::detachStatement() {
+	// by default, don't support statement caching
+	return NULL;
+}
+
+bool sqlrservercursor::attachStatement(void *stmt) {
+	// by default, don't support statement caching
+	return false;
+}
+
 bool sqlrservercursor::supportsNativeBinds(const char *query,
 						uint32_t length) {
 	return true;
@@ -1088,7 +1155,24 @@ void sqlrservercursor::encodeBlob(stringbuffer *buffer,
 }
 
 memorypool *sqlrservercursor::getBindPool() {
-	return &pvt->_bindpool;
+	return pvt->_bindpool;
+}
+
+void sqlrservercursor::clearBindPool() {
+
+	// the bind values are gone after this
+	releaseQueryMemory();
+
+	// a pool keeps the memory that it grew to, so if the connection
+	// has gone over its soft memory limit, then replace it instead
+	sqlrmemorybudget	*mb=conn->cont->getMemoryBudget();
+	if (mb->shouldShrink(&pvt->_bindpoolshrinks)) {
+		delete pvt->_bindpool;
+		pvt->_bindpool=new memorypool;
+		mb->countShrink();
+	} else {
+		pvt->_bindpool->clear();
+	}
 }
 
 dictionary<char *, char *> *sqlrservercursor::getBindMappings() {
@@ -1145,6 +1229,15 @@ void sqlrservercursor::abort() {
 	clearCustomQueryCursor();
 }
 
+void sqlrservercursor::setStatementCacheKey(const char *key) {
+	delete[] pvt->_stmtcachekey;
+	pvt->_stmtcachekey=charstring::duplicate(key);
+}
+
+const char *sqlrservercursor::getStatementCacheKey() {
+	return pvt->_stmtcachekey;
+}
+
 char *sqlrservercursor::getQueryBuffer() {
 	return pvt->_querybuffer;
 }
@@ -1155,6 +1248,11 @@ uint32_t sqlrservercursor::getQueryLength() {
 
 void sqlrservercursor::setQueryLength(uint32_t querylength) {
 	pvt->_querylength=querylength;
+
+	// anything that changes the query sets the length,
+	// so the parsed query and fingerprint are no longer valid
+	pvt->_queryhasbeenparsed=false;
+	pvt->_fingerprint=0;
 }
 
 void sqlrservercursor::setQueryStatus(sqlrquerystatus_t status) {
@@ -1178,6 +1276,68 @@ void sqlrservercursor::clearQueryTree() {
 	pvt->_querytree=NULL;
 }
 
+sqlrparsedquery *sqlrservercursor::getParsedQuery() {
+	if (!pvt->_parsedquery) {
+		pvt->_parsedquery=new sqlrparsedquery;
+	}
+	return pvt->_parsedquery;
+}
+
+void sqlrservercursor::shrinkParsedQuery() {
+	// the parsed query's arena keeps the memory that it grew to as well
+	sqlrmemorybudget	*mb=conn->cont->getMemoryBudget();
+	if (pvt->_parsedquery &&
+			mb->shouldShrink(&pvt->_parsedqueryshrinks)) {
+		delete pvt->_parsedquery;
+		pvt->_parsedquery=NULL;
+		mb->countShrink();
+	}
+}
+
+void sqlrservercursor::countMemory(sqlrmemorycategory_t category,
+							uint64_t bytes) {
+	conn->cont->getMemoryBudget()->count(category,bytes);
+	pvt->_memory[category]+=bytes;
+}
+
+bool sqlrservercursor::reserveMemory(sqlrmemorycategory_t category,
+							uint64_t bytes) {
+	if (!conn->cont->getMemoryBudget()->reserve(category,bytes)) {
+		conn->cont->setError(this,SQLR_ERROR_MEMORYLIMIT_STRING,
+						SQLR_ERROR_MEMORYLIMIT,true);
+		return false;
+	}
+	pvt->_memory[category]+=bytes;
+	return true;
+}
+
+void sqlrservercursor::releaseMemory(sqlrmemorycategory_t category,
+							uint64_t bytes) {
+	if (bytes>pvt->_memory[category]) {
+		bytes=pvt->_memory[category];
+	}
+	conn->cont->getMemoryBudget()->release(category,bytes);
+	pvt->_memory[category]-=bytes;
+}
+
+bool sqlrservercursor::reserveQueryMemory(sqlrmemorycategory_t category,
+							uint64_t bytes) {
+	releaseMemory(category,pvt->_querymemory[category]);
+	pvt->_querymemory[category]=0;
+	if (!reserveMemory(category,bytes)) {
+		return false;
+	}
+	pvt->_querymemory[category]=bytes;
+	return true;
+}
+
+void sqlrservercursor::releaseQueryMemory() {
+	for (uint16_t i=0; i<SQLRMEMORY_CATEGORIES; i++) {
+		releaseMemory((sqlrmemorycategory_t)i,pvt->_querymemory[i]);
+		pvt->_querymemory[i]=0;
+	}
+}
+
 stringbuffer *sqlrservercursor::getTranslatedQueryBuffer() {
 	return &(pvt->_translatedquery);
 }
@@ -1277,6 +1437,26 @@ uint64_t sqlrservercursor::getFetchUSec() {
 	return pvt->_fetchusec;
 }
 
+void sqlrservercursor::setFingerprint(uint64_t fingerprint) {
+	pvt->_fingerprint=fingerprint;
+}
+
+uint64_t sqlrservercursor::getFingerprint() {
+	return pvt->_fingerprint;
+}
+
+stringbuffer *sqlrservercursor::getFingerprintText() {
+	return &(pvt->_fingerprinttext);
+}
+
+void sqlrservercursor::setPendingFingerprint(uint64_t fingerprint) {
+	pvt->_pendingfingerprint=fingerprint;
+}
+
+uint64_t sqlrservercursor::getPendingFingerprint() {
+	return pvt->_pendingfingerprint;
+}
+
 void sqlrservercursor::setState(sqlrcursorstate_t state) {
 	pvt->_state=state;
 }
@@ -1310,6 +1490,19 @@ void sqlrservercursor::incrementTotalRowsFetched() {
 	pvt->_totalrowsfetched++;
 }
 
+void sqlrservercursor::setTotalRowsFetched(uint64_t rows) {
+	pvt->_totalrowsfetched=rows;
+}
+
+void sqlrservercursor::setSpool(sqlrspool *spool) {
+	delete pvt->_spool;
+	pvt->_spool=spool;
+}
+
+sqlrspool *sqlrservercursor::getSpool() {
+	return pvt->_spool;
+}
+
 void sqlrservercursor::setCurrentRowReformatted(bool crr) {
 	pvt->_currentrowreformatted=crr;
 }
@@ -1379,6 +1572,14 @@ bool sqlrservercursor::getQueryHasBeenPreProcessed() {
 	return pvt->_queryhasbeenpreprocessed;
 }
 
+void sqlrservercursor::setQueryHasBeenParsed(bool parsed) {
+	pvt->_queryhasbeenparsed=parsed;
+}
+
+bool sqlrservercursor::getQueryHasBeenParsed() {
+	return pvt->_queryhasbeenparsed;
+}
+
 void sqlrservercursor::setQueryHasBeenPrepared(bool prepared) {
 	pvt->_queryhasbeenprepared=prepared;
 }
@@ -1683,12 +1884,47 @@ bool sqlrservercursor::getExecuteRpc() {
 
 void sqlrservercursor::setFetchAtOnce(uint32_t fetchatonce) {
 	pvt->_fetchatonce=fetchatonce;
+	if (pvt->_fetchbatch) {
+		pvt->_fetchbatch->setMaxRows(fetchatonce);
+	}
 }
 
 uint32_t sqlrservercursor::getFetchAtOnce() {
 	return pvt->_fetchatonce;
 }
 
+bool sqlrservercursor::getAdaptiveFetch() {
+	return (pvt->_fetchbatch!=NULL);
+}
+
+uint32_t sqlrservercursor::startFetchBatch() {
+	if (!pvt->_fetchbatch) {
+		return pvt->_fetchatonce;
+	}
+	pvt->_fetchbatchstart=conn->cont->traceClock();
+	return pvt->_fetchbatch->getRows();
+}
+
+void sqlrservercursor::endFetchBatch(uint32_t rows) {
+	if (pvt->_fetchbatch) {
+		pvt->_fetchbatch->fetched(rows,
+				conn->cont->traceClock()-
+						pvt->_fetchbatchstart);
+	}
+}
+
+void sqlrservercursor::countFetchedRow(uint64_t bytes) {
+	if (pvt->_fetchbatch) {
+		pvt->_fetchbatch->countRow(bytes);
+	}
+}
+
+void sqlrservercursor::resetFetchBatch() {
+	if (pvt->_fetchbatch) {
+		pvt->_fetchbatch->reset();
+	}
+}
+
 void sqlrservercursor::setResultSetHeaderHasBeenHandled(
 				bool resultsetheaderhasbeenhandled) {
 	pvt->_resultsetheaderhasbeenhandled=resultsetheaderhasbeenhandled;
@@ -0,0 +1,434 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrserver.h>
+#include <rudiments/file.h>
+#include <rudiments/permissions.h>
+#include <rudiments/process.h>
+#include <rudiments/charstring.h>
+#include <rudiments/bytestring.h>
+
+// Each field is spooled as a byte of flags, followed by an 8-byte length
+// (in host byte order, the file never leaves this process) and the data.
+// Lobs are streamed into the file, so their flags and length are written
+// as placeholders and overwritten once the whole lob has been written.
+#define SPOOL_NULL 0x01
+#define SPOOL_BLOB 0x02
+
+#define SPOOLBUFFERSIZE 65536
+
+class sqlrspoolprivate {
+	friend class sqlrspool;
+	private:
+		file		_file;
+		bool		_open;
+		bool		_active;
+
+		uint64_t	_rowcount;
+		uint64_t	_rowsread;
+		uint64_t	_size;
+
+		uint64_t	_resultsetbytes;
+		uint64_t	_resultsetstart;
+
+		uint64_t	_lobstart;
+		uint64_t	_loblength;
+
+		unsigned char	*_readbuffer;
+		uint64_t	_readpos;
+		uint64_t	_readlen;
+		uint64_t	_filepos;
+
+		char		*_row;
+		uint64_t	_rowsize;
+		uint64_t	*_offsets;
+		uint64_t	*_loboffsets;
+		uint64_t	*_loblengths;
+		uint32_t	_offsetcount;
+
+		uint64_t	_bufferbytes;
+};
+
+sqlrspool::sqlrspool() {
+	pvt=new sqlrspoolprivate;
+	pvt->_open=false;
+	pvt->_active=false;
+	pvt->_rowcount=0;
+	pvt->_rowsread=0;
+	pvt->_size=0;
+	pvt->_resultsetbytes=0;
+	pvt->_resultsetstart=0;
+	pvt->_lobstart=0;
+	pvt->_loblength=0;
+	pvt->_readbuffer=NULL;
+	pvt->_readpos=0;
+	pvt->_readlen=0;
+	pvt->_filepos=0;
+	pvt->_row=NULL;
+	pvt->_rowsize=0;
+	pvt->_offsets=NULL;
+	pvt->_loboffsets=NULL;
+	pvt->_loblengths=NULL;
+	pvt->_offsetcount=0;
+	pvt->_bufferbytes=0;
+}
+
+sqlrspool::~sqlrspool() {
+	if (pvt->_open) {
+		pvt->_file.close();
+	}
+	delete[] pvt->_readbuffer;
+	delete[] pvt->_row;
+	delete[] pvt->_offsets;
+	delete[] pvt->_loboffsets;
+	delete[] pvt->_loblengths;
+	delete pvt;
+}
+
+void sqlrspool::clear(uint64_t start) {
+
+	// the file was removed when it was created,
+	// so closing it releases the disk space too
+	if (pvt->_open) {
+		pvt->_file.close();
+		pvt->_open=false;
+	}
+	pvt->_active=false;
+	pvt->_rowcount=0;
+	pvt->_rowsread=0;
+	pvt->_size=0;
+	pvt->_readpos=0;
+	pvt->_readlen=0;
+	pvt->_filepos=0;
+
+	pvt->_resultsetbytes=0;
+	pvt->_resultsetstart=start;
+}
+
+void sqlrspool::countRow(uint64_t bytes) {
+	pvt->_resultsetbytes+=bytes;
+}
+
+uint64_t sqlrspool::getResultSetBytes() {
+	return pvt->_resultsetbytes;
+}
+
+uint64_t sqlrspool::getResultSetStart() {
+	return pvt->_resultsetstart;
+}
+
+bool sqlrspool::create(const char *dir, uint16_t id) {
+
+	clear(pvt->_resultsetstart);
+
+	stringbuffer	filename;
+	filename.append(dir)->append("/sqlrspool.");
+	filename.append((uint64_t)process::getProcessId());
+	filename.append('.')->append(id);
+
+	if (!pvt->_file.open(filename.getString(),
+				O_RDWR|O_CREAT|O_TRUNC,
+				permissions::ownerReadWrite())) {
+		return false;
+	}
+	file::remove(filename.getString());
+	pvt->_file.setWriteBufferSize(SPOOLBUFFERSIZE);
+	pvt->_open=true;
+	return true;
+}
+
+bool sqlrspool::writeField(const char *field,
+					uint64_t fieldlength,
+					bool blob,
+					bool null) {
+
+	unsigned char	flags=((null)?SPOOL_NULL:0)|((blob)?SPOOL_BLOB:0);
+	if (null) {
+		fieldlength=0;
+	}
+
+	if (!writeFieldHeader(flags,fieldlength) ||
+		(fieldlength &&
+			pvt->_file.write((const void *)field,fieldlength)!=
+						(ssize_t)fieldlength)) {
+		return false;
+	}
+
+	pvt->_size+=fieldlength;
+	return true;
+}
+
+bool sqlrspool::writeFieldHeader(unsigned char flags, uint64_t length) {
+	if (pvt->_file.write(&flags,1)!=1 ||
+		pvt->_file.write((const void *)&length,
+				sizeof(uint64_t))!=sizeof(uint64_t)) {
+		return false;
+	}
+	pvt->_size+=1+sizeof(uint64_t);
+	return true;
+}
+
+void sqlrspool::endRow() {
+	pvt->_rowcount++;
+}
+
+bool sqlrspool::beginLobField() {
+	pvt->_lobstart=pvt->_size;
+	pvt->_loblength=0;
+	return writeFieldHeader(SPOOL_BLOB,0);
+}
+
+bool sqlrspool::writeLobSegment(const char *segment, uint64_t length) {
+	if (pvt->_file.write((const void *)segment,length)!=(ssize_t)length) {
+		return false;
+	}
+	pvt->_size+=length;
+	pvt->_loblength+=length;
+	return true;
+}
+
+bool sqlrspool::endLobField(bool null) {
+
+	// go back and fill in the placeholder flags and length,
+	// then carry on writing at the end of the file
+	unsigned char	flags=SPOOL_BLOB|((null)?SPOOL_NULL:0);
+	uint64_t	length=(null)?0:pvt->_loblength;
+	uint64_t	size=pvt->_size;
+	if (!pvt->_file.flushWriteBuffer(-1,-1) ||
+		pvt->_file.setPositionRelativeToBeginning(pvt->_lobstart)!=
+						(int64_t)pvt->_lobstart ||
+		!writeFieldHeader(flags,length) ||
+		!pvt->_file.flushWriteBuffer(-1,-1) ||
+		pvt->_file.setPositionRelativeToBeginning(size)!=
+							(int64_t)size) {
+		return false;
+	}
+	pvt->_size=size;
+	return true;
+}
+
+bool sqlrspool::finishWriting() {
+
+	if (!pvt->_file.flushWriteBuffer(-1,-1) ||
+			pvt->_file.setPositionRelativeToBeginning(0)!=0) {
+		return false;
+	}
+
+	if (!pvt->_readbuffer) {
+		pvt->_readbuffer=new unsigned char[SPOOLBUFFERSIZE];
+	}
+	pvt->_readpos=0;
+	pvt->_readlen=0;
+	pvt->_filepos=0;
+	pvt->_rowsread=0;
+	pvt->_active=true;
+	return true;
+}
+
+bool sqlrspool::readBytes(void *buffer, uint64_t size) {
+
+	unsigned char	*dest=(unsigned char *)buffer;
+
+	while (size) {
+
+		if (pvt->_readpos==pvt->_readlen) {
+
+			// read large fields straight into place
+			// rather than through the buffer
+			ssize_t	result;
+			if (size>=SPOOLBUFFERSIZE) {
+				result=pvt->_file.read((void *)dest,size);
+				if (result<=0) {
+					return false;
+				}
+				pvt->_filepos+=result;
+				dest+=result;
+				size-=result;
+				continue;
+			}
+
+			result=pvt->_file.read((void *)pvt->_readbuffer,
+							SPOOLBUFFERSIZE);
+			if (result<=0) {
+				return false;
+			}
+			pvt->_filepos+=result;
+			pvt->_readpos=0;
+			pvt->_readlen=result;
+		}
+
+		uint64_t	available=pvt->_readlen-pvt->_readpos;
+		if (available>size) {
+			available=size;
+		}
+		bytestring::copy(dest,pvt->_readbuffer+pvt->_readpos,available);
+		pvt->_readpos+=available;
+		dest+=available;
+		size-=available;
+	}
+	return true;
+}
+
+bool sqlrspool::skipBytes(uint64_t size) {
+
+	// skip whatever is left in the buffer,
+	// then seek past the rest
+	uint64_t	available=pvt->_readlen-pvt->_readpos;
+	if (size<=available) {
+		pvt->_readpos+=size;
+		return true;
+	}
+	size-=available;
+	pvt->_readpos=0;
+	pvt->_readlen=0;
+	pvt->_filepos+=size;
+	return (pvt->_file.setPositionRelativeToBeginning(pvt->_filepos)==
+						(int64_t)pvt->_filepos);
+}
+
+bool sqlrspool::readRow(uint32_t colcount,
+				const char **fields,
+				uint64_t *fieldlengths,
+				bool *blobs,
+				bool *nulls,
+				bool *error) {
+
+	*error=false;
+
+	if (!pvt->_active || pvt->_rowsread==pvt->_rowcount) {
+		return false;
+	}
+
+	if (colcount>pvt->_offsetcount) {
+		delete[] pvt->_offsets;
+		delete[] pvt->_loboffsets;
+		delete[] pvt->_loblengths;
+		pvt->_offsets=new uint64_t[colcount];
+		pvt->_loboffsets=new uint64_t[colcount];
+		pvt->_loblengths=new uint64_t[colcount];
+		pvt->_offsetcount=colcount;
+	}
+
+	// read the fields into the row buffer, one after the other,
+	// terminating each of them the way connection modules do
+	uint64_t	used=0;
+	for (uint32_t i=0; i<colcount; i++) {
+
+		unsigned char	flags;
+		uint64_t	length;
+		if (!readBytes(&flags,1) ||
+				!readBytes(&length,sizeof(uint64_t))) {
+			*error=true;
+			return false;
+		}
+
+		// leave lobs in the file, just remember where they are
+		pvt->_loboffsets[i]=0;
+		pvt->_loblengths[i]=0;
+		if (flags&SPOOL_BLOB) {
+			pvt->_loboffsets[i]=pvt->_filepos-
+						pvt->_readlen+pvt->_readpos;
+			pvt->_loblengths[i]=length;
+			if (!skipBytes(length)) {
+				*error=true;
+				return false;
+			}
+			length=0;
+		}
+
+		if (used+length+1>pvt->_rowsize) {
+			uint64_t	newsize=(used+length+1)*2;
+			char		*newrow=new char[newsize];
+			if (used) {
+				bytestring::copy(newrow,pvt->_row,used);
+			}
+			delete[] pvt->_row;
+			pvt->_row=newrow;
+			pvt->_rowsize=newsize;
+		}
+
+		if (length && !readBytes(pvt->_row+used,length)) {
+			*error=true;
+			return false;
+		}
+		pvt->_row[used+length]='\0';
+
+		pvt->_offsets[i]=used;
+		fieldlengths[i]=length;
+		blobs[i]=(flags&SPOOL_BLOB);
+		nulls[i]=(flags&SPOOL_NULL);
+		used+=length+1;
+	}
+
+	// the row buffer might have moved while it was being filled,
+	// so point the fields into it once it's complete
+	for (uint32_t i=0; i<colcount; i++) {
+		fields[i]=pvt->_row+pvt->_offsets[i];
+	}
+
+	pvt->_rowsread++;
+	return true;
+}
+
+uint64_t sqlrspool::getLobLength(uint32_t col) {
+	return (col<pvt->_offsetcount)?pvt->_loblengths[col]:0;
+}
+
+bool sqlrspool::readLobSegment(uint32_t col,
+				char *buffer,
+				uint64_t length,
+				uint64_t offset,
+				uint64_t *bytesread) {
+
+	*bytesread=0;
+
+	uint64_t	loblength=getLobLength(col);
+	if (offset>=loblength) {
+		return true;
+	}
+	if (length>loblength-offset) {
+		length=loblength-offset;
+	}
+
+	// read the segment straight from the file, then put the file position
+	// back where it was, so the next row is read from the right place
+	uint64_t	pos=pvt->_loboffsets[col]+offset;
+	if (pvt->_file.setPositionRelativeToBeginning(pos)!=(int64_t)pos) {
+		return false;
+	}
+	while (*bytesread<length) {
+		ssize_t	result=pvt->_file.read((void *)(buffer+*bytesread),
+							length-*bytesread);
+		if (result<=0) {
+			break;
+		}
+		*bytesread+=result;
+	}
+	return (*bytesread==length &&
+		pvt->_file.setPositionRelativeToBeginning(pvt->_filepos)==
+						(int64_t)pvt->_filepos);
+}
+
+uint64_t sqlrspool::getNewBufferBytes() {
+
+	// the row buffer, the per-column offsets, the read buffer,
+	// and the file's write buffer, which are never shrunk
+	uint64_t	total=pvt->_rowsize+
+				pvt->_offsetcount*3*sizeof(uint64_t)+
+				((pvt->_readbuffer)?2*SPOOLBUFFERSIZE:0);
+	uint64_t	grown=total-pvt->_bufferbytes;
+	pvt->_bufferbytes=total;
+	return grown;
+}
+
+bool sqlrspool::isActive() {
+	return pvt->_active;
+}
+
+uint64_t sqlrspool::getRowCount() {
+	return pvt->_rowcount;
+}
+
+uint64_t sqlrspool::getSize() {
+	return pvt->_size;
+}
@@ -158,6 +158,7 @@ class SQLRUTIL_DLLSPEC sqlrconfig {
 
 		virtual const char	*getEndOfSession()=0;
 		virtual bool		getEndOfSessionCommit()=0;
+		virtual bool		getSessionQueriesOnlyIfDirty()=0;
 		virtual uint32_t	getSessionTimeout()=0;
 
 		virtual const char	*getRunAsUser()=0;
@@ -175,6 +176,10 @@ class SQLRUTIL_DLLSPEC sqlrconfig {
 
 		virtual const char	*getHandoff()=0;
 
+		virtual const char	*getPooling()=0;
+		virtual uint32_t	getPoolingIdleTimeout()=0;
+		virtual const char	*getAffinity()=0;
+
 		virtual const char	*getAllowedIps()=0;
 		virtual const char	*getDeniedIps()=0;
 
@@ -214,6 +219,8 @@ class SQLRUTIL_DLLSPEC sqlrconfig {
 		virtual int32_t		getIdleClientTimeout()=0;
 
 		virtual int64_t		getMaxListeners()=0;
+		virtual uint32_t	getProxyThreads()=0;
+		virtual uint32_t	getAcceptors()=0;
 		virtual uint32_t	getListenerTimeout()=0;
 
 		virtual bool		getReLoginAtStart()=0;
@@ -234,6 +241,15 @@ class SQLRUTIL_DLLSPEC sqlrconfig {
 
 		virtual bool		getWaitForDownDatabase()=0;
 
+		virtual bool		getFingerprintStats()=0;
+
+		virtual uint64_t	getSpoolRows()=0;
+		virtual uint64_t	getSpoolBytes()=0;
+		virtual uint32_t	getSpoolTimeout()=0;
+
+		virtual uint64_t	getMemorySoftLimit()=0;
+		virtual uint64_t	getMemoryHardLimit()=0;
+
 		virtual const char	*getPasswordPath()=0;
 
 		virtual linkedlist< char *>	*getSessionStartQueries()=0;
@@ -287,4 +303,35 @@ class SQLRUTIL_DLLSPEC sqlrconfigs {
 		dynamiclib	*dl;
 };
 
+class SQLRUTIL_DLLSPEC sqlriplist {
+	public:
+			sqlriplist();
+			~sqlriplist();
+		bool		add(const char *pattern);
+		bool		addList(const char *patterns);
+		void		clear();
+		uint64_t	getCount();
+		bool		match(const char *address);
+		bool		match(const unsigned char *address,
+						uint16_t addresslength);
+
+		static bool	parseAddress(const char *address,
+						unsigned char *buffer,
+						uint16_t *addresslength);
+	private:
+		bool		addWildcard(const char *pattern);
+		bool		addPrefix(const unsigned char *address,
+						uint16_t addresslength,
+						uint16_t prefixlength);
+		uint32_t	newNode();
+
+		uint32_t	*children;
+		unsigned char	*terminal;
+		uint32_t	nodecount;
+		uint32_t	nodecapacity;
+		uint32_t	root4;
+		uint32_t	root6;
+		uint64_t	count;
+};
+
 #endif
@@ -0,0 +1,465 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+
+#include <sqlrelay/sqlrutil.h>
+
+#include <rudiments/charstring.h>
+#include <rudiments/character.h>
+#include <rudiments/bytestring.h>
+
+// Wildcard patterns like *.168.1.1 or 192.168.*.0-50 that don't reduce to a
+// small number of prefixes are rejected rather than expanded into a huge
+// number of them.
+#define MAXWILDCARDPREFIXES 65536
+
+// The list is a binary trie over the bits of the address.  Nodes are kept in
+// arrays and refer to each other by index, with index 0 meaning "none".  A
+// terminal node means that every address below it is in the list.
+
+sqlriplist::sqlriplist() {
+	children=NULL;
+	terminal=NULL;
+	nodecount=0;
+	nodecapacity=0;
+	count=0;
+	newNode();
+	root4=newNode();
+	root6=newNode();
+}
+
+sqlriplist::~sqlriplist() {
+	delete[] children;
+	delete[] terminal;
+}
+
+bool sqlriplist::addList(const char *patterns) {
+
+	// patterns may be separated by commas and/or whitespace
+	const char	*ptr=patterns;
+	while (ptr && *ptr) {
+
+		while (*ptr==',' || character::isWhitespace(*ptr)) {
+			ptr++;
+		}
+		const char	*end=ptr;
+		while (*end && *end!=',' && !character::isWhitespace(*end)) {
+			end++;
+		}
+		if (end==ptr) {
+			break;
+		}
+
+		char	*pattern=charstring::duplicate(ptr,end-ptr);
+		bool	result=add(pattern);
+		delete[] pattern;
+		if (!result) {
+			return false;
+		}
+
+		ptr=end;
+	}
+	return (count>0);
+}
+
+bool sqlriplist::add(const char *pattern) {
+
+	// everything
+	if (!charstring::compare(pattern,"*")) {
+		unsigned char	any[16];
+		bytestring::zero(any,sizeof(any));
+		return addPrefix(any,4,0) && addPrefix(any,16,0);
+	}
+
+	unsigned char	address[16];
+	uint16_t	addresslength;
+
+	// CIDR notation
+	const char	*slash=charstring::findFirst(pattern,'/');
+	if (slash) {
+		if (!charstring::isNumber(slash+1)) {
+			return false;
+		}
+		char	*addr=charstring::duplicate(pattern,slash-pattern);
+		bool	result=parseAddress(addr,address,&addresslength);
+		delete[] addr;
+		uint64_t	prefixlength=
+				charstring::toUnsignedInteger(slash+1);
+		if (!result || prefixlength>(uint64_t)addresslength*8) {
+			return false;
+		}
+		return addPrefix(address,addresslength,prefixlength);
+	}
+
+	// individual addresses
+	if (parseAddress(pattern,address,&addresslength)) {
+		return addPrefix(address,addresslength,addresslength*8);
+	}
+
+	// wildcards and ranges
+	return addWildcard(pattern);
+}
+
+bool sqlriplist::addWildcard(const char *pattern) {
+
+	// Each octet may be a number, a dash-separated range of numbers, or a
+	// * meaning "all possible values".  A trailing * also matches all of
+	// the octets after it, so 192.168.* is the same as 192.168.*.*
+	uint16_t	lo[4];
+	uint16_t	hi[4];
+	uint16_t	octets=0;
+	bool		more=false;
+	const char	*ptr=pattern;
+	while (octets<4) {
+
+		const char	*dot=charstring::findFirstOrEnd(ptr,'.');
+		char		*chunk=charstring::duplicate(ptr,dot-ptr);
+		char		*dash=charstring::findFirst(chunk,'-');
+		bool		valid=true;
+		if (!charstring::compare(chunk,"*")) {
+			lo[octets]=0;
+			hi[octets]=255;
+			if (!*dot) {
+				// fill in the rest
+				for (uint16_t i=octets+1; i<4; i++) {
+					lo[i]=0;
+					hi[i]=255;
+				}
+				octets=4;
+				more=false;
+				delete[] chunk;
+				break;
+			}
+		} else if (dash) {
+			*dash='\0';
+			valid=(charstring::isNumber(chunk) &&
+					charstring::isNumber(dash+1));
+			lo[octets]=charstring::toUnsignedInteger(chunk);
+			hi[octets]=charstring::toUnsignedInteger(dash+1);
+		} else {
+			valid=charstring::isNumber(chunk);
+			lo[octets]=charstring::toUnsignedInteger(chunk);
+			hi[octets]=lo[octets];
+		}
+		delete[] chunk;
+
+		if (!valid || lo[octets]>hi[octets] || hi[octets]>255) {
+			return false;
+		}
+
+		octets++;
+		more=(*dot!='\0');
+		if (!more) {
+			break;
+		}
+		ptr=dot+1;
+	}
+	if (octets!=4 || more) {
+		return false;
+	}
+
+	// Find the last octet that isn't "all possible values".  Everything
+	// after it is covered by the prefix length.  Everything before it has
+	// to be enumerated.
+	int16_t	last=3;
+	while (last>=0 && !lo[last] && hi[last]==255) {
+		last--;
+	}
+	if (last<0) {
+		unsigned char	any[4]={0,0,0,0};
+		return addPrefix(any,4,0);
+	}
+
+	// don't add an unreasonable number of prefixes
+	uint64_t	combinations=1;
+	for (int16_t i=0; i<last; i++) {
+		combinations=combinations*(hi[i]-lo[i]+1);
+	}
+	if (combinations*8>MAXWILDCARDPREFIXES) {
+		return false;
+	}
+
+	unsigned char	address[4]={0,0,0,0};
+	for (int16_t i=0; i<last; i++) {
+		address[i]=lo[i];
+	}
+	for (;;) {
+
+		// cover the range of the last octet with as few
+		// power-of-two-aligned blocks as possible
+		uint16_t	value=lo[last];
+		while (value<=hi[last]) {
+			uint16_t	bits=0;
+			while (bits<8 &&
+				!(value&((1<<(bits+1))-1)) &&
+				value+(1<<(bits+1))-1<=hi[last]) {
+				bits++;
+			}
+			address[last]=value;
+			if (!addPrefix(address,4,last*8+(8-bits))) {
+				return false;
+			}
+			value=value+(1<<bits);
+		}
+
+		// next combination of the preceding octets
+		int16_t	i=last-1;
+		while (i>=0 && address[i]==hi[i]) {
+			address[i]=lo[i];
+			i--;
+		}
+		if (i<0) {
+			break;
+		}
+		address[i]++;
+	}
+	return true;
+}
+
+bool sqlriplist::addPrefix(const unsigned char *address,
+					uint16_t addresslength,
+					uint16_t prefixlength) {
+
+	uint32_t	node=(addresslength==4)?root4:root6;
+	for (uint16_t bit=0; bit<prefixlength; bit++) {
+
+		// a shorter prefix already covers this one
+		if (terminal[node]) {
+			count++;
+			return true;
+		}
+
+		uint16_t	b=(address[bit/8]>>(7-bit%8))&1;
+		uint32_t	child=children[2*node+b];
+		if (!child) {
+			child=newNode();
+			children[2*node+b]=child;
+		}
+		node=child;
+	}
+	terminal[node]=1;
+	count++;
+	return true;
+}
+
+uint32_t sqlriplist::newNode() {
+	if (nodecount==nodecapacity) {
+		uint32_t	newcapacity=(nodecapacity)?nodecapacity*2:64;
+		uint32_t	*newchildren=new uint32_t[newcapacity*2];
+		unsigned char	*newterminal=new unsigned char[newcapacity];
+		if (nodecount) {
+			bytestring::copy(newchildren,children,
+					nodecount*2*sizeof(uint32_t));
+			bytestring::copy(newterminal,terminal,nodecount);
+		}
+		delete[] children;
+		delete[] terminal;
+		children=newchildren;
+		terminal=newterminal;
+		nodecapacity=newcapacity;
+	}
+	children[2*nodecount]=0;
+	children[2*nodecount+1]=0;
+	terminal[nodecount]=0;
+	return nodecount++;
+}
+
+void sqlriplist::clear() {
+	nodecount=0;
+	count=0;
+	newNode();
+	root4=newNode();
+	root6=newNode();
+}
+
+uint64_t sqlriplist::getCount() {
+	return count;
+}
+
+bool sqlriplist::match(const char *address) {
+	unsigned char	buffer[16];
+	uint16_t	addresslength;
+	return parseAddress(address,buffer,&addresslength) &&
+			match(buffer,addresslength);
+}
+
+bool sqlriplist::match(const unsigned char *address, uint16_t addresslength) {
+
+	// match IPv4-mapped IPv6 addresses (::ffff:a.b.c.d) against IPv4
+	if (addresslength==16 &&
+		!address[0] && !address[1] && !address[2] && !address[3] &&
+		!address[4] && !address[5] && !address[6] && !address[7] &&
+		!address[8] && !address[9] &&
+		address[10]==0xff && address[11]==0xff) {
+		address=address+12;
+		addresslength=4;
+	} else if (addresslength!=4 && addresslength!=16) {
+		return false;
+	}
+
+	uint32_t	node=(addresslength==4)?root4:root6;
+	uint16_t	bits=addresslength*8;
+	for (uint16_t bit=0; bit<bits; bit++) {
+		if (terminal[node]) {
+			return true;
+		}
+		node=children[2*node+((address[bit/8]>>(7-bit%8))&1)];
+		if (!node) {
+			return false;
+		}
+	}
+	return terminal[node];
+}
+
+static bool parseIPv4(const char *address, const char *end,
+						unsigned char *buffer) {
+	uint16_t	octets=0;
+	const char	*ptr=address;
+	while (octets<4) {
+		uint16_t	value=0;
+		uint16_t	digits=0;
+		while (ptr<end && character::isDigit(*ptr) && digits<3) {
+			value=value*10+(*ptr-'0');
+			ptr++;
+			digits++;
+		}
+		if (!digits || value>255) {
+			return false;
+		}
+		buffer[octets++]=value;
+		if (octets<4) {
+			if (ptr>=end || *ptr!='.') {
+				return false;
+			}
+			ptr++;
+		}
+	}
+	return (ptr==end);
+}
+
+static int16_t hexValue(char c) {
+	if (c>='0' && c<='9') {
+		return c-'0';
+	}
+	if (c>='a' && c<='f') {
+		return c-'a'+10;
+	}
+	if (c>='A' && c<='F') {
+		return c-'A'+10;
+	}
+	return -1;
+}
+
+bool sqlriplist::parseAddress(const char *address,
+					unsigned char *buffer,
+					uint16_t *addresslength) {
+
+	if (charstring::isNullOrEmpty(address)) {
+		return false;
+	}
+
+	// ignore IPv6 zone ids (eg. fe80::1%eth0)
+	const char	*end=charstring::findFirstOrEnd(address,'%');
+
+	// IPv4
+	if (!charstring::findFirst(address,':')) {
+		*addresslength=4;
+		return parseIPv4(address,end,buffer);
+	}
+
+	// IPv6
+	uint16_t	groups[8];
+	int16_t		groupcount=0;
+	int16_t		gap=-1;
+	const char	*ptr=address;
+	if (*ptr==':') {
+		if (*(ptr+1)!=':') {
+			return false;
+		}
+		gap=0;
+		ptr=ptr+2;
+	}
+	while (ptr<end) {
+
+		// find the end of this group
+		const char	*groupend=ptr;
+		bool		dotted=false;
+		while (groupend<end && *groupend!=':') {
+			if (*groupend=='.') {
+				dotted=true;
+			}
+			groupend++;
+		}
+
+		// an embedded IPv4 address must come last
+		if (dotted) {
+			unsigned char	v4[4];
+			if (groupend!=end || groupcount>6 ||
+					!parseIPv4(ptr,end,v4)) {
+				return false;
+			}
+			groups[groupcount++]=(v4[0]<<8)|v4[1];
+			groups[groupcount++]=(v4[2]<<8)|v4[3];
+			ptr=end;
+			break;
+		}
+
+		// 1 to 4 hex digits
+		if (groupend==ptr || groupend-ptr>4 || groupcount==8) {
+			return false;
+		}
+		uint16_t	value=0;
+		for (const char *c=ptr; c<groupend; c++) {
+			int16_t	h=hexValue(*c);
+			if (h<0) {
+				return false;
+			}
+			value=(value<<4)|h;
+		}
+		groups[groupcount++]=value;
+
+		// a single colon separates groups, a double colon
+		// stands in for one or more groups of zeros
+		ptr=groupend;
+		if (ptr<end) {
+			if (ptr+1<end && *(ptr+1)==':') {
+				if (gap!=-1) {
+					return false;
+				}
+				gap=groupcount;
+				ptr=ptr+2;
+			} else {
+				ptr++;
+				if (ptr==end) {
+					return false;
+				}
+			}
+		}
+	}
+	if ((gap==-1 && groupcount!=8) || (gap!=-1 && groupcount>7)) {
+		return false;
+	}
+
+	// expand the gap
+	uint16_t	expanded[8];
+	int16_t		missing=8-groupcount;
+	int16_t		out=0;
+	for (int16_t i=0; i<groupcount; i++) {
+		if (i==gap) {
+			for (int16_t j=0; j<missing; j++) {
+				expanded[out++]=0;
+			}
+		}
+		expanded[out++]=groups[i];
+	}
+	if (gap==groupcount) {
+		for (int16_t j=0; j<missing; j++) {
+			expanded[out++]=0;
+		}
+	}
+	for (int16_t i=0; i<8; i++) {
+		buffer[i*2]=expanded[i]>>8;
+		buffer[i*2+1]=expanded[i]&0xff;
+	}
+	*addresslength=16;
+	return true;
+}
@@ -0,0 +1,107 @@
+-- Statements for sqlr-parsebench, separated by blank lines.  They're
+-- typical of what applications, ORMs, and administrative tools send.
+SELECT c_discount, c_last, c_credit, w_tax FROM customer, warehouse WHERE w_id = ? AND c_w_id = w_id AND c_d_id = ? AND c_id = ?
+
+UPDATE district SET d_next_o_id = d_next_o_id + 1 WHERE d_id = ? AND d_w_id = ?
+
+INSERT INTO orders (o_id, o_d_id, o_w_id, o_c_id, o_entry_d, o_ol_cnt, o_all_local) VALUES (?, ?, ?, ?, ?, ?, ?)
+
+SELECT i_price, i_name, i_data FROM item WHERE i_id = ?
+
+SELECT s_quantity, s_data, s_dist_01, s_dist_02, s_dist_03, s_dist_04, s_dist_05, s_dist_06, s_dist_07, s_dist_08, s_dist_09, s_dist_10 FROM stock WHERE s_i_id = ? AND s_w_id = ? FOR UPDATE
+
+INSERT INTO order_line (ol_o_id, ol_d_id, ol_w_id, ol_number, ol_i_id, ol_supply_w_id, ol_quantity, ol_amount, ol_dist_info) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+
+SELECT count(c_id) FROM customer WHERE c_last = ? AND c_d_id = ? AND c_w_id = ?
+
+SELECT o_id, o_carrier_id, o_entry_d FROM orders WHERE o_w_id = ? AND o_d_id = ? AND o_c_id = ? ORDER BY o_id DESC
+
+DELETE FROM new_order WHERE no_o_id = ? AND no_d_id = ? AND no_w_id = ?
+
+SELECT COUNT(DISTINCT (s_i_id)) AS stock_count FROM order_line, stock WHERE ol_w_id = ? AND ol_d_id = ? AND ol_o_id < ? AND ol_o_id >= ? AND s_w_id = ? AND s_i_id = ol_i_id AND s_quantity < ?
+
+select "user"."id" as "user_id", "user"."email" as "user_email", "user"."created_at" as "user_created_at" from "user" "user" where "user"."email" = $1 limit 1
+
+select `posts`.* from `posts` inner join `post_tag` on `posts`.`id` = `post_tag`.`post_id` where `post_tag`.`tag_id` in (?, ?, ?) and `posts`.`deleted_at` is null order by `posts`.`created_at` desc limit 20 offset 40
+
+SELECT t0.ID, t0.NAME, t0.STATUS, t1.ID, t1.TOTAL FROM APP.ACCOUNT t0 LEFT OUTER JOIN APP.INVOICE t1 ON (t1.ACCOUNT_ID = t0.ID) WHERE ((t0.STATUS = :status) AND (t1.TOTAL > :minimum))
+
+insert into audit_log (user_id, action, detail, created) values (:1, :2, :3, sysdate)
+
+UPDATE users SET last_login = NOW(), login_count = login_count + 1 WHERE id = @id
+
+with recent as (
+  select customer_id, sum(amount) as total
+  from payments
+  where paid_at > current_date - interval '30 days'
+  group by customer_id
+)
+select c.name, r.total
+from customers c
+join recent r on r.customer_id = c.id
+where r.total > 1000
+order by r.total desc
+
+INSERT INTO archive.events SELECT * FROM events WHERE created < '2020-01-01'
+
+insert into tags (name) values ('red'), ('green'), ('blue'), ('it''s'), ('a,b')
+
+SELECT /*+ INDEX(e emp_dept_ix) */ e.last_name, d.department_name FROM employees e, departments d WHERE e.department_id = d.department_id AND d.location_id = 1700
+
+-- fetch the next page
+SELECT * FROM (SELECT a.*, ROWNUM rnum FROM (SELECT id, title FROM articles ORDER BY published DESC) a WHERE ROWNUM <= 40) WHERE rnum > 20
+
+select nextval('orders_id_seq')
+
+select version()
+
+SELECT 1
+
+begin
+
+commit
+
+rollback
+
+START TRANSACTION
+
+SET NAMES utf8mb4
+
+set autocommit=0
+
+CREATE TABLE IF NOT EXISTS session_data (id varchar(64) NOT NULL PRIMARY KEY, data text, expires bigint NOT NULL)
+
+CREATE INDEX idx_session_expires ON session_data (expires)
+
+ALTER TABLE accounts ADD COLUMN last_seen timestamp NULL
+
+DROP TABLE IF EXISTS tmp_import
+
+TRUNCATE TABLE staging_rows
+
+BEGIN
+  update_balances(:account, :amount);
+  INSERT INTO ledger (account, amount) VALUES (:account, :amount);
+END;
+
+exec sp_who2
+
+SELECT TABLE_NAME, COLUMN_NAME, DATA_TYPE, IS_NULLABLE FROM INFORMATION_SCHEMA.COLUMNS WHERE TABLE_SCHEMA = 'public' ORDER BY TABLE_NAME, ORDINAL_POSITION
+
+select extract(year from o.created) as yr, count(*) from orders o group by extract(year from o.created) having count(*) > 100
+
+MERGE INTO inventory i USING shipments s ON (i.item_id = s.item_id) WHEN MATCHED THEN UPDATE SET i.qty = i.qty + s.qty WHEN NOT MATCHED THEN INSERT (item_id, qty) VALUES (s.item_id, s.qty)
+
+select p.id, p.price * 1.0825 as price_with_tax, 0x1F as flags, 1.5e-3 as eps from products p where p.sku like 'AB-%' and p.price between 10 and 99.95
+
+INSERT INTO counters (name, value) VALUES ('hits', 1) ON DUPLICATE KEY UPDATE value = value + 1
+
+UPDATE inventory SET qty = qty - 1 WHERE id = 42 RETURNING qty
+
+SELECT u.id, u.name FROM users u WHERE EXISTS (SELECT 1 FROM orders o WHERE o.user_id = u.id AND o.total > 500) AND u.id NOT IN (SELECT user_id FROM banned)
+
+select a.id from a union all select b.id from b union select c.id from c
+
+DELETE FROM sessions WHERE expires < ? -- expired sessions
+
+select data::jsonb ->> 'name' as name from documents where data @> '{"type": "invoice"}'::jsonb
@@ -8,8 +8,31 @@ extern "C" {
 	#include <sqlite3.h>
 }
 
+#include <rudiments/thread.h>
+#include <rudiments/semaphoreset.h>
+#include <rudiments/permissions.h>
+
 #include "sqlrbench.h"
 
+// When the "readers" parameter is set, each select is run concurrently by
+// that many threads, each on its own read-only handle.  The threads are
+// started once, at connect time, and are woken up for each select so that
+// thread creation isn't part of the measurement.  The reported
+// queries-per-second measure rounds of concurrent selects and aggregate
+// read throughput is queries-per-second times the number of readers.  Use
+// with journalmode=wal to measure reads that proceed alongside a writer.
+
+struct sqlitebenchreader {
+	uint16_t	index;
+	uint16_t	done;
+	sqlite3		*sqlitecon;
+	semaphoreset	*semset;
+	const char	*query;
+	bool		getcolumns;
+	bool		result;
+	bool		quit;
+};
+
 class sqlitebench : public sqlrbench {
 	public:
 		sqlitebench(const char *connectstring,
@@ -33,9 +56,20 @@ class sqlitebenchconnection : public sqlrbenchconnection {
 		bool	disconnect();
 
 	private:
+		sqlite3	*open(bool readonly);
+
 		const char	*dbase;
+		const char	*journalmode;
+		const char	*mmapsize;
+		bool		sharedcache;
+		int32_t		busytimeout;
+		uint16_t	readers;
 
-		sqlite3		*sqlitecon;
+		sqlite3			*sqlitecon;
+		thread			*readerthreads;
+		sqlitebenchreader	*readerdata;
+		semaphoreset		*readersemset;
+		uint16_t		readerthreadcount;
 };
 
 class sqlitebenchcursor : public sqlrbenchcursor {
@@ -47,10 +81,15 @@ class sqlitebenchcursor : public sqlrbenchcursor {
 		bool	close();
 
 	private:
+		bool	concurrentQuery(const char *query, bool getcolumns);
+
 		sqlitebenchconnection	*sbcon;
-		sqlite3_stmt		*sqlitestmt;
 };
 
+static bool runQuery(sqlite3 *sqlitecon,
+				const char *query, bool getcolumns);
+static void readerThread(sqlitebenchreader *reader);
+
 sqlitebench::sqlitebench(const char *connectstring,
 					const char *db,
 					uint64_t queries,
@@ -73,14 +112,128 @@ sqlitebenchconnection::sqlitebenchconnection(
 				const char *db) :
 				sqlrbenchconnection(connectstring,db) {
 	dbase=getParam("db");
+	journalmode=getParam("journalmode");
+	mmapsize=getParam("mmapsize");
+	sharedcache=charstring::isYes(getParam("sharedcache"));
+	busytimeout=charstring::toInteger(getParam("busytimeout"));
+	readers=charstring::toInteger(getParam("readers"));
+	sqlitecon=NULL;
+	readerthreads=NULL;
+	readerdata=NULL;
+	readersemset=NULL;
+	readerthreadcount=0;
 }
 
 bool sqlitebenchconnection::connect() {
-	return (sqlite3_open(dbase,&sqlitecon)==SQLITE_OK);
+
+	// the main handle creates and populates the table, so it
+	// must always be read-write
+	sqlitecon=open(false);
+	if (!sqlitecon) {
+		return false;
+	}
+
+	if (!readers) {
+		return true;
+	}
+
+	// semaphore i wakes up reader i, the last one counts finished readers
+	int32_t	*vals=new int32_t[readers+1];
+	bytestring::zero(vals,sizeof(int32_t)*(readers+1));
+	readersemset=new semaphoreset();
+	bool	created=readersemset->create(0,permissions::ownerReadWrite(),
+							readers+1,vals);
+	delete[] vals;
+	if (!created) {
+		disconnect();
+		return false;
+	}
+
+	// open a handle for each reader and start its thread
+	readerthreads=new thread[readers];
+	readerdata=new sqlitebenchreader[readers];
+	for (uint16_t i=0; i<readers; i++) {
+		readerdata[i].index=i;
+		readerdata[i].done=readers;
+		readerdata[i].sqlitecon=open(true);
+		readerdata[i].semset=readersemset;
+		readerdata[i].query=NULL;
+		readerdata[i].getcolumns=false;
+		readerdata[i].result=false;
+		readerdata[i].quit=false;
+		if (!readerdata[i].sqlitecon ||
+			!readerthreads[i].spawn(
+				(void*(*)(void*))readerThread,
+				(void *)&readerdata[i],false)) {
+
+			// stop the readers that were already started, and
+			// release the semaphores and the main handle too
+			sqlite3_close(readerdata[i].sqlitecon);
+			disconnect();
+			return false;
+		}
+		readerthreadcount++;
+	}
+	return true;
+}
+
+sqlite3 *sqlitebenchconnection::open(bool readonly) {
+
+	int	flags=(readonly)?SQLITE_OPEN_READONLY:
+				(SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE);
+	if (sharedcache) {
+		flags|=SQLITE_OPEN_SHAREDCACHE;
+	}
+
+	sqlite3	*con=NULL;
+	if (sqlite3_open_v2(dbase,&con,flags,NULL)!=SQLITE_OK) {
+		sqlite3_close(con);
+		return NULL;
+	}
+
+	if (busytimeout>0) {
+		sqlite3_busy_timeout(con,busytimeout);
+	}
+
+	stringbuffer	pragma;
+	if (!charstring::isNullOrEmpty(journalmode) && !readonly) {
+		pragma.append("pragma journal_mode=");
+		pragma.append(journalmode)->append(';');
+	}
+	if (!charstring::isNullOrEmpty(mmapsize)) {
+		pragma.append("pragma mmap_size=");
+		pragma.append(mmapsize)->append(';');
+	}
+	if (pragma.getSize() &&
+		sqlite3_exec(con,pragma.getString(),
+				NULL,NULL,NULL)!=SQLITE_OK) {
+		sqlite3_close(con);
+		return NULL;
+	}
+	return con;
 }
 
 bool sqlitebenchconnection::disconnect() {
+
+	// tell the reader threads to exit and wait for them
+	for (uint16_t i=0; i<readerthreadcount; i++) {
+		readerdata[i].quit=true;
+		readersemset->signal(i);
+	}
+	for (uint16_t i=0; i<readerthreadcount; i++) {
+		readerthreads[i].wait(NULL);
+		sqlite3_close(readerdata[i].sqlitecon);
+	}
+	readerthreadcount=0;
+	delete[] readerdata;
+	readerdata=NULL;
+	delete[] readerthreads;
+	readerthreads=NULL;
+	delete readersemset;
+	readersemset=NULL;
+
 	sqlite3_close(sqlitecon);
+	sqlitecon=NULL;
 	return true;
 }
 
@@ -94,10 +247,59 @@ bool sqlitebenchcursor::open() {
 }
 
 bool sqlitebenchcursor::query(const char *query, bool getcolumns) {
+	if (sbcon->readers &&
+		!charstring::compareIgnoringCase(query,"select",6)) {
+		return concurrentQuery(query,getcolumns);
+	}
+	return runQuery(sbcon->sqlitecon,query,getcolumns);
+}
+
+bool sqlitebenchcursor::concurrentQuery(const char *query, bool getcolumns) {
+
+	uint16_t		readers=sbcon->readerthreadcount;
+	sqlitebenchreader	*rd=sbcon->readerdata;
+	semaphoreset		*semset=sbcon->readersemset;
+
+	// wake up each reader thread to run the query simultaneously
+	for (uint16_t i=0; i<readers; i++) {
+		rd[i].query=query;
+		rd[i].getcolumns=getcolumns;
+		rd[i].result=false;
+		semset->signal(i);
+	}
+
+	// wait for them all to finish
+	for (uint16_t i=0; i<readers; i++) {
+		semset->wait(readers);
+	}
+
+	bool	retval=true;
+	for (uint16_t i=0; i<readers; i++) {
+		if (!rd[i].result) {
+			retval=false;
+		}
+	}
+	return retval;
+}
+
+static void readerThread(sqlitebenchreader *reader) {
+	for (;;) {
+		reader->semset->wait(reader->index);
+		if (reader->quit) {
+			break;
+		}
+		reader->result=runQuery(reader->sqlitecon,
+					reader->query,reader->getcolumns);
+		reader->semset->signal(reader->done);
+	}
+}
+
+static bool runQuery(sqlite3 *sqlitecon, const char *query, bool getcolumns) {
 
-	bool	retval=false;
+	bool		retval=false;
+	sqlite3_stmt	*sqlitestmt=NULL;
 
-	if (sqlite3_prepare_v2(sbcon->sqlitecon,
+	if (sqlite3_prepare_v2(sqlitecon,
 					query,
 					charstring::length(query),
 					&sqlitestmt,
@@ -0,0 +1,256 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+#include <rudiments/commandline.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+#include <rudiments/charstring.h>
+
+#include <sqlrelay/sqlrserver.h>
+
+// Compares static fetchatonce values against adaptive fetch batches over a
+// range of row widths.
+//
+// The database is modeled rather than run, so the matrix is repeatable and
+// doesn't depend on which databases are available: each round trip costs a
+// fixed latency, plus a fixed cost per row, plus a cost per byte.  The
+// adaptive policy is driven by the same sqlrfetchbatch class that the
+// connection modules use, fed the modeled time of each batch.
+//
+// With -check, it instead checks how sqlrfetchbatch sizes batches against
+// known timings and exits non-zero if any check fails.
+
+struct model {
+	uint64_t	rows;
+	uint64_t	latencynsec;
+	uint64_t	rownsec;
+	uint64_t	bytensec;
+};
+
+struct result {
+	uint64_t	roundtrips;
+	uint64_t	nsec;
+	uint64_t	peakbytes;
+};
+
+static uint64_t batchTime(model *m, uint64_t rows, uint64_t rowbytes) {
+	return m->latencynsec+rows*(m->rownsec+rowbytes*m->bytensec);
+}
+
+static void runStatic(model *m, uint64_t rowbytes,
+				uint32_t fetchatonce, result *r) {
+	r->roundtrips=0;
+	r->nsec=0;
+	r->peakbytes=0;
+	uint64_t	remaining=m->rows;
+	for (;;) {
+		uint64_t	rows=(remaining<fetchatonce)?
+						remaining:fetchatonce;
+		r->roundtrips++;
+		r->nsec+=batchTime(m,rows,rowbytes);
+		if (rows*rowbytes>r->peakbytes) {
+			r->peakbytes=rows*rowbytes;
+		}
+		remaining-=rows;
+		if (rows<fetchatonce) {
+			break;
+		}
+	}
+}
+
+static void runAdaptive(model *m, uint64_t rowbytes,
+				uint32_t fetchatonce, uint64_t batchbytes,
+				result *r) {
+	r->roundtrips=0;
+	r->nsec=0;
+	r->peakbytes=0;
+
+	sqlrfetchbatch	fb;
+	fb.setMaxRows(fetchatonce);
+	fb.setMaxBytes(batchbytes);
+	fb.reset();
+
+	uint64_t	remaining=m->rows;
+	for (;;) {
+		uint32_t	batch=fb.getRows();
+		uint64_t	rows=(remaining<batch)?remaining:batch;
+		uint64_t	nsec=batchTime(m,rows,rowbytes);
+		r->roundtrips++;
+		r->nsec+=nsec;
+		if (rows*rowbytes>r->peakbytes) {
+			r->peakbytes=rows*rowbytes;
+		}
+		remaining-=rows;
+		fb.fetched(rows,nsec);
+		for (uint64_t i=0; i<rows; i++) {
+			fb.countRow(rowbytes);
+		}
+		if (rows<batch) {
+			break;
+		}
+	}
+}
+
+static bool checkRows(const char *what, sqlrfetchbatch *fb, uint32_t rows) {
+	bool	success=(fb->getRows()==rows);
+	stdoutput.printf("  %-40s %s",what,(success)?"success":"failure");
+	if (!success) {
+		stdoutput.printf(" (%d!=%d)",fb->getRows(),rows);
+	}
+	stdoutput.printf("\n");
+	return success;
+}
+
+static void countRows(sqlrfetchbatch *fb, uint32_t rows, uint64_t rowbytes) {
+	for (uint32_t i=0; i<rows; i++) {
+		fb->countRow(rowbytes);
+	}
+}
+
+static bool check() {
+
+	bool		success=true;
+	sqlrfetchbatch	fb;
+
+	stdoutput.printf("growth:\n");
+	fb.setMaxRows(1000);
+	fb.setMaxBytes(0);
+	fb.reset();
+	success&=checkRows("starts small",&fb,10);
+	fb.fetched(10,1000000);
+	success&=checkRows("doubles after the first batch",&fb,20);
+	fb.fetched(20,1100000);
+	success&=checkRows("doubles while rows get cheaper",&fb,40);
+	fb.fetched(40,1200000);
+	success&=checkRows("doubles while rows get cheaper",&fb,80);
+	fb.fetched(80,2400000);
+	success&=checkRows("stops when rows stop getting cheaper",&fb,80);
+	fb.fetched(80,800000);
+	success&=checkRows("stays stopped",&fb,80);
+
+	stdoutput.printf("short final batch:\n");
+	fb.fetched(15,100);
+	success&=checkRows("is ignored",&fb,80);
+	fb.fetched(0,100);
+	success&=checkRows("is ignored when empty",&fb,80);
+	fb.reset();
+	success&=checkRows("reset starts over",&fb,10);
+
+	stdoutput.printf("row cap:\n");
+	fb.setMaxRows(30);
+	fb.reset();
+	fb.fetched(10,1000000);
+	fb.fetched(20,1100000);
+	success&=checkRows("never exceeds fetchatonce",&fb,30);
+	fb.setMaxRows(5);
+	fb.reset();
+	success&=checkRows("starts at fetchatonce if smaller",&fb,5);
+
+	stdoutput.printf("byte cap:\n");
+	fb.setMaxRows(1000);
+	fb.setMaxBytes(10000);
+	fb.reset();
+	countRows(&fb,10,500);
+	fb.fetched(10,1000000);
+	success&=checkRows("grows up to the byte limit",&fb,20);
+	countRows(&fb,20,500);
+	fb.fetched(20,1000000);
+	success&=checkRows("is held to the byte limit",&fb,20);
+	fb.setMaxBytes(100);
+	fb.reset();
+	countRows(&fb,10,500);
+	fb.fetched(10,1000000);
+	success&=checkRows("fetches at least one wide row",&fb,1);
+
+	stdoutput.printf("%s\n",(success)?"success":"failure");
+	return success;
+}
+
+static void report(const char *name, result *r) {
+	stdoutput.printf("  %-16s %10lld trips  %10.3f ms  %10.1f KB peak\n",
+				name,(long long)r->roundtrips,
+				(double)r->nsec/1000000.0,
+				(double)r->peakbytes/1024.0);
+}
+
+int main(int argc, const char **argv) {
+
+	commandline	cmdl(argc,argv);
+
+	model		m;
+	m.rows=100000;
+	m.latencynsec=200000;
+	m.rownsec=200;
+	m.bytensec=1;
+	uint32_t	fetchatonce=1000;
+	uint64_t	batchbytes=1048576;
+
+	if (cmdl.found("rows")) {
+		m.rows=charstring::toUnsignedInteger(cmdl.getValue("rows"));
+	}
+	if (cmdl.found("latency")) {
+		m.latencynsec=charstring::toUnsignedInteger(
+					cmdl.getValue("latency"))*1000;
+	}
+	if (cmdl.found("rowcost")) {
+		m.rownsec=charstring::toUnsignedInteger(
+					cmdl.getValue("rowcost"));
+	}
+	if (cmdl.found("bytecost")) {
+		m.bytensec=charstring::toUnsignedInteger(
+					cmdl.getValue("bytecost"));
+	}
+	if (cmdl.found("fetchatonce")) {
+		fetchatonce=charstring::toUnsignedInteger(
+					cmdl.getValue("fetchatonce"));
+	}
+	if (cmdl.found("fetchbatchbytes")) {
+		batchbytes=charstring::toUnsignedInteger(
+					cmdl.getValue("fetchbatchbytes"));
+	}
+	if (cmdl.found("check")) {
+		process::exit((check())?0:1);
+	}
+	if (cmdl.found("help","h") || !m.rows || !fetchatonce) {
+		stdoutput.printf(
+			"usage: sqlr-fetchbench \\\n"
+			"	[-check] \\\n"
+			"	[-rows count] \\\n"
+			"	[-latency usec-per-round-trip] \\\n"
+			"	[-rowcost nsec-per-row] \\\n"
+			"	[-bytecost nsec-per-byte] \\\n"
+			"	[-fetchatonce rows] \\\n"
+			"	[-fetchbatchbytes bytes]\n");
+		process::exit(1);
+	}
+
+	stdoutput.printf("%lld rows, %lld usec latency, %lld nsec/row, "
+				"%lld nsec/byte\n"
+				"adaptive: fetchatonce=%d, "
+				"fetchbatchbytes=%lld\n",
+				(long long)m.rows,
+				(long long)(m.latencynsec/1000),
+				(long long)m.rownsec,
+				(long long)m.bytensec,
+				fetchatonce,(long long)batchbytes);
+
+	static const uint64_t	widths[]={16,128,1024,8192,65536,0};
+	static const uint32_t	statics[]={10,100,1000,0};
+
+	for (const uint64_t *w=widths; *w; w++) {
+
+		stdoutput.printf("\n%lld byte rows\n",(long long)*w);
+
+		result	r;
+		char	name[32];
+		for (const uint32_t *s=statics; *s; s++) {
+			charstring::printf(name,sizeof(name),
+						"fetchatonce=%d",*s);
+			runStatic(&m,*w,*s,&r);
+			report(name,&r);
+		}
+		runAdaptive(&m,*w,fetchatonce,batchbytes,&r);
+		report("adaptive",&r);
+	}
+
+	process::exit(0);
+}
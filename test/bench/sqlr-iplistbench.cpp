@@ -0,0 +1,227 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+#include <rudiments/commandline.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+#include <rudiments/charstring.h>
+#include <rudiments/stringbuffer.h>
+#include <rudiments/regularexpression.h>
+#include <rudiments/randomnumber.h>
+#include <rudiments/datetime.h>
+
+#include <sqlrelay/sqlrutil.h>
+
+// Compares the prefix list used for allowedips/deniedips and the clientiplist
+// router against the regular expression and pattern-by-pattern matching that
+// were used before.
+//
+// The list contains a mix of individual addresses and /24 blocks, as those
+// can be expressed in all three forms.
+
+static randomnumber	rnd;
+
+static uint32_t randomOctet() {
+	int32_t	result;
+	rnd.generateScaledNumber(0,255,&result);
+	return result;
+}
+
+static float elapsed(datetime *start) {
+	datetime	end;
+	end.getSystemDateAndTime();
+	uint32_t	sec=end.getEpoch()-start->getEpoch();
+	int32_t		usec=end.getMicroseconds()-start->getMicroseconds();
+	if (usec<0) {
+		sec--;
+		usec=usec+1000000;
+	}
+	return (float)sec+(((float)usec)/1000000.0);
+}
+
+static void report(const char *name, float sec,
+				uint64_t lookups, uint64_t matches) {
+	stdoutput.printf("%-24s %10.3f sec  %12.1f ns/lookup  %lld matches\n",
+				name,sec,sec*1000000000.0/(float)lookups,
+				(long long)matches);
+}
+
+// what the clientiplist router did for each entry in its list
+static bool legacyMatch(const char *ip, const char *pattern, bool block) {
+	return (block)?!charstring::compare(ip,pattern,
+						charstring::length(pattern)):
+			!charstring::compare(ip,pattern);
+}
+
+int main(int argc, const char **argv) {
+
+	commandline	cmdl(argc,argv);
+
+	uint64_t	entries=10000;
+	uint64_t	lookups=100000;
+	bool		regex=true;
+	bool		legacy=true;
+
+	if (cmdl.found("entries")) {
+		entries=charstring::toUnsignedInteger(cmdl.getValue("entries"));
+	}
+	if (cmdl.found("lookups")) {
+		lookups=charstring::toUnsignedInteger(cmdl.getValue("lookups"));
+	}
+	if (cmdl.found("noregex")) {
+		regex=false;
+	}
+	if (cmdl.found("nolegacy")) {
+		legacy=false;
+	}
+	if (cmdl.found("help","h") || !entries || !lookups) {
+		stdoutput.printf(
+			"usage: sqlr-iplistbench \\\n"
+			"	[-entries list-entries] \\\n"
+			"	[-lookups lookup-count] \\\n"
+			"	[-noregex] \\\n"
+			"	[-nolegacy]\n");
+		process::exit(1);
+	}
+
+	// use the same list and addresses every time
+	rnd.setSeed(1);
+
+	// build the list in each form
+	stdoutput.printf("building %lld-entry lists...\n",(long long)entries);
+	char		**patterns=new char *[entries];
+	bool		*blocks=new bool[entries];
+	sqlriplist	iplist;
+	stringbuffer	re;
+	for (uint64_t i=0; i<entries; i++) {
+
+		uint32_t	a=randomOctet();
+		uint32_t	b=randomOctet();
+		uint32_t	c=randomOctet();
+		uint32_t	d=randomOctet();
+		blocks[i]=(i%2==0);
+
+		stringbuffer	cidr;
+		if (i) {
+			re.append('|');
+		}
+		if (blocks[i]) {
+			cidr.append(a)->append('.')->append(b)->append('.');
+			cidr.append(c)->append(".0/24");
+			charstring::printf(&patterns[i],"%d.%d.%d.",a,b,c);
+			re.append("^")->append(a)->append("\\.");
+			re.append(b)->append("\\.")->append(c)->append("\\.");
+		} else {
+			cidr.append(a)->append('.')->append(b)->append('.');
+			cidr.append(c)->append('.')->append(d);
+			charstring::printf(&patterns[i],"%d.%d.%d.%d",a,b,c,d);
+			re.append("^")->append(a)->append("\\.");
+			re.append(b)->append("\\.")->append(c)->append("\\.");
+			re.append(d)->append("$");
+		}
+		iplist.add(cidr.getString());
+	}
+
+	// Generate the addresses to look up.  About half of them are taken
+	// from the list, so there is a mix of hits and misses.
+	char		**addresses=new char *[lookups];
+	unsigned char	*binary=new unsigned char[lookups*4];
+	for (uint64_t i=0; i<lookups; i++) {
+		uint32_t	a;
+		uint32_t	b;
+		uint32_t	c;
+		uint32_t	d=randomOctet();
+		if (i%2==0) {
+			int32_t	index;
+			rnd.generateScaledNumber(0,entries-1,&index);
+			const char	*ptr=patterns[index];
+			a=charstring::toUnsignedInteger(ptr);
+			ptr=charstring::findFirst(ptr,'.')+1;
+			b=charstring::toUnsignedInteger(ptr);
+			ptr=charstring::findFirst(ptr,'.')+1;
+			c=charstring::toUnsignedInteger(ptr);
+			if (!blocks[index]) {
+				ptr=charstring::findFirst(ptr,'.')+1;
+				d=charstring::toUnsignedInteger(ptr);
+			}
+		} else {
+			a=randomOctet();
+			b=randomOctet();
+			c=randomOctet();
+		}
+		charstring::printf(&addresses[i],"%d.%d.%d.%d",a,b,c,d);
+		binary[i*4]=a;
+		binary[i*4+1]=b;
+		binary[i*4+2]=c;
+		binary[i*4+3]=d;
+	}
+
+	stdoutput.printf("running %lld lookups...\n\n",(long long)lookups);
+
+	// prefix list, binary addresses (as used by the listener)
+	datetime	start;
+	start.getSystemDateAndTime();
+	uint64_t	matches=0;
+	for (uint64_t i=0; i<lookups; i++) {
+		if (iplist.match(&binary[i*4],4)) {
+			matches++;
+		}
+	}
+	report("prefix list (binary)",elapsed(&start),lookups,matches);
+
+	// prefix list, string addresses (as used by the router)
+	start.getSystemDateAndTime();
+	matches=0;
+	for (uint64_t i=0; i<lookups; i++) {
+		if (iplist.match(addresses[i])) {
+			matches++;
+		}
+	}
+	report("prefix list (string)",elapsed(&start),lookups,matches);
+
+	// one big regular expression (as allowedips/deniedips were)
+	if (regex) {
+		regularexpression	r;
+		start.getSystemDateAndTime();
+		r.compile(re.getString());
+		r.study();
+		report("regex compile",elapsed(&start),1,0);
+		start.getSystemDateAndTime();
+		matches=0;
+		for (uint64_t i=0; i<lookups; i++) {
+			if (r.match(addresses[i])) {
+				matches++;
+			}
+		}
+		report("regex",elapsed(&start),lookups,matches);
+	}
+
+	// pattern by pattern (as the clientiplist router was)
+	if (legacy) {
+		start.getSystemDateAndTime();
+		matches=0;
+		for (uint64_t i=0; i<lookups; i++) {
+			for (uint64_t j=0; j<entries; j++) {
+				if (legacyMatch(addresses[i],
+						patterns[j],blocks[j])) {
+					matches++;
+					break;
+				}
+			}
+		}
+		report("pattern by pattern",elapsed(&start),lookups,matches);
+	}
+
+	// clean up
+	for (uint64_t i=0; i<entries; i++) {
+		delete[] patterns[i];
+	}
+	delete[] patterns;
+	delete[] blocks;
+	for (uint64_t i=0; i<lookups; i++) {
+		delete[] addresses[i];
+	}
+	delete[] addresses;
+	delete[] binary;
+
+	process::exit(0);
+}
@@ -0,0 +1,229 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+#include <rudiments/commandline.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+#include <rudiments/charstring.h>
+#include <rudiments/character.h>
+#include <rudiments/file.h>
+#include <rudiments/datetime.h>
+
+#include <sqlrelay/sqlrserver.h>
+
+// Compares tokenizing each query once with sqlrparsedquery against the
+// prefix compares and word scans that the server and its modules did
+// before, each of which scanned the raw query text on its own.
+//
+// The corpus contains one statement per block, with blocks separated by
+// blank lines.
+
+static float elapsed(datetime *start) {
+	datetime	end;
+	end.getSystemDateAndTime();
+	uint32_t	sec=end.getEpoch()-start->getEpoch();
+	int32_t		usec=end.getMicroseconds()-start->getMicroseconds();
+	if (usec<0) {
+		sec--;
+		usec=usec+1000000;
+	}
+	return (float)sec+(((float)usec)/1000000.0);
+}
+
+static void report(const char *name, float sec,
+				uint64_t statements, uint64_t bytes,
+				uint64_t reads) {
+	stdoutput.printf("%-24s %10.3f sec  %10.1f ns/stmt  %8.1f MB/s  "
+				"%lld reads\n",
+				name,sec,sec*1000000000.0/(float)statements,
+				(float)bytes/(sec*1024.0*1024.0),
+				(long long)reads);
+}
+
+// what sqlrservercontroller::skipWhitespaceAndComments() does
+static const char *legacySkip(const char *query) {
+	const char	*ptr=query;
+	while (*ptr) {
+		if (character::isWhitespace(*ptr)) {
+			ptr++;
+		} else if (!charstring::compare(ptr,"--",2)) {
+			while (*ptr && *ptr!='\n') {
+				ptr++;
+			}
+			if (*ptr) {
+				ptr++;
+			}
+		} else {
+			return ptr;
+		}
+	}
+	return ptr;
+}
+
+// what the readwrite router does without a parsed query
+static bool legacyContainsWord(const char *query, const char *word) {
+	size_t	wordlen=charstring::length(word);
+	char	quote='\0';
+	for (const char *c=query; *c; c++) {
+		if (quote) {
+			if (*c==quote) {
+				quote='\0';
+			}
+			continue;
+		}
+		if (*c=='\'' || *c=='"' || *c=='`') {
+			quote=*c;
+			continue;
+		}
+		if (c>query && (character::isAlphanumeric(*(c-1)) ||
+							*(c-1)=='_')) {
+			continue;
+		}
+		if (!charstring::compareIgnoringCase(c,word,wordlen) &&
+				!character::isAlphanumeric(*(c+wordlen)) &&
+				*(c+wordlen)!='_') {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool legacyIsRead(const char *query) {
+	const char	*ptr=legacySkip(query);
+	if (charstring::compareIgnoringCase(ptr,"select",6) ||
+				!character::isWhitespace(ptr[6])) {
+		return false;
+	}
+	return (!legacyContainsWord(query,"into") &&
+			!legacyContainsWord(query,"for"));
+}
+
+int main(int argc, const char **argv) {
+
+	commandline	cmdl(argc,argv);
+
+	const char	*corpus="parsecorpus.sql";
+	uint64_t	iterations=10000;
+
+	if (cmdl.found("corpus")) {
+		corpus=cmdl.getValue("corpus");
+	}
+	if (cmdl.found("iterations")) {
+		iterations=charstring::toUnsignedInteger(
+					cmdl.getValue("iterations"));
+	}
+	if (cmdl.found("help","h") || !iterations) {
+		stdoutput.printf(
+			"usage: sqlr-parsebench \\\n"
+			"	[-corpus file] \\\n"
+			"	[-iterations count] \\\n"
+			"	[-verbose]\n");
+		process::exit(1);
+	}
+
+	// read the corpus and split it into statements
+	char	*contents=file::getContents(corpus);
+	if (!contents) {
+		stderror.printf("failed to read %s\n",corpus);
+		process::exit(1);
+	}
+	uint64_t	statementcount=0;
+	for (char *ptr=contents; ptr; ptr=charstring::findFirst(ptr,"\n\n")) {
+		while (*ptr=='\n') {
+			ptr++;
+		}
+		if (*ptr) {
+			statementcount++;
+		}
+	}
+	char		**statements=new char *[statementcount];
+	uint32_t	*lengths=new uint32_t[statementcount];
+	uint64_t	bytes=0;
+	uint64_t	s=0;
+	char		*ptr=contents;
+	while (s<statementcount) {
+		while (*ptr=='\n') {
+			ptr++;
+		}
+		char	*end=charstring::findFirst(ptr,"\n\n");
+		if (end) {
+			*end='\0';
+		}
+		statements[s]=ptr;
+		lengths[s]=charstring::length(ptr);
+		bytes+=lengths[s];
+		s++;
+		if (end) {
+			ptr=end+1;
+		}
+	}
+
+	stdoutput.printf("%lld statements, %lld bytes, %lld iterations\n\n",
+				(long long)statementcount,(long long)bytes,
+				(long long)iterations);
+
+	// tokenize once, then answer the same questions from the tokens
+	sqlrparsedquery	pq;
+	datetime	start;
+	start.getSystemDateAndTime();
+	uint64_t	reads=0;
+	uint64_t	tokens=0;
+	for (uint64_t i=0; i<iterations; i++) {
+		for (uint64_t j=0; j<statementcount; j++) {
+			pq.parse(statements[j],lengths[j]);
+			tokens+=pq.getTokenCount();
+			if (pq.getQueryType()==SQLRQUERYTYPE_SELECT &&
+					!pq.hasKeyword(SQLRKEYWORD_FOR) &&
+					!pq.hasKeyword(SQLRKEYWORD_INSERT) &&
+					!pq.hasKeyword(SQLRKEYWORD_UPDATE) &&
+					!pq.hasKeyword(SQLRKEYWORD_DELETE)) {
+				reads++;
+			}
+		}
+	}
+	report("parsed query",elapsed(&start),
+			statementcount*iterations,bytes*iterations,reads);
+
+	// re-scan the text for each question
+	start.getSystemDateAndTime();
+	reads=0;
+	for (uint64_t i=0; i<iterations; i++) {
+		for (uint64_t j=0; j<statementcount; j++) {
+			if (legacyIsRead(statements[j])) {
+				reads++;
+			}
+		}
+	}
+	report("prefix and word scans",elapsed(&start),
+			statementcount*iterations,bytes*iterations,reads);
+
+	stdoutput.printf("\n%lld tokens per pass\n",
+				(long long)(tokens/iterations));
+
+	// show how each statement was classified
+	if (cmdl.found("verbose")) {
+		stdoutput.printf("\n");
+		for (uint64_t j=0; j<statementcount; j++) {
+			pq.parse(statements[j],lengths[j]);
+			stdoutput.printf("type %d, %d tokens, %d binds, tables:",
+						pq.getQueryType(),
+						pq.getTokenCount(),
+						pq.getBindCount());
+			for (uint32_t k=0; k<pq.getTableCount(); k++) {
+				const sqlrtoken	*t=pq.getTable(k);
+				stdoutput.write(' ');
+				stdoutput.write(t->text,t->length);
+			}
+			stdoutput.printf("\n	");
+			stdoutput.safePrint(statements[j],
+					(lengths[j]<60)?lengths[j]:60);
+			stdoutput.printf("\n");
+		}
+	}
+
+	// clean up
+	delete[] statements;
+	delete[] lengths;
+	delete[] contents;
+
+	process::exit(0);
+}
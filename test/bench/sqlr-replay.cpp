@@ -0,0 +1,722 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/commandline.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+#include <rudiments/file.h>
+#include <rudiments/charstring.h>
+#include <rudiments/character.h>
+#include <rudiments/stringbuffer.h>
+#include <rudiments/linkedlist.h>
+#include <rudiments/dictionary.h>
+#include <rudiments/thread.h>
+#include <rudiments/datetime.h>
+#include <rudiments/snooze.h>
+
+// Replays query logs written by the "sql" and "custom_nw" loggers against an
+// SQL Relay instance and reports latency percentiles as JSON.
+//
+// The custom_nw log records the time that each query finished and how long it
+// took, so queries are replayed with their original inter-arrival times, or a
+// multiple thereof.  Queries are grouped into sessions by the connection that
+// ran them.
+//
+// The sql log doesn't record times, so each file is replayed as one session
+// (or more, if the connection's pid changed), with each query sent as soon as
+// the previous one finishes.
+//
+// By default, the tool connects to the sqlitetest instance defined in
+// test/sqlrelay.conf.d/sqlite.conf, so it can be run against a local SQLite
+// backend without a real database.
+
+enum statementclass {
+	CLASS_SELECT=0,
+	CLASS_INSERT,
+	CLASS_UPDATE,
+	CLASS_DELETE,
+	CLASS_TRANSACTION,
+	CLASS_DDL,
+	CLASS_OTHER,
+	CLASS_COUNT
+};
+
+static const char	*classnames[]={
+	"select",
+	"insert",
+	"update",
+	"delete",
+	"transaction",
+	"ddl",
+	"other"
+};
+
+struct statement {
+	uint64_t	offset;
+	char		*query;
+	uint16_t	cls;
+	char		**bindnames;
+	char		**bindvalues;
+	uint16_t	bindcount;
+};
+
+class samples {
+	public:
+			samples();
+			~samples();
+		void	add(uint64_t value);
+		void	append(samples *s);
+		void	sort();
+		uint64_t	percentile(uint16_t p);
+		uint64_t	getCount();
+	private:
+		uint64_t	*values;
+		uint64_t	count;
+		uint64_t	size;
+};
+
+samples::samples() {
+	values=NULL;
+	count=0;
+	size=0;
+}
+
+samples::~samples() {
+	delete[] values;
+}
+
+void samples::add(uint64_t value) {
+	if (count==size) {
+		size=(size)?size*2:1024;
+		uint64_t	*newvalues=new uint64_t[size];
+		for (uint64_t i=0; i<count; i++) {
+			newvalues[i]=values[i];
+		}
+		delete[] values;
+		values=newvalues;
+	}
+	values[count++]=value;
+}
+
+void samples::append(samples *s) {
+	for (uint64_t i=0; i<s->count; i++) {
+		add(s->values[i]);
+	}
+}
+
+void samples::sort() {
+	// shell sort, there are only as many values as there were statements
+	for (uint64_t gap=count/2; gap>0; gap=gap/2) {
+		for (uint64_t i=gap; i<count; i++) {
+			uint64_t	v=values[i];
+			uint64_t	j=i;
+			for (; j>=gap && values[j-gap]>v; j=j-gap) {
+				values[j]=values[j-gap];
+			}
+			values[j]=v;
+		}
+	}
+}
+
+uint64_t samples::percentile(uint16_t p) {
+	if (!count) {
+		return 0;
+	}
+	uint64_t	index=(count*p)/100;
+	return values[(index<count)?index:count-1];
+}
+
+uint64_t samples::getCount() {
+	return count;
+}
+
+// sessions, in the order that they first appeared in the trace
+class sessionset {
+	public:
+			~sessionset();
+		linkedlist< statement * >	*getSession(const char *key);
+		linkedlist< linkedlist< statement * > * >	*getSessions();
+	private:
+		dictionary< char *, linkedlist< statement * > *>	bykey;
+		linkedlist< linkedlist< statement * > * >	inorder;
+		linkedlist< char * >				keys;
+};
+
+sessionset::~sessionset() {
+	for (linkedlistnode< linkedlist< statement * > * >
+				*node=inorder.getFirst();
+				node; node=node->getNext()) {
+		delete node->getValue();
+	}
+	bykey.clear();
+	for (linkedlistnode< char * > *node=keys.getFirst();
+					node; node=node->getNext()) {
+		delete[] node->getValue();
+	}
+}
+
+linkedlist< statement * > *sessionset::getSession(const char *key) {
+	linkedlist< statement * >	*session=NULL;
+	if (!bykey.getValue((char *)key,&session)) {
+		session=new linkedlist< statement * >;
+		char	*k=charstring::duplicate(key);
+		bykey.setValue(k,session);
+		keys.append(k);
+		inorder.append(session);
+	}
+	return session;
+}
+
+linkedlist< linkedlist< statement * > * > *sessionset::getSessions() {
+	return &inorder;
+}
+
+struct worker {
+	thread				thr;
+	uint64_t			id;
+	linkedlist< statement * >	statements;
+	samples				latency[CLASS_COUNT];
+	uint64_t			errors[CLASS_COUNT];
+	samples				handoffwait;
+	bool				connectfailed;
+};
+
+static const char	*host="localhost";
+static uint16_t		port=9000;
+static const char	*sock="/tmp/test.socket";
+static const char	*user="test";
+static const char	*password="test";
+static double		speed=1.0;
+static uint64_t		rsbs=0;
+static bool		debug=false;
+static datetime		start;
+
+static uint64_t microsecondsSince(datetime *dt) {
+	datetime	now;
+	now.getSystemDateAndTime();
+	int64_t	sec=now.getEpoch()-dt->getEpoch();
+	int64_t	usec=(int64_t)now.getMicroseconds()-
+				(int64_t)dt->getMicroseconds();
+	return (uint64_t)(sec*1000000+usec);
+}
+
+static uint16_t classify(const char *query) {
+	while (character::isWhitespace(*query) || *query=='(') {
+		query++;
+	}
+	if (!charstring::compareIgnoringCase(query,"select",6) ||
+		!charstring::compareIgnoringCase(query,"with",4)) {
+		return CLASS_SELECT;
+	}
+	if (!charstring::compareIgnoringCase(query,"insert",6)) {
+		return CLASS_INSERT;
+	}
+	if (!charstring::compareIgnoringCase(query,"update",6)) {
+		return CLASS_UPDATE;
+	}
+	if (!charstring::compareIgnoringCase(query,"delete",6)) {
+		return CLASS_DELETE;
+	}
+	if (!charstring::compareIgnoringCase(query,"begin",5) ||
+		!charstring::compareIgnoringCase(query,"commit",6) ||
+		!charstring::compareIgnoringCase(query,"rollback",8) ||
+		!charstring::compareIgnoringCase(query,"start transaction",17)) {
+		return CLASS_TRANSACTION;
+	}
+	if (!charstring::compareIgnoringCase(query,"create",6) ||
+		!charstring::compareIgnoringCase(query,"drop",4) ||
+		!charstring::compareIgnoringCase(query,"alter",5) ||
+		!charstring::compareIgnoringCase(query,"truncate",8)) {
+		return CLASS_DDL;
+	}
+	return CLASS_OTHER;
+}
+
+static statement *newStatement(const char *query, uint64_t offset) {
+	statement	*st=new statement;
+	st->offset=offset;
+	st->query=charstring::duplicate(query);
+	st->cls=classify(query);
+	st->bindnames=NULL;
+	st->bindvalues=NULL;
+	st->bindcount=0;
+	return st;
+}
+
+static void deleteStatement(statement *st) {
+	delete[] st->query;
+	for (uint16_t i=0; i<st->bindcount; i++) {
+		delete[] st->bindnames[i];
+		delete[] st->bindvalues[i];
+	}
+	delete[] st->bindnames;
+	delete[] st->bindvalues;
+	delete st;
+}
+
+// splits a custom_nw line into fields, undoing the logger's escaping
+static uint16_t splitCustomNwLine(const char *line,
+				stringbuffer *fields, uint16_t maxfields) {
+	uint16_t	field=0;
+	for (const char *c=line; *c && field<maxfields; c++) {
+		if (*c=='\\' && *(c+1)) {
+			c++;
+			if (*c=='n') {
+				fields[field].append('\n');
+			} else if (*c=='r') {
+				fields[field].append('\r');
+			} else {
+				fields[field].append(*c);
+			}
+		} else if (*c=='|') {
+			field++;
+		} else {
+			fields[field].append(*c);
+		}
+	}
+	return field;
+}
+
+// parses "[name => 'value'][name => NULL][name => 1.5]..."
+static void parseBinds(statement *st, const char *binds) {
+
+	uint16_t	count=0;
+	for (const char *c=binds; *c; c++) {
+		if (*c=='[') {
+			count++;
+		}
+	}
+	if (!count) {
+		return;
+	}
+	st->bindnames=new char *[count];
+	st->bindvalues=new char *[count];
+
+	const char	*c=binds;
+	while (st->bindcount<count && (c=charstring::findFirst(c,'['))) {
+
+		c++;
+		const char	*arrow=charstring::findFirst(c," => ");
+		if (!arrow) {
+			break;
+		}
+
+		// the client api doesn't want the delimiter
+		const char	*name=c;
+		if (*name==':' || *name=='@' || *name=='$' || *name=='?') {
+			name++;
+		}
+		const char	*value=arrow+4;
+		const char	*end;
+		char		*val;
+		if (*value=='\'') {
+			value++;
+			end=charstring::findFirst(value,"']");
+			if (!end) {
+				break;
+			}
+			val=charstring::duplicate(value,end-value);
+		} else {
+			end=charstring::findFirst(value,']');
+			if (!end) {
+				break;
+			}
+			val=(!charstring::compare(value,"NULL]",5))?
+					NULL:charstring::duplicate(value,
+								end-value);
+		}
+		st->bindnames[st->bindcount]=
+				charstring::duplicate(name,arrow-name);
+		st->bindvalues[st->bindcount]=val;
+		st->bindcount++;
+		c=end;
+	}
+}
+
+// converts a y-m-d h:m:s timestamp to seconds since 1970
+static int64_t toEpoch(const char *ts) {
+	int64_t	y=charstring::toInteger(ts);
+	int64_t	m=charstring::toInteger(ts+5);
+	int64_t	d=charstring::toInteger(ts+8);
+	int64_t	hh=charstring::toInteger(ts+11);
+	int64_t	mm=charstring::toInteger(ts+14);
+	int64_t	ss=charstring::toInteger(ts+17);
+	y=y-(m<=2);
+	int64_t	era=((y>=0)?y:y-399)/400;
+	int64_t	yoe=y-era*400;
+	int64_t	doy=(153*(m+((m>2)?-3:9))+2)/5+d-1;
+	int64_t	doe=yoe*365+yoe/4-yoe/100+doy;
+	int64_t	days=era*146097+doe-719468;
+	return days*86400+hh*3600+mm*60+ss;
+}
+
+static bool isCustomNwLine(const char *line) {
+	return (charstring::length(line)>20 &&
+		character::isDigit(line[0]) && line[4]=='-' &&
+		line[7]=='-' && line[10]==' ' && line[13]==':' &&
+		line[16]==':' && line[19]=='|');
+}
+
+static void loadCustomNw(const char *contents,
+			sessionset *sessions, int64_t *firstusec) {
+
+	const char	*line=contents;
+	while (*line) {
+
+		const char	*eol=charstring::findFirstOrEnd(line,'\n');
+		char		*l=charstring::duplicate(line,eol-line);
+		line=(*eol)?eol+1:eol;
+
+		if (!isCustomNwLine(l)) {
+			delete[] l;
+			continue;
+		}
+
+		// date|connection|time|error|rows|clientinfo|query|
+		// time|clientaddr|binds|
+		stringbuffer	fields[10];
+		if (splitCustomNwLine(l,fields,10)<7) {
+			delete[] l;
+			continue;
+		}
+
+		// custom_nw logs when the query finished,
+		// back up to when it started
+		int64_t	usec=toEpoch(fields[0].getString())*1000000-
+			(int64_t)(charstring::toFloat(
+					fields[2].getString())*1000000.0);
+		if (*firstusec<0 || usec<*firstusec) {
+			*firstusec=usec;
+		}
+
+		statement	*st=newStatement(fields[6].getString(),usec);
+		parseBinds(st,fields[9].getString());
+
+		sessions->getSession(fields[1].getString())->append(st);
+
+		delete[] l;
+	}
+}
+
+static void loadSql(const char *filename, const char *contents,
+			sessionset *sessions) {
+
+	char		*key=NULL;
+	charstring::printf(&key,"%s",filename);
+	linkedlist< statement * >	*session=NULL;
+	stringbuffer	query;
+
+	const char	*line=contents;
+	while (*line) {
+
+		const char	*eol=charstring::findFirstOrEnd(line,'\n');
+		char		*l=charstring::duplicate(line,eol-line);
+		line=(*eol)?eol+1:eol;
+
+		// a new pid means a new session
+		if (!charstring::compare(l,"-- pid changed to ",18)) {
+			delete[] key;
+			charstring::printf(&key,"%s:%s",filename,l+18);
+			session=NULL;
+			query.clear();
+			delete[] l;
+			continue;
+		}
+		if (!charstring::compare(l,"-- ",3) && !query.getSize()) {
+			delete[] l;
+			continue;
+		}
+
+		// queries may span lines and end with a semicolon
+		if (query.getSize()) {
+			query.append('\n');
+		}
+		query.append(l);
+		size_t	len=charstring::length(l);
+		delete[] l;
+		if (!len || query.getString()[query.getSize()-1]!=';') {
+			continue;
+		}
+		query.truncate(query.getSize()-1);
+
+		if (!session) {
+			session=sessions->getSession(key);
+		}
+		session->append(newStatement(query.getString(),0));
+		query.clear();
+	}
+	delete[] key;
+}
+
+static void replay(worker *w) {
+
+	sqlrconnection	sqlrcon(host,port,sock,user,password,0,1);
+	sqlrcursor	sqlrcur(&sqlrcon);
+	if (rsbs) {
+		sqlrcur.setResultSetBufferSize(rsbs);
+	}
+
+	// the first round trip includes connecting to the
+	// listener and waiting to be handed off to a connection
+	datetime	before;
+	before.getSystemDateAndTime();
+	if (!sqlrcon.ping()) {
+		w->connectfailed=true;
+		if (debug) {
+			stderror.printf("%lld: %s\n",
+					(long long)w->id,sqlrcon.errorMessage());
+		}
+		return;
+	}
+	w->handoffwait.add(microsecondsSince(&before));
+
+	for (linkedlistnode< statement * > *node=w->statements.getFirst();
+						node; node=node->getNext()) {
+
+		statement	*st=node->getValue();
+
+		// wait until it's time to run the query
+		if (speed>0) {
+			uint64_t	due=(uint64_t)((double)st->offset/speed);
+			uint64_t	now=microsecondsSince(&start);
+			if (due>now) {
+				uint64_t	wait=due-now;
+				snooze::microsnooze(wait/1000000,
+							wait%1000000);
+			}
+		}
+
+		sqlrcur.clearBinds();
+		for (uint16_t i=0; i<st->bindcount; i++) {
+			sqlrcur.inputBind(st->bindnames[i],st->bindvalues[i]);
+		}
+
+		datetime	qstart;
+		qstart.getSystemDateAndTime();
+		bool	result=sqlrcur.sendQuery(st->query);
+		if (result && rsbs) {
+			// fetch the rest of the result set
+			for (uint64_t row=0; sqlrcur.getRow(row); row++) {}
+		}
+		w->latency[st->cls].add(microsecondsSince(&qstart));
+		if (!result) {
+			w->errors[st->cls]++;
+			if (debug) {
+				stderror.printf("%lld: %s\n%s\n",
+						(long long)w->id,st->query,
+						sqlrcur.errorMessage());
+			}
+		}
+	}
+
+	sqlrcon.endSession();
+}
+
+static void printPercentiles(samples *s) {
+	s->sort();
+	stdoutput.printf("\"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+			"\"p99_ms\": %.3f, \"max_ms\": %.3f",
+			(double)s->percentile(50)/1000.0,
+			(double)s->percentile(90)/1000.0,
+			(double)s->percentile(99)/1000.0,
+			(double)s->percentile(100)/1000.0);
+}
+
+int main(int argc, const char **argv) {
+
+	commandline	cmdl(argc,argv);
+
+	const char	*trace=NULL;
+	uint64_t	concurrency=0;
+
+	if (cmdl.found("trace")) {
+		trace=cmdl.getValue("trace");
+	}
+	if (cmdl.found("host")) {
+		host=cmdl.getValue("host");
+	}
+	if (cmdl.found("port")) {
+		port=charstring::toUnsignedInteger(cmdl.getValue("port"));
+	}
+	if (cmdl.found("socket")) {
+		sock=cmdl.getValue("socket");
+	}
+	if (cmdl.found("user")) {
+		user=cmdl.getValue("user");
+	}
+	if (cmdl.found("password")) {
+		password=cmdl.getValue("password");
+	}
+	if (cmdl.found("speed")) {
+		speed=charstring::toFloat(cmdl.getValue("speed"));
+	}
+	if (cmdl.found("sessions")) {
+		concurrency=charstring::toUnsignedInteger(
+						cmdl.getValue("sessions"));
+	}
+	if (cmdl.found("rsbs")) {
+		rsbs=charstring::toUnsignedInteger(cmdl.getValue("rsbs"));
+	}
+	if (cmdl.found("debug")) {
+		debug=true;
+	}
+	if (cmdl.found("help","h") || charstring::isNullOrEmpty(trace)) {
+		stdoutput.printf(
+			"usage: sqlr-replay \\\n"
+			"	-trace logfile[,logfile...] \\\n"
+			"	[-host host] [-port port] [-socket socket] \\\n"
+			"	[-user user] [-password password] \\\n"
+			"	[-speed multiplier (0 = as fast as possible)] \\\n"
+			"	[-sessions concurrent-sessions] \\\n"
+			"	[-rsbs result-set-buffer-size] \\\n"
+			"	[-debug]\n");
+		process::exit(1);
+	}
+
+	// load the trace files
+	sessionset	sessions;
+	int64_t		firstusec=-1;
+	const char	*format="sql";
+	char		**files;
+	uint64_t	filecount;
+	charstring::split(trace,",",true,&files,&filecount);
+	for (uint64_t i=0; i<filecount; i++) {
+		char	*contents=file::getContents(files[i]);
+		if (!contents) {
+			stderror.printf("failed to read %s\n",files[i]);
+			process::exit(1);
+		}
+		if (isCustomNwLine(contents)) {
+			format="custom_nw";
+			loadCustomNw(contents,&sessions,&firstusec);
+		} else {
+			loadSql(files[i],contents,&sessions);
+		}
+		delete[] contents;
+		delete[] files[i];
+	}
+	delete[] files;
+
+	// Distribute the sessions over the workers.  Statements are appended
+	// in log order, so each worker's list stays in time order unless
+	// more than one session shares a worker, in which case the worker
+	// runs them one after another.
+	uint64_t	sessioncount=sessions.getSessions()->getLength();
+	if (!sessioncount) {
+		stderror.printf("no queries found\n");
+		process::exit(1);
+	}
+	if (!concurrency || concurrency>sessioncount) {
+		concurrency=sessioncount;
+	}
+	worker		*workers=new worker[concurrency];
+	uint64_t	statementcount=0;
+	uint64_t	s=0;
+	for (linkedlistnode< linkedlist< statement * > * >
+				*node=sessions.getSessions()->getFirst();
+				node; node=node->getNext()) {
+		worker	*w=&workers[s%concurrency];
+		linkedlist< statement * >	*session=node->getValue();
+		for (linkedlistnode< statement * > *sn=session->getFirst();
+						sn; sn=sn->getNext()) {
+			statement	*st=sn->getValue();
+			st->offset=(firstusec<0)?0:st->offset-firstusec;
+			w->statements.append(st);
+			statementcount++;
+		}
+		s++;
+	}
+
+	// run the workers
+	start.getSystemDateAndTime();
+	for (uint64_t i=0; i<concurrency; i++) {
+		workers[i].id=i;
+		workers[i].connectfailed=false;
+		for (uint16_t c=0; c<CLASS_COUNT; c++) {
+			workers[i].errors[c]=0;
+		}
+		if (!workers[i].thr.spawn((void *(*)(void *))replay,
+						(void *)&workers[i],false)) {
+			stderror.printf("failed to start session %lld\n",
+								(long long)i);
+			process::exit(1);
+		}
+	}
+	uint64_t	connectfailures=0;
+	for (uint64_t i=0; i<concurrency; i++) {
+		workers[i].thr.join(NULL);
+		if (workers[i].connectfailed) {
+			connectfailures++;
+		}
+	}
+	double	elapsed=(double)microsecondsSince(&start)/1000000.0;
+
+	// merge the results
+	samples		latency[CLASS_COUNT];
+	samples		all;
+	samples		handoffwait;
+	uint64_t	errors[CLASS_COUNT];
+	uint64_t	totalerrors=0;
+	for (uint16_t c=0; c<CLASS_COUNT; c++) {
+		errors[c]=0;
+		for (uint64_t i=0; i<concurrency; i++) {
+			latency[c].append(&workers[i].latency[c]);
+			errors[c]+=workers[i].errors[c];
+		}
+		all.append(&latency[c]);
+		totalerrors+=errors[c];
+	}
+	for (uint64_t i=0; i<concurrency; i++) {
+		handoffwait.append(&workers[i].handoffwait);
+	}
+
+	// report
+	uint64_t	executed=all.getCount();
+	stdoutput.printf("{\n");
+	stdoutput.printf("  \"format\": \"%s\",\n",format);
+	stdoutput.printf("  \"speed\": %.3f,\n",speed);
+	stdoutput.printf("  \"sessions\": %lld,\n",(long long)concurrency);
+	stdoutput.printf("  \"connect_failures\": %lld,\n",
+						(long long)connectfailures);
+	stdoutput.printf("  \"statements\": %lld,\n",(long long)statementcount);
+	stdoutput.printf("  \"executed\": %lld,\n",(long long)executed);
+	stdoutput.printf("  \"errors\": %lld,\n",(long long)totalerrors);
+	stdoutput.printf("  \"elapsed_sec\": %.3f,\n",elapsed);
+	stdoutput.printf("  \"throughput_qps\": %.1f,\n",
+				(elapsed>0)?(double)executed/elapsed:0.0);
+	stdoutput.printf("  \"handoff_wait\": { ");
+	printPercentiles(&handoffwait);
+	stdoutput.printf(" },\n");
+	stdoutput.printf("  \"latency\": { \"count\": %lld, ",
+						(long long)executed);
+	printPercentiles(&all);
+	stdoutput.printf(" },\n");
+	stdoutput.printf("  \"classes\": {");
+	bool	first=true;
+	for (uint16_t c=0; c<CLASS_COUNT; c++) {
+		if (!latency[c].getCount()) {
+			continue;
+		}
+		stdoutput.printf("%s\n    \"%s\": { \"count\": %lld, "
+					"\"errors\": %lld, ",
+					(first)?"":",",classnames[c],
+					(long long)latency[c].getCount(),
+					(long long)errors[c]);
+		printPercentiles(&latency[c]);
+		stdoutput.printf(" }");
+		first=false;
+	}
+	stdoutput.printf("\n  }\n}\n");
+
+	// clean up
+	for (uint64_t i=0; i<concurrency; i++) {
+		for (linkedlistnode< statement * > *node=
+					workers[i].statements.getFirst();
+					node; node=node->getNext()) {
+			deleteStatement(node->getValue());
+		}
+	}
+	delete[] workers;
+
+	process::exit((connectfailures || !executed)?1:0);
+}
@@ -5,6 +5,7 @@
 #include <rudiments/process.h>
 #include <rudiments/datetime.h>
 #include <rudiments/signalclasses.h>
+#include <rudiments/snooze.h>
 #include <sqlrelay/sqlrclient.h>
 #include <string.h>
 #include <stdlib.h>
@@ -67,6 +68,31 @@ void checkSuccess(const char *value, const char *success, size_t length) {
 	}
 }
 
+// the fingerprint of a normalized query is its
+// 64-bit FNV-1a hash, in hex, like sqlrcmd fpstat shows it
+void fingerprint(const char *normalized, char *hex, size_t hexsize) {
+	uint64_t		hash=14695981039346656037ULL;
+	const unsigned char	*ptr=(const unsigned char *)normalized;
+	while (*ptr) {
+		hash^=*ptr;
+		hash*=1099511628211ULL;
+		ptr++;
+	}
+	charstring::printf(hex,hexsize,"%016llx",
+			(unsigned long long)((hash)?hash:1));
+}
+
+// returns the sqlrcmd fpstat row for "normalized", or -1
+int64_t fingerprintRow(const char *normalized) {
+	for (uint64_t i=0; i<cur->rowCount(); i++) {
+		if (!charstring::compare(cur->getField(i,(uint32_t)8),
+							normalized)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
 void checkSuccess(int value, int success) {
 
 	if (value==success) {
@@ -404,6 +430,60 @@ int	main(int argc, char **argv) {
 	stdoutput.printf("\n\n");
 
 
+	stdoutput.printf("SQLRCMD FPSTAT: \n");
+	// these differ only by literals, case and whitespace,
+	// so they should all be counted under one fingerprint
+	const char	*fpselect="select ? fpstattest from dual";
+	checkSuccess(cur->sendQuery("select 1 fpstattest from dual"),1);
+	checkSuccess(cur->sendQuery("select 'two' fpstattest from dual"),1);
+	checkSuccess(cur->sendQuery("SELECT  3  FPSTATTEST  FROM  DUAL"),1);
+	// and these should be counted as errors
+	const char	*fperror="select fpstattest from fpstatnosuchtable "
+					"where fpstattest = ?";
+	checkSuccess(cur->sendQuery("select fpstattest "
+					"from fpstatnosuchtable "
+					"where fpstattest=1"),0);
+	checkSuccess(cur->sendQuery("select fpstattest "
+					"from fpstatnosuchtable "
+					"where fpstattest=2"),0);
+	// the totals are published at the end of the session
+	con->endSession();
+	snooze::macrosnooze(2);
+	checkSuccess(cur->sendQuery("sqlrcmd fpstat"),1);
+	checkSuccess(cur->colCount(),9);
+	stdoutput.printf("\n");
+
+	checkSuccess(cur->getColumnName((uint32_t)0),"FINGERPRINT");
+	checkSuccess(cur->getColumnName(1),"CALLS");
+	checkSuccess(cur->getColumnName(2),"ERRORS");
+	checkSuccess(cur->getColumnName(3),"ROWS");
+	checkSuccess(cur->getColumnName(4),"EXEC_TOTAL");
+	checkSuccess(cur->getColumnName(5),"EXEC_MAX");
+	checkSuccess(cur->getColumnName(6),"FETCH_TOTAL");
+	checkSuccess(cur->getColumnName(7),"FETCH_MAX");
+	checkSuccess(cur->getColumnName(8),"SQL_TEXT");
+	stdoutput.printf("\n");
+
+	char	hex[17];
+	int64_t	fprow=fingerprintRow(fpselect);
+	checkSuccess(fprow>=0,true);
+	fingerprint(fpselect,hex,sizeof(hex));
+	checkSuccess(cur->getField(fprow,(uint32_t)0),hex);
+	checkSuccess(cur->getField(fprow,(uint32_t)1),"3");
+	checkSuccess(cur->getField(fprow,(uint32_t)2),"0");
+	checkSuccess(cur->getField(fprow,(uint32_t)3),"3");
+	stdoutput.printf("\n");
+
+	fprow=fingerprintRow(fperror);
+	checkSuccess(fprow>=0,true);
+	fingerprint(fperror,hex,sizeof(hex));
+	checkSuccess(cur->getField(fprow,(uint32_t)0),hex);
+	checkSuccess(cur->getField(fprow,(uint32_t)1),"2");
+	checkSuccess(cur->getField(fprow,(uint32_t)2),"2");
+	checkSuccess(cur->getField(fprow,(uint32_t)3),"0");
+	stdoutput.printf("\n\n");
+
+
 	stdoutput.printf("SESSION QUERIES: Date Format\n");
 	checkSuccess(cur->sendQuery("select sysdate from dual"),1);
 	datetime	dt;
@@ -0,0 +1,128 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <rudiments/charstring.h>
+#include <rudiments/process.h>
+#include <sqlrelay/sqlrclient.h>
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success ");
+			return;
+		} else {
+			stdoutput.printf("%s!=%s\n",value,success);
+			stdoutput.printf("failure ");
+			delete cur;
+			delete con;
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success ");
+	} else {
+		stdoutput.printf("%s!=%s\n",value,success);
+		stdoutput.printf("failure ");
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success ");
+	} else {
+		stdoutput.printf("%d!=%d\n",value,success);
+		stdoutput.printf("failure ");
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+int	main(int argc, char **argv) {
+
+	// instantiation
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+
+	// get database type
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"mysql");
+	stdoutput.printf("\n");
+
+	// the test instance sets stmtcachesize, these check that statements
+	// are borrowed from and returned to the cache correctly
+	stdoutput.printf("STATEMENT CACHE: \n");
+	sqlrcursor	*stmtcur=new sqlrcursor(con);
+	cur->prepareQuery("select ?,?");
+	cur->inputBind("1",1);
+	cur->inputBind("2","one");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->colCount(),2);
+	checkSuccess(cur->getField(0,(uint32_t)1),"one");
+	// re-preparing returns the statement to the cache...
+	cur->prepareQuery("select 1+1");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"2");
+	// ...where another cursor can borrow it
+	stmtcur->prepareQuery("select ?,?");
+	stmtcur->inputBind("1",2);
+	stmtcur->inputBind("2","two");
+	checkSuccess(stmtcur->executeQuery(),1);
+	checkSuccess(stmtcur->colCount(),2);
+	checkSuccess(stmtcur->getField(0,(uint32_t)0),"2");
+	checkSuccess(stmtcur->getField(0,(uint32_t)1),"two");
+	stdoutput.printf("\n");
+	// while the other cursor holds it, the same query is prepared anew
+	cur->prepareQuery("select ?,?");
+	cur->inputBind("1",3);
+	cur->inputBind("2","three");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)1),"three");
+	stmtcur->inputBind("1",4);
+	stmtcur->inputBind("2","four");
+	checkSuccess(stmtcur->executeQuery(),1);
+	checkSuccess(stmtcur->getField(0,(uint32_t)1),"four");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)1),"three");
+	stdoutput.printf("\n");
+	// both statements go back to the cache and one of them is reused
+	stmtcur->prepareQuery("select 2+2,3+3,4+4");
+	checkSuccess(stmtcur->executeQuery(),1);
+	checkSuccess(stmtcur->colCount(),3);
+	checkSuccess(stmtcur->getField(0,(uint32_t)2),"8");
+	cur->prepareQuery("select 3+3");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"6");
+	stmtcur->prepareQuery("select ?,?");
+	stmtcur->inputBind("1",5);
+	stmtcur->inputBind("2","five");
+	checkSuccess(stmtcur->executeQuery(),1);
+	checkSuccess(stmtcur->colCount(),2);
+	checkSuccess(stmtcur->getField(0,(uint32_t)1),"five");
+	stdoutput.printf("\n");
+	// ending the session returns statements to the cache too
+	con->endSession();
+	cur->prepareQuery("select ?,?");
+	cur->inputBind("1",6);
+	cur->inputBind("2","six");
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"6");
+	checkSuccess(cur->getField(0,(uint32_t)1),"six");
+	delete stmtcur;
+	stdoutput.printf("\n");
+
+	delete cur;
+	delete con;
+
+	return 0;
+}
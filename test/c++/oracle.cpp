@@ -91,6 +91,41 @@ void checkSuccess(double value, double success) {
 	}
 }
 
+struct lobcallbackdata {
+	uint64_t	rows;
+	uint64_t	length;
+	uint64_t	segments;
+	uint64_t	finallength;
+	bool		valid;
+};
+
+void lobFieldCallback(sqlrcursor *cursor, uint64_t row, uint32_t col,
+					uint64_t offset, const char *segment,
+					uint32_t segmentlength,
+					uint64_t totallength, void *data) {
+
+	lobcallbackdata	*lcd=(lobcallbackdata *)data;
+
+	// the final call
+	if (!segment) {
+		lcd->finallength+=totallength;
+		lcd->rows++;
+		return;
+	}
+
+	// segments arrive in order and contain what was inserted
+	if (offset!=lcd->length-lcd->finallength || col) {
+		lcd->valid=false;
+	}
+	for (uint32_t i=0; i<segmentlength; i++) {
+		if (segment[i]!='A'+(char)((offset+i+row)%26)) {
+			lcd->valid=false;
+		}
+	}
+	lcd->length+=segmentlength;
+	lcd->segments++;
+}
+
 int	main(int argc, char **argv) {
 
 	const char	*bindvars[6]={"1","2","3","4","5",NULL};
@@ -937,6 +972,47 @@ int	main(int argc, char **argv) {
 	cur->sendQuery("drop table testtable2");
 	stdoutput.printf("\n");
 
+	stdoutput.printf("LOB FIELD CALLBACK: \n");
+	cur->sendQuery("drop table testtable2");
+	cur->sendQuery("create table testtable2 (testclob clob, testint number)");
+	cur->prepareQuery("insert into testtable2 values (:clobval,:intval)");
+	char	*bigclobval=new char[256*1024+1];
+	for (uint16_t row=0; row<2; row++) {
+		for (int i=0; i<256*1024; i++) {
+			bigclobval[i]='A'+(char)((i+row)%26);
+		}
+		bigclobval[256*1024]='\0';
+		cur->inputBindClob("clobval",bigclobval,256*1024);
+		cur->inputBind("intval",row);
+		checkSuccess(cur->executeQuery(),1);
+	}
+	delete[] bigclobval;
+	lobcallbackdata	lcd;
+	lcd.rows=0;
+	lcd.length=0;
+	lcd.segments=0;
+	lcd.finallength=0;
+	lcd.valid=true;
+	cur->setLobFieldCallback(lobFieldCallback,&lcd);
+	cur->setResultSetBufferSize(1);
+	checkSuccess(cur->sendQuery("select testclob from testtable2 order by testint"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"");
+	checkSuccess(lcd.rows,1);
+	checkSuccess(cur->getField(1,(uint32_t)0),"");
+	checkSuccess(cur->getField(2,(uint32_t)0),NULL);
+	checkSuccess(lcd.rows,2);
+	checkSuccess(lcd.length,2*256*1024);
+	checkSuccess(lcd.finallength,2*256*1024);
+	checkSuccess(lcd.segments>2,1);
+	checkSuccess(lcd.valid,1);
+	cur->setResultSetBufferSize(0);
+	cur->setLobFieldCallback(NULL,NULL);
+	checkSuccess(cur->sendQuery("select testclob from testtable2 order by testint"),1);
+	checkSuccess(cur->getFieldLength(1,(uint32_t)0),256*1024);
+	checkSuccess(cur->getField(1,(uint32_t)0)[256*1024-1],'A'+(char)((256*1024)%26));
+	cur->sendQuery("drop table testtable2");
+	stdoutput.printf("\n");
+
 
 	stdoutput.printf("LONG OUTPUT BIND\n");
 	cur->sendQuery("drop table testtable2");
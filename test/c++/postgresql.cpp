@@ -3,6 +3,8 @@
 
 #include <sqlrelay/sqlrclient.h>
 #include <rudiments/charstring.h>
+#include <rudiments/file.h>
+#include <rudiments/permissions.h>
 #include <rudiments/process.h>
 #include <rudiments/stdio.h>
 
@@ -724,6 +726,119 @@ int	main(int argc, char **argv) {
 	delete[] filename;
 	stdoutput.printf("\n");
 
+	stdoutput.printf("MAPPED CACHED RESULT SET: \n");
+	checkSuccess(cur->openCachedResultSet("cachefile1"),1);
+	checkSuccess(cur->rowCount(),8);
+	checkSuccess(cur->endOfResultSet(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1");
+	checkSuccess(cur->getField(7,(uint32_t)0),"8");
+	checkSuccess(cur->getField(7,4),"testchar8                               ");
+	checkSuccess(cur->getField(7,"testvarchar"),"testvarchar8");
+	checkSuccess(cur->getFieldAsInteger(7,(uint32_t)0),8);
+	checkSuccess(cur->getFieldLength(7,4),40);
+	checkSuccess(cur->getFieldLength(7,8),0);
+	checkSuccess(cur->getField(8,(uint32_t)0),NULL);
+	stdoutput.printf("\n");
+	fields=cur->getRow(3);
+	checkSuccess(fields[0],"4");
+	checkSuccess(fields[5],"testvarchar4");
+	checkSuccess(fields[9],"testtext4");
+	fieldlens=cur->getRowLengths(3);
+	checkSuccess(fieldlens[0],1);
+	checkSuccess(fieldlens[5],12);
+	checkSuccess(fieldlens[9],9);
+	fields=cur->getRow(0);
+	checkSuccess(fields[0],"1");
+	checkSuccess(fields[5],"testvarchar1");
+	checkSuccess(cur->getLongest(4),40);
+	checkSuccess(cur->getLongest(5),12);
+	stdoutput.printf("\n");
+
+	stdoutput.printf("PARTIALLY CACHED RESULT SET: \n");
+	cur->setResultSetBufferSize(2);
+	cur->cacheToFile("cachefile3");
+	cur->setCacheTtl(200);
+	checkSuccess(cur->sendQuery("select * from testtable order by testint"),1);
+	checkSuccess(cur->getField(2,(uint32_t)0),"3");
+	id=cur->getResultSetId();
+	cur->suspendResultSet();
+	checkSuccess(con->suspendSession(),1);
+	port=con->getConnectionPort();
+	socket=charstring::duplicate(con->getConnectionSocket());
+	secondcur=new sqlrcursor(con);
+	checkSuccess(secondcur->openCachedResultSet("cachefile3"),1);
+	checkSuccess(secondcur->rowCount(),4);
+	checkSuccess(secondcur->getField(0,(uint32_t)0),"1");
+	checkSuccess(secondcur->getField(3,(uint32_t)0),"4");
+	checkSuccess(secondcur->getField(3,5),"testvarchar4");
+	checkSuccess(secondcur->getField(4,(uint32_t)0),NULL);
+	checkSuccess(secondcur->getLongest(5),12);
+	delete secondcur;
+	stdoutput.printf("\n");
+	checkSuccess(con->resumeSession(port,socket),1);
+	checkSuccess(cur->resumeCachedResultSet(id,"cachefile3"),1);
+	checkSuccess(cur->getField(7,(uint32_t)0),"8");
+	checkSuccess(cur->getField(8,(uint32_t)0),NULL);
+	cur->cacheOff();
+	checkSuccess(cur->openCachedResultSet("cachefile3"),1);
+	checkSuccess(cur->rowCount(),8);
+	checkSuccess(cur->getField(7,(uint32_t)0),"8");
+	cur->setResultSetBufferSize(0);
+	stdoutput.printf("\n");
+
+	stdoutput.printf("VERSION 1 CACHE FILE: \n");
+	{
+		// a file in the format used before version 2,
+		// with two rows of two columns and no column info
+		file	v1;
+		file	v1ind;
+		checkSuccess(v1.open("cachefile4",O_WRONLY|O_TRUNC|O_CREAT,
+					permissions::ownerReadWrite()),1);
+		checkSuccess(v1ind.open("cachefile4.ind",
+					O_WRONLY|O_TRUNC|O_CREAT,
+					permissions::ownerReadWrite()),1);
+		v1.write("SQLRELAYCACHE",13);
+		v1ind.write("SQLRELAYCACHE",13);
+		v1.write((int64_t)2147483647);
+		v1ind.write((int64_t)2147483647);
+
+		// no error, unknown actual and affected rows, no column
+		// info, two columns, no output or input/output binds
+		v1.write((uint16_t)1);
+		v1.write((uint16_t)0);
+		v1.write((uint16_t)0);
+		v1.write((uint16_t)0);
+		v1.write((uint32_t)2);
+		v1.write((uint16_t)8);
+		v1.write((uint16_t)8);
+
+		// a string and a null, then two strings, then the end
+		v1ind.write((int64_t)v1.getCurrentPosition());
+		v1.write((uint16_t)1);
+		v1.write((uint32_t)1);
+		v1.write("1",1);
+		v1.write((uint16_t)0);
+		v1ind.write((int64_t)v1.getCurrentPosition());
+		v1.write((uint16_t)1);
+		v1.write((uint32_t)1);
+		v1.write("2",1);
+		v1.write((uint16_t)1);
+		v1.write((uint32_t)3);
+		v1.write("two",3);
+		v1.write((uint16_t)8);
+		v1.close();
+		v1ind.close();
+	}
+	checkSuccess(cur->openCachedResultSet("cachefile4"),1);
+	checkSuccess(cur->colCount(),2);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1");
+	checkSuccess(cur->getFieldLength(0,1),0);
+	checkSuccess(cur->getField(1,(uint32_t)0),"2");
+	checkSuccess(cur->getField(1,1),"two");
+	checkSuccess(cur->getField(2,(uint32_t)0),NULL);
+	checkSuccess(cur->rowCount(),2);
+	stdoutput.printf("\n");
+
 	stdoutput.printf("COMMIT AND ROLLBACK: \n");
 	secondcon=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
 							"test","test",0,1);
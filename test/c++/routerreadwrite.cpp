@@ -0,0 +1,160 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			delete cur;
+			delete con;
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkReplica(const char *value) {
+
+	if (!charstring::compare(value,"replica1") ||
+			!charstring::compare(value,"replica2")) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=replica1/replica2\n",value);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+int	main(int argc, char **argv) {
+
+	// connections directly to the primary and replicas
+	const char	*ids[3]={"primary","replica1","replica2"};
+	sqlrconnection	*dbcon[3];
+	sqlrcursor	*dbcur[3];
+	for (uint16_t i=0; i<3; i++) {
+		char	*socket=NULL;
+		charstring::printf(&socket,"/tmp/router%s.socket",ids[i]);
+		dbcon[i]=new sqlrconnection("localhost",0,socket,
+							"test","test",0,1);
+		dbcur[i]=new sqlrcursor(dbcon[i]);
+		delete[] socket;
+	}
+
+	// instantiation
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+
+	// get database type
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"router");
+	stdoutput.printf("\n");
+
+	// each database gets a table with a row that says which database it is
+	stdoutput.printf("CREATE TESTTABLES: \n");
+	for (uint16_t i=0; i<3; i++) {
+		char	*query=NULL;
+		charstring::printf(&query,
+				"insert into testtable values (1,'%s')",ids[i]);
+		dbcur[i]->sendQuery("drop table if exists testtable");
+		checkSuccess(dbcur[i]->sendQuery("create table testtable "
+					"(testint int, testvarchar varchar(40))"),1);
+		checkSuccess(dbcur[i]->sendQuery(query),1);
+		checkSuccess(dbcon[i]->commit(),1);
+		dbcon[i]->endSession();
+		delete[] query;
+	}
+	stdoutput.printf("\n");
+
+	stdoutput.printf("READ GOES TO A REPLICA: \n");
+	checkSuccess(cur->sendQuery("select testvarchar from testtable"),1);
+	checkReplica(cur->getField(0,(uint32_t)0));
+	checkSuccess(cur->sendQuery("SELECT testvarchar FROM testtable"),1);
+	checkReplica(cur->getField(0,(uint32_t)0));
+	stdoutput.printf("\n");
+
+	stdoutput.printf("READ IN A TRANSACTION GOES TO THE PRIMARY: \n");
+	checkSuccess(con->begin(),1);
+	checkSuccess(cur->sendQuery("select testvarchar from testtable"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"primary");
+	checkSuccess(con->commit(),1);
+	checkSuccess(cur->sendQuery("select testvarchar from testtable"),1);
+	checkReplica(cur->getField(0,(uint32_t)0));
+	stdoutput.printf("\n");
+
+	stdoutput.printf("WRITE GOES TO THE PRIMARY: \n");
+	checkSuccess(cur->sendQuery("insert into testtable "
+					"values (2,'written')"),1);
+	checkSuccess(con->commit(),1);
+	checkSuccess(dbcur[0]->sendQuery(
+			"select count(*) from testtable"),1);
+	checkSuccess(dbcur[0]->getField(0,(uint32_t)0),"2");
+	dbcon[0]->endSession();
+	for (uint16_t i=1; i<3; i++) {
+		checkSuccess(dbcur[i]->sendQuery(
+				"select count(*) from testtable"),1);
+		checkSuccess(dbcur[i]->getField(0,(uint32_t)0),"1");
+		dbcon[i]->endSession();
+	}
+	stdoutput.printf("\n");
+
+	stdoutput.printf("READ AFTER WRITE GOES TO THE PRIMARY: \n");
+	checkSuccess(cur->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"2");
+	stdoutput.printf("\n");
+
+	stdoutput.printf("READ IN A NEW SESSION GOES TO A REPLICA: \n");
+	con->endSession();
+	checkSuccess(cur->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1");
+	stdoutput.printf("\n");
+
+	// drop existing tables
+	con->endSession();
+	for (uint16_t i=0; i<3; i++) {
+		dbcur[i]->sendQuery("drop table testtable");
+		dbcon[i]->commit();
+		delete dbcur[i];
+		delete dbcon[i];
+	}
+
+	stdoutput.printf("\n");
+
+	delete cur;
+	delete con;
+
+	return 0;
+}
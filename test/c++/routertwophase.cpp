@@ -0,0 +1,133 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			delete cur;
+			delete con;
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkCounts(const char *count) {
+	checkSuccess(cur->sendQuery("select count(*) from twophase1"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),count);
+	checkSuccess(cur->sendQuery("select count(*) from twophase2"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),count);
+	checkSuccess(con->commit(),1);
+}
+
+int	main(int argc, char **argv) {
+
+	// instantiation
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+
+	// get database type
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"router");
+	stdoutput.printf("\n");
+
+	// twophase1 is routed to one database and twophase2 to the other,
+	// and the unique constraints aren't checked until the transaction
+	// is prepared
+	stdoutput.printf("CREATE TESTTABLES: \n");
+	cur->sendQuery("drop table twophase1");
+	cur->sendQuery("drop table twophase2");
+	checkSuccess(con->commit(),1);
+	checkSuccess(cur->sendQuery("create table twophase1 (testint int, "
+				"constraint twophase1_unique unique (testint) "
+				"deferrable initially deferred)"),1);
+	checkSuccess(cur->sendQuery("create table twophase2 (testint int, "
+				"constraint twophase2_unique unique (testint) "
+				"deferrable initially deferred)"),1);
+	checkSuccess(con->commit(),1);
+	stdoutput.printf("\n");
+
+	stdoutput.printf("TWO-PHASE COMMIT: \n");
+	checkSuccess(con->begin(),1);
+	checkSuccess(cur->sendQuery("insert into twophase1 values (1)"),1);
+	checkSuccess(cur->sendQuery("insert into twophase2 values (1)"),1);
+	checkSuccess(con->commit(),1);
+	checkCounts("1");
+	stdoutput.printf("\n");
+
+	stdoutput.printf("FAN-OUT ROLLBACK: \n");
+	checkSuccess(con->begin(),1);
+	checkSuccess(cur->sendQuery("insert into twophase1 values (2)"),1);
+	checkSuccess(cur->sendQuery("insert into twophase2 values (2)"),1);
+	checkSuccess(con->rollback(),1);
+	checkCounts("1");
+	stdoutput.printf("\n");
+
+	// both prepares fail at once, only one of the errors is reported,
+	// and the transaction is rolled back on both databases
+	stdoutput.printf("TWO-PHASE COMMIT, BOTH PREPARES FAIL: \n");
+	checkSuccess(con->begin(),1);
+	checkSuccess(cur->sendQuery("insert into twophase1 values (1)"),1);
+	checkSuccess(cur->sendQuery("insert into twophase2 values (1)"),1);
+	checkSuccess(con->commit(),0);
+	const char	*err=con->errorMessage();
+	checkSuccess((!charstring::compare(err,"postgresql1: ",13) &&
+			charstring::contains(err,"twophase1_unique")) ||
+			(!charstring::compare(err,"postgresql2: ",13) &&
+			charstring::contains(err,"twophase2_unique")),1);
+	checkCounts("1");
+	stdoutput.printf("\n");
+
+	// the connection is still usable afterwards
+	stdoutput.printf("TWO-PHASE COMMIT AFTER FAILURE: \n");
+	checkSuccess(con->begin(),1);
+	checkSuccess(cur->sendQuery("insert into twophase1 values (3)"),1);
+	checkSuccess(cur->sendQuery("insert into twophase2 values (3)"),1);
+	checkSuccess(con->commit(),1);
+	checkCounts("2");
+	stdoutput.printf("\n");
+
+	// drop existing tables
+	cur->sendQuery("drop table twophase1");
+	cur->sendQuery("drop table twophase2");
+	con->commit();
+
+	delete cur;
+	delete con;
+
+	return 0;
+}
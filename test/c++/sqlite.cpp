@@ -646,6 +646,93 @@ int	main(int argc, char **argv) {
 	checkSuccess(cur->getField(7,(uint32_t)0),NULL);
 	stdoutput.printf("\n");
 
+	stdoutput.printf("PIPELINING: \n");
+	sqlrcursor	*pipecur=new sqlrcursor(con);
+	sqlrcursor	*errcur=new sqlrcursor(con);
+	con->beginPipeline();
+	checkSuccess(cur->sendQuery("insert into testtable values (11,11.1,'testchar11','testvarchar11','testclob11','testblob11')"),1);
+	checkSuccess(pipecur->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(errcur->sendQuery("select * from nosuchtable"),1);
+	checkSuccess(con->commit(),1);
+	checkSuccess(con->endPipeline(),0);
+	checkSuccess(pipecur->getField(0,(uint32_t)0),"10");
+	checkSuccess(errcur->errorMessage()!=NULL,1);
+	checkSuccess(con->errorMessage(),NULL);
+	stdoutput.printf("\n");
+	con->beginPipeline();
+	checkSuccess(cur->sendQuery("select testint from testtable where testint=11"),1);
+	checkSuccess(pipecur->sendQuery("select testint from testtable where testint=10"),1);
+	checkSuccess(con->endPipeline(),1);
+	checkSuccess(cur->rowCount(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"11");
+	checkSuccess(pipecur->rowCount(),1);
+	checkSuccess(pipecur->getField(0,(uint32_t)0),"10");
+	stdoutput.printf("\n");
+	con->beginPipeline();
+	checkSuccess(pipecur->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(pipecur->getField(0,(uint32_t)0),"10");
+	checkSuccess(con->endPipeline(),1);
+	stdoutput.printf("\n");
+	// a cursor can only have one query in the pipeline at a time, so
+	// queue each command on a different cursor, more of them than the
+	// pipeline depth, with one in the middle that fails
+	sqlrcursor	*pipecurs[40];
+	for (uint16_t i=0; i<40; i++) {
+		pipecurs[i]=new sqlrcursor(con);
+	}
+	con->setPipelineDepth(16);
+	con->beginPipeline();
+	for (uint16_t i=0; i<40; i++) {
+		char	*query=NULL;
+		if (i==20) {
+			query=charstring::duplicate(
+					"select * from nosuchtable");
+		} else {
+			charstring::printf(&query,"select %d",i);
+		}
+		checkSuccess(pipecurs[i]->sendQuery(query),1);
+		delete[] query;
+	}
+	checkSuccess(con->endPipeline(),0);
+	for (uint16_t i=0; i<40; i++) {
+		if (i==20) {
+			checkSuccess(pipecurs[i]->errorMessage()!=NULL,1);
+		} else {
+			checkSuccess(pipecurs[i]->rowCount(),1);
+			checkSuccess(pipecurs[i]->getField(0,(uint32_t)0)!=NULL,1);
+			checkSuccess(charstring::toInteger(
+				pipecurs[i]->getField(0,(uint32_t)0)),i);
+		}
+	}
+	stdoutput.printf("\n");
+	// queue more bytes than the pipeline holds, on distinct cursors
+	char	bigclob[4001];
+	for (uint16_t i=0; i<4000; i++) {
+		bigclob[i]='x';
+	}
+	bigclob[4000]='\0';
+	con->setPipelineDepth(256);
+	con->beginPipeline();
+	for (uint16_t i=0; i<20; i++) {
+		pipecurs[i]->prepareQuery("insert into testtable values (:var1,1.1,'testchar','testvarchar',:var2,'testblob')");
+		pipecurs[i]->inputBind("var1",(int64_t)(100+i));
+		pipecurs[i]->inputBind("var2",bigclob);
+		checkSuccess(pipecurs[i]->executeQuery(),1);
+	}
+	checkSuccess(con->commit(),1);
+	checkSuccess(pipecurs[20]->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(pipecurs[21]->sendQuery("select length(testclob) from testtable where testint=119"),1);
+	checkSuccess(con->endPipeline(),1);
+	checkSuccess(pipecurs[20]->getField(0,(uint32_t)0),"30");
+	checkSuccess(pipecurs[21]->getField(0,(uint32_t)0),"4000");
+	con->setPipelineDepth(32);
+	for (uint16_t i=0; i<40; i++) {
+		delete pipecurs[i];
+	}
+	delete errcur;
+	delete pipecur;
+	stdoutput.printf("\n");
+
 	// drop existing table
 	cur->sendQuery("drop table testtable");
 
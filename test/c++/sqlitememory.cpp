@@ -0,0 +1,99 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/bytestring.h>
+#include <rudiments/process.h>
+#include <rudiments/stdio.h>
+
+// the instance has a 512KB hard memory limit,
+// and allows lob binds of up to 1MB
+#define SMALLLOB	1024
+#define LARGELOB	(1024*1024)
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+char		lob[LARGELOB+1];
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			delete cur;
+			delete con;
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+int	main(int argc, char **argv) {
+
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+
+	bytestring::set(lob,'a',LARGELOB);
+	lob[LARGELOB]='\0';
+
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"sqlite");
+	stdoutput.printf("\n");
+
+	stdoutput.printf("UNDER THE HARD LIMIT: \n");
+	cur->prepareQuery("select length(:var1)");
+	cur->inputBindClob("var1",lob,SMALLLOB);
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1024");
+	stdoutput.printf("\n");
+
+	// the bind is received, but the query
+	// is refused rather than being run
+	stdoutput.printf("OVER THE HARD LIMIT: \n");
+	cur->prepareQuery("select length(:var1)");
+	cur->inputBindClob("var1",lob,LARGELOB);
+	checkSuccess(cur->executeQuery(),0);
+	// SQLR_ERROR_MEMORYLIMIT
+	checkSuccess(cur->errorNumber(),900036);
+	stdoutput.printf("\n");
+
+	// the connection should carry on with the next query
+	stdoutput.printf("AFTER THE HARD LIMIT: \n");
+	checkSuccess(cur->sendQuery("select 1"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1");
+	cur->prepareQuery("select length(:var1)");
+	cur->inputBindClob("var1",lob,SMALLLOB);
+	checkSuccess(cur->executeQuery(),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1024");
+	stdoutput.printf("\n");
+
+	delete cur;
+	delete con;
+
+	return 0;
+}
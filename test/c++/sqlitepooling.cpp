@@ -0,0 +1,157 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/process.h>
+#include <rudiments/snooze.h>
+#include <rudiments/stdio.h>
+
+sqlrconnection	*con[3];
+sqlrcursor	*cur[3];
+
+void cleanUp() {
+	for (uint16_t i=0; i<3; i++) {
+		delete cur[i];
+		delete con[i];
+	}
+}
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			cleanUp();
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		cleanUp();
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		cleanUp();
+		process::exit(1);
+	}
+}
+
+void idle() {
+	// sit idle for longer than the poolingidletimeout (50ms)
+	// so that sessions are released back to the listener
+	snooze::microsnooze(0,250000);
+}
+
+void checkCount(uint16_t i, const char *count) {
+	checkSuccess(cur[i]->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(cur[i]->getField(0,(uint32_t)0),count);
+	cur[i]->closeResultSet();
+}
+
+int	main(int argc, char **argv) {
+
+	// There are three clients but only two connections, so every query
+	// below that ends up waiting on a connection that's held by another
+	// client's session would hang if sessions weren't being released and
+	// resumed.
+	for (uint16_t i=0; i<3; i++) {
+		con[i]=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+		cur[i]=new sqlrcursor(con[i]);
+	}
+
+	// get database type
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con[0]->identify(),"sqlite");
+	stdoutput.printf("\n");
+
+	// create a new table
+	stdoutput.printf("CREATE TESTTABLE: \n");
+	cur[0]->sendQuery("drop table testtable");
+	checkSuccess(cur[0]->sendQuery("create table testtable (testint int)"),1);
+	checkSuccess(cur[0]->sendQuery("insert into testtable values (0)"),1);
+	checkSuccess(con[0]->commit(),1);
+	cur[0]->closeResultSet();
+	idle();
+	stdoutput.printf("\n");
+
+	stdoutput.printf("RELEASE AND RESUME: \n");
+	for (uint16_t i=0; i<3; i++) {
+		checkCount(i,"1");
+		idle();
+	}
+	stdoutput.printf("\n");
+	for (uint16_t i=0; i<3; i++) {
+		checkCount(i,"1");
+	}
+	idle();
+	stdoutput.printf("\n");
+
+	stdoutput.printf("COMMITTED DATA FOLLOWS THE SESSION: \n");
+	char	count[2]={'1','\0'};
+	for (uint16_t i=0; i<3; i++) {
+		char	*query=NULL;
+		charstring::printf(&query,
+				"insert into testtable values (%d)",i+1);
+		checkSuccess(cur[i]->sendQuery(query),1);
+		checkSuccess(con[i]->commit(),1);
+		cur[i]->closeResultSet();
+		delete[] query;
+		idle();
+		count[0]++;
+		for (uint16_t j=0; j<3; j++) {
+			checkCount((i+j+1)%3,count);
+			idle();
+		}
+	}
+	stdoutput.printf("\n");
+
+	stdoutput.printf("PINNED SESSION: \n");
+	cur[0]->sendQuery("drop table temptable");
+	checkSuccess(cur[0]->sendQuery(
+			"create temporary table temptable (col1 int)"),1);
+	checkSuccess(cur[0]->sendQuery("insert into temptable values (1)"),1);
+	checkSuccess(con[0]->commit(),1);
+	cur[0]->closeResultSet();
+	idle();
+	// the other two clients have to share the remaining connection
+	for (uint16_t i=0; i<2; i++) {
+		checkCount(1,"4");
+		idle();
+		checkCount(2,"4");
+		idle();
+	}
+	checkSuccess(cur[0]->sendQuery("select count(*) from temptable"),1);
+	checkSuccess(cur[0]->getField(0,(uint32_t)0),"1");
+	cur[0]->closeResultSet();
+	con[0]->endSession();
+	idle();
+	stdoutput.printf("\n");
+
+	stdoutput.printf("ENDED SESSION: \n");
+	checkCount(0,"4");
+	stdoutput.printf("\n");
+
+	// drop existing table
+	cur[0]->sendQuery("drop table testtable");
+	con[0]->commit();
+	stdoutput.printf("\n");
+
+	cleanUp();
+
+	return 0;
+}
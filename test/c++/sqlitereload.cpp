@@ -0,0 +1,145 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/file.h>
+#include <rudiments/permissions.h>
+#include <rudiments/process.h>
+#include <rudiments/snooze.h>
+#include <rudiments/stdio.h>
+#include <stdlib.h>
+
+#define CONFIG		"../sqlrelay.conf.d/sqlitereload.conf"
+#define RELOADEDCONFIG	"../sqlrelay.conf.d/sqlitereloaded.conf"
+#define HUP		"pkill -HUP -f \"sqlr-connection.* -id sqlitereloadtest \""
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+char		*originalconfig;
+
+void restoreConfig() {
+	if (originalconfig) {
+		file::createFile(CONFIG,
+			permissions::evalPermString("rw-r--r--"),
+			originalconfig);
+		delete[] originalconfig;
+		originalconfig=NULL;
+	}
+}
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			delete cur;
+			delete con;
+			restoreConfig();
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		delete cur;
+		delete con;
+		restoreConfig();
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		delete cur;
+		delete con;
+		restoreConfig();
+		process::exit(1);
+	}
+}
+
+void connect() {
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+}
+
+void disconnect() {
+	delete cur;
+	cur=NULL;
+	delete con;
+	con=NULL;
+}
+
+int	main(int argc, char **argv) {
+
+	originalconfig=NULL;
+
+	connect();
+
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"sqlite");
+	stdoutput.printf("\n");
+
+	stdoutput.printf("CREATE TESTTABLE: \n");
+	cur->sendQuery("drop table testtable");
+	checkSuccess(cur->sendQuery("create table testtable (testint int)"),1);
+	checkSuccess(cur->sendQuery("insert into testtable values (1)"),1);
+	stdoutput.printf("\n");
+
+	stdoutput.printf("BEFORE RELOAD: \n");
+	checkSuccess(cur->sendQuery("select 'beforereload'"),0);
+	checkSuccess(cur->errorMessage(),"beforereload encountered");
+	checkSuccess(cur->sendQuery("select 'afterreload'"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"afterreload");
+	stdoutput.printf("\n");
+
+	// swap in a configuration with a different filter and connect string
+	// and tell the connection to reload while no client is connected
+	stdoutput.printf("RELOAD: \n");
+	disconnect();
+	originalconfig=file::getContents(CONFIG);
+	char	*reloadedconfig=file::getContents(RELOADEDCONFIG);
+	checkSuccess(originalconfig!=NULL,1);
+	checkSuccess(reloadedconfig!=NULL,1);
+	checkSuccess(file::createFile(CONFIG,
+				permissions::evalPermString("rw-r--r--"),
+				reloadedconfig),1);
+	delete[] reloadedconfig;
+	checkSuccess(system(HUP),0);
+	snooze::macrosnooze(3);
+	stdoutput.printf("\n");
+
+	connect();
+
+	// the new filter should be applied and the old one removed
+	stdoutput.printf("AFTER RELOAD: \n");
+	checkSuccess(cur->sendQuery("select 'afterreload'"),0);
+	checkSuccess(cur->errorMessage(),"afterreload encountered");
+	checkSuccess(cur->sendQuery("select 'beforereload'"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"beforereload");
+	stdoutput.printf("\n");
+
+	// the new connect string should be applied, and cursors rebuilt
+	// after logging back in with it should still work
+	stdoutput.printf("RELOADED CONNECT STRING: \n");
+	checkSuccess(con->identify(),"reloaded");
+	checkSuccess(cur->sendQuery("select testint from testtable"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"1");
+	checkSuccess(cur->sendQuery("drop table testtable"),1);
+	stdoutput.printf("\n");
+
+	disconnect();
+	restoreConfig();
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 1999-2018 David Muse
+// See the file COPYING for more information.
+
+#include <sqlrelay/sqlrclient.h>
+#include <rudiments/charstring.h>
+#include <rudiments/bytestring.h>
+#include <rudiments/process.h>
+#include <rudiments/snooze.h>
+#include <rudiments/stdio.h>
+
+// the instance spools result sets after 5 rows or 1 second
+#define ROWS		20
+#define LOBLENGTH	100000
+
+sqlrconnection	*con;
+sqlrcursor	*cur;
+char		lob[LOBLENGTH+1];
+
+void checkSuccess(const char *value, const char *success) {
+
+	if (!success) {
+		if (!value) {
+			stdoutput.printf("success \n");
+			return;
+		} else {
+			stdoutput.printf("failure %s!=%s\n",value,success);
+			delete cur;
+			delete con;
+			process::exit(1);
+		}
+	}
+
+	if (!charstring::compare(value,success)) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %s!=%s\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+void checkSuccess(int value, int success) {
+
+	if (value==success) {
+		stdoutput.printf("success \n");
+	} else {
+		stdoutput.printf("failure %d!=%d\n",value,success);
+		delete cur;
+		delete con;
+		process::exit(1);
+	}
+}
+
+// every row has a different lob, filled with a different letter
+void fillLob(uint64_t row) {
+	bytestring::set(lob,'a'+row,LOBLENGTH);
+	lob[LOBLENGTH]='\0';
+}
+
+// every third row has a NULL testvarchar
+void checkRow(uint64_t row) {
+
+	char	*testint=charstring::parseNumber(row+1);
+	checkSuccess(cur->getField(row,(uint32_t)0),testint);
+	delete[] testint;
+
+	if (!(row%3)) {
+		checkSuccess(cur->getField(row,1),NULL);
+	} else {
+		char	testvarchar[20];
+		charstring::printf(testvarchar,sizeof(testvarchar),
+					"testvarchar%d",(int)row+1);
+		checkSuccess(cur->getField(row,1),testvarchar);
+	}
+
+	fillLob(row);
+	checkSuccess(cur->getFieldLength(row,2),LOBLENGTH);
+	checkSuccess(cur->getField(row,2),lob);
+	checkSuccess(cur->getFieldLength(row,3),LOBLENGTH);
+	checkSuccess(cur->getField(row,3),lob);
+}
+
+int	main(int argc, char **argv) {
+
+	con=new sqlrconnection("sqlrelay",9000,"/tmp/test.socket",
+							"test","test",0,1);
+	cur=new sqlrcursor(con);
+	cur->getNullsAsNulls();
+
+	stdoutput.printf("IDENTIFY: \n");
+	checkSuccess(con->identify(),"sqlite");
+	stdoutput.printf("\n");
+
+	stdoutput.printf("CREATE TESTTABLE: \n");
+	cur->sendQuery("drop table testtable");
+	checkSuccess(cur->sendQuery("create table testtable (testint int, testvarchar varchar(40), testclob clob, testblob blob)"),1);
+	cur->prepareQuery("insert into testtable values "
+				"(:var1,:var2,:var3,:var4)");
+	for (uint64_t row=0; row<ROWS; row++) {
+		char	testvarchar[20];
+		charstring::printf(testvarchar,sizeof(testvarchar),
+					"testvarchar%d",(int)row+1);
+		fillLob(row);
+		cur->clearBinds();
+		cur->inputBind("var1",(int64_t)row+1);
+		cur->inputBind("var2",(row%3)?testvarchar:(const char *)NULL);
+		cur->inputBindClob("var3",lob,LOBLENGTH);
+		cur->inputBindBlob("var4",lob,LOBLENGTH);
+		checkSuccess(cur->executeQuery(),1);
+	}
+	stdoutput.printf("\n");
+
+	// fetch a couple of rows at a time, the rest of the result set is
+	// spooled once 5 rows have been fetched from the database
+	stdoutput.printf("SPOOL ROWS: \n");
+	cur->setResultSetBufferSize(2);
+	checkSuccess(cur->sendQuery("select * from testtable order by testint"),1);
+	for (uint64_t row=0; row<ROWS; row++) {
+		checkRow(row);
+	}
+	checkSuccess(cur->getField(ROWS,(uint32_t)0),NULL);
+	checkSuccess(cur->endOfResultSet(),1);
+	checkSuccess(cur->rowCount(),ROWS);
+	stdoutput.printf("\n");
+
+	// skip from before the point where spooling starts to after it,
+	// and then skip within the spool
+	stdoutput.printf("SKIP ACROSS SPOOL: \n");
+	cur->setResultSetBufferSize(3);
+	checkSuccess(cur->sendQuery("select * from testtable order by testint"),1);
+	checkRow(0);
+	checkRow(1);
+	checkRow(12);
+	checkSuccess(cur->firstRowIndex(),12);
+	checkRow(13);
+	checkRow(18);
+	checkRow(19);
+	checkSuccess(cur->getField(ROWS,(uint32_t)0),NULL);
+	checkSuccess(cur->endOfResultSet(),1);
+	checkSuccess(cur->rowCount(),ROWS);
+	stdoutput.printf("\n");
+
+	// fall behind before 5 rows have been fetched,
+	// the rest of the result set is spooled anyway
+	stdoutput.printf("SPOOL TIMEOUT: \n");
+	cur->setResultSetBufferSize(1);
+	checkSuccess(cur->sendQuery("select * from testtable order by testint"),1);
+	checkRow(0);
+	checkRow(1);
+	snooze::macrosnooze(2);
+	for (uint64_t row=2; row<ROWS; row++) {
+		checkRow(row);
+	}
+	checkSuccess(cur->getField(ROWS,(uint32_t)0),NULL);
+	checkSuccess(cur->rowCount(),ROWS);
+	stdoutput.printf("\n");
+
+	// the next result set on the same cursor
+	// shouldn't be served from the old spool
+	stdoutput.printf("AFTER SPOOL: \n");
+	cur->setResultSetBufferSize(0);
+	checkSuccess(cur->sendQuery("select count(*) from testtable"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"20");
+	checkSuccess(cur->sendQuery("select testint from testtable where testint=7"),1);
+	checkSuccess(cur->getField(0,(uint32_t)0),"7");
+	checkSuccess(cur->rowCount(),1);
+	stdoutput.printf("\n");
+
+	// drop existing table
+	cur->sendQuery("drop table testtable");
+
+	delete cur;
+	delete con;
+
+	return 0;
+}